@@ -51,6 +51,39 @@ std::shared_ptr<IHost> ConnectionsPool::Get(const std::string &id)
 	return out;
 }
 
+unsigned int ConnectionsPool::AcquireTransferSlots(const std::string &site_id, unsigned int limit)
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+
+	auto &busy = _site_2_busy_xfers[site_id];
+	const unsigned int out = (busy + 1 < limit) ? limit - busy : 1;
+	busy+= out;
+	return out;
+}
+
+void ConnectionsPool::ReleaseTransferSlots(const std::string &site_id, unsigned int count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> locker(_mutex);
+
+	auto it = _site_2_busy_xfers.find(site_id);
+	if (it == _site_2_busy_xfers.end() || it->second < count) {
+		fprintf(stderr, "%s: bad count=%u for '%s'\n", __FUNCTION__, count, site_id.c_str());
+		if (it != _site_2_busy_xfers.end()) {
+			_site_2_busy_xfers.erase(it);
+		}
+
+	} else if (it->second == count) {
+		_site_2_busy_xfers.erase(it);
+
+	} else {
+		it->second-= count;
+	}
+}
+
 void ConnectionsPool::PurgeAll()
 {
 	std::vector<std::shared_ptr<IHost> > purgeds; // destroy hosts out of lock
@@ -18,6 +18,7 @@ class ConnectionsPool : Threaded
 	};
 
 	std::map<std::string, PooledHost> _id_2_pooled_host;
+	std::map<std::string, unsigned int> _site_2_busy_xfers;
 	std::mutex _mutex;
 	std::condition_variable _cond;
 
@@ -34,6 +35,12 @@ public:
 	void Put(const std::string &id, std::shared_ptr<IHost> &host);
 	std::shared_ptr<IHost> Get(const std::string &id);
 
+	// Accounts concurrent file transfers to given site among all operations.
+	// Returns count of transfers granted to caller that is not above limit
+	// with exception that at least one transfer is always granted.
+	unsigned int AcquireTransferSlots(const std::string &site_id, unsigned int limit);
+	void ReleaseTransferSlots(const std::string &site_id, unsigned int count);
+
 	void PurgeAll();
 	void OnGlobalSettingsChanged();
 };
@@ -0,0 +1,516 @@
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utils.h>
+#include <crc64.h>
+#include <Threaded.h>
+#include "DirListingCache.h"
+#include "Globals.h"
+#include "PooledStrings.h"
+#include "Op/OpEnumDirectory.h"
+
+#define DIRCACHE_MAGIC     "NRDC1"
+#define DIRCACHE_MAX_SIZE  0x10000000 // dont load insanely big files
+#define DIRCACHE_MAX_TOTAL 0x4000000  // prune least recently used listings above this total size
+#define DIRCACHE_MAX_AGE   (30 * 24 * 3600) // prune listings not used for that many seconds
+#define DIRCACHE_TMP_AGE   3600 // leftovers of interrupted saves
+
+static std::atomic<unsigned int> s_tmp_counter{0};
+
+static std::string CacheKey(const std::string &site, const std::string &dir)
+{
+	std::string out = site;
+	out+= '\n';
+	out+= dir;
+	return out;
+}
+
+static std::string CacheDirPath()
+{
+	return InMyCache("NetRocks/dircache");
+}
+
+static std::string CacheFilePath(const std::string &key)
+{
+	const uint64_t h = crc64(0xC001000CAC4E, (const unsigned char *)key.data(), key.size());
+	return InMyCache(StrPrintf("NetRocks/dircache/%016llx", (unsigned long long)h).c_str());
+}
+
+static void AppendU64(std::string &out, uint64_t v)
+{
+	for (unsigned int i = 0; i < 8; ++i, v>>= 8) {
+		out+= (char)(unsigned char)(v & 0xff);
+	}
+}
+
+static void AppendStr(std::string &out, const std::string &s)
+{
+	AppendU64(out, s.size());
+	out+= s;
+}
+
+static void AppendFileTime(std::string &out, const FILETIME &ft)
+{
+	AppendU64(out, (uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime);
+}
+
+struct CacheReader
+{
+	const std::string &data;
+	size_t pos = 0;
+
+	uint64_t U64()
+	{
+		if (data.size() - pos < 8) {
+			throw std::runtime_error("truncated");
+		}
+		uint64_t out = 0;
+		for (unsigned int i = 0; i < 8; ++i) {
+			out|= uint64_t((unsigned char)data[pos + i]) << (i * 8);
+		}
+		pos+= 8;
+		return out;
+	}
+
+	void Str(std::string &out)
+	{
+		const uint64_t len = U64();
+		if (data.size() - pos < len) {
+			throw std::runtime_error("truncated");
+		}
+		out.assign(data, pos, len);
+		pos+= len;
+	}
+
+	void FileTime(FILETIME &ft)
+	{
+		const uint64_t v = U64();
+		ft.dwLowDateTime = DWORD(v & 0xffffffff);
+		ft.dwHighDateTime = DWORD(v >> 32);
+	}
+};
+
+static void SerializeItems(std::string &out, const PluginPanelItems &items, int from)
+{
+	std::string tmp;
+	for (int i = from; i < items.count; ++i) {
+		const auto &fd = items.items[i].FindData;
+		AppendStr(out, Wide2MB(fd.lpwszFileName));
+		AppendStr(out, items.items[i].Owner ? Wide2MB(items.items[i].Owner) : tmp);
+		AppendStr(out, items.items[i].Group ? Wide2MB(items.items[i].Group) : tmp);
+		AppendU64(out, fd.nFileSize);
+		AppendU64(out, fd.dwUnixMode);
+		AppendU64(out, fd.dwFileAttributes);
+		AppendFileTime(out, fd.ftCreationTime);
+		AppendFileTime(out, fd.ftLastAccessTime);
+		AppendFileTime(out, fd.ftLastWriteTime);
+	}
+}
+
+bool DirListingCache_Enabled()
+{
+	return G.GetGlobalConfigBool("DirListingCache", false);
+}
+
+uint64_t DirListingCache_Fingerprint(const PluginPanelItems &items, int from)
+{
+	std::string data;
+	SerializeItems(data, items, from);
+	return crc64(0, (const unsigned char *)data.data(), data.size());
+}
+
+bool DirListingCache_Load(const std::string &site, const std::string &dir,
+	PluginPanelItems &result, timespec &dir_mtime, uint64_t &fingerprint)
+{
+	const std::string &key = CacheKey(site, dir);
+	const std::string &path = CacheFilePath(key);
+	std::string data;
+	if (!ReadWholeFile(path.c_str(), data, DIRCACHE_MAX_SIZE) || data.empty()) {
+		return false;
+	}
+
+	const int initial_count = result.count;
+	try {
+		CacheReader cr{data};
+		std::string str, owner, group;
+		cr.Str(str);
+		if (str != DIRCACHE_MAGIC) {
+			throw std::runtime_error("bad magic");
+		}
+		cr.Str(str);
+		if (str != key) { // hash collision
+			return false;
+		}
+		dir_mtime.tv_sec = (time_t)cr.U64();
+		dir_mtime.tv_nsec = (long)cr.U64();
+		const size_t items_begin = cr.pos;
+		for (uint64_t count = cr.U64(); count; --count) {
+			cr.Str(str);
+			cr.Str(owner);
+			cr.Str(group);
+			auto *ppi = result.Add(str.c_str());
+			ppi->Owner = owner.empty() ? nullptr : (wchar_t *)MB2WidePooled(owner);
+			ppi->Group = group.empty() ? nullptr : (wchar_t *)MB2WidePooled(group);
+			ppi->FindData.nFileSize = cr.U64();
+			ppi->FindData.dwUnixMode = (DWORD)cr.U64();
+			ppi->FindData.dwFileAttributes = (DWORD)cr.U64();
+			cr.FileTime(ppi->FindData.ftCreationTime);
+			cr.FileTime(ppi->FindData.ftLastAccessTime);
+			cr.FileTime(ppi->FindData.ftLastWriteTime);
+		}
+		fingerprint = crc64(0, (const unsigned char *)data.data() + items_begin + 8, cr.pos - items_begin - 8);
+
+	} catch (std::exception &e) {
+		fprintf(stderr, "DirListingCache_Load('%s', '%s'): %s\n", site.c_str(), dir.c_str(), e.what());
+		result.Shrink(initial_count);
+		return false;
+	}
+
+	// file's modification time tells when listing was used last time, see DirListingCache_Prune
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	return true;
+}
+
+void DirListingCache_Save(const std::string &site, const std::string &dir,
+	const PluginPanelItems &items, int from, const timespec &dir_mtime)
+{
+	const std::string &key = CacheKey(site, dir);
+	std::string data;
+	AppendStr(data, DIRCACHE_MAGIC);
+	AppendStr(data, key);
+	AppendU64(data, (uint64_t)dir_mtime.tv_sec);
+	AppendU64(data, (uint64_t)dir_mtime.tv_nsec);
+	AppendU64(data, (uint64_t)std::max(items.count - from, 0));
+	SerializeItems(data, items, from);
+
+	// write to temporary file and rename it to avoid concurrent readers to see partial content
+	const std::string &path = CacheFilePath(key);
+	const std::string &tmp_path = StrPrintf("%s.%lu.%u",
+		path.c_str(), (unsigned long)getpid(), ++s_tmp_counter);
+	if (!WriteWholeFile(tmp_path.c_str(), data, 0600) || rename(tmp_path.c_str(), path.c_str()) == -1) {
+		perror("DirListingCache_Save");
+		unlink(tmp_path.c_str());
+	}
+}
+
+void DirListingCache_Drop(const std::string &site, const std::string &dir)
+{
+	unlink(CacheFilePath(CacheKey(site, dir)).c_str());
+}
+
+void DirListingCache_Prune()
+{
+	const std::string &dir_path = CacheDirPath();
+	DIR *d = opendir(dir_path.c_str());
+	if (!d) {
+		return;
+	}
+
+	struct Entry
+	{
+		std::string name;
+		time_t mtime;
+		off_t size;
+	};
+	std::vector<Entry> entries;
+	const bool enabled = DirListingCache_Enabled();
+	const time_t now = time(nullptr);
+	unsigned long long total = 0;
+	const int dfd = dirfd(d);
+	while (struct dirent *de = readdir(d)) {
+		if (de->d_name[0] == '.') {
+			continue;
+		}
+		struct stat s{};
+		if (fstatat(dfd, de->d_name, &s, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISREG(s.st_mode)) {
+			continue;
+		}
+		const time_t age = (now > s.st_mtime) ? now - s.st_mtime : 0;
+		if (strchr(de->d_name, '.') != nullptr) { // temporary file of DirListingCache_Save
+			if (age > DIRCACHE_TMP_AGE) {
+				unlinkat(dfd, de->d_name, 0);
+			}
+		} else if (!enabled || age > DIRCACHE_MAX_AGE) {
+			unlinkat(dfd, de->d_name, 0);
+		} else {
+			entries.emplace_back(Entry{de->d_name, s.st_mtime, s.st_size});
+			total+= s.st_size;
+		}
+	}
+
+	if (total > DIRCACHE_MAX_TOTAL) {
+		std::sort(entries.begin(), entries.end(),
+			[](const Entry &a, const Entry &b) { return a.mtime < b.mtime; });
+		for (const auto &e : entries) {
+			if (total <= DIRCACHE_MAX_TOTAL) {
+				break;
+			}
+			if (unlinkat(dfd, e.name.c_str(), 0) == 0) {
+				total-= e.size;
+			}
+		}
+	}
+
+	closedir(d);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+struct DirListingRevalidator::Shared
+{
+	struct Request
+	{
+		std::shared_ptr<IHost> origin;
+		std::string site, dir;
+		timespec dir_mtime;
+		uint64_t fingerprint;
+	};
+
+	void *plugin_handle;
+
+	std::mutex mtx;
+	std::unique_ptr<Request> pending;
+	std::string current_key, fresh_key;
+	std::shared_ptr<IHost> host; // clone of origin used by worker
+	std::string host_site;
+	bool worker_running = false;
+	bool aborted = false;
+};
+
+class DirListingRevalidator::Worker : protected Threaded
+{
+	std::shared_ptr<Shared> _shared;
+
+	void Process(Shared::Request &req)
+	{
+		std::shared_ptr<IHost> host;
+		{
+			std::lock_guard<std::mutex> lock(_shared->mtx);
+			if (!_shared->host || _shared->host_site != req.site) {
+				_shared->host = req.origin->Clone();
+				_shared->host_site = req.site;
+			}
+			host = _shared->host;
+		}
+		req.origin.reset();
+
+		FileInformation file_info{};
+		try {
+			host->GetInformation(file_info, req.dir);
+
+		} catch (ProtocolError &) {
+			// server failed with connection still alive means directory vanished or became
+			// inaccessible, so drop its listing and let panel re-read it with proper error
+			if (host->Alive()) {
+				DirListingCache_Drop(req.site, req.dir);
+				NotifyFresh(req);
+			}
+			throw;
+		}
+		if (req.dir_mtime.tv_sec != 0
+		 && req.dir_mtime.tv_sec == file_info.modification_time.tv_sec
+		 && req.dir_mtime.tv_nsec == file_info.modification_time.tv_nsec) {
+			return;
+		}
+
+		PluginPanelItems ppis;
+		ppis.Add(L"..")->FindData.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		std::shared_ptr<IDirectoryEnumer> enumer = host->DirectoryEnum(req.dir);
+		std::string name, owner, group;
+		FileInformation item_info;
+		while (enumer->Enum(name, owner, group, item_info)) {
+			AddEnumeratedItem(ppis, name, owner, group, item_info);
+			CheckAborted();
+		}
+		enumer.reset();
+		MarkSymlinkedDirectories(host.get(), req.dir, ppis, 1, [this] { CheckAborted(); });
+		DirListingCache_Save(req.site, req.dir, ppis, 1, file_info.modification_time);
+
+		if (DirListingCache_Fingerprint(ppis, 1) == req.fingerprint) {
+			return;
+		}
+
+		NotifyFresh(req);
+	}
+
+	void NotifyFresh(const Shared::Request &req)
+	{
+		const std::string &key = CacheKey(req.site, req.dir);
+		{
+			std::lock_guard<std::mutex> lock(_shared->mtx);
+			if (_shared->current_key != key || _shared->pending) {
+				return;
+			}
+			_shared->fresh_key = key;
+		}
+		{
+			std::lock_guard<std::mutex> lock(s_workers_mtx);
+			if (s_exiting) {
+				return;
+			}
+		}
+		// Control with plugin's handle affects only panel showing that plugin instance,
+		// so if panel was closed meanwhile then nothing happens
+		G.info.Control(_shared->plugin_handle, FCTL_UPDATEPANEL, 1, 0);
+		G.info.Control(_shared->plugin_handle, FCTL_REDRAWPANEL, 0, 0);
+	}
+
+	void CheckAborted()
+	{
+		std::lock_guard<std::mutex> lock(_shared->mtx);
+		if (_shared->aborted) {
+			throw AbortError();
+		}
+	}
+
+	virtual void *ThreadProc()
+	{
+		for (;;) {
+			std::unique_ptr<Shared::Request> req;
+			{
+				std::lock_guard<std::mutex> lock(_shared->mtx);
+				if (!_shared->pending || _shared->aborted) {
+					_shared->worker_running = false;
+					_shared->host.reset();
+					break;
+				}
+				req = std::move(_shared->pending);
+			}
+			try {
+				Process(*req);
+
+			} catch (std::exception &e) {
+				fprintf(stderr, "DirListingRevalidator('%s', '%s'): %s\n", req->site.c_str(), req->dir.c_str(), e.what());
+				std::lock_guard<std::mutex> lock(_shared->mtx);
+				_shared->host.reset();
+			}
+		}
+		return nullptr;
+	}
+
+public:
+	static std::mutex s_workers_mtx;
+	static std::condition_variable s_workers_cond;
+	static std::multiset<std::shared_ptr<Shared>> s_workers;
+	static bool s_exiting;
+
+	Worker(std::shared_ptr<Shared> &shared) : _shared(shared)
+	{
+		std::lock_guard<std::mutex> lock(s_workers_mtx);
+		s_workers.insert(_shared);
+	}
+
+	virtual ~Worker()
+	{
+		std::lock_guard<std::mutex> lock(s_workers_mtx);
+		s_workers.erase(s_workers.find(_shared));
+		s_workers_cond.notify_all();
+	}
+
+	void Start()
+	{
+		if (!StartThread(true)) {
+			fprintf(stderr, "DirListingRevalidator: can't start thread\n");
+			{
+				std::lock_guard<std::mutex> lock(_shared->mtx);
+				_shared->worker_running = false;
+				_shared->pending.reset();
+			}
+			delete this;
+		}
+	}
+};
+
+std::mutex DirListingRevalidator::Worker::s_workers_mtx;
+std::condition_variable DirListingRevalidator::Worker::s_workers_cond;
+std::multiset<std::shared_ptr<DirListingRevalidator::Shared>> DirListingRevalidator::Worker::s_workers;
+bool DirListingRevalidator::Worker::s_exiting = false;
+
+DirListingRevalidator::DirListingRevalidator(void *plugin_handle)
+	: _shared(std::make_shared<Shared>())
+{
+	_shared->plugin_handle = plugin_handle;
+}
+
+DirListingRevalidator::~DirListingRevalidator()
+{
+	std::shared_ptr<IHost> host;
+	{
+		std::lock_guard<std::mutex> lock(_shared->mtx);
+		_shared->aborted = true;
+		_shared->pending.reset();
+		_shared->current_key.clear();
+		host = _shared->host;
+	}
+	if (host) {
+		host->Abort();
+	}
+}
+
+void DirListingRevalidator::Revalidate(const std::shared_ptr<IHost> &origin, const std::string &site,
+	const std::string &dir, const timespec &dir_mtime, uint64_t fingerprint)
+{
+	{
+		std::lock_guard<std::mutex> lock(Worker::s_workers_mtx);
+		if (Worker::s_exiting) {
+			return;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_shared->mtx);
+	_shared->pending.reset(new Shared::Request{origin, site, dir, dir_mtime, fingerprint});
+	_shared->current_key = CacheKey(site, dir);
+	_shared->fresh_key.clear();
+	if (!_shared->worker_running) {
+		_shared->worker_running = true;
+		(new Worker(_shared))->Start();
+	}
+}
+
+void DirListingRevalidator::Cancel()
+{
+	std::lock_guard<std::mutex> lock(_shared->mtx);
+	_shared->pending.reset();
+	_shared->current_key.clear();
+	_shared->fresh_key.clear();
+}
+
+bool DirListingRevalidator::TakeFresh(const std::string &site, const std::string &dir)
+{
+	std::lock_guard<std::mutex> lock(_shared->mtx);
+	if (_shared->fresh_key.empty() || _shared->fresh_key != CacheKey(site, dir)) {
+		return false;
+	}
+	_shared->fresh_key.clear();
+	return true;
+}
+
+void DirListingRevalidator::sOnExiting()
+{
+	std::unique_lock<std::mutex> lock(Worker::s_workers_mtx);
+	Worker::s_exiting = true;
+	for (const auto &shared : Worker::s_workers) {
+		std::lock_guard<std::mutex> shared_lock(shared->mtx);
+		shared->aborted = true;
+		shared->pending.reset();
+		if (shared->host) {
+			shared->host->Abort();
+		}
+	}
+	// worker may wait for main thread while updating panel, so keep dispatching
+	while (!Worker::s_workers.empty()) {
+		lock.unlock();
+		G.info.FSF->DispatchInterThreadCalls();
+		lock.lock();
+		Worker::s_workers_cond.wait_for(lock, std::chrono::milliseconds(10));
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <stdint.h>
+#include <time.h>
+#include "Host/Host.h"
+#include "PluginPanelItems.h"
+
+// Optional on-disk cache of remote directories listings, keyed by site and directory path.
+// When entering directory its cached listing (if any) is shown immediately and then
+// DirListingRevalidator re-reads that directory in background and updates panel if
+// anything changed. Cached directory's modification time is used to skip re-reading
+// of directories that look unchanged since protocols don't provide anything like ETag
+// for directories.
+
+bool DirListingCache_Enabled();
+
+// appends cached items to result, returns false if nothing cached or cache is broken
+bool DirListingCache_Load(const std::string &site, const std::string &dir,
+	PluginPanelItems &result, timespec &dir_mtime, uint64_t &fingerprint);
+
+// caches items starting from given index, zero dir_mtime means its unknown
+void DirListingCache_Save(const std::string &site, const std::string &dir,
+	const PluginPanelItems &items, int from, const timespec &dir_mtime);
+
+uint64_t DirListingCache_Fingerprint(const PluginPanelItems &items, int from);
+
+// removes cached listing of directory that can't be read anymore
+void DirListingCache_Drop(const std::string &site, const std::string &dir);
+
+// removes listings unused for long time or least recently used ones if cache grew too big,
+// or everything if cache is disabled
+void DirListingCache_Prune();
+
+
+class DirListingRevalidator
+{
+	struct Shared;
+	class Worker;
+
+	std::shared_ptr<Shared> _shared;
+
+public:
+	DirListingRevalidator(void *plugin_handle);
+	~DirListingRevalidator();
+
+	// schedules background re-read of directory shown from cache, replaces previously scheduled one
+	void Revalidate(const std::shared_ptr<IHost> &origin, const std::string &site,
+		const std::string &dir, const timespec &dir_mtime, uint64_t fingerprint);
+
+	// panel doesn't show cached listing anymore
+	void Cancel();
+
+	// returns true once if cache was refreshed for given directory and panel asked to update
+	bool TakeFresh(const std::string &site, const std::string &dir);
+
+	static void sOnExiting();
+};
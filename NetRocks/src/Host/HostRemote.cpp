@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <wchar.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -8,6 +9,7 @@
 #include <fcntl.h>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <ScopeHelpers.h>
 #include <Threaded.h>
 #include <UtfConvert.hpp>
@@ -218,6 +220,7 @@ void HostRemote::CheckReady()
 void HostRemote::OnBroken()
 {
 	IPCEndpoint::SetFD(-1, -1);
+	_shared_buf.Reset();
 	_peer = 0;
 	_init_deinit_cmd.reset();
 }
@@ -252,6 +255,10 @@ void HostRemote::ReInitialize()
 	char keep_alive_arg[32];
 	snprintf(keep_alive_arg, sizeof(keep_alive_arg), "%d", sc_options.GetInt("KeepAlive", 0));
 
+	int fd_shared_buf = _shared_buf.Create();
+	char shared_buf_arg[32];
+	snprintf(shared_buf_arg, sizeof(shared_buf_arg), "%d", fd_shared_buf);
+
 	std::string work_path = broker_path;
 	TranslateInstallPath_Lib2Share(work_path);
 
@@ -287,11 +294,11 @@ void HostRemote::ReInitialize()
 		}
 		if (fork() == 0) {
 			if (prxf == "proxychains") {
-				execlp("proxychains", "proxychains", "-f", prxf_cfg.c_str(),
-					broker_pathname.c_str(), ipc_fd.broker_arg_r, ipc_fd.broker_arg_w, keep_alive_arg, NULL);
+				execlp("proxychains", "proxychains", "-f", prxf_cfg.c_str(), broker_pathname.c_str(),
+					ipc_fd.broker_arg_r, ipc_fd.broker_arg_w, keep_alive_arg, shared_buf_arg, NULL);
 			} else {
-				execl(broker_pathname.c_str(),
-					broker_pathname.c_str(), ipc_fd.broker_arg_r, ipc_fd.broker_arg_w, keep_alive_arg, NULL);
+				execl(broker_pathname.c_str(), broker_pathname.c_str(),
+					ipc_fd.broker_arg_r, ipc_fd.broker_arg_w, keep_alive_arg, shared_buf_arg, NULL);
 			}
 			_exit(-1);
 			exit(-2);
@@ -313,13 +320,25 @@ void HostRemote::ReInitialize()
 	// so far so good - avoid automatic closing of pipes FDs in ipc_fd's d-tor
 	ipc_fd.Detach();
 
+	// broker got own copy of shared buffer's FD, mapping remains valid without it
+	if (fd_shared_buf != -1) {
+		CheckedCloseFD(fd_shared_buf);
+	}
+
 	uint32_t ipc_ver_magic = 0;
 
 	try {
 		pid_t peer = 0;
+		bool shared_buf_attached = false;
 		RecvPOD(ipc_ver_magic);
 		RecvPOD(peer);
+		if (ipc_ver_magic == IPC_VERSION_MAGIC) {
+			RecvPOD(shared_buf_attached);
+		}
 		_peer = peer;
+		if (!shared_buf_attached) {
+			_shared_buf.Reset();
+		}
 
 	} catch (std::exception &) {
 		OnBroken();
@@ -718,6 +737,7 @@ class HostRemoteFileIO : public IFileReader, public IFileWriter
 {
 	std::shared_ptr<HostRemote> _conn;
 	bool _complete = false, _writing;
+	size_t _write_seq = 0;
 
 	void EnsureComplete()
 	{
@@ -752,6 +772,11 @@ public:
 			return 0;
 		}
 
+		IPCSharedBuffer &shared_buf = _conn->_shared_buf;
+		if (shared_buf.Active() && len > shared_buf.Size()) {
+			len = shared_buf.Size();
+		}
+
 		try {
 			_conn->SendPOD(len);
 			_conn->RecvReply(IPC_FILE_GET);
@@ -766,7 +791,11 @@ public:
 				_conn->Abort();
 				throw ProtocolError("Read: IPC gonna mad");
 			}
-			_conn->Recv(buf, recv_len);
+			if (shared_buf.Active()) {
+				memcpy(buf, shared_buf.Data(), recv_len);
+			} else {
+				_conn->Recv(buf, recv_len);
+			}
 			return recv_len;
 
 		} catch (...) {
@@ -785,10 +814,26 @@ public:
 			throw std::runtime_error("Write: already complete");
 		}
 
+		IPCSharedBuffer &shared_buf = _conn->_shared_buf;
+
 		try {
-			_conn->SendPOD(len);
-			_conn->Send(buf, len);
-			_conn->RecvReply(IPC_FILE_PUT);
+			if (!shared_buf.Active()) {
+				_conn->SendPOD(len);
+				_conn->Send(buf, len);
+				_conn->RecvReply(IPC_FILE_PUT);
+				return;
+			}
+
+			// Broker replies on chunk before writing it but after it completed writing of previous
+			// chunk, so on reply receival previous slot is free and can be filled by next chunk
+			// while broker still writing current one.
+			for (size_t ofs = 0; ofs < len; ++_write_seq) {
+				const size_t piece = std::min(len - ofs, shared_buf.SlotSize());
+				memcpy(shared_buf.Slot(_write_seq), (const char *)buf + ofs, piece);
+				_conn->SendPOD(piece);
+				_conn->RecvReply(IPC_FILE_PUT);
+				ofs+= piece;
+			}
 
 		} catch (...) {
 			_complete = true;
@@ -7,6 +7,7 @@
 
 #include "Host.h"
 #include "IPC.h"
+#include "IPCSharedBuffer.h"
 #include "FileInformation.h"
 #include "InitDeinitCmd.h"
 
@@ -35,6 +36,7 @@ class HostRemote : protected IPCEndpoint, public std::enable_shared_from_this<Ho
 	bool _busy = false;
 	bool _cloning = false;
 	std::atomic<pid_t> _peer{0};
+	IPCSharedBuffer _shared_buf;
 
 	void RecvReply(IPCCommand cmd);
 
@@ -1,9 +1,11 @@
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <unistd.h>
 #include <stdlib.h>
 #include <signal.h>
 #include "IPC.h"
+#include "IPCSharedBuffer.h"
 #include "Protocol/Protocol.h"
 
 static const std::string s_empty_string;
@@ -33,6 +35,7 @@ class HostRemoteBroker : protected IPCEndpoint
 	} _args;
 
 	std::vector<char> _io_buf;
+	IPCSharedBuffer _shared_buf;
 
 	void InitConnection(int fd_recv)
 	{
@@ -111,11 +114,18 @@ class HostRemoteBroker : protected IPCEndpoint
 				SendCommand(IPC_STOP);
 				break;
 			}
+			char *buf;
 			try {
-				if (_io_buf.size() < len) {
-					_io_buf.resize(len);
+				if (_shared_buf.Active()) {
+					len = std::min(len, _shared_buf.Size());
+					buf = _shared_buf.Data();
+				} else {
+					if (_io_buf.size() < len) {
+						_io_buf.resize(len);
+					}
+					buf = &_io_buf[0];
 				}
-				len = reader->Read(&_io_buf[0], len);
+				len = reader->Read(buf, len);
 			} catch (std::exception &ex) {
 				fprintf(stderr, "OnFileGet: %s\n", ex.what());
 				SendCommand(IPC_ERROR);
@@ -127,7 +137,9 @@ class HostRemoteBroker : protected IPCEndpoint
 			if (len == 0) {
 				break;
 			}
-			Send(&_io_buf[0], len);
+			if (!_shared_buf.Active()) {
+				Send(buf, len);
+			}
 		}
 	}
 
@@ -141,16 +153,17 @@ class HostRemoteBroker : protected IPCEndpoint
 		SendCommand(IPC_FILE_PUT);
 		// Trick to improve IO parallelization: instead of sending status reply on operation,
 		// send preliminary OK and if error will occur - do error reply on next operation.
+		// With shared buffer data comes in its slots in round-robin order, see HostRemoteFileIO::Write
 		std::string error_str;
-		for (;;) {
+		for (size_t seq = 0;; ++seq) {
 			size_t len = 0;
 			RecvPOD(len);
-			if (_io_buf.size() < len) {
+			if (!_shared_buf.Active() && _io_buf.size() < len) {
 				_io_buf.resize(len);
 			}
 
 			if (!error_str.empty()) {
-				if (len) {
+				if (len && !_shared_buf.Active()) {
 					// still have to fetch buffer to ensure proper IPC sequencing
 					Recv(&_io_buf[0], len);
 				}
@@ -165,9 +178,18 @@ class HostRemoteBroker : protected IPCEndpoint
 			}
 			SendCommand(IPC_FILE_PUT);
 
-			Recv(&_io_buf[0], len);
+			const char *buf;
+			if (_shared_buf.Active()) {
+				if (len > _shared_buf.SlotSize()) {
+					throw PipeIPCError("OnFilePut: bad length", (unsigned int)len);
+				}
+				buf = _shared_buf.Slot(seq);
+			} else {
+				Recv(&_io_buf[0], len);
+				buf = &_io_buf[0];
+			}
 			try {
-				writer->Write(&_io_buf[0], len);
+				writer->Write(buf, len);
 			} catch (ProtocolError &ex) {
 				fprintf(stderr, "OnFilePut: %s\n", ex.what());
 				error_str = ex.what();
@@ -344,12 +366,16 @@ class HostRemoteBroker : protected IPCEndpoint
 	}
 
 public:
-	HostRemoteBroker(int fd_recv, int fd_send, int keepalive) :
+	HostRemoteBroker(int fd_recv, int fd_send, int keepalive, int fd_shared_buf) :
 		IPCEndpoint(fd_recv, fd_send),
 		_keepalive(keepalive)
 	{
+		if (fd_shared_buf != -1) {
+			_shared_buf.Attach(fd_shared_buf);
+		}
 		SendPOD((uint32_t)IPC_VERSION_MAGIC);
 		SendPOD((pid_t)getpid());
+		SendPOD(_shared_buf.Active());
 
 		for (;;) try {
 			InitConnection(fd_recv);
@@ -414,7 +440,7 @@ void handle_sigquit(int) {
 
 int main(int argc, char *argv[])
 {
-	if (argc != 4) {
+	if (argc != 5) {
 		fprintf(stderr, "Its a NetRocks protocol broker and must be started by NetRocks only\n");
 		return -1;
 	}
@@ -427,7 +453,7 @@ int main(int argc, char *argv[])
 
 	fprintf(stderr, "%d: HostRemoteBrokerMain: BEGIN\n", getpid());
 	try {
-		HostRemoteBroker(atoi(argv[1]), atoi(argv[2]), atoi(argv[3])).Loop();
+		HostRemoteBroker(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]), atoi(argv[4])).Loop();
 
 	} catch (std::exception &e) {
 		fprintf(stderr, "%d HostRemoteBrokerMain: %s\n", getpid(), e.what());
@@ -0,0 +1,95 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <utils.h>
+#include "IPCSharedBuffer.h"
+
+IPCSharedBuffer::~IPCSharedBuffer()
+{
+	Reset();
+}
+
+void IPCSharedBuffer::Reset()
+{
+	if (_ptr) {
+		munmap(_ptr, _size);
+		_ptr = nullptr;
+		_size = 0;
+	}
+}
+
+static int CreateSharedFD()
+{
+#if defined(__linux__)
+	int fd = memfd_create("NetRocks-IPC", 0);
+	if (fd != -1) {
+		return fd;
+	}
+	fprintf(stderr, "IPCSharedBuffer: memfd_create error %d\n", errno);
+#endif
+	std::string path = InMyTemp("NetRocks/shbufXXXXXX");
+	int fd_tmp = mkstemp(&path[0]);
+	if (fd_tmp == -1) {
+		fprintf(stderr, "IPCSharedBuffer: mkstemp('%s') error %d\n", path.c_str(), errno);
+		return -1;
+	}
+	unlink(path.c_str());
+	return fd_tmp;
+}
+
+int IPCSharedBuffer::Create()
+{
+	Reset();
+
+	const size_t size = IPC_SHARED_BUFFER_SLOTS * IPC_SHARED_BUFFER_SLOT_SIZE;
+	int fd = CreateSharedFD();
+	if (fd == -1) {
+		return -1;
+	}
+
+	if (ftruncate(fd, size) == -1) {
+		fprintf(stderr, "IPCSharedBuffer: ftruncate error %d\n", errno);
+		CheckedCloseFD(fd);
+		return -1;
+	}
+
+	void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "IPCSharedBuffer: mmap error %d\n", errno);
+		CheckedCloseFD(fd);
+		return -1;
+	}
+
+	_ptr = ptr;
+	_size = size;
+	return fd;
+}
+
+bool IPCSharedBuffer::Attach(int fd)
+{
+	Reset();
+
+	const size_t size = IPC_SHARED_BUFFER_SLOTS * IPC_SHARED_BUFFER_SLOT_SIZE;
+	struct stat s{};
+	if (fstat(fd, &s) == -1 || s.st_size < (off_t)size) {
+		fprintf(stderr, "IPCSharedBuffer: bad FD %d\n", fd);
+		CheckedCloseFD(fd);
+		return false;
+	}
+
+	void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	CheckedCloseFD(fd);
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "IPCSharedBuffer: mmap error %d\n", errno);
+		return false;
+	}
+
+	_ptr = ptr;
+	_size = size;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+
+// Shared memory area used to pass files data between HostRemote and its broker
+// avoiding copying it through IPC pipes, so only small descriptors are sent via pipes.
+// Master side creates it before starting broker and passes its FD as broker's argument.
+// Area split into IPC_SHARED_BUFFER_SLOTS slots to let master fill next chunk while
+// broker still writing previous one, see HostRemoteFileIO::Write for details.
+
+#define IPC_SHARED_BUFFER_SLOTS      2
+#define IPC_SHARED_BUFFER_SLOT_SIZE  0x100000
+
+class IPCSharedBuffer
+{
+	void *_ptr = nullptr;
+	size_t _size = 0;
+
+public:
+	IPCSharedBuffer() = default;
+	IPCSharedBuffer(const IPCSharedBuffer &) = delete;
+	~IPCSharedBuffer();
+
+	// master side: creates area and returns its FD that must be closed after broker started
+	// returns -1 on failure, in such case shared buffer will not be used
+	int Create();
+
+	// broker side: maps area of given FD and closes that FD
+	bool Attach(int fd);
+
+	void Reset();
+
+	inline bool Active() const { return _ptr != nullptr; }
+
+	inline size_t Size() const { return _size; }
+	inline char *Data() { return (char *)_ptr; }
+
+	inline size_t SlotSize() const { return _size / IPC_SHARED_BUFFER_SLOTS; }
+	inline char *Slot(size_t seq) { return (char *)_ptr + (seq % IPC_SHARED_BUFFER_SLOTS) * SlotSize(); }
+};
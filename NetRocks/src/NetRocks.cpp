@@ -1,6 +1,7 @@
 #include <utils.h>
 #include "Globals.h"
 #include "PluginImpl.h"
+#include "DirListingCache.h"
 #include "BackgroundTasks.h"
 #include "UI/Activities/BackgroundTasksUI.h"
 #include "Protocol/Protocol.h"
@@ -27,6 +28,7 @@ SHAREDSYMBOL int WINAPI _export GetMinFarVersionW(void)
 SHAREDSYMBOL void WINAPI _export SetStartupInfoW(const struct PluginStartupInfo *Info)
 {
 	G.Startup(Info);
+	DirListingCache_Prune();
 //	fprintf(stderr, "FSF=%p ExecuteLibrary=%p\n", G.info.FSF, G.info.FSF ? G.info.FSF->ExecuteLibrary : nullptr);
 
 }
@@ -4,6 +4,66 @@
 #include "../UI/Activities/SimpleOperationProgress.h"
 #include "../PooledStrings.h"
 
+PluginPanelItem *AddEnumeratedItem(PluginPanelItems &result, const std::string &name,
+	const std::string &owner, const std::string &group, FileInformation &file_info)
+{
+	auto *ppi = result.Add(name.c_str());
+	ppi->FindData.nFileSize = file_info.size;
+	ppi->FindData.dwUnixMode = file_info.mode;
+	ppi->FindData.dwFileAttributes = WINPORT(EvaluateAttributesA)(file_info.mode, name.c_str());
+	ppi->Owner = (wchar_t *)MB2WidePooled(owner);
+	ppi->Group = (wchar_t *)MB2WidePooled(group);
+
+	WINPORT(FileTime_UnixToWin32)(file_info.access_time, &ppi->FindData.ftLastAccessTime);
+	WINPORT(FileTime_UnixToWin32)(file_info.modification_time, &ppi->FindData.ftLastWriteTime);
+	if (file_info.status_change_time.tv_sec) { // libssh often returns zero attributes->createtime (their bug?)
+		WINPORT(FileTime_UnixToWin32)(file_info.status_change_time, &ppi->FindData.ftCreationTime);
+	} else {
+		file_info.status_change_time = file_info.modification_time;
+	}
+
+	return ppi;
+}
+
+void MarkSymlinkedDirectories(IHost *host, const std::string &base_dir,
+	PluginPanelItems &result, int from, const std::function<void()> &on_item)
+{
+	std::vector<std::string> paths;
+	std::vector<mode_t> modes;
+	std::vector<DWORD *> pattrs;
+	size_t paths_len = 0;
+	for (int i = from; ; ++i) {
+		if (paths_len >= 1024 || i >= result.count) {
+			if (!paths.empty()) {
+				host->GetModes(true, paths.size(), paths.data(), modes.data());
+				for (size_t j = 0; j < paths.size(); ++j) {
+					if (modes[j] != (mode_t)-1 && S_ISDIR(modes[j])) {
+						(*pattrs[j])|= FILE_ATTRIBUTE_DIRECTORY;
+					}
+				}
+				paths.clear();
+				modes.clear();
+				pattrs.clear();
+				paths_len = 0;
+			}
+			if (i >= result.count) break;
+		}
+		auto &entry = result.items[i];
+		if (S_ISLNK(entry.FindData.dwUnixMode)) {
+			paths.emplace_back(base_dir);
+			if (!base_dir.empty() && base_dir.back() != '/') {
+				paths.back()+= '/';
+			}
+			paths.back()+= Wide2MB(entry.FindData.lpwszFileName);
+			paths_len+= paths.back().size();
+			modes.emplace_back(~(mode_t)0);
+			pattrs.emplace_back(&entry.FindData.dwFileAttributes);
+		}
+		on_item();
+	}
+}
+
+
 OpEnumDirectory::OpEnumDirectory(int op_mode, std::shared_ptr<IHost> &base_host, const std::string &base_dir, PluginPanelItems &result, std::shared_ptr<WhatOnErrorState> &wea_state)
 	:
 	OpBase(op_mode, base_host, base_dir, wea_state),
@@ -46,20 +106,7 @@ void OpEnumDirectory::Process()
 					break;
 				}
 
-				auto *ppi = _result.Add(name.c_str());
-				ppi->FindData.nFileSize = file_info.size;
-				ppi->FindData.dwUnixMode = file_info.mode;
-				ppi->FindData.dwFileAttributes = WINPORT(EvaluateAttributesA)(file_info.mode, name.c_str());
-				ppi->Owner = (wchar_t *)MB2WidePooled(owner);
-				ppi->Group = (wchar_t *)MB2WidePooled(group);
-
-				WINPORT(FileTime_UnixToWin32)(file_info.access_time, &ppi->FindData.ftLastAccessTime);
-				WINPORT(FileTime_UnixToWin32)(file_info.modification_time, &ppi->FindData.ftLastWriteTime);
-				if (file_info.status_change_time.tv_sec) { // libssh often returns zero attributes->createtime (their bug?)
-					WINPORT(FileTime_UnixToWin32)(file_info.status_change_time, &ppi->FindData.ftCreationTime);
-				} else {
-					file_info.status_change_time = file_info.modification_time;
-				}
+				AddEnumeratedItem(_result, name, owner, group, file_info);
 
 				ProgressStateUpdate psu(_state);
 				_state.stats.count_complete++;
@@ -75,41 +122,9 @@ void OpEnumDirectory::Process()
 		}
 	);
 
-	// Now for those of them which are symlinks check if they point to directory and
-	// set FILE_ATTRIBUTE_DIRECTORY to tell far2l that they're 'enterable' directories
-	// note that not care about possible faults for a reason to do not bother user with
+	// Now for those of them which are symlinks check if they point to directory.
+	// Note that not care about possible faults for a reason to do not bother user with
 	// annoying errors if some directories target's will appear inaccessible.
-	std::vector<std::string> paths;
-	std::vector<mode_t> modes;
-	std::vector<DWORD *> pattrs;
-	size_t paths_len = 0;
-	for (int i = _initial_result_count; ; ++i) {
-		if (paths_len >= 1024 || i >= _result.count) {
-			if (!paths.empty()) {
-				_base_host->GetModes(true, paths.size(), paths.data(), modes.data());
-				for (size_t j = 0; j < paths.size(); ++j) {
-					if (modes[j] != (mode_t)-1 && S_ISDIR(modes[j])) {
-						(*pattrs[j])|= FILE_ATTRIBUTE_DIRECTORY;
-					}
-				}
-				paths.clear();
-				modes.clear();
-				pattrs.clear();
-				paths_len = 0;
-			}
-			if (i >= _result.count) break;
-		}
-		auto &entry = _result.items[i];
-		if (S_ISLNK(entry.FindData.dwUnixMode)) {
-			paths.emplace_back(_base_dir);
-			if (!_base_dir.empty() && _base_dir.back() != '/') {
-				paths.back()+= '/';
-			}
-			paths.back()+= Wide2MB(entry.FindData.lpwszFileName);
-			paths_len+= paths.back().size();
-			modes.emplace_back(~(mode_t)0);
-			pattrs.emplace_back(&entry.FindData.dwFileAttributes);
-		}
-		ProgressStateUpdate psu(_state); // check for pause/abort
-	}
+	MarkSymlinkedDirectories(_base_host.get(), _base_dir, _result, _initial_result_count,
+		[this] { ProgressStateUpdate psu(_state); }); // check for pause/abort
 }
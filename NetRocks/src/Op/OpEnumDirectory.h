@@ -1,7 +1,17 @@
 #pragma once
+#include <functional>
 #include "OpBase.h"
 #include "../PluginPanelItems.h"
 
+// Helpers shared with background listings revalidation (see DirListingCache)
+PluginPanelItem *AddEnumeratedItem(PluginPanelItems &result, const std::string &name,
+	const std::string &owner, const std::string &group, FileInformation &file_info);
+
+// For items that are symlinks check if they point to directory and set FILE_ATTRIBUTE_DIRECTORY
+// to tell far2l that they're 'enterable' directories. on_item invoked per each inspected item.
+void MarkSymlinkedDirectories(IHost *host, const std::string &base_dir,
+	PluginPanelItems &result, int from, const std::function<void()> &on_item);
+
 
 class OpEnumDirectory : protected OpBase
 {
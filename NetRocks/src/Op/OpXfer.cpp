@@ -15,9 +15,141 @@
 
 #define EXTRA_NEEDED_MODE	(S_IRUSR | S_IWUSR)
 
+#define MAX_PARALLEL_TRANSFERS    32
+
+// identifies remote site for transfers accounting and connections pooling, empty for local host
+static std::string XferSiteId(IHost *host)
+{
+	IHost::Identity identity;
+	host->GetIdentity(identity);
+	if (identity.protocol.empty()) {
+		return std::string();
+	}
+
+	return StrPrintf("xfer:%s://%s@%s:%u%s", identity.protocol.c_str(),
+		identity.username.c_str(), identity.host.c_str(), identity.port, host->SiteName().c_str());
+}
+
+// Each worker transfers regular files, queued by OpXfer::Transfer, using own pair of connections.
+// Connections are taken from connections pool if there are ones left by previous transfers,
+// otherwise operation's hosts are cloned. On completion alive connections are returned to pool.
+class OpXfer::FileXferWorker : public Threaded
+{
+	OpXfer *_op;
+	std::string _src_pool_id, _dst_pool_id;
+	std::shared_ptr<IHost> _src_host, _dst_host;
+	IOBuffer _io_buf;
+	bool _failed = false;
+
+	std::shared_ptr<IHost> PooledOrCloned(const std::string &pool_id, std::shared_ptr<IHost> &host)
+	{
+		std::shared_ptr<IHost> out;
+		if (!pool_id.empty()) {
+			out = _op->_conn_pool->Get(pool_id);
+		}
+		if (!out) {
+			out = host->Clone();
+		}
+		return out;
+	}
+
+	bool FetchJob(FileXferJob &job)
+	{
+		std::unique_lock<std::mutex> lock(_op->_jobs_mtx);
+		while (_op->_jobs.empty() && !_op->_jobs_finish) {
+			_op->_jobs_cond.wait(lock);
+		}
+		if (_op->_jobs.empty()) {
+			return false;
+		}
+		job = std::move(_op->_jobs.front());
+		_op->_jobs.pop_front();
+		_op->_jobs_cond.notify_all(); // queue has free space now
+		return true;
+	}
+
+	void OnJobsInterrupted(bool cancelled)
+	{
+		std::lock_guard<std::mutex> lock(_op->_jobs_mtx);
+		if (cancelled) {
+			_op->_jobs_cancelled = true;
+		} else {
+			_op->_jobs_failed = true;
+		}
+		_op->_jobs.clear();
+		_op->_jobs_cond.notify_all();
+	}
+
+protected:
+	virtual void *ThreadProc()
+	{
+		SudoClientRegion sdc_region;
+		FileXferJob job;
+		while (FetchJob(job)) try {
+			if (!_op->FileXfer(_src_host.get(), _dst_host.get(), _io_buf, job.path_src, job.path_dst, *job.info)) {
+				OnJobsInterrupted(true);
+				break;
+			}
+
+		} catch (std::exception &ex) {
+			fprintf(stderr, "NetRocks::FileXferWorker: %s on '%s'\n", ex.what(), job.path_src.c_str());
+			_failed = true;
+			OnJobsInterrupted(false);
+			break;
+		}
+
+		return nullptr;
+	}
+
+public:
+	FileXferWorker(OpXfer *op, unsigned int index)
+		:
+		_op(op),
+		_io_buf(BUFFER_SIZE_INITIAL, BUFFER_SIZE_GRANULARITY, BUFFER_SIZE_LIMIT)
+	{
+		_src_pool_id = XferSiteId(op->_base_host.get());
+		if (!_src_pool_id.empty()) {
+			_src_pool_id+= StrPrintf("#src%u", index);
+		}
+		_dst_pool_id = XferSiteId(op->_dst_host.get());
+		if (!_dst_pool_id.empty()) {
+			_dst_pool_id+= StrPrintf("#dst%u", index);
+		}
+		_src_host = PooledOrCloned(_src_pool_id, op->_base_host);
+		_dst_host = PooledOrCloned(_dst_pool_id, op->_dst_host);
+	}
+
+	~FileXferWorker()
+	{
+		WaitThread();
+		if (!_failed) {
+			_op->_conn_pool->Put(_src_pool_id, _src_host);
+			_op->_conn_pool->Put(_dst_pool_id, _dst_host);
+		}
+	}
+
+	bool Start()
+	{
+		return StartThread();
+	}
+
+	void Join()
+	{
+		WaitThread();
+	}
+
+	void Abort()
+	{
+		_src_host->Abort();
+		_dst_host->Abort();
+	}
+};
+
+
 OpXfer::OpXfer(int op_mode, std::shared_ptr<IHost> &base_host, const std::string &base_dir,
 	std::shared_ptr<IHost> &dst_host, const std::string &dst_dir,
-	struct PluginPanelItem *items, int items_count, XferKind kind, XferDirection direction)
+	struct PluginPanelItem *items, int items_count, XferKind kind, XferDirection direction,
+	std::shared_ptr<ConnectionsPool> conn_pool)
 	:
 	OpBase(op_mode, base_host, base_dir),
 
@@ -27,7 +159,8 @@ OpXfer::OpXfer(int op_mode, std::shared_ptr<IHost> &base_host, const std::string
 	_direction(direction),
 	_io_buf(BUFFER_SIZE_INITIAL, BUFFER_SIZE_GRANULARITY, BUFFER_SIZE_LIMIT),
 	_smart_symlinks_copy(G.GetGlobalConfigBool("SmartSymlinksCopy", true)),
-	_use_of_chmod(G.GetGlobalConfigInt("UseOfChmod", 0))
+	_use_of_chmod(G.GetGlobalConfigInt("UseOfChmod", 0)),
+	_conn_pool(conn_pool)
 {
 
 	_enumer = std::make_shared<Enumer>(_entries, _base_host, _base_dir, items, items_count, true, _state, _wea_state);
@@ -168,6 +301,11 @@ void OpXfer::Abort()
 
 	_dst_host->Abort();
 	_base_host->Abort();
+
+	std::lock_guard<std::mutex> locker(_jobs_mtx);
+	for (const auto &worker : _workers) {
+		worker->Abort();
+	}
 }
 
 void OpXfer::Process()
@@ -289,159 +427,213 @@ void OpXfer::EnsureDstDirExists()
 	}
 }
 
-void OpXfer::Transfer()
+void OpXfer::StartWorkers()
 {
-	EnsureDstDirExists();
+	if (_on_site_move || _on_site_copy || !_conn_pool) {
+		return;
+	}
 
-	std::string path_dst;
-	for (auto &e : _entries) {
-		const std::string &subpath = e.first.substr(_base_dir.size());
-		path_dst = _dst_dir;
-		path_dst+= subpath;
-		{
-			std::lock_guard<std::mutex> lock(_state.mtx);
-			_state.path = subpath;
-			_state.stats.file_complete = 0;
-			_state.stats.file_total = S_ISDIR(e.second.mode) ? 0 : e.second.size;
-			_state.stats.current_start = TimeMSNow();
-			_state.stats.current_paused = std::chrono::milliseconds::zero();
+	unsigned int limit = (unsigned int)std::max(1, std::min(
+		G.GetGlobalConfigInt("ParallelTransfers", 1), MAX_PARALLEL_TRANSFERS));
+	if (limit < 2) {
+		return;
+	}
+
+	size_t files_count = 0;
+	for (const auto &e : _entries) {
+		if (!S_ISDIR(e.second.mode)) {
+			++files_count;
 		}
+	}
+	if (limit > files_count) {
+		limit = (unsigned int)files_count;
+	}
+	if (limit < 2) {
+		return;
+	}
 
-		FileInformation existing_file_info;
-		bool existing = false;
-		try {
-			_dst_host->GetInformation(existing_file_info, path_dst);
-			existing = true;
-		} catch (std::exception &ex) { (void)ex; } // FIXME: distinguish unexistence of file from IO failure
+	// respect per-site limit among all operations that currently transfer to/from same site(s)
+	unsigned int count = limit;
+	for (IHost *host : {_base_host.get(), _dst_host.get()}) {
+		const std::string &site_id = XferSiteId(host);
+		if (!site_id.empty() && (_xfer_slots.empty() || _xfer_slots.front().first != site_id)) {
+			const unsigned int granted = _conn_pool->AcquireTransferSlots(site_id, limit);
+			_xfer_slots.emplace_back(site_id, granted);
+			count = std::min(count, granted);
+		}
+	}
 
+	if (count < 2) {
+		count = 0; // no sense to have single worker, do all in this thread
+	}
 
-		if (S_ISLNK(e.second.mode)) {
-			if (existing || SymlinkCopy(e.first, path_dst)) {
-				if (_kind == XK_MOVE && !existing) {
-					FileDelete(e.first);
-				}
-				ProgressStateUpdate psu(_state);
-				_state.stats.count_complete++;
-				continue;
-			}
-			// if symlink copy failed then fallback to target's content copy
-			WhatOnErrorWrap<WEK_QUERYINFO>(_wea_state, _state, _base_host.get(), e.first,
-				[&] () mutable
-				{
-					_base_host->GetInformation(e.second, e.first, true);
-				}
-			);
-			if (!S_ISREG(e.second.mode) && !S_ISDIR(e.second.mode)) {
-				// don't copy symlink's target if its nor file nor directory
-				fprintf(stderr, "NetRocks: skipped symlink target with mode=0x%x - '%s' \n", e.second.mode, path_dst.c_str());
-				ProgressStateUpdate psu(_state);
-				_state.stats.count_complete++;
-				_state.stats.count_skips++;
-				continue;
-			}
+	for (auto &slot : _xfer_slots) {
+		_conn_pool->ReleaseTransferSlots(slot.first, slot.second - count);
+		slot.second = count;
+	}
 
-			if (S_ISREG(e.second.mode)) {
-				// symlinks are not counted in all_total, need to add size for symlink's target if gonna file-copy it
-				std::lock_guard<std::mutex> lock(_state.mtx);
-				_state.stats.all_total+= e.second.size;
-			}
+	for (unsigned int i = 0; i < count; ++i) {
+		auto worker = std::make_shared<FileXferWorker>(this, i);
+		if (!worker->Start()) {
+			fprintf(stderr, "NetRocks::Xfer: failed to start worker %u\n", i);
+			break;
 		}
+		std::lock_guard<std::mutex> lock(_jobs_mtx);
+		_workers.emplace_back(worker);
+	}
 
-		if (S_ISDIR(e.second.mode)) {
-			if (!existing) {
-				DirectoryCopy(path_dst, e.second);
-			}
+	if (g_netrocks_verbosity > 0) {
+		fprintf(stderr, "NetRocks::Xfer: %u parallel transfers\n", (unsigned int)_workers.size());
+	}
+}
 
-		} else {
-			if (existing) {
-				auto xoa = _default_xoa;
-				if (xoa == XOA_OVERWRITE_IF_NEWER_OTHERWISE_ASK) {
-					xoa = (TimeSpecCompare(existing_file_info.modification_time, e.second.modification_time) < 0)
-						? XOA_OVERWRITE : XOA_ASK;
-				}
+void OpXfer::EnqueueFileXfer(const std::string &path_src, const std::string &path_dst, FileInformation &info)
+{
+	std::unique_lock<std::mutex> lock(_jobs_mtx);
+	// dont let queue grow too far ahead of workers
+	while (_jobs.size() >= 2 * _workers.size() && !_jobs_failed && !_jobs_cancelled) {
+		_jobs_cond.wait(lock);
+	}
+	if (_jobs_failed) {
+		throw AbortError(); // worker already shown error UI
+	}
+	if (!_jobs_cancelled) {
+		_jobs.emplace_back(FileXferJob{path_src, path_dst, &info});
+		_jobs_cond.notify_all();
+	}
+}
 
-				if (xoa == XOA_ASK) {
-					xoa = ConfirmOverwrite(_kind, _direction, path_dst, e.second.modification_time, e.second.size,
-								existing_file_info.modification_time, existing_file_info.size).Ask(_default_xoa);
-					if (xoa == XOA_CANCEL) {
-						return;
+void OpXfer::FinishWorkers()
+{
+	std::vector<std::shared_ptr<FileXferWorker> > workers;
+	{
+		std::lock_guard<std::mutex> lock(_jobs_mtx);
+		_jobs_finish = true;
+		_jobs_cond.notify_all();
+		workers = _workers;
+	}
+
+	// keep workers in _workers while joining them, so Abort() still can reach their hosts
+	for (const auto &worker : workers) {
+		worker->Join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_jobs_mtx);
+		_workers.clear();
+	}
+	workers.clear(); // returns connections to pool
+
+	for (const auto &slot : _xfer_slots) {
+		_conn_pool->ReleaseTransferSlots(slot.first, slot.second);
+	}
+	_xfer_slots.clear();
+}
+
+void OpXfer::Transfer()
+{
+	EnsureDstDirExists();
+
+	StartWorkers();
+	try {
+		std::string path_dst;
+		for (auto &e : _entries) {
+			path_dst = _dst_dir;
+			path_dst+= e.first.substr(_base_dir.size());
+
+			if (!S_ISREG(e.second.mode)) {
+				ProgressStateStartItem(e.first, 0);
+
+				FileInformation existing_file_info;
+				bool existing = false;
+				try {
+					_dst_host->GetInformation(existing_file_info, path_dst);
+					existing = true;
+				} catch (std::exception &ex) { (void)ex; } // FIXME: distinguish unexistence of file from IO failure
+
+				if (S_ISLNK(e.second.mode)) {
+					if (existing || SymlinkCopy(e.first, path_dst)) {
+						if (_kind == XK_MOVE && !existing) {
+							FileDelete(_base_host.get(), e.first);
+						}
+						ProgressStateUpdate psu(_state);
+						_state.stats.count_complete++;
+						continue;
 					}
-				}
-				if (xoa == XOA_OVERWRITE_IF_NEWER) {
-					xoa = (TimeSpecCompare(existing_file_info.modification_time, e.second.modification_time) < 0)
-						? XOA_OVERWRITE : XOA_SKIP;
-				}
-				if (xoa == XOA_RESUME) {
-					if (existing_file_info.size < e.second.size) {
-						std::lock_guard<std::mutex> lock(_state.mtx);
-						_state.stats.all_complete+= existing_file_info.size;
-						_state.stats.file_complete = existing_file_info.size;
-					} else {
-						xoa = XOA_SKIP;
+					// if symlink copy failed then fallback to target's content copy
+					WhatOnErrorWrap<WEK_QUERYINFO>(_wea_state, _state, _base_host.get(), e.first,
+						[&] () mutable
+						{
+							_base_host->GetInformation(e.second, e.first, true);
+						}
+					);
+					if (!S_ISREG(e.second.mode) && !S_ISDIR(e.second.mode)) {
+						// don't copy symlink's target if its nor file nor directory
+						fprintf(stderr, "NetRocks: skipped symlink target with mode=0x%x - '%s' \n", e.second.mode, path_dst.c_str());
+						ProgressStateUpdate psu(_state);
+						_state.stats.count_complete++;
+						_state.stats.count_skips++;
+						continue;
 					}
 
-				} else if (xoa == XOA_CREATE_DIFFERENT_NAME) {
-					path_dst+= _diffname_suffix;
+					if (S_ISREG(e.second.mode)) {
+						// symlinks are not counted in all_total, need to add size for symlink's target if gonna file-copy it
+						std::lock_guard<std::mutex> lock(_state.mtx);
+						_state.stats.all_total+= e.second.size;
+					}
 				}
 
-				if (xoa == XOA_SKIP) {
-					std::lock_guard<std::mutex> lock(_state.mtx);
-					_state.stats.all_complete+= e.second.size;
-					_state.stats.file_complete+= e.second.size;
+				if (S_ISDIR(e.second.mode)) {
+					if (!existing) {
+						DirectoryCopy(path_dst, e.second);
+					}
+					ProgressStateUpdate psu(_state);
 					_state.stats.count_complete++;
 					continue;
 				}
 			}
 
-			if (_on_site_move) try {
-				_base_host->Rename(e.first, path_dst);
-				std::lock_guard<std::mutex> lock(_state.mtx);
-				_state.stats.all_complete+= e.second.size;
-				_state.stats.file_complete+= e.second.size;
-				_state.stats.count_complete++;
-				continue;
-
-			} catch(std::exception &ex) {
-				fprintf(stderr,
-					"NetRocks: on-site move file error %s: '%s' -> '%s'\n",
-					ex.what(), e.first.c_str(), path_dst.c_str());
-			}
+			if (!_workers.empty()) {
+				EnqueueFileXfer(e.first, path_dst, e.second);
 
-			if (_on_site_copy) try {
-				_base_host->FileCopy(e.first, path_dst);
-				std::lock_guard<std::mutex> lock(_state.mtx);
-				_state.stats.all_complete+= e.second.size;
-				_state.stats.file_complete+= e.second.size;
-				_state.stats.count_complete++;
-				continue;
-
-			} catch(ProtocolUnsupportedError &) {
-				// Asked once, refused: stop asking for the rest of the batch.
-				_on_site_copy = false;
-
-			} catch(std::exception &ex) {
-				fprintf(stderr,
-					"NetRocks: on-site copy file error %s: '%s' -> '%s'\n",
-					ex.what(), e.first.c_str(), path_dst.c_str());
+			} else if (!FileXfer(_base_host.get(), _dst_host.get(), _io_buf, e.first, path_dst, e.second)) {
+				return;
 			}
 
-			if (FileCopyLoop(e.first, path_dst, e.second)) {
-				CopyAttributes(path_dst, e.second);
-				if (_kind == XK_MOVE) {
-					FileDelete(e.first);
-				}
+			std::lock_guard<std::mutex> lock(_jobs_mtx);
+			if (_jobs_cancelled) {
+				break;
 			}
 		}
 
-		ProgressStateUpdate psu(_state);
-		_state.stats.count_complete++;
+	} catch (...) {
+		if (!_workers.empty()) {
+			// let workers to stop ASAP: they will notice this on next progress update
+			std::lock_guard<std::mutex> lock(_state.mtx);
+			_state.aborting = true;
+		}
+		FinishWorkers();
+		throw;
 	}
 
+	FinishWorkers();
+
+	{
+		std::lock_guard<std::mutex> lock(_jobs_mtx);
+		if (_jobs_failed) {
+			throw AbortError(); // worker already shown error UI
+		}
+		if (_jobs_cancelled) {
+			return;
+		}
+	}
+
+	std::string path_dst;
 	for (auto rev_i = _entries.rbegin(); rev_i != _entries.rend(); ++rev_i) {
 		if (S_ISDIR(rev_i->second.mode)) {
 			path_dst = _dst_dir;
 			path_dst+= rev_i->first.substr(_base_dir.size());
-			CopyAttributes(path_dst, rev_i->second);
+			CopyAttributes(_dst_host.get(), path_dst, rev_i->second);
 		}
 
 		if (_kind == XK_MOVE) {
@@ -457,22 +649,135 @@ void OpXfer::Transfer()
 	}
 }
 
-void OpXfer::FileDelete(const std::string &path)
+void OpXfer::ProgressStateStartItem(const std::string &path_src, unsigned long long file_total)
+{
+	std::lock_guard<std::mutex> lock(_state.mtx);
+	_state.path = path_src.substr(_base_dir.size());
+	_state.stats.file_complete = 0;
+	_state.stats.file_total = file_total;
+	_state.stats.current_start = TimeMSNow();
+	_state.stats.current_paused = std::chrono::milliseconds::zero();
+}
+
+// Transfers single regular file, returns false if user cancelled whole operation.
+// May be invoked concurrently from several FileXferWorker-s, each with its own hosts and buffer.
+bool OpXfer::FileXfer(IHost *src_host, IHost *dst_host, IOBuffer &io_buf,
+	const std::string &path_src, std::string path_dst, FileInformation &info)
+{
+	ProgressStateStartItem(path_src, info.size);
+
+	FileInformation existing_file_info;
+	bool existing = false;
+	try {
+		dst_host->GetInformation(existing_file_info, path_dst);
+		existing = true;
+	} catch (std::exception &ex) { (void)ex; } // FIXME: distinguish unexistence of file from IO failure
+
+	unsigned long long file_complete = 0;
+	if (existing) {
+		std::unique_lock<std::mutex> ui_lock(_ui_mtx);
+		auto xoa = _default_xoa;
+		if (xoa == XOA_OVERWRITE_IF_NEWER_OTHERWISE_ASK) {
+			xoa = (TimeSpecCompare(existing_file_info.modification_time, info.modification_time) < 0)
+				? XOA_OVERWRITE : XOA_ASK;
+		}
+
+		if (xoa == XOA_ASK) {
+			xoa = ConfirmOverwrite(_kind, _direction, path_dst, info.modification_time, info.size,
+						existing_file_info.modification_time, existing_file_info.size).Ask(_default_xoa);
+			if (xoa == XOA_CANCEL) {
+				return false;
+			}
+		}
+		ui_lock.unlock();
+
+		if (xoa == XOA_OVERWRITE_IF_NEWER) {
+			xoa = (TimeSpecCompare(existing_file_info.modification_time, info.modification_time) < 0)
+				? XOA_OVERWRITE : XOA_SKIP;
+		}
+		if (xoa == XOA_RESUME) {
+			if (existing_file_info.size < info.size) {
+				file_complete = existing_file_info.size;
+				std::lock_guard<std::mutex> lock(_state.mtx);
+				_state.stats.all_complete+= file_complete;
+				_state.stats.file_complete = file_complete;
+			} else {
+				xoa = XOA_SKIP;
+			}
+
+		} else if (xoa == XOA_CREATE_DIFFERENT_NAME) {
+			path_dst+= _diffname_suffix;
+		}
+
+		if (xoa == XOA_SKIP) {
+			std::lock_guard<std::mutex> lock(_state.mtx);
+			_state.stats.all_complete+= info.size;
+			_state.stats.file_complete+= info.size;
+			_state.stats.count_complete++;
+			return true;
+		}
+	}
+
+	if (_on_site_move) try {
+		src_host->Rename(path_src, path_dst);
+		std::lock_guard<std::mutex> lock(_state.mtx);
+		_state.stats.all_complete+= info.size;
+		_state.stats.file_complete+= info.size;
+		_state.stats.count_complete++;
+		return true;
+
+	} catch(std::exception &ex) {
+		fprintf(stderr,
+			"NetRocks: on-site move file error %s: '%s' -> '%s'\n",
+			ex.what(), path_src.c_str(), path_dst.c_str());
+	}
+
+	if (_on_site_copy) try {
+		src_host->FileCopy(path_src, path_dst);
+		std::lock_guard<std::mutex> lock(_state.mtx);
+		_state.stats.all_complete+= info.size;
+		_state.stats.file_complete+= info.size;
+		_state.stats.count_complete++;
+		return true;
+
+	} catch(ProtocolUnsupportedError &) {
+		// Asked once, refused: stop asking for the rest of the batch.
+		_on_site_copy = false;
+
+	} catch(std::exception &ex) {
+		fprintf(stderr,
+			"NetRocks: on-site copy file error %s: '%s' -> '%s'\n",
+			ex.what(), path_src.c_str(), path_dst.c_str());
+	}
+
+	if (FileCopyLoop(src_host, dst_host, io_buf, path_src, path_dst, info, file_complete)) {
+		CopyAttributes(dst_host, path_dst, info);
+		if (_kind == XK_MOVE) {
+			FileDelete(src_host, path_src);
+		}
+	}
+
+	ProgressStateUpdate psu(_state);
+	_state.stats.count_complete++;
+	return true;
+}
+
+void OpXfer::FileDelete(IHost *src_host, const std::string &path)
 {
-	WhatOnErrorWrap<WEK_REMOVE>(_wea_state, _state, _base_host.get(), path,
+	WhatOnErrorWrap<WEK_REMOVE>(_wea_state, _state, src_host, path,
 		[&] () mutable
 		{
-			_base_host->FileDelete(path);
+			src_host->FileDelete(path);
 		}
 	);
 }
 
-void OpXfer::CopyAttributes(const std::string &path_dst, const FileInformation &info)
+void OpXfer::CopyAttributes(IHost *dst_host, const std::string &path_dst, const FileInformation &info)
 {
-	WhatOnErrorWrap<WEK_SETTIMES>(_wea_state, _state, _dst_host.get(), path_dst,
+	WhatOnErrorWrap<WEK_SETTIMES>(_wea_state, _state, dst_host, path_dst,
 		[&] () mutable
 		{
-			_dst_host->SetTimes(path_dst.c_str(), info.access_time, info.modification_time);
+			dst_host->SetTimes(path_dst.c_str(), info.access_time, info.modification_time);
 		}
 	);
 
@@ -488,60 +793,61 @@ void OpXfer::CopyAttributes(const std::string &path_dst, const FileInformation &
 			return;
 	}
 fprintf(stderr, "!!!! copy mode !!!\n");
-	WhatOnErrorWrap<WEK_CHMODE>(_wea_state, _state, _dst_host.get(), path_dst,
+	WhatOnErrorWrap<WEK_CHMODE>(_wea_state, _state, dst_host, path_dst,
 		[&] () mutable
 		{
 			const mode_t mode = info.mode & 07777;
 			try {
-				_dst_host->SetMode(path_dst.c_str(), mode);
+				dst_host->SetMode(path_dst.c_str(), mode);
 			} catch (...) {
 				if ((mode & 07000) == 0) {
 					throw;
 				}
-				_dst_host->SetMode(path_dst.c_str(), mode & 00777);
+				dst_host->SetMode(path_dst.c_str(), mode & 00777);
 			}
 		}
 	);
 
 }
 
-void OpXfer::EnsureProgressConsistency()
+// must be invoked under _state.mtx lock, file_total is tracked by caller cuz
+// several files may be transferred concurrently, so _state.stats.file_* are only informational
+void OpXfer::EnsureProgressConsistency(unsigned long long file_complete, unsigned long long &file_total)
 {
-	if (_state.stats.file_complete > _state.stats.file_total) {
+	if (file_complete > file_total) {
 		// keep pocker face if file grew while copying
-		_state.stats.all_total+= _state.stats.file_complete - _state.stats.file_total;
-		_state.stats.file_total = _state.stats.file_complete;
+		_state.stats.all_total+= file_complete - file_total;
+		file_total = file_complete;
 	}
+	_state.stats.file_complete = file_complete;
+	_state.stats.file_total = file_total;
 }
 
-bool OpXfer::FileCopyLoop(const std::string &path_src, const std::string &path_dst, FileInformation &info)
+bool OpXfer::FileCopyLoop(IHost *src_host, IHost *dst_host, IOBuffer &io_buf,
+	const std::string &path_src, const std::string &path_dst, FileInformation &info, unsigned long long file_complete)
 {
+	unsigned long long file_total = info.size;
 	for (IHost *indicted = nullptr;;) try {
-		unsigned long long file_complete;
 		if (indicted) { // retrying...
 			indicted->ReInitialize();
-			indicted = _dst_host.get();
-			file_complete = _dst_host->GetSize(path_dst);
+			indicted = dst_host;
+			file_complete = dst_host->GetSize(path_dst);
 
 			ProgressStateUpdate psu(_state);
-			_state.stats.file_complete = file_complete;
-			EnsureProgressConsistency();
-		} else {
-			ProgressStateUpdate psu(_state);
-			file_complete = _state.stats.file_complete;
+			EnsureProgressConsistency(file_complete, file_total);
 		}
 
-		indicted = _base_host.get();
-		std::shared_ptr<IFileReader> reader = _base_host->FileGet(path_src, file_complete);
-		indicted = _dst_host.get();
-		std::shared_ptr<IFileWriter> writer = _dst_host->FilePut(path_dst,
+		indicted = src_host;
+		std::shared_ptr<IFileReader> reader = src_host->FileGet(path_src, file_complete);
+		indicted = dst_host;
+		std::shared_ptr<IFileWriter> writer = dst_host->FilePut(path_dst,
 			(info.mode | EXTRA_NEEDED_MODE) & 07777, info.size, file_complete);
-		if (!_io_buf.Size())
+		if (!io_buf.Size())
 			throw std::runtime_error("No buffer - no file");
 
 		for (unsigned long long transfer_msec = 0, initial_complete = file_complete;;) {
-			indicted = _base_host.get();
-			size_t ask_piece = _io_buf.Size();
+			indicted = src_host;
+			size_t ask_piece = io_buf.Size();
 			if (info.size < file_complete + ask_piece && info.size > file_complete) {
 				// use small buffer if gonna read small piece: IO may have small-read-optimized implementation
 				// but ask by one extra byte more to properly detect file being grew while copied
@@ -550,14 +856,14 @@ bool OpXfer::FileCopyLoop(const std::string &path_src, const std::string &path_d
 
 			std::chrono::milliseconds msec = TimeMSNow();
 
-			const size_t piece = reader->Read(_io_buf.Data(), ask_piece);
+			const size_t piece = reader->Read(io_buf.Data(), ask_piece);
 			if (piece == 0) {
 				if (file_complete < info.size) {
 					// protocol returned no read error, but trieved less data then expected, only two reasons possible:
 					// - remote file size reduced while copied
 					// - protocol implementation misdetected read failure
 					// so get actual file size, and if it still bigger than retrieved data size then ring-the-bell
-					const auto actual_size = _base_host->GetSize(path_src);
+					const auto actual_size = src_host->GetSize(path_src);
 					if (file_complete < actual_size) {
 						info.size = actual_size;
 						throw std::runtime_error("Retrieved less data than expected");
@@ -565,13 +871,13 @@ bool OpXfer::FileCopyLoop(const std::string &path_src, const std::string &path_d
 					info.size = file_complete;
 				}
 
-				indicted = _dst_host.get();
+				indicted = dst_host;
 				writer->WriteComplete();
 				break;
 			}
 
-			indicted = _dst_host.get();
-			writer->Write(_io_buf.Data(), piece);
+			indicted = dst_host;
+			writer->Write(io_buf.Data(), piece);
 
 			file_complete+= piece;
 			const bool fast_complete = (piece < ask_piece && file_complete == info.size);
@@ -591,11 +897,11 @@ bool OpXfer::FileCopyLoop(const std::string &path_src, const std::string &path_d
 					bufsize_optimal-= bufsize_align;
 				}
 
-				unsigned long prev_bufsize = _io_buf.Size();
-				_io_buf.Desire(bufsize_optimal);
+				unsigned long prev_bufsize = io_buf.Size();
+				io_buf.Desire(bufsize_optimal);
 
-				if (g_netrocks_verbosity > 0 && _io_buf.Size() != prev_bufsize) {
-					fprintf(stderr, "NetRocks: IO buffer size changed to %lu\n", (unsigned long)_io_buf.Size());
+				if (g_netrocks_verbosity > 0 && io_buf.Size() != prev_bufsize) {
+					fprintf(stderr, "NetRocks: IO buffer size changed to %lu\n", (unsigned long)io_buf.Size());
 				}
 			}
 
@@ -603,9 +909,8 @@ bool OpXfer::FileCopyLoop(const std::string &path_src, const std::string &path_d
 			_wea_state->ResetAutoRetryDelay();
 
 			ProgressStateUpdate psu(_state);
-			_state.stats.file_complete = file_complete;
 			_state.stats.all_complete+= piece;
-			EnsureProgressConsistency();
+			EnsureProgressConsistency(file_complete, file_total);
 
 			if (fast_complete) {
 				break;
@@ -742,4 +1047,9 @@ void OpXfer::ForcefullyAbort()
 {
 	OpBase::ForcefullyAbort();
 	_dst_host->Abort();
+
+	std::lock_guard<std::mutex> locker(_jobs_mtx);
+	for (const auto &worker : _workers) {
+		worker->Abort();
+	}
 }
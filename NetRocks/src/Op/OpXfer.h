@@ -1,9 +1,13 @@
 #pragma once
+#include <deque>
+#include <vector>
+#include <condition_variable>
 #include "OpBase.h"
 #include "./Utils/Enumer.h"
 #include "./Utils/IOBuffer.h"
 #include "../UI/Defs.h"
 #include "../BackgroundTasks.h"
+#include "../ConnectionsPool.h"
 
 
 class OpXfer : protected OpBase, public IBackgroundTask
@@ -21,6 +25,23 @@ class OpXfer : protected OpBase, public IBackgroundTask
 	bool _on_site_copy = false;
 	int _use_of_chmod;
 
+	// parallel transfer of regular files, see FileXferWorker
+	struct FileXferJob
+	{
+		std::string path_src, path_dst;
+		FileInformation *info;
+	};
+	class FileXferWorker;
+
+	std::shared_ptr<ConnectionsPool> _conn_pool;
+	std::vector<std::pair<std::string, unsigned int> > _xfer_slots;
+	std::vector<std::shared_ptr<FileXferWorker> > _workers;
+	std::deque<FileXferJob> _jobs;
+	std::mutex _jobs_mtx;
+	std::condition_variable _jobs_cond;
+	bool _jobs_finish = false, _jobs_failed = false, _jobs_cancelled = false;
+	std::mutex _ui_mtx; // serializes overwrite confirmations and guards _default_xoa
+
 	virtual void Process();
 
 	virtual void ForcefullyAbort();	// IAbortableOperationsHost
@@ -30,17 +51,24 @@ class OpXfer : protected OpBase, public IBackgroundTask
 	void Rename(const std::set<std::string> &items);
 	void EnsureDstDirExists();
 	void Transfer();
-	void FileDelete(const std::string &path);
+	void StartWorkers();
+	void EnqueueFileXfer(const std::string &path_src, const std::string &path_dst, FileInformation &info);
+	void FinishWorkers();
+	void ProgressStateStartItem(const std::string &path_src, unsigned long long file_total);
+	bool FileXfer(IHost *src_host, IHost *dst_host, IOBuffer &io_buf,
+		const std::string &path_src, std::string path_dst, FileInformation &info);
+	void FileDelete(IHost *src_host, const std::string &path);
 	void DirectoryCopy(const std::string &path_dst, const FileInformation &info);
 	bool SymlinkCopy(const std::string &path_src, const std::string &path_dst);
-	bool FileCopyLoop(const std::string &path_src, const std::string &path_dst, FileInformation &info);
-	void EnsureProgressConsistency();
-	void CopyAttributes(const std::string &path_dst, const FileInformation &info);
+	bool FileCopyLoop(IHost *src_host, IHost *dst_host, IOBuffer &io_buf,
+		const std::string &path_src, const std::string &path_dst, FileInformation &info, unsigned long long file_complete);
+	void EnsureProgressConsistency(unsigned long long file_complete, unsigned long long &file_total);
+	void CopyAttributes(IHost *dst_host, const std::string &path_dst, const FileInformation &info);
 
 public:
 	OpXfer(int op_mode, std::shared_ptr<IHost> &base_host, const std::string &base_dir,
 		std::shared_ptr<IHost> &dst_host, const std::string &dst_dir, struct PluginPanelItem *items,
-		int items_count, XferKind kind, XferDirection direction);
+		int items_count, XferKind kind, XferDirection direction, std::shared_ptr<ConnectionsPool> conn_pool);
 
 	virtual ~OpXfer();
 
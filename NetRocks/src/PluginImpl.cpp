@@ -25,7 +25,7 @@
 #include "Op/OpChangeMode.h"
 #include "Op/OpGetLinkTarget.h"
 
-static std::unique_ptr<ConnectionsPool> g_conn_pool;
+static std::shared_ptr<ConnectionsPool> g_conn_pool;
 
 
 class AllNetRocks
@@ -116,6 +116,7 @@ PluginImpl::PluginImpl(const wchar_t *path, bool path_is_standalone_config, int
 
 PluginImpl::~PluginImpl()
 {
+	_dir_listing_revalidator.reset();
 	DismissRemoteHost();
 	g_all_netrocks.Remove(this);
 }
@@ -272,8 +273,19 @@ int PluginImpl::GetFindData(PluginPanelItem **pPanelItem, int *pItemsNumber, int
 			}
 
 		} else {
-			OpEnumDirectory(OpMode, _remote, CurrentSiteDir(false), ppis, _wea_state).Do();
-			//_remote->DirectoryEnum(CurrentSiteDir(false), il, OpMode);
+			const std::string &site_dir = CurrentSiteDir(false);
+			if (!ListCachedDirectory(OpMode, site_dir, ppis)) {
+				try {
+					OpEnumDirectory(OpMode, _remote, site_dir, ppis, _wea_state).Do();
+				} catch (ProtocolError &) {
+					if (_remote->Alive() && DirListingCache_Enabled()) {
+						DirListingCache_Drop(CurrentConnectionPoolId(), site_dir);
+					}
+					throw;
+				}
+				//_remote->DirectoryEnum(CurrentSiteDir(false), il, OpMode);
+				OnDirectoryListed(OpMode, site_dir, ppis);
+			}
 		}
 
 	} catch (std::exception &e) {
@@ -287,6 +299,58 @@ int PluginImpl::GetFindData(PluginPanelItem **pPanelItem, int *pItemsNumber, int
 	return TRUE;
 }
 
+// Cached listing shown when entering directory or when background revalidation found it
+// changed, any other re-reading (like after file operations or Ctrl+R) goes to server.
+bool PluginImpl::ListCachedDirectory(int OpMode, const std::string &site_dir, PluginPanelItems &ppis)
+{
+	if ((OpMode & (OPM_FIND | OPM_SILENT)) != 0 || !DirListingCache_Enabled()) {
+		return false;
+	}
+
+	const std::string &site = CurrentConnectionPoolId();
+	const bool fresh = _dir_listing_revalidator && _dir_listing_revalidator->TakeFresh(site, site_dir);
+	std::string listed = site;
+	listed+= '\n';
+	listed+= site_dir;
+	if (!fresh && listed == _last_listed) {
+		return false;
+	}
+
+	timespec dir_mtime{};
+	uint64_t fingerprint = 0;
+	if (!DirListingCache_Load(site, site_dir, ppis, dir_mtime, fingerprint)) {
+		return false;
+	}
+
+	_last_listed.swap(listed);
+	if (!fresh) {
+		if (!_dir_listing_revalidator) {
+			_dir_listing_revalidator.reset(new DirListingRevalidator(this));
+		}
+		_dir_listing_revalidator->Revalidate(_remote, site, site_dir, dir_mtime, fingerprint);
+	}
+	return true;
+}
+
+void PluginImpl::OnDirectoryListed(int OpMode, const std::string &site_dir, const PluginPanelItems &ppis)
+{
+	if ((OpMode & OPM_FIND) != 0 || !DirListingCache_Enabled()) {
+		return;
+	}
+
+	if (_dir_listing_revalidator) {
+		_dir_listing_revalidator->Cancel();
+	}
+
+	const std::string &site = CurrentConnectionPoolId();
+	_last_listed = site;
+	_last_listed+= '\n';
+	_last_listed+= site_dir;
+	if (ppis.count > 1) { // dont overwrite cache by listing that was skipped due to error
+		DirListingCache_Save(site, site_dir, ppis, 1, timespec{});
+	}
+}
+
 void PluginImpl::FreeFindData(PluginPanelItem *PanelItem, int ItemsNumber)
 {
 	PluginPanelItems_Free(PanelItem, ItemsNumber);
@@ -528,8 +592,11 @@ BackgroundTaskStatus PluginImpl::StartXfer(int op_mode, std::shared_ptr<IHost> &
 {
 	BackgroundTaskStatus out = BTS_ABORTED;
 	try {
+		if (!g_conn_pool)
+			g_conn_pool.reset(new ConnectionsPool);
+
 		std::shared_ptr<IBackgroundTask> task = std::make_shared<OpXfer>(op_mode, base_host,
-				base_dir, dst_host, dst_dir, items, items_count, kind, direction);
+				base_dir, dst_host, dst_dir, items, items_count, kind, direction, g_conn_pool);
 
 		// task->Show();
 		out = task->GetStatus();
@@ -1138,6 +1205,11 @@ int PluginImpl::ProcessEventCommand(const wchar_t *cmd)
 
 void PluginImpl::DismissRemoteHost()
 {
+	if (_dir_listing_revalidator) {
+		_dir_listing_revalidator->Cancel();
+	}
+	_last_listed.clear();
+
 	if (!g_conn_pool)
 		g_conn_pool.reset(new ConnectionsPool);
 
@@ -1166,6 +1238,7 @@ std::string PluginImpl::CurrentConnectionPoolId()
 
 void PluginImpl::sOnExiting()
 {
+	DirListingRevalidator::sOnExiting();
 	g_conn_pool.reset();
 }
 
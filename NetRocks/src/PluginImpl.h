@@ -9,6 +9,7 @@
 #include "BackgroundTasks.h"
 #include "Location.h"
 #include "SitesConfig.h"
+#include "DirListingCache.h"
 
 class PluginImpl
 {
@@ -38,12 +39,17 @@ class PluginImpl
 	std::deque<StackedDir> _dir_stack;
 	std::shared_ptr<WhatOnErrorState> _wea_state = std::make_shared<WhatOnErrorState>();
 
+	std::unique_ptr<DirListingRevalidator> _dir_listing_revalidator;
+	std::string _last_listed; // site and directory of last listing that was fetched or taken from cache
+
 	void StackedDirCapture(StackedDir &sd);
 	void StackedDirApply(StackedDir &sd);
 
 	void UpdatePathInfo();
 
 	std::string CurrentSiteDir(bool with_ending_slash) const;
+	bool ListCachedDirectory(int OpMode, const std::string &site_dir, PluginPanelItems &ppis);
+	void OnDirectoryListed(int OpMode, const std::string &site_dir, const PluginPanelItems &ppis);
 	void ByKey_EditSiteConnection(bool create_new);
 	bool ByKey_TryCrossload(bool mv);
 	bool ByKey_TryExecuteSelected();
@@ -5,8 +5,31 @@
 #include <cstring>
 #include <memory>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+
+AWSFileReader::ChunkWorker::ChunkWorker(AWSFileReader *owner)
+	: _owner(owner)
+{
+	if (!StartThread()) {
+		throw ProtocolError("Failed to start download thread");
+	}
+}
+
+AWSFileReader::ChunkWorker::~ChunkWorker()
+{
+	WaitThread();
+}
+
+void *AWSFileReader::ChunkWorker::ThreadProc() // NOSONAR(cpp:S5008)
+{
+	_owner->FetchChunks();
+	return nullptr;
+}
 
 AWSFileReader::AWSFileReader(std::shared_ptr<S3Session> session,
+                             S3SessionFactory session_factory,
+                             const S3TransferOptions &opts,
                              const S3Credentials &creds,
                              const std::string &endpoint,
                              const std::string &useragent,
@@ -14,110 +37,202 @@ AWSFileReader::AWSFileReader(std::shared_ptr<S3Session> session,
                              const std::string &key,
                              unsigned long long position,
                              unsigned long long size)
-	: _session(std::move(session)), _creds(creds), _endpoint(endpoint),
+	: _session(std::move(session)), _session_factory(std::move(session_factory)), _opts(opts), _creds(creds), _endpoint(endpoint),
 	  _useragent(useragent), _path_prefix(path_prefix), _key(key),
-	  _position(position), _size(size)
+	  _size(size), _next_offset(position)
 {
-	std::string uri_path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
-	std::string payload_hash = S3SHA256Hex("");
-	auto auth_headers = S3SignRequest("GET", _endpoint, uri_path, {},
-	                                  payload_hash, _creds.region,
-	                                  _creds.access_key, _creds.secret_key);
-
-	std::unique_ptr<char, decltype(&free)> escaped(ne_path_escape(uri_path.c_str()), free);
-	std::string neon_path = escaped ? escaped.get() : uri_path;
-
-	_req = ne_request_create(_session->sess, "GET", neon_path.c_str());
-	if (!_req) throw ProtocolError("Failed to create GET request");
-
-	for (auto &h : auth_headers) {
-		ne_add_request_header(_req, h.first.c_str(), h.second.c_str());
+	unsigned long long workers = _opts.download_concurrency;
+	if (_size != 0) {
+		if (_size <= position) {
+			_scheduled_all = true;
+			return;
+		}
+		workers = std::min(workers, (_size - position + _opts.download_chunk - 1) / _opts.download_chunk);
 	}
-	if (!_useragent.empty()) {
-		ne_add_request_header(_req, "User-Agent", _useragent.c_str());
+	if (workers <= 1) {
+		_inline = true;
+		return;
 	}
-
-	if (_position > 0 || _size > 0) {
-		char range[64] = {};
-		if (_size > 0 && _size > _position) {
-			snprintf(range, sizeof(range) - 1, "bytes=%llu-%llu",
-			         (unsigned long long)_position, (unsigned long long)(_size - 1));
-		} else {
-			snprintf(range, sizeof(range) - 1, "bytes=%llu-",
-			         (unsigned long long)_position);
+	try {
+		while (_workers.size() < workers) {
+			_workers.emplace_back(new ChunkWorker(this));
 		}
-		ne_add_request_header(_req, "Range", range);
-	}
-
-	ne_add_response_body_reader(_req, ne_accept_always, sReadCallback, this);
-
-	if (!StartThread()) {
-		ne_request_destroy(_req);
-		_req = nullptr;
-		throw ProtocolError("Failed to start download thread");
+	} catch (...) {
+		StopWorkers();
+		throw;
 	}
 }
 
 AWSFileReader::~AWSFileReader()
 {
-	EnsureAllDone();
-	if (_req) {
-		ne_request_destroy(_req);
-		_req = nullptr;
-	}
+	StopWorkers();
 }
 
-void AWSFileReader::EnsureAllDone()
+void AWSFileReader::StopWorkers()
 {
 	{
-		std::unique_lock<std::mutex> lock(_mtx);
-		_done = true;
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stopping = true;
 		_cond.notify_all();
 	}
-	WaitThread();
+	_workers.clear();
 }
 
-void *AWSFileReader::ThreadProc() // NOSONAR(cpp:S5008)
+bool AWSFileReader::ScheduleChunk(unsigned long long &offset, Chunk *&chunk)
 {
-	_ne_status = ne_request_dispatch(_req);
-	std::unique_lock<std::mutex> lock(_mtx);
-	if (_ne_status != NE_OK) {
-		const char *err = ne_get_error(_session->sess);
-		_ne_error = err ? err : "download failed";
+	if (_stopping || _eof || _scheduled_all || !_error.empty()) {
+		return false;
+	}
+	unsigned long long length = _opts.download_chunk;
+	if (_size != 0) { // size unknown - read chunks until got short one
+		length = std::min(length, _size - _next_offset);
+	}
+	offset = _next_offset;
+	chunk = &_chunks[offset];
+	chunk->length = length;
+	chunk->data.reserve((size_t)length);
+	_next_offset+= length;
+	if (_size != 0 && _next_offset >= _size) {
+		_scheduled_all = true;
 	}
-	_done = true;
 	_cond.notify_all();
-	return nullptr;
+	return true;
+}
+
+int AWSFileReader::sAcceptResponse(void *, ne_request *, const ne_status *st)
+{
+	return (st && st->klass == 2) ? 1 : 0;
 }
 
 int AWSFileReader::sReadCallback(void *userdata, const char *buf, size_t len) // NOSONAR(cpp:S5008)
 {
-	return reinterpret_cast<AWSFileReader *>(userdata)->ReadCallback(buf, len);
+	FetchState *fs = reinterpret_cast<FetchState *>(userdata);
+	std::lock_guard<std::mutex> lock(fs->owner->_mtx);
+	if (fs->owner->_stopping) return -1;
+	if (len == 0) return 0;
+	if (fs->chunk->data.size() + len > fs->chunk->length) {
+		fs->overflow = true;
+		return -1;
+	}
+	fs->chunk->data.insert(fs->chunk->data.end(), buf, buf + len);
+	fs->owner->_cond.notify_all();
+	return 0;
 }
 
-int AWSFileReader::ReadCallback(const char *buf, size_t len)
+void AWSFileReader::FetchChunk(S3Session &session, unsigned long long offset, Chunk &chunk)
 {
-	std::unique_lock<std::mutex> lock(_mtx);
-	for (;;) {
-		if (_done) return -1;
-		if (len == 0) return 0;
-		if (_buf.size() < (size_t)INTERMEDIATE_BUFFER) {
-			_buf.insert(_buf.end(), buf, buf + len);
+	unsigned long long from;
+	{
+		// on retry continue from where previous attempt stopped
+		std::lock_guard<std::mutex> lock(_mtx);
+		from = offset + chunk.data.size();
+		if (from == offset + chunk.length) {
+			chunk.done = true;
 			_cond.notify_all();
-			return 0;
+			return;
+		}
+	}
+
+	std::string uri_path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
+	std::string payload_hash = S3SHA256Hex("");
+	auto auth_headers = S3SignRequest("GET", _endpoint, uri_path, {},
+	                                  payload_hash, _creds.region,
+	                                  _creds.access_key, _creds.secret_key);
+
+	std::unique_ptr<char, decltype(&free)> escaped(ne_path_escape(uri_path.c_str()), free);
+	std::string neon_path = escaped ? escaped.get() : uri_path;
+
+	ne_request *req = ne_request_create(session.sess, "GET", neon_path.c_str());
+	if (!req) throw ProtocolError("Failed to create GET request");
+
+	for (auto &h : auth_headers) {
+		ne_add_request_header(req, h.first.c_str(), h.second.c_str());
+	}
+	if (!_useragent.empty()) {
+		ne_add_request_header(req, "User-Agent", _useragent.c_str());
+	}
+
+	char range[64] = {};
+	snprintf(range, sizeof(range) - 1, "bytes=%llu-%llu", from, offset + chunk.length - 1);
+	ne_add_request_header(req, "Range", range);
+
+	FetchState fs{this, &chunk, offset};
+	ne_add_response_body_reader(req, sAcceptResponse, sReadCallback, &fs);
+
+	int rc = ne_request_dispatch(req);
+	const ne_status *st = ne_get_status(req);
+	int http_code = st ? st->code : 0;
+	ne_request_destroy(req);
+
+	if (fs.overflow) {
+		throw ProtocolError("Read error", "server ignored requested range");
+	}
+	if (rc != NE_OK) {
+		const char *err = ne_get_error(session.sess);
+		throw ProtocolError("Read error", err ? err : "download failed", rc);
+	}
+	if (http_code == 200 && from != 0) {
+		throw ProtocolError("Read error", "server ignored requested range");
+	}
+	// 416 means requested range starts at or beyond end of object,
+	// so chunk just gets shorter than requested that means EOF for Read
+	if (http_code != 416 && (http_code < 200 || http_code >= 300)) {
+		throw ProtocolError("S3 HTTP error: " + std::to_string(http_code) + " on GET " + uri_path);
+	}
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	chunk.done = true;
+	_cond.notify_all();
+}
+
+void AWSFileReader::FetchChunks()
+{
+	std::shared_ptr<S3Session> session;
+	for (;;) {
+		unsigned long long offset;
+		Chunk *chunk;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			// bounds memory usage by download_concurrency chunks ahead of reader
+			_cond.wait(lock, [this]{ return _stopping || _eof || _scheduled_all || !_error.empty()
+				|| _chunks.size() < _opts.download_concurrency; });
+			if (!ScheduleChunk(offset, chunk)) {
+				break;
+			}
+		}
+		if (!FetchChunkRetrying(session, offset, *chunk)) {
+			break;
 		}
-		_cond.wait(lock, [this]{ return _done || _buf.size() < (size_t)INTERMEDIATE_BUFFER; });
 	}
 }
 
-size_t AWSFileReader::TryFetch(char *data, size_t len)
+// Returns false if stopped or failed, in last case _error is set
+bool AWSFileReader::FetchChunkRetrying(std::shared_ptr<S3Session> &session, unsigned long long offset, Chunk &chunk)
 {
-	len = std::min(len, _buf.size());
-	if (len) {
-		std::copy(_buf.begin(), _buf.begin() + len, data);
-		_buf.erase(_buf.begin(), _buf.begin() + len);
+	for (unsigned int attempt = 1; ; ++attempt) {
+		try {
+			if (!session) {
+				session = _session_factory();
+			}
+			FetchChunk(*session, offset, chunk);
+			return true;
+
+		} catch (std::exception &e) {
+			std::lock_guard<std::mutex> lock(_mtx);
+			if (_stopping || !_error.empty()) {
+				return false;
+			}
+			if (attempt >= _opts.retries) {
+				_error = e.what();
+				_cond.notify_all();
+				return false;
+			}
+			fprintf(stderr, "AWSFileReader: chunk at %llu attempt %u failed: %s\n", offset, attempt, e.what());
+		}
+		// connection could be left in unusable state, so retry with fresh one
+		session.reset();
+		std::this_thread::sleep_for(std::chrono::milliseconds(250 << attempt));
 	}
-	return len;
 }
 
 size_t AWSFileReader::Read(void *buf, size_t buflen) // NOSONAR(cpp:S5008)
@@ -126,17 +241,43 @@ size_t AWSFileReader::Read(void *buf, size_t buflen) // NOSONAR(cpp:S5008)
 
 	std::unique_lock<std::mutex> lock(_mtx);
 	for (;;) {
-		size_t got = TryFetch(static_cast<char *>(buf), buflen);
-		if (got) {
-			_cond.notify_all();
-			return got;
+		if (_eof) {
+			return 0;
 		}
-		if (_done) {
-			if (_ne_status != NE_OK) {
-				throw ProtocolError("Read error", _ne_error.c_str(), _ne_status);
+		if (!_chunks.empty()) {
+			auto it = _chunks.begin();
+			Chunk &chunk = it->second;
+			size_t got = std::min(buflen, chunk.data.size() - chunk.consumed);
+			if (got) {
+				memcpy(buf, chunk.data.data() + chunk.consumed, got);
+				chunk.consumed+= got;
+				return got;
 			}
+			if (chunk.done) {
+				if (chunk.data.size() < chunk.length) {
+					_eof = true;
+				}
+				_chunks.erase(it);
+				_cond.notify_all();
+				continue;
+			}
+		}
+		if (!_error.empty()) {
+			throw ProtocolError("Read error", _error.c_str());
+		}
+		if (_chunks.empty() && _scheduled_all) {
 			return 0;
 		}
-		_cond.wait(lock, [this]{ return _done || !_buf.empty(); });
+		if (_inline) {
+			unsigned long long offset;
+			Chunk *chunk;
+			if (_chunks.empty() && ScheduleChunk(offset, chunk)) {
+				lock.unlock();
+				FetchChunkRetrying(_session, offset, *chunk);
+				lock.lock();
+				continue;
+			}
+		}
+		_cond.wait(lock);
 	}
 }
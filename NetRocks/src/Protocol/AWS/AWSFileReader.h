@@ -1,7 +1,8 @@
 #pragma once
 #include <memory>
 #include <string>
-#include <deque>
+#include <vector>
+#include <map>
 #include <mutex>
 #include <condition_variable>
 #include <Threaded.h>
@@ -10,10 +11,16 @@
 #include "../Protocol.h"
 #include "S3Repository.h"
 
-class AWSFileReader : public IFileReader, protected Threaded
+// Downloads object as sequence of ranged GETs of opts.download_chunk size, up to
+// opts.download_concurrency of them are in flight ahead of current read position.
+// If only one GET may be in flight (e.g. object fits single chunk) then no workers
+// started and chunks are fetched by Read itself using repository's session.
+class AWSFileReader : public IFileReader
 {
 public:
 	AWSFileReader(std::shared_ptr<S3Session> session,
+	              S3SessionFactory session_factory,
+	              const S3TransferOptions &opts,
 	              const S3Credentials &creds,
 	              const std::string &endpoint,
 	              const std::string &useragent,
@@ -26,33 +33,61 @@ public:
 	size_t Read(void *buf, size_t len) override; // NOSONAR(cpp:S5008)
 
 private:
-	std::shared_ptr<S3Session> _session;
+	class ChunkWorker : protected Threaded
+	{
+		AWSFileReader *_owner;
+
+	protected:
+		void *ThreadProc() override; // NOSONAR(cpp:S5008)
+
+	public:
+		ChunkWorker(AWSFileReader *owner);
+		~ChunkWorker() override;
+	};
+
+	struct Chunk
+	{
+		unsigned long long length;  // requested length
+		std::vector<char>  data;    // received so far
+		size_t             consumed = 0;
+		bool               done = false;
+	};
+
+	struct FetchState
+	{
+		AWSFileReader *owner;
+		Chunk         *chunk;
+		unsigned long long offset; // offset of chunk
+		bool           overflow = false;
+	};
+
+	std::shared_ptr<S3Session> _session; // used by Read if there are no workers
+	S3SessionFactory           _session_factory;
+	S3TransferOptions          _opts;
 	S3Credentials              _creds;
 	std::string                _endpoint;
 	std::string                _useragent;
 	std::string                _path_prefix;
 	std::string                _key;
-	unsigned long long         _position;
-	unsigned long long         _size;
-	ne_request                *_req = nullptr;
+	unsigned long long         _size;  // object size or zero if unknown
 
-	int         _ne_status = NE_ERROR;
-	std::string _ne_error;
-	bool        _done = false;
-
-	std::deque<char>        _buf;
 	std::mutex              _mtx;
 	std::condition_variable _cond;
-
-	enum { INTERMEDIATE_BUFFER = 10 * 1024 * 1024 };
+	std::map<unsigned long long, Chunk> _chunks; // offset -> chunk, front one is being read
+	unsigned long long      _next_offset;        // offset of next chunk to schedule
+	bool                    _scheduled_all = false;
+	bool                    _stopping = false;
+	bool                    _eof = false;
+	bool                    _inline = false;
+	std::string             _error;
+	std::vector<std::unique_ptr<ChunkWorker>> _workers;
 
 	static int sReadCallback(void *userdata, const char *buf, size_t len); // NOSONAR(cpp:S5008)
-	int ReadCallback(const char *buf, size_t len);
-
-	size_t TryFetch(char *data, size_t len);
-
-	void EnsureAllDone();
+	static int sAcceptResponse(void *userdata, ne_request *req, const ne_status *st);
 
-protected:
-	void *ThreadProc() override; // NOSONAR(cpp:S5008)
+	bool ScheduleChunk(unsigned long long &offset, Chunk *&chunk); // expects _mtx locked
+	void FetchChunk(S3Session &session, unsigned long long offset, Chunk &chunk);
+	bool FetchChunkRetrying(std::shared_ptr<S3Session> &session, unsigned long long offset, Chunk &chunk);
+	void FetchChunks();
+	void StopWorkers();
 };
@@ -6,6 +6,8 @@
 #include <memory>
 #include <stdexcept>
 #include <map>
+#include <thread>
+#include <chrono>
 
 struct WriteResponseCapture {
 	std::string body;
@@ -61,6 +63,10 @@ std::string AWSFileWriter::DoRequest(const std::string &method,
 	WriteResponseCapture cap;
 	cap.header_name = capture_response_header;
 
+	if (!_session) {
+		// dropped by failed inline upload retry
+		_session = _session_factory();
+	}
 	ne_request *req = ne_request_create(_session->sess, method.c_str(), neon_path.c_str());
 	if (!req) throw ProtocolError("Failed to create neon request");
 
@@ -107,20 +113,42 @@ std::string AWSFileWriter::DoRequest(const std::string &method,
 	return capture_response_header.empty() ? cap.body : cap.header_value;
 }
 
+AWSFileWriter::PartWorker::PartWorker(AWSFileWriter *owner)
+	: _owner(owner)
+{
+	if (!StartThread()) {
+		throw ProtocolError("Failed to start upload thread");
+	}
+}
+
+AWSFileWriter::PartWorker::~PartWorker()
+{
+	WaitThread();
+}
+
+void *AWSFileWriter::PartWorker::ThreadProc() // NOSONAR(cpp:S5008)
+{
+	_owner->UploadQueuedParts();
+	return nullptr;
+}
+
 AWSFileWriter::AWSFileWriter(std::shared_ptr<S3Session> session,
+                             S3SessionFactory session_factory,
+                             const S3TransferOptions &opts,
                              const S3Credentials &creds,
                              const std::string &endpoint,
                              const std::string &useragent,
                              const std::string &path_prefix,
                              const std::string &key)
-	: _session(std::move(session)), _creds(creds), _endpoint(endpoint),
-	  _useragent(useragent), _path_prefix(path_prefix), _key(key)
+	: _session(std::move(session)), _session_factory(std::move(session_factory)), _opts(opts),
+	  _creds(creds), _endpoint(endpoint), _useragent(useragent), _path_prefix(path_prefix), _key(key)
 {
 	StartMultipartUpload();
 }
 
 AWSFileWriter::~AWSFileWriter()
 {
+	StopWorkers();
 	if (!_completed && !_aborted) {
 		try {
 			AbortMultipartUpload();
@@ -128,10 +156,14 @@ AWSFileWriter::~AWSFileWriter()
 	}
 }
 
+std::string AWSFileWriter::ObjectPath() const
+{
+	return _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
+}
+
 void AWSFileWriter::StartMultipartUpload()
 {
-	std::string path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
-	std::string body = DoRequest("POST", path, {{"uploads", ""}}, "");
+	std::string body = DoRequest("POST", ObjectPath(), {{"uploads", ""}}, "");
 	// Parse <UploadId>
 	std::string o = "<UploadId>", c = "</UploadId>";
 	auto s = body.find(o);
@@ -142,18 +174,15 @@ void AWSFileWriter::StartMultipartUpload()
 	_upload_id = body.substr(s, e - s);
 }
 
-void AWSFileWriter::FlushPart()
+std::string AWSFileWriter::UploadPart(S3Session &session, int number, const char *data, size_t len)
 {
-	if (_buffer.empty()) return;
-
-	std::string path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
+	std::string path = ObjectPath();
 	std::map<std::string, std::string> qp = {
-		{"partNumber", std::to_string(_part_number)},
+		{"partNumber", std::to_string(number)},
 		{"uploadId",   _upload_id}
 	};
-	std::string body(_buffer.data(), _buffer.size());
 
-	std::string payload_hash = S3SHA256Hex(body.data(), body.size());
+	std::string payload_hash = S3SHA256Hex(data, len);
 	auto auth_headers = S3SignRequest("PUT", _endpoint, path, qp,
 	                                  payload_hash, _creds.region,
 	                                  _creds.access_key, _creds.secret_key);
@@ -164,7 +193,7 @@ void AWSFileWriter::FlushPart()
 	WriteResponseCapture cap;
 	cap.header_name = "ETag";
 
-	ne_request *req = ne_request_create(_session->sess, "PUT", neon_path.c_str());
+	ne_request *req = ne_request_create(session.sess, "PUT", neon_path.c_str());
 	if (!req) throw ProtocolError("Failed to create PUT part request");
 
 	for (auto &h : auth_headers) {
@@ -173,9 +202,11 @@ void AWSFileWriter::FlushPart()
 	if (!_useragent.empty()) {
 		ne_add_request_header(req, "User-Agent", _useragent.c_str());
 	}
-	ne_set_request_body_buffer(req, _buffer.data(), _buffer.size());
+	if (len) {
+		ne_set_request_body_buffer(req, data, len);
+	}
 	char cl[32];
-	snprintf(cl, sizeof(cl), "%zu", _buffer.size());
+	snprintf(cl, sizeof(cl), "%zu", len);
 	ne_add_request_header(req, "Content-Length", cl);
 	ne_add_response_body_reader(req, ne_accept_always, WriteResponseCapture::sBodyReader, &cap);
 
@@ -188,7 +219,7 @@ void AWSFileWriter::FlushPart()
 	ne_request_destroy(req);
 
 	if (rc != NE_OK) {
-		const char *err = ne_get_error(_session->sess);
+		const char *err = ne_get_error(session.sess);
 		throw ProtocolError(err ? err : "UploadPart failed");
 	}
 	if (http_code < 200 || http_code >= 300) {
@@ -197,54 +228,153 @@ void AWSFileWriter::FlushPart()
 	CheckXmlError(cap.body, "UploadPart");
 	if (etag.empty()) throw ProtocolError("UploadPart: missing ETag in response");
 
-	_etags.push_back(etag);
+	return etag;
+}
+
+// Returns false if failed, in that case _error is set and queued parts are discarded
+bool AWSFileWriter::UploadPartRetrying(std::shared_ptr<S3Session> &session, const PendingPart &part)
+{
+	std::string etag, error;
+	bool error_auth = false;
+	for (unsigned int attempt = 1; ; ++attempt) {
+		try {
+			if (!session) {
+				session = _session_factory();
+			}
+			etag = UploadPart(*session, part.number, part.data.data(), part.data.size());
+			break;
+
+		} catch (ProtocolAuthFailedError &e) {
+			error = e.what();
+			error_auth = true;
+			break;
+
+		} catch (std::exception &e) {
+			if (attempt >= _opts.retries) {
+				error = e.what();
+				break;
+			}
+			fprintf(stderr, "AWSFileWriter: part %d attempt %u failed: %s\n", part.number, attempt, e.what());
+			// connection could be left in unusable state, so retry with fresh one
+			session.reset();
+			std::this_thread::sleep_for(std::chrono::milliseconds(250 << attempt));
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (!error.empty()) {
+		if (_error.empty()) {
+			_error = error;
+			_error_auth = error_auth;
+		}
+		_queue.clear();
+		_cond.notify_all();
+		return false;
+	}
+	_etags[part.number] = etag;
+	_cond.notify_all();
+	return true;
+}
+
+void AWSFileWriter::UploadQueuedParts()
+{
+	std::shared_ptr<S3Session> session;
+	std::unique_lock<std::mutex> lock(_mtx);
+	for (;;) {
+		_cond.wait(lock, [this]{ return _stopping || !_queue.empty(); });
+		if (_stopping) {
+			break;
+		}
+		PendingPart part = std::move(_queue.front());
+		_queue.pop_front();
+		++_busy;
+		lock.unlock();
+
+		UploadPartRetrying(session, part);
+
+		lock.lock();
+		--_busy;
+		_cond.notify_all();
+	}
+}
+
+void AWSFileWriter::ThrowIfFailed()
+{
+	if (!_error.empty()) {
+		if (_error_auth) {
+			throw ProtocolAuthFailedError(_error);
+		}
+		throw ProtocolError(_error);
+	}
+}
+
+void AWSFileWriter::QueuePart(bool last)
+{
+	if (_buffer.empty()) return;
+
+	if (_opts.upload_concurrency <= 1 || (last && _part_number == 1)) {
+		// only one UploadPart can be in flight, so no point in worker thread
+		// with own session: upload on calling thread using repository's session
+		PendingPart part{_part_number, std::move(_buffer)};
+		++_part_number;
+		_buffer.clear();
+		if (!UploadPartRetrying(_session, part)) {
+			std::lock_guard<std::mutex> lock(_mtx);
+			ThrowIfFailed();
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	// bounds memory usage by upload_concurrency parts in flight plus one being filled
+	_cond.wait(lock, [this]{ return !_error.empty() || _queue.size() + _busy < _opts.upload_concurrency; });
+	ThrowIfFailed();
+
+	_queue.emplace_back(PendingPart{_part_number, std::move(_buffer)});
 	++_part_number;
 	_buffer.clear();
+	if (_workers.size() < _opts.upload_concurrency && _workers.size() < _queue.size() + _busy) {
+		_workers.emplace_back(new PartWorker(this));
+	}
+	_cond.notify_all();
+}
+
+void AWSFileWriter::WaitQueuedParts()
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	_cond.wait(lock, [this]{ return !_error.empty() || (_queue.empty() && _busy == 0); });
+	ThrowIfFailed();
+}
+
+void AWSFileWriter::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stopping = true;
+		_queue.clear();
+		_cond.notify_all();
+	}
+	_workers.clear();
 }
 
 void AWSFileWriter::CompleteMultipartUpload()
 {
-	if (_buffer.size() > 0) FlushPart();
+	QueuePart(true);
+	WaitQueuedParts();
+	StopWorkers();
+
 	if (_etags.empty()) {
-		std::string path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
-		std::map<std::string, std::string> qp = {{"partNumber", "1"}, {"uploadId", _upload_id}};
-		std::string payload_hash = S3SHA256Hex("");
-		auto auth_headers = S3SignRequest("PUT", _endpoint, path, qp,
-		                                  payload_hash, _creds.region,
-		                                  _creds.access_key, _creds.secret_key);
-		std::unique_ptr<char, decltype(&free)> escaped(ne_path_escape(path.c_str()), free);
-		std::string neon_path = (escaped ? escaped.get() : path) + "?" + BuildQueryString(qp);
-
-		WriteResponseCapture cap;
-		ne_request *req = ne_request_create(_session->sess, "PUT", neon_path.c_str());
-		if (!req) throw ProtocolError("Failed to create zero-byte part request");
-		for (auto &h : auth_headers) {
-			ne_add_request_header(req, h.first.c_str(), h.second.c_str());
-		}
-		ne_add_request_header(req, "Content-Length", "0");
-		ne_add_response_body_reader(req, ne_accept_always, WriteResponseCapture::sBodyReader, &cap);
-		int rc = ne_request_dispatch(req);
-		const char *etag_hdr = ne_get_response_header(req, "ETag");
-		std::string etag = etag_hdr ? etag_hdr : "";
-		const ne_status *st = ne_get_status(req);
-		int http_code = st ? st->code : 0;
-		ne_request_destroy(req);
-		if (rc != NE_OK) throw ProtocolError("UploadPart(0) failed");
-		if (http_code < 200 || http_code >= 300)
-			throw ProtocolError("UploadPart(0) HTTP error: " + std::to_string(http_code));
-		if (etag.empty()) throw ProtocolError("UploadPart(0): missing ETag");
-		_etags.push_back(etag);
+		_etags[1] = UploadPart(*_session, 1, nullptr, 0);
 	}
 
 	std::string xml = "<CompleteMultipartUpload>";
-	for (size_t i = 0; i < _etags.size(); ++i) {
-		xml += "<Part><PartNumber>" + std::to_string(i + 1) +
-		       "</PartNumber><ETag>" + _etags[i] + "</ETag></Part>";
+	for (const auto &it : _etags) {
+		xml += "<Part><PartNumber>" + std::to_string(it.first) +
+		       "</PartNumber><ETag>" + it.second + "</ETag></Part>";
 	}
 	xml += "</CompleteMultipartUpload>";
 
-	std::string path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
-	DoRequest("POST", path, {{"uploadId", _upload_id}}, xml);
+	DoRequest("POST", ObjectPath(), {{"uploadId", _upload_id}}, xml);
 	_completed = true;
 }
 
@@ -252,8 +382,7 @@ void AWSFileWriter::AbortMultipartUpload()
 {
 	if (_upload_id.empty()) return;
 	try {
-		std::string path = _path_prefix.empty() ? "/" + _key : _path_prefix + "/" + _key;
-		DoRequest("DELETE", path, {{"uploadId", _upload_id}}, "");
+		DoRequest("DELETE", ObjectPath(), {{"uploadId", _upload_id}}, "");
 	} catch (...) { /* best-effort abort — ignore errors */ } // NOSONAR(cpp:S2221)
 	_aborted = true;
 }
@@ -262,13 +391,16 @@ void AWSFileWriter::Write(const void *buf, size_t len) // NOSONAR(cpp:S5008)
 {
 	const char *data = reinterpret_cast<const char *>(buf);
 	while (len > 0) {
-		size_t space = MAX_PART_SIZE - _buffer.size();
+		if (_buffer.capacity() < _opts.part_size) {
+			_buffer.reserve(_opts.part_size);
+		}
+		size_t space = _opts.part_size - _buffer.size();
 		size_t chunk = std::min(len, space);
 		_buffer.insert(_buffer.end(), data, data + chunk);
 		data += chunk;
 		len -= chunk;
-		if (_buffer.size() >= MAX_PART_SIZE)
-			FlushPart();
+		if (_buffer.size() >= _opts.part_size)
+			QueuePart();
 	}
 }
 
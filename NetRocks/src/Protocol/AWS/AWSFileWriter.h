@@ -2,6 +2,8 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <condition_variable>
 #include <Threaded.h>
@@ -14,6 +16,8 @@ class AWSFileWriter : public IFileWriter
 {
 public:
 	AWSFileWriter(std::shared_ptr<S3Session> session,
+	              S3SessionFactory session_factory,
+	              const S3TransferOptions &opts,
 	              const S3Credentials &creds,
 	              const std::string &endpoint,
 	              const std::string &useragent,
@@ -25,7 +29,29 @@ public:
 	void WriteComplete() override;
 
 private:
-	std::shared_ptr<S3Session> _session;
+	// Uploads queued parts using own session, so up to
+	// opts.upload_concurrency UploadPart requests are in flight
+	class PartWorker : protected Threaded
+	{
+		AWSFileWriter *_owner;
+
+	protected:
+		void *ThreadProc() override; // NOSONAR(cpp:S5008)
+
+	public:
+		PartWorker(AWSFileWriter *owner);
+		~PartWorker() override;
+	};
+
+	struct PendingPart
+	{
+		int number;
+		std::vector<char> data;
+	};
+
+	std::shared_ptr<S3Session> _session; // used only by owner thread, also for inline uploads
+	S3SessionFactory           _session_factory;
+	S3TransferOptions          _opts;
 	S3Credentials              _creds;
 	std::string                _endpoint;
 	std::string                _useragent;
@@ -35,11 +61,20 @@ private:
 	std::string              _upload_id;
 	std::vector<char>        _buffer;
 	int                      _part_number = 1;
-	std::vector<std::string> _etags;   // one per completed part
 	bool                     _completed = false;
 	bool                     _aborted   = false;
 
-	static constexpr size_t MAX_PART_SIZE = 5 * 1024 * 1024;
+	std::mutex                 _mtx;
+	std::condition_variable    _cond;
+	std::deque<PendingPart>    _queue;
+	unsigned int               _busy = 0;
+	bool                       _stopping = false;
+	std::map<int, std::string> _etags;   // part number -> ETag of completed parts
+	std::string                _error;   // first failure, stops whole upload
+	bool                       _error_auth = false;
+	std::vector<std::unique_ptr<PartWorker>> _workers;
+
+	std::string ObjectPath() const;
 
 	std::string DoRequest(const std::string &method,
 	                      const std::string &path,
@@ -47,8 +82,15 @@ private:
 	                      const std::string &body,
 	                      const std::string &capture_response_header = "");
 
+	std::string UploadPart(S3Session &session, int number, const char *data, size_t len);
+	bool UploadPartRetrying(std::shared_ptr<S3Session> &session, const PendingPart &part);
+	void UploadQueuedParts();
+
 	void StartMultipartUpload();
-	void FlushPart();
+	void QueuePart(bool last = false);
+	void WaitQueuedParts();
+	void StopWorkers();
+	void ThrowIfFailed(); // expects _mtx locked
 	void CompleteMultipartUpload();
 	void AbortMultipartUpload();
 };
@@ -253,6 +253,10 @@ S3Repository::S3Repository(const std::string &host, unsigned int port,
 	_creds.region = options.GetString("Region");
 	_use_path_style = options.GetInt("UsePathStyle", 0) != 0;
 	_verify_ssl = options.GetInt("VerifySSL", 1) != 0;
+	_xfer_opts.part_size = size_t(std::min(std::max(options.GetInt("PartSizeMB", 8), 5), 512)) * 1024 * 1024;
+	_xfer_opts.upload_concurrency = (unsigned int)std::min(std::max(options.GetInt("UploadConcurrency", 4), 1), 32);
+	_xfer_opts.download_chunk = size_t(std::min(std::max(options.GetInt("DownloadChunkMB", 8), 1), 512)) * 1024 * 1024;
+	_xfer_opts.download_concurrency = (unsigned int)std::min(std::max(options.GetInt("DownloadConcurrency", 4), 1), 32);
 	if (_use_path_style && _creds.region.empty()) _creds.region = "us-east-1";
 
 	std::string trimmed_host = Trim(host);
@@ -355,22 +359,44 @@ S3Repository::S3Repository(const std::string &host, unsigned int port,
 	}
 }
 
-std::shared_ptr<S3Session> S3Repository::CreateConfiguredSession(const std::string &host)
+static std::shared_ptr<S3Session> CreateSession(const std::string &scheme, const std::string &host, unsigned int port,
+	bool verify_ssl, const std::string &proxy_host, unsigned int proxy_port)
 {
 	auto s = std::make_shared<S3Session>();
-	s->sess = ne_session_create(_scheme.c_str(), host.c_str(), _port);
+	s->sess = ne_session_create(scheme.c_str(), host.c_str(), port);
 	if (s->sess) {
-		if (_verify_ssl) {
+		if (verify_ssl) {
 			ne_ssl_trust_default_ca(s->sess);
 		} else {
 			ne_ssl_set_verify(s->sess, [](void *, int, const ne_ssl_certificate *) { return 0; }, nullptr); // NOSONAR(cpp:S5008)
 		}
-		if (!_proxy_host.empty())
-			ne_session_proxy(s->sess, _proxy_host.c_str(), _proxy_port);
+		if (!proxy_host.empty())
+			ne_session_proxy(s->sess, proxy_host.c_str(), proxy_port);
 	}
 	return s;
 }
 
+std::shared_ptr<S3Session> S3Repository::CreateConfiguredSession(const std::string &host)
+{
+	return CreateSession(_scheme, host, _port, _verify_ssl, _proxy_host, _proxy_port);
+}
+
+S3SessionFactory S3Repository::ConfiguredSessionFactory(const std::string &host)
+{
+	// captures settings by value as transfer may outlive repository
+	const std::string scheme = _scheme, proxy_host = _proxy_host;
+	const unsigned int port = _port, proxy_port = _proxy_port;
+	const bool verify_ssl = _verify_ssl;
+	return [scheme, host, port, verify_ssl, proxy_host, proxy_port]()
+	{
+		auto s = CreateSession(scheme, host, port, verify_ssl, proxy_host, proxy_port);
+		if (!s->sess) {
+			throw ProtocolError("Failed to create neon session");
+		}
+		return s;
+	};
+}
+
 std::shared_ptr<S3Session> S3Repository::GetOrCreateBucketSession(const std::string &neon_vhost)
 {
 	auto it = _bucket_sessions.find(neon_vhost);
@@ -619,11 +645,13 @@ std::shared_ptr<AWSFileReader> S3Repository::GetDownloader(const std::string &pa
 	Path localPath(path);
 	S3Credentials effective_creds = _creds;
 	std::shared_ptr<S3Session> req_session;
+	S3SessionFactory session_factory;
 	std::string effective_host;
 	std::string path_prefix;
 
 	if (_use_path_style) {
 		req_session = _session;
+		session_factory = ConfiguredSessionFactory(_neon_host);
 		effective_host = _endpoint;
 		path_prefix = "/" + localPath.bucket();
 		if (effective_creds.region.empty()) effective_creds.region = "us-east-1";
@@ -632,10 +660,11 @@ std::shared_ptr<AWSFileReader> S3Repository::GetDownloader(const std::string &pa
 		std::string neon_vhost;
 		effective_host = GetVirtualEndpoint(localPath.bucket(), effective_creds.region, &neon_vhost);
 		req_session = GetOrCreateBucketSession(neon_vhost);
+		session_factory = ConfiguredSessionFactory(neon_vhost);
 		path_prefix = "";
 	}
 
-	return std::make_shared<AWSFileReader>(req_session, effective_creds, effective_host, _useragent,
+	return std::make_shared<AWSFileReader>(req_session, session_factory, _xfer_opts, effective_creds, effective_host, _useragent,
 	                                       path_prefix, localPath.key(), position, size);
 }
 
@@ -644,11 +673,13 @@ std::shared_ptr<AWSFileWriter> S3Repository::GetUploader(const std::string &path
 	Path localPath(path);
 	S3Credentials effective_creds = _creds;
 	std::shared_ptr<S3Session> req_session;
+	S3SessionFactory session_factory;
 	std::string effective_host;
 	std::string path_prefix;
 
 	if (_use_path_style) {
 		req_session = _session;
+		session_factory = ConfiguredSessionFactory(_neon_host);
 		effective_host = _endpoint;
 		path_prefix = "/" + localPath.bucket();
 		if (effective_creds.region.empty()) effective_creds.region = "us-east-1";
@@ -657,10 +688,11 @@ std::shared_ptr<AWSFileWriter> S3Repository::GetUploader(const std::string &path
 		std::string neon_vhost;
 		effective_host = GetVirtualEndpoint(localPath.bucket(), effective_creds.region, &neon_vhost);
 		req_session = GetOrCreateBucketSession(neon_vhost);
+		session_factory = ConfiguredSessionFactory(neon_vhost);
 		path_prefix = "";
 	}
 
-	return std::make_shared<AWSFileWriter>(req_session, effective_creds, effective_host, _useragent,
+	return std::make_shared<AWSFileWriter>(req_session, session_factory, _xfer_opts, effective_creds, effective_host, _useragent,
 	                                       path_prefix, localPath.key());
 }
 
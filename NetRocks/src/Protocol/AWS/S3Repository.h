@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <neon/ne_session.h>
 #include "AWSFile.h"
 #include "../Protocol.h"
@@ -29,6 +30,18 @@ private:
 	S3Session &operator=(const S3Session &) = delete;
 };
 
+// Each concurrent transfer worker needs own neon session as they're not thread-safe
+typedef std::function<std::shared_ptr<S3Session>()> S3SessionFactory;
+
+struct S3TransferOptions
+{
+	size_t part_size = 8 * 1024 * 1024;       // multipart upload part size, S3 requires at least 5MB
+	unsigned int upload_concurrency = 4;      // max UploadPart requests in flight
+	size_t download_chunk = 8 * 1024 * 1024;  // size of single ranged GET
+	unsigned int download_concurrency = 4;    // max ranged GETs in flight
+	unsigned int retries = 3;                 // attempts per part/chunk before failing whole transfer
+};
+
 class S3Repository
 {
 public:
@@ -98,11 +111,13 @@ private:
 	unsigned int _proxy_port = 0;
 	bool _use_path_style = false;
 	bool _verify_ssl = true;
+	S3TransferOptions _xfer_opts;
 
 	std::map<std::string, std::shared_ptr<S3Session>> _bucket_sessions;
 	std::map<std::string, std::string> _bucket_region_cache;
 
 	std::shared_ptr<S3Session> CreateConfiguredSession(const std::string &host);
+	S3SessionFactory ConfiguredSessionFactory(const std::string &host);
 	std::shared_ptr<S3Session> GetOrCreateBucketSession(const std::string &neon_vhost);
 	std::string ResolveRegion(const std::string &bucket);
 	std::string GetEffectiveRegion(const std::string &bucket);
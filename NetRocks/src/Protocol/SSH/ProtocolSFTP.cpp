@@ -12,6 +12,7 @@
 #include <map>
 #include <set>
 #include <deque>
+#include <unordered_map>
 #include <fstream>
 #include <algorithm>
 #include <libssh/libssh.h>
@@ -77,6 +78,42 @@ struct SFTPConnection : SSHConnection
 	SFTPSession sftp;
 	size_t max_read_block = 32768; // default value
 	size_t max_write_block = 32768; // default value
+	size_t max_write_pipeline = 16; // default value
+	size_t max_stat_pipeline = 64; // default value
+
+	// files opened for IO may have async requests in flight, see SFTPPipelinedModes
+	unsigned int open_files = 0;
+
+	// modes of entries reported by recent readdir-s, same as lstat would return
+	struct ReaddirMode
+	{
+		mode_t mode;
+		time_t stamp;
+	};
+	std::unordered_map<std::string, ReaddirMode> readdir_modes;
+
+	enum {
+		READDIR_MODES_TTL = 5, // seconds
+		READDIR_MODES_LIMIT = 0x20000
+	};
+
+	void RememberReaddirMode(const std::string &path, mode_t mode, time_t now)
+	{
+		if (readdir_modes.size() >= READDIR_MODES_LIMIT) {
+			readdir_modes.clear();
+		}
+		readdir_modes[path] = ReaddirMode{mode, now};
+	}
+
+	bool LookupReaddirMode(const std::string &path, time_t now, mode_t &mode)
+	{
+		auto it = readdir_modes.find(path);
+		if (it == readdir_modes.end() || now - it->second.stamp > READDIR_MODES_TTL) {
+			return false;
+		}
+		mode = it->second.mode;
+		return true;
+	}
 
 	SFTPConnection(const std::string &host, unsigned int port, const std::string &username,
 		const std::string &password, const StringConfig &protocol_options)
@@ -85,6 +122,8 @@ struct SFTPConnection : SSHConnection
 	{
 		max_read_block = (size_t)std::max(protocol_options.GetInt("MaxReadBlock", max_read_block), 512);
 		max_write_block = (size_t)std::max(protocol_options.GetInt("MaxWriteBlock", max_write_block), 512);
+		max_write_pipeline = (size_t)std::max(protocol_options.GetInt("MaxWritePipeline", max_write_pipeline), 1);
+		max_stat_pipeline = (size_t)std::max(protocol_options.GetInt("MaxStatPipeline", max_stat_pipeline), 1);
 
 		const std::string &subsystem = protocol_options.GetString("CustomSubsystem");
 		if (!subsystem.empty() && protocol_options.GetInt("UseCustomSubsystem", 0) != 0) {
@@ -131,6 +170,18 @@ struct SFTPConnection : SSHConnection
 		if (rc != SSH_OK)
 			throw ProtocolError("SFTP init", ssh_get_error(ssh), rc);
 
+#if (LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0))
+		// server may not accept writes longer than it announced, and async write
+		// doesn't split request by itself, so clamp configured block to that limit
+		sftp_limits_t limits = sftp_limits(sftp);
+		if (limits) {
+			if (limits->max_write_length > 0 && max_write_block > limits->max_write_length) {
+				max_write_block = (size_t)limits->max_write_length;
+			}
+			sftp_limits_free(limits);
+		}
+#endif
+
 		//_dir = directory;
 	}
 
@@ -228,6 +279,177 @@ mode_t ProtocolSFTP::GetMode(const std::string &path, bool follow_symlink)
 	return mode;
 }
 
+// libssh has no API for asynchronous stat, so requests are written directly into SFTP
+// channel and replies are parsed here. It's safe only while no other requests are in
+// flight on this SFTP session, that means no files opened for IO. Request ids are taken
+// from range that libssh's own id counter never reaches, and all replies are consumed
+// before returning, so libssh never sees them.
+static void SFTPPutU32(std::string &out, uint32_t v)
+{
+	out+= (char)(unsigned char)(v >> 24);
+	out+= (char)(unsigned char)(v >> 16);
+	out+= (char)(unsigned char)(v >> 8);
+	out+= (char)(unsigned char)v;
+}
+
+static uint32_t SFTPGetU32(const unsigned char *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static void SFTPChannelRead(SFTPConnection &conn, void *buf, size_t len)
+{
+	for (char *p = (char *)buf; len;) {
+		int r = ssh_channel_read(conn.sftp->channel, p, (uint32_t)len, 0);
+		if (r <= 0)
+			throw ProtocolError("SFTP channel read", ssh_get_error(conn.ssh));
+		p+= r;
+		len-= (size_t)r;
+	}
+}
+
+static void SFTPReadPacket(SFTPConnection &conn, std::vector<unsigned char> &in)
+{
+	unsigned char hdr[4];
+	SFTPChannelRead(conn, hdr, sizeof(hdr));
+	const uint32_t len = SFTPGetU32(hdr);
+	if (len < 5 || len > 0x100000)
+		throw ProtocolError("SFTP bad packet length", len);
+	in.resize(len);
+	SFTPChannelRead(conn, in.data(), len);
+}
+
+static mode_t SFTPModeFromPermissions(uint32_t permissions)
+{
+	// same as SFTPModeFromAttributes would produce for libssh-parsed v3 attributes
+	mode_t out = permissions;
+	switch (permissions & S_IFMT) {
+		case S_IFREG: case S_IFDIR: case S_IFLNK: case 0: break;
+		default: out|= S_IFBLK;
+	}
+	return out;
+}
+
+#define SFTP_PIPELINED_FIRST_ID 0xc0000000
+
+static void SFTPPipelinedModes(SFTPConnection &conn, bool follow_symlink,
+	const std::string *paths, const std::vector<size_t> &indices, mode_t *modes)
+{
+	std::unordered_map<uint32_t, size_t> inflight; // request id -> index in paths
+	std::vector<std::pair<uint32_t, size_t> > batch;
+	std::string out;
+	std::vector<unsigned char> in;
+	uint32_t id = SFTP_PIPELINED_FIRST_ID;
+	size_t next = 0, replied = 0;
+	bool in_sync = true; // channel stream is at packets boundary
+
+	try {
+		while (replied < indices.size()) {
+			out.clear();
+			batch.clear();
+			for (; next < indices.size() && inflight.size() + batch.size() < conn.max_stat_pipeline; ++next) {
+				const std::string &path = paths[indices[next]];
+				SFTPPutU32(out, (uint32_t)(1 + 4 + 4 + path.size()));
+				out+= (char)(follow_symlink ? SSH_FXP_STAT : SSH_FXP_LSTAT);
+				SFTPPutU32(out, ++id);
+				SFTPPutU32(out, (uint32_t)path.size());
+				out+= path;
+				batch.emplace_back(id, indices[next]);
+			}
+			if (!out.empty()) {
+				in_sync = false;
+				int r = ssh_channel_write(conn.sftp->channel, out.data(), (uint32_t)out.size());
+				if (r < 0 || (size_t)r != out.size())
+					throw ProtocolError("SFTP channel write", ssh_get_error(conn.ssh));
+				in_sync = true;
+				inflight.insert(batch.begin(), batch.end());
+			}
+
+			in_sync = false;
+			SFTPReadPacket(conn, in);
+			in_sync = true;
+
+			auto it = inflight.find(SFTPGetU32(&in[1]));
+			if (it == inflight.end())
+				throw ProtocolError("SFTP unexpected reply id", SFTPGetU32(&in[1]));
+
+			const size_t index = it->second;
+			inflight.erase(it);
+			++replied;
+
+			if (in[0] == SSH_FXP_ATTRS && in.size() >= 9) {
+				const uint32_t flags = SFTPGetU32(&in[5]);
+				size_t ofs = 9;
+				if (flags & SSH_FILEXFER_ATTR_SIZE)
+					ofs+= 8;
+				if (flags & SSH_FILEXFER_ATTR_UIDGID)
+					ofs+= 8;
+				if ((flags & SSH_FILEXFER_ATTR_PERMISSIONS) && ofs + 4 <= in.size())
+					modes[index] = SFTPModeFromPermissions(SFTPGetU32(&in[ofs]));
+
+			} else if (in[0] != SSH_FXP_STATUS) {
+				throw ProtocolError("SFTP unexpected reply", in[0]);
+			}
+		}
+
+	} catch (...) {
+		// replies still in flight must not reach libssh, otherwise it would take them
+		// for replies to its own requests, so consume them or drop whole connection
+		try {
+			if (!in_sync)
+				throw std::runtime_error("channel out of sync");
+			for (size_t n = inflight.size(); n; --n) {
+				SFTPReadPacket(conn, in);
+			}
+		} catch (std::exception &e) {
+			fprintf(stderr, "%s: disconnecting due to %s\n", __FUNCTION__, e.what());
+			ssh_disconnect(conn.ssh);
+		}
+		throw;
+	}
+}
+
+void ProtocolSFTP::GetModes(bool follow_symlink, size_t count, const std::string *paths, mode_t *modes) noexcept
+{
+	// first take what recent readdir-s already told, for symlinks that is only good enough for lstat
+	std::vector<size_t> unknown;
+	const time_t now = time(NULL);
+	for (size_t i = 0; i < count; ++i) {
+		if (!_conn->LookupReaddirMode(paths[i], now, modes[i]) || (follow_symlink && S_ISLNK(modes[i]))) {
+			modes[i] = ~(mode_t)0;
+			unknown.emplace_back(i);
+		}
+	}
+
+	if (!unknown.empty()) try {
+		_conn->executed_command.reset();
+		if (unknown.size() > 1 && _conn->max_stat_pipeline > 1 && _conn->open_files == 0) {
+			SFTPPipelinedModes(*_conn, follow_symlink, paths, unknown, modes);
+
+		} else for (size_t i : unknown) {
+			sftp_attributes attributes = follow_symlink
+				? sftp_stat(_conn->sftp, paths[i].c_str()) : sftp_lstat(_conn->sftp, paths[i].c_str());
+			if (attributes) {
+				modes[i] = SFTPModeFromAttributes(attributes);
+				sftp_attributes_free(attributes);
+			}
+		}
+
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s: %s\n", __FUNCTION__, e.what());
+	} catch (...) {
+		fprintf(stderr, "%s: ...\n", __FUNCTION__);
+	}
+
+	if (_conn->file_stats_override) {
+		for (size_t i = 0; i < count; ++i) {
+			if (modes[i] != ~(mode_t)0) {
+				_conn->file_stats_override->FilterFileMode(paths[i], modes[i]);
+			}
+		}
+	}
+}
+
 unsigned long long ProtocolSFTP::GetSize(const std::string &path, bool follow_symlink)
 {
 #if SIMULATED_GETSIZE_FAILS_RATE
@@ -265,6 +487,7 @@ void ProtocolSFTP::FileDelete(const std::string &path)
 #endif
 
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_unlink(_conn->sftp, path.c_str());
 	if (rc != 0)
@@ -282,6 +505,7 @@ void ProtocolSFTP::DirectoryDelete(const std::string &path)
 #endif
 
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_rmdir(_conn->sftp, path.c_str());
 	if (rc != 0)
@@ -299,6 +523,7 @@ void ProtocolSFTP::DirectoryCreate(const std::string &path, mode_t mode)
 #endif
 
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_mkdir(_conn->sftp, path.c_str(), mode);
 	if (rc != 0)
@@ -313,6 +538,7 @@ void ProtocolSFTP::Rename(const std::string &path_old, const std::string &path_n
 #endif
 
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_rename(_conn->sftp, path_old.c_str(), path_new.c_str());
 	if (rc != 0)
@@ -345,6 +571,7 @@ void ProtocolSFTP::SetTimes(const std::string &path, const timespec &access_time
 void ProtocolSFTP::SetMode(const std::string &path, mode_t mode)
 {
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_chmod(_conn->sftp, path.c_str(), mode);
 	if (rc != 0) {
@@ -360,6 +587,7 @@ void ProtocolSFTP::SetMode(const std::string &path, mode_t mode)
 void ProtocolSFTP::SymlinkCreate(const std::string &link_path, const std::string &link_target)
 {
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	int rc = sftp_symlink(_conn->sftp, link_target.c_str(), link_path.c_str());
 	if (rc != 0)
@@ -387,13 +615,18 @@ class SFTPDirectoryEnumer : public IDirectoryEnumer
 {
 	std::shared_ptr<SFTPConnection> _conn;
 	SFTPDir _dir;
+	std::string _path_prefix; // for readdir_modes keys
 
 public:
 	SFTPDirectoryEnumer(std::shared_ptr<SFTPConnection> &conn, const std::string &path)
-		: _conn(conn), _dir(sftp_opendir(conn->sftp, path.c_str()))
+		: _conn(conn), _dir(sftp_opendir(conn->sftp, path.c_str())), _path_prefix(path)
 	{
 		if (!_dir)
 			throw ProtocolError(ssh_get_error(_conn->ssh));
+
+		if (!_path_prefix.empty() && _path_prefix.back() != '/') {
+			_path_prefix+= '/';
+		}
 	}
 
 	virtual bool Enum(std::string &name, std::string &owner, std::string &group, FileInformation &file_info)
@@ -420,6 +653,7 @@ public:
 				group = attributes->group ? attributes->group : "";
 
 				SftpFileInfoFromAttributes(file_info, attributes);
+				_conn->RememberReaddirMode(_path_prefix + name, file_info.mode, time(NULL));
 				return true;
 			}
 		}
@@ -457,6 +691,12 @@ public:
 			if (rc != 0)
 				throw ProtocolError("seek", ssh_get_error(_conn->ssh), rc);
 		}
+		++_conn->open_files;
+	}
+
+	~SFTPFileIO()
+	{
+		--_conn->open_files;
 	}
 };
 
@@ -664,21 +904,95 @@ public:
 };
 
 
+#if (LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0))
+# define SFTP_ASYNC_WRITE
+#endif
+
 class SFTPFileWriter : protected SFTPFileIO, public IFileWriter
 {
+#ifdef SFTP_ASYNC_WRITE
+	struct PipelinedWrite
+	{
+		sftp_aio aio;
+		size_t len;
+	};
+
+	// pipeline of write requests that were sent but not yet replied
+	std::deque<PipelinedWrite> _pipeline;
+
+	void AsyncWriteComplete()
+	{
+		PipelinedWrite pw = _pipeline.front();
+		_pipeline.pop_front();
+		// sftp_aio_wait_write frees aio unless returned SSH_AGAIN that cannot happen in blocking mode
+		ssize_t written = sftp_aio_wait_write(&pw.aio);
+		if (written < 0 || (size_t)written != pw.len) {
+			throw ProtocolError("write error", ssh_get_error(_conn->ssh));
+		}
+	}
+
+	void DiscardPipeline()
+	{
+		for (auto &pw : _pipeline) {
+			sftp_aio_free(pw.aio);
+		}
+		_pipeline.clear();
+	}
+#endif
+
 public:
 	SFTPFileWriter(std::shared_ptr<SFTPConnection> &conn, const std::string &path, int flags, mode_t mode, unsigned long long resume_pos)
 		: SFTPFileIO(conn, path, flags, mode, resume_pos)
 	{
 	}
 
+#ifdef SFTP_ASYNC_WRITE
+	~SFTPFileWriter()
+	{
+		if (!_pipeline.empty()) try {
+			if (g_netrocks_verbosity > 0) {
+				fprintf(stderr, "~SFTPFileWriter: still pipelined %u\n", (unsigned int)_pipeline.size());
+			}
+			do {
+				AsyncWriteComplete();
+			} while (!_pipeline.empty());
+
+		} catch (std::exception &ex) {
+			fprintf(stderr, "~SFTPFileWriter: %s\n", ex.what());
+			DiscardPipeline();
+		}
+	}
+#endif
+
 	virtual void Write(const void *buf, size_t len)
 	{
 #if SIMULATED_WRITE_FAILS_RATE
 		if ( (rand() % 100) + 1 <= SIMULATED_WRITE_FAILS_RATE)
 			throw ProtocolError("Simulated write file error");
 #endif
-		// somewhy libssh doesnt have async write yet
+#ifdef SFTP_ASYNC_WRITE
+		// keep up to max_write_pipeline requests in flight, error of any of them
+		// reported by subsequent Write or by WriteComplete
+		while (len > 0) {
+			while (_pipeline.size() >= _conn->max_write_pipeline) {
+				AsyncWriteComplete();
+			}
+			const size_t piece = std::min(len, _conn->max_write_block);
+			sftp_aio aio = nullptr;
+			ssize_t sent = sftp_aio_begin_write(_file, buf, piece, &aio);
+			if (sent < 0 || (size_t)sent != piece) {
+				if (aio) {
+					sftp_aio_free(aio);
+				}
+				throw ProtocolError("write error", ssh_get_error(_conn->ssh));
+			}
+			_pipeline.emplace_back(PipelinedWrite{aio, piece});
+
+			len-= piece;
+			buf = (const char *)buf + piece;
+		}
+#else
+		// libssh prior 0.11 doesnt have async write
 		if (len > 0) for (;;) {
 			size_t piece = (len >= _conn->max_write_block) ? _conn->max_write_block : len;
 			ssize_t written = sftp_write(_file, buf, piece);
@@ -692,6 +1006,7 @@ public:
 			len-= (size_t)written;
 			buf = (const char *)buf + written;
 		}
+#endif
 	}
 
 	virtual void WriteComplete()
@@ -700,7 +1015,16 @@ public:
 		if ( (rand() % 100) + 1 <= SIMULATED_WRITE_COMPLETE_FAILS_RATE)
 			throw ProtocolError("Simulated write-complete file error");
 #endif
-		// what?
+#ifdef SFTP_ASYNC_WRITE
+		try {
+			while (!_pipeline.empty()) {
+				AsyncWriteComplete();
+			}
+		} catch (...) {
+			DiscardPipeline();
+			throw;
+		}
+#endif
 	}
 };
 
@@ -715,6 +1039,7 @@ std::shared_ptr<IFileReader> ProtocolSFTP::FileGet(const std::string &path, unsi
 std::shared_ptr<IFileWriter> ProtocolSFTP::FilePut(const std::string &path, mode_t mode, unsigned long long size_hint, unsigned long long resume_pos)
 {
 	_conn->executed_command.reset();
+	_conn->readdir_modes.clear();
 
 	return std::make_shared<SFTPFileWriter>(_conn, path, O_WRONLY | O_CREAT | (resume_pos ? 0 : O_TRUNC), mode, resume_pos);
 }
@@ -14,6 +14,7 @@ public:
 		const std::string &password, const std::string &options);
 	virtual ~ProtocolSFTP();
 
+	virtual void GetModes(bool follow_symlink, size_t count, const std::string *paths, mode_t *modes) noexcept;
 	virtual mode_t GetMode(const std::string &path, bool follow_symlink = true);
 	virtual unsigned long long GetSize(const std::string &path, bool follow_symlink = true);
 	virtual void GetInformation(FileInformation &file_info, const std::string &path, bool follow_symlink = true);
@@ -112,33 +112,46 @@ WhatOnErrorAction WhatOnError::Ask(WhatOnErrorAction &default_wea)
 
 WhatOnErrorAction WhatOnErrorState::Query(ProgressState &progress_state, WhatOnErrorKind wek, const std::string &error, const std::string &object, const std::string &site, bool may_recovery)
 {
-	std::unique_lock<std::mutex> locker(_mtx);
-	auto wea = _default_weas[wek].emplace(error, WEA_ASK).first->second;
-	locker.unlock();
-	if (wea == WEA_RECOVERY && !may_recovery) {
-		wea = WEA_ASK;
-	}
+	std::unique_lock<std::mutex> locker(_mtx, std::defer_lock);
+	std::unique_lock<std::mutex> ui_locker(_ui_mtx, std::defer_lock);
+	WhatOnErrorAction wea;
+	for (;;) {
+		locker.lock();
+		wea = _default_weas[wek].emplace(error, WEA_ASK).first->second;
+		locker.unlock();
+		if (wea == WEA_RECOVERY && !may_recovery) {
+			wea = WEA_ASK;
+		}
 
-	if (wea != WEA_ASK) {
-		if (wea == WEA_RETRY || wea == WEA_RECOVERY) {
-			for (unsigned int sleep_usec = _auto_retry_delay * 1000000; sleep_usec; ) {
-				unsigned int sleep_usec_portion = (sleep_usec > 100000) ? 100000 : sleep_usec;
-				usleep(sleep_usec_portion);
-				sleep_usec-= sleep_usec_portion;
-				std::lock_guard<std::mutex> locker(progress_state.mtx);
-				if (progress_state.aborting) {
-					return WEA_CANCEL;
-				}
+		if (wea != WEA_ASK) {
+			if (ui_locker.owns_lock()) {
+				ui_locker.unlock();
 			}
-			if (_auto_retry_delay < 5) {
-				++_auto_retry_delay;
+			if (wea == WEA_RETRY || wea == WEA_RECOVERY) {
+				for (unsigned int sleep_usec = _auto_retry_delay * 1000000; sleep_usec; ) {
+					unsigned int sleep_usec_portion = (sleep_usec > 100000) ? 100000 : sleep_usec;
+					usleep(sleep_usec_portion);
+					sleep_usec-= sleep_usec_portion;
+					std::lock_guard<std::mutex> locker(progress_state.mtx);
+					if (progress_state.aborting) {
+						return WEA_CANCEL;
+					}
+				}
+				if (_auto_retry_delay < 5) {
+					++_auto_retry_delay;
+				}
 			}
+			return wea;
 		}
-		return wea;
-	}
-
 
+		if (ui_locker.owns_lock()) {
+			break;
+		}
 
+		// Errors may come from several concurrent transfers: show dialogs one by one
+		// and recheck remembered choice once previous dialog is closed.
+		ui_locker.lock();
+	}
 
 	++_showing_ui;
 	auto out = WhatOnError(wek, error, object, site, may_recovery).Ask(wea);
@@ -22,10 +22,11 @@ public:
 class WhatOnErrorState
 {
 	std::map<std::string, WhatOnErrorAction> _default_weas[WEKS_COUNT];
-	unsigned int _auto_retry_delay = 0;
+	std::atomic<unsigned int> _auto_retry_delay{0};
 	std::atomic<int> _showing_ui{0};
 	std::atomic<bool> _has_any_autoaction{false};
 	std::mutex _mtx;
+	std::mutex _ui_mtx;
 
 	public:
 	WhatOnErrorAction Query(ProgressState &progress_state, WhatOnErrorKind wek, const std::string &error, const std::string &object, const std::string &site, bool may_recovery = false);
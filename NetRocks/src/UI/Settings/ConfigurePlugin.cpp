@@ -17,6 +17,8 @@
 | Use of chmod:                    [COMBOBOX               ] |
 | [ ] Remember working directory in site settings            |
 | Connections pool expiration (seconds):               [   ] |
+| Concurrent file transfers per site:                  [  ] |
+| [ ] Cache directory listings on disk                       |
 |------------------------------------------------------------|
 |             [  OK    ]        [        Cancel       ]      |
  ============================================================
@@ -60,6 +62,8 @@ class ConfigurePlugin : protected BaseDialog
 	int _i_use_of_chmod = -1;
 	int _i_remember_directory = -1;
 	int _i_conn_pool_expiration = -1;
+	int _i_parallel_transfers = -1;
+	int _i_dir_listing_cache = -1;
 
 	int _i_ok = -1, _i_cancel = -1;
 
@@ -95,6 +99,13 @@ public:
 		_di.AddAtLine(DI_TEXT, 5,58, 0, MConnPoolExpiration);
 		_i_conn_pool_expiration = _di.AddAtLine(DI_FIXEDIT, 59,62, DIF_MASKEDIT, "30", "9999");
 
+		_di.NextLine();
+		_di.AddAtLine(DI_TEXT, 5,58, 0, MParallelTransfers);
+		_i_parallel_transfers = _di.AddAtLine(DI_FIXEDIT, 59,60, DIF_MASKEDIT, "1", "99");
+
+		_di.NextLine();
+		_i_dir_listing_cache = _di.AddAtLine(DI_CHECKBOX, 5,62, 0, MDirListingCache);
+
 		_di.NextLine();
 		_di.AddAtLine(DI_TEXT, 4,61, DIF_BOXCOLOR | DIF_SEPARATOR);
 
@@ -116,6 +127,8 @@ public:
 		SetDialogListPosition( _i_use_of_chmod, G.GetGlobalConfigInt("UseOfChmod", 0) );
 		SetCheckedDialogControl( _i_remember_directory, G.GetGlobalConfigBool("RememberDirectory", false) );
 		LongLongToDialogControl( _i_conn_pool_expiration, G.GetGlobalConfigInt("ConnectionsPoolExpiration", 30) );
+		LongLongToDialogControl( _i_parallel_transfers, G.GetGlobalConfigInt("ParallelTransfers", 1) );
+		SetCheckedDialogControl( _i_dir_listing_cache, G.GetGlobalConfigBool("DirListingCache", false) );
 
 		if (Show(L"PluginOptions", 6, 2) == _i_ok) {
 			auto gcw = G.GetGlobalConfigWriter();
@@ -125,6 +138,8 @@ public:
 			gcw.SetInt("UseOfChmod", GetDialogListPosition(_i_use_of_chmod));
 			gcw.SetBool("RememberDirectory", IsCheckedDialogControl(_i_remember_directory) );
 			gcw.SetInt("ConnectionsPoolExpiration", LongLongFromDialogControl( _i_conn_pool_expiration) );
+			gcw.SetInt("ParallelTransfers", std::max(1, (int)LongLongFromDialogControl( _i_parallel_transfers)) );
+			gcw.SetBool("DirListingCache", IsCheckedDialogControl(_i_dir_listing_cache) );
 		}
 	}
 };
@@ -10,6 +10,10 @@
  ===== WebDAV Protocol options ================
 | User agent:          [                     ] |
 | Region:              [                     ] |
+| Part size, MB:       [999]                   |
+| Upload threads:      [99 ]                   |
+| Download threads:    [99 ]                   |
+| Download chunk, MB:  [999]                   |
 | [x] Connect via proxy:                       |
 |  Proxy host:         [                     ] |
 |  Proxy port          [9999999              ] |
@@ -29,6 +33,8 @@ class ProtocolOptionsAWS : protected BaseDialog
 	int _i_region = -1;
 	int _i_use_path_style = -1;
 	int _i_use_untrusted_ssl = -1;
+	int _i_part_size = -1, _i_upload_concurrency = -1;
+	int _i_download_concurrency = -1, _i_download_chunk = -1;
 	int _i_use_proxy = -1, _i_proxy_host = -1, _i_proxy_port = -1;
 	int _i_auth_proxy = -1, _i_proxy_username = -1, _i_proxy_password = -1;
 
@@ -66,6 +72,22 @@ public:
 		_di.AddAtLine(DI_TEXT, 6,25, 0, MAWSRegion);
 		_i_region = _di.AddAtLine(DI_EDIT, 26,48, 0, "0", "0");
 
+		_di.NextLine();
+		_di.AddAtLine(DI_TEXT, 6,25, 0, MAWSPartSize);
+		_i_part_size = _di.AddAtLine(DI_FIXEDIT, 26,28, DIF_MASKEDIT, "8", "999");
+
+		_di.NextLine();
+		_di.AddAtLine(DI_TEXT, 6,25, 0, MAWSUploadConcurrency);
+		_i_upload_concurrency = _di.AddAtLine(DI_FIXEDIT, 26,27, DIF_MASKEDIT, "4", "99");
+
+		_di.NextLine();
+		_di.AddAtLine(DI_TEXT, 6,25, 0, MAWSDownloadConcurrency);
+		_i_download_concurrency = _di.AddAtLine(DI_FIXEDIT, 26,27, DIF_MASKEDIT, "4", "99");
+
+		_di.NextLine();
+		_di.AddAtLine(DI_TEXT, 6,25, 0, MAWSDownloadChunk);
+		_i_download_chunk = _di.AddAtLine(DI_FIXEDIT, 26,28, DIF_MASKEDIT, "8", "999");
+
 		_di.NextLine();
 		_i_use_path_style = _di.AddAtLine(DI_CHECKBOX, 5,48, 0, MAWSUsePathStyle);
 
@@ -112,6 +134,10 @@ public:
 
 		TextToDialogControl(_i_user_agent, sc.GetString("UserAgent"));
 		TextToDialogControl(_i_region, sc.GetString("Region"));
+		LongLongToDialogControl(_i_part_size, sc.GetInt("PartSizeMB", 8));
+		LongLongToDialogControl(_i_upload_concurrency, sc.GetInt("UploadConcurrency", 4));
+		LongLongToDialogControl(_i_download_concurrency, sc.GetInt("DownloadConcurrency", 4));
+		LongLongToDialogControl(_i_download_chunk, sc.GetInt("DownloadChunkMB", 8));
 		SetCheckedDialogControl(_i_use_path_style, sc.GetInt("UsePathStyle", 0) != 0);
 		SetCheckedDialogControl(_i_use_untrusted_ssl, sc.GetInt("VerifySSL", 1) == 0);
 		SetCheckedDialogControl( _i_use_proxy, sc.GetInt("UseProxy", 0) != 0);
@@ -129,6 +155,11 @@ public:
 			TextFromDialogControl(_i_region, str);
 			sc.SetString("Region", str);
 
+			sc.SetInt("PartSizeMB", std::max(5, (int)LongLongFromDialogControl(_i_part_size)));
+			sc.SetInt("UploadConcurrency", std::max(1, (int)LongLongFromDialogControl(_i_upload_concurrency)));
+			sc.SetInt("DownloadConcurrency", std::max(1, (int)LongLongFromDialogControl(_i_download_concurrency)));
+			sc.SetInt("DownloadChunkMB", std::max(1, (int)LongLongFromDialogControl(_i_download_chunk)));
+
 			sc.SetInt("UsePathStyle", IsCheckedDialogControl(_i_use_path_style) ? 1 : 0);
 			sc.SetInt("VerifySSL", IsCheckedDialogControl(_i_use_untrusted_ssl) ? 0 : 1);
 
@@ -16,6 +16,8 @@
 | Compression:          [COMBOBOX Compressed traffic       ] |
 | Max read block size, bytes:                 [9999999]      |
 | Max write block size, bytes:                [9999999]      |
+| Max pending write requests:                 [###]          |
+| Max pending stat requests:                  [###]          |
 | Automatically retry connect, times:         [##]           |
 | Connection timeout, seconds:                [###]          |
 | Allowed host keys:           [EDIT.......................] |
@@ -39,7 +41,7 @@ class ProtocolOptionsSFTPSCP : protected BaseDialog
 	int _i_auth_mode = -1, _i_privkey_path = -1;
 	int _i_use_custom_subsystem = -1, _i_custom_subsystem = -1;
 	int _i_compression = -1;
-	int _i_max_read_block_size = -1, _i_max_write_block_size = -1;
+	int _i_max_read_block_size = -1, _i_max_write_block_size = -1, _i_max_write_pipeline = -1, _i_max_stat_pipeline = -1;
 	int _i_connect_retries = -1, _i_connect_timeout = -1;
 	int _i_allowed_hostkeys = -1;
 	int _i_allowed_kex = -1;
@@ -196,6 +198,14 @@ public:
 			_di.NextLine();
 			_di.AddAtLine(DI_TEXT, 5,50, 0, MSFTPMaxWriteBlockSize);
 			_i_max_write_block_size = _di.AddAtLine(DI_FIXEDIT, 51,60, DIF_MASKEDIT, "32768", "9999999999");
+
+			_di.NextLine();
+			_di.AddAtLine(DI_TEXT, 5,50, 0, MSFTPMaxWritePipeline);
+			_i_max_write_pipeline = _di.AddAtLine(DI_FIXEDIT, 51,53, DIF_MASKEDIT, "16", "999");
+
+			_di.NextLine();
+			_di.AddAtLine(DI_TEXT, 5,50, 0, MSFTPMaxStatPipeline);
+			_i_max_stat_pipeline = _di.AddAtLine(DI_FIXEDIT, 51,53, DIF_MASKEDIT, "64", "999");
 			_di.NextLine();
 		}
 
@@ -293,6 +303,12 @@ public:
 		if (_i_max_write_block_size != -1) {
 			LongLongToDialogControl(_i_max_write_block_size, std::max((int)512, sc.GetInt("MaxWriteBlock", 32768)));
 		}
+		if (_i_max_write_pipeline != -1) {
+			LongLongToDialogControl(_i_max_write_pipeline, std::max((int)1, sc.GetInt("MaxWritePipeline", 16)));
+		}
+		if (_i_max_stat_pipeline != -1) {
+			LongLongToDialogControl(_i_max_stat_pipeline, std::max((int)1, sc.GetInt("MaxStatPipeline", 64)));
+		}
 
 		SetCheckedDialogControl(_i_tcp_nodelay, sc.GetInt("TcpNoDelay", 1) != 0);
 		SetCheckedDialogControl(_i_tcp_quickack, sc.GetInt("TcpQuickAck", 0) != 0);
@@ -337,6 +353,12 @@ public:
 			if (_i_max_write_block_size != -1) {
 				sc.SetInt("MaxWriteBlock", std::max((int)512, (int)LongLongFromDialogControl(_i_max_write_block_size)));
 			}
+			if (_i_max_write_pipeline != -1) {
+				sc.SetInt("MaxWritePipeline", std::max((int)1, (int)LongLongFromDialogControl(_i_max_write_pipeline)));
+			}
+			if (_i_max_stat_pipeline != -1) {
+				sc.SetInt("MaxStatPipeline", std::max((int)1, (int)LongLongFromDialogControl(_i_max_stat_pipeline)));
+			}
 			sc.SetInt("TcpNoDelay", IsCheckedDialogControl(_i_tcp_nodelay) ? 1 : 0);
 			sc.SetInt("TcpQuickAck", IsCheckedDialogControl(_i_tcp_quickack) ? 1 : 0);
 			sc.SetInt("IgnoreTimeModeErrors", IsCheckedDialogControl(_i_ignore_time_and_mode_errors) ? 1 : 0);
@@ -22,6 +22,8 @@ enum LanguageID
 	MUseOfChmod_Never,
 	MRememberDirectory,
 	MConnPoolExpiration,
+	MParallelTransfers,
+	MDirListingCache,
 
 	MRememberChoice,
 	MOperationFailed,
@@ -224,6 +226,8 @@ enum LanguageID
 	MSFTPCustomSubsystem,
 	MSFTPMaxReadBlockSize,
 	MSFTPMaxWriteBlockSize,
+	MSFTPMaxWritePipeline,
+	MSFTPMaxStatPipeline,
 	MSFTPTCPNodelay,
 	MSFTPTCPQuickAck,
 	MSFTPIgnoreTimeAndModeErrors,
@@ -333,5 +337,9 @@ enum LanguageID
 	MAWSAuthProxy,
 	MAWSProxyUsername,
 	MAWSProxyPassword,
+	MAWSPartSize,
+	MAWSUploadConcurrency,
+	MAWSDownloadConcurrency,
+	MAWSDownloadChunk,
 
 };
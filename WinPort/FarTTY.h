@@ -133,6 +133,13 @@ Synopsis:
   CLIP_GETDATA(CF_TEXT) -> (STATUS, UTF8 encoded text, ID of retrieved data)
   CLIP_CLOSE -> (STATUS)
 
+ Get text from clipboard in multiple transactions:
+  CLIP_OPEN(PASSCODE) -> (STATUS)
+  CLIP_GETDATACHUNK(CF_TEXT, 0) -> (TOTAL SIZE, ID of data, first part of UTF8 encoded text)
+  CLIP_GETDATACHUNK(CF_TEXT, size of first part) -> (TOTAL SIZE, ID of data, second part of UTF8 encoded text)
+  ...
+  CLIP_CLOSE -> (STATUS)
+
 
 Glossary:
 
@@ -197,6 +204,16 @@ Glossary:
 */
 #define FARTTY_INTERACT_CLIP_SETDATACHUNK          'S'
 
+/** Same as FARTTY_INTERACT_CLIP_SETDATACHUNK but chunk's data is compressed by LZBlockCompress.
+ OPTIONAL: can be used only if server reported both FARTTY_FEATCLIP_CHUNKED_SET and FARTTY_FEATCLIP_COMPRESSION
+ In:
+  uint16_t (chunk's uncompressed data size, shifted right by 8 bits, must be nonzero)
+  uint32_t (compressed data size)
+  compressed data of specified size
+ Out: N/A
+*/
+#define FARTTY_INTERACT_CLIP_SETDATACHUNK_COMPRESSED 'Z'
+
 /** Puts into clipboard data of specified format. Prepends given data with pending chunks (if any).
  In:
   uint32_t (format ID)
@@ -227,6 +244,26 @@ Glossary:
 */
 #define FARTTY_INTERACT_CLIP_GETDATAID             'i'
 
+/** Gets part of clipboard data of specified format.
+ Request with zero offset takes snapshot of current clipboard data, requests with nonzero offset
+ return parts of that snapshot, so data doesn't change in the middle of transfer. Snapshot is
+ released on CLIP_CLOSE or when its last part retrieved.
+ OPTIONAL: can be used only if server reported FARTTY_FEATCLIP_CHUNKED_GET as supported feature
+ In:
+  uint32_t (format ID)
+  uint32_t (offset of requested part)
+  uint16_t (maximal uncompressed size of part, shifted right by 8 bits, must be nonzero)
+  uint8_t (1 - part can be compressed, only if server reported FARTTY_FEATCLIP_COMPRESSION, 0 - no compression)
+ Out:
+  uint32_t (0 - on failure, -1 - clipboard wasn't open, other value - total size of data - on success)
+  uint64_t (clipboard data ID or zero if server doesn't support FARTTY_FEATCLIP_DATA_ID), only on success
+  uint32_t (uncompressed size of part), only on success
+  uint8_t (1 - part's data compressed by LZBlockCompress, 0 - not compressed), only on success
+  uint32_t (size of part's data), only on success
+  part's data of specified size, only on success
+*/
+#define FARTTY_INTERACT_CLIP_GETDATACHUNK          'G'
+
 /** Registers arbitrary clipboard data format.
  In:
   string (format name to be registered)
@@ -307,6 +344,17 @@ Glossary:
 */
 #define FARTTY_FEATCLIP_CHUNKED_SET           0x00000002
 
+/** Server reports this on response of FARTTY_INTERACT_CLIP_OPEN if it supports chunked clipboard data get.
+ This feature allows client to retrieve large clipboard data by parts, showing progress and allowing cancellation.
+*/
+#define FARTTY_FEATCLIP_CHUNKED_GET           0x00000004
+
+/** Server reports this on response of FARTTY_INTERACT_CLIP_OPEN if it supports compressed chunks.
+ Compression applies only to FARTTY_INTERACT_CLIP_SETDATACHUNK_COMPRESSED and FARTTY_INTERACT_CLIP_GETDATACHUNK.
+ See utils/include/LZBlock.h for compression format.
+*/
+#define FARTTY_FEATCLIP_COMPRESSION           0x00000008
+
 ///////////////////////
 /**
 FARTTY_INPUT_* notifications are send from server to client to inform about specific event happened.
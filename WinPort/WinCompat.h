@@ -1189,6 +1189,7 @@ typedef void *HKL;
 #define ERROR_INVALID_PARAMETER          EINVAL
 #define ERROR_NOT_SAME_DEVICE            EXDEV
 #define ERROR_CANCELLED                  ECANCELED
+#define ERROR_REQUEST_ABORTED            ECANCELED
 #define ERROR_ACCESS_DENIED              EACCES
 #define ERROR_BUFFER_OVERFLOW            EOVERFLOW
 #define ERROR_WRITE_FAULT                EIO
@@ -44,6 +44,12 @@
 #define TWEAK_STATUS_SUPPORT_TTY_PALETTE	0x10
 #define TWEAK_STATUS_SUPPORT_BLINK_RATE		0x20
 
+// TraceConsoleLatency stages, reported by application when input-to-paint latency
+// tracing is enabled by FAR2L_LATENCY_TRACE environment variable, no-op otherwise
+#define CONSOLE_LATENCY_DISPATCHED	1 // dequeued input event(s) processed
+#define CONSOLE_LATENCY_FLUSHED		2 // resulting changes written to console output
+#define CONSOLE_LATENCY_UNCHANGED	3 // flush found nothing to write to console output
+
 // FindFirstFileWithFlags
 #define FIND_FILE_FLAG_NO_DIRS		0x01
 #define FIND_FILE_FLAG_NO_FILES		0x02
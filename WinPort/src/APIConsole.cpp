@@ -8,6 +8,7 @@
 
 #include "WinPort.h"
 #include "Backend.h"
+#include "LatencyTrace.h"
 
 #define FORKED_CONSOLE_MAGIC 0xc001ba11f00dbabe
 
@@ -555,6 +556,11 @@ extern "C" {
 		}
 	}
 
+	WINPORT_DECL(TraceConsoleLatency, VOID, (DWORD Stage))
+	{
+		LatencyTraceMark(Stage);
+	}
+
 	WINPORT_DECL(GetConsoleImageCaps, BOOL, (HANDLE con, size_t sizeof_wgi, WinportGraphicsInfo *wgi))
 	{
 		if (sizeof_wgi != sizeof(*wgi)) {
@@ -13,6 +13,7 @@
 #include "SDLBackendUtils.h"
 #include "SDLFontManager.h"
 #include "SDLPrinterSupport.h"
+#include "LatencyTrace.h"
 
 #include <SDL.h>
 #include <ft2build.h>
@@ -637,6 +638,9 @@ public:
 	void NotifyFrameDrawn()
 	{
 		_frame_pending = true;
+		if (!_latency_painting && LatencyTraceEnabled()) {
+			_latency_painting = LatencyTraceNow();
+		}
 		if (g_sdl_debug_redraw) {
 			SDLDebugLog("PresentController: frame pending (waiters=%zu)", _flush_waiters.size());
 		}
@@ -645,6 +649,10 @@ public:
 	void NotifyPresented()
 	{
 		_frame_pending = false;
+		if (_latency_painting) {
+			LatencyTracePainted(_latency_painting);
+			_latency_painting = 0;
+		}
 		if (g_sdl_debug_redraw) {
 			SDLDebugLog("PresentController: frame presented (waiters=%zu)", _flush_waiters.size());
 		}
@@ -679,6 +687,7 @@ public:
 private:
 	SDLConsoleRenderer *_renderer{nullptr};
 	bool _frame_pending{false};
+	uint64_t _latency_painting{0};
 	std::vector<std::shared_ptr<std::promise<bool>>> _flush_waiters;
 };
 
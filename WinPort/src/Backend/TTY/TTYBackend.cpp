@@ -16,6 +16,7 @@
 #include "CheckedCast.hpp"
 #include "WinPortHandle.h"
 #include "Backend.h"
+#include "LatencyTrace.h"
 #include "TTYBackend.h"
 #include "TTYRevive.h"
 #include "TTYFar2lClipboardBackend.h"
@@ -437,8 +438,13 @@ void TTYBackend::WriterThread()
 				ae.output = true;
 			}
 
-			if (ae.output)
+			uint64_t latency_painting = 0;
+			if (ae.output) {
+				if (LatencyTraceEnabled()) {
+					latency_painting = LatencyTraceNow();
+				}
 				DispatchOutput(tty_out);
+			}
 
 			if (ae.title_changed) {
 				tty_out.ChangeTitle(StrWide2MB(g_winport_con_out->GetTitle()));
@@ -467,6 +473,9 @@ void TTYBackend::WriterThread()
 
 			tty_out.Flush();
 			tcdrain(_stdout);
+			if (latency_painting) {
+				LatencyTracePainted(latency_painting);
+			}
 
 			if (ae.go_background) {
 				gone_background = true;
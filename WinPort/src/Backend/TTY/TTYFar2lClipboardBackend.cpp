@@ -2,12 +2,82 @@
 #include <utils.h>
 #include <RandomString.h>
 #include <base64.h>
+#include <LZBlock.h>
 #include <UtfConvert.hpp>
 #include "TTYFar2lClipboardBackend.h"
 #include "WinPort.h"
 #include "FarTTY.h"
 
 #define CHUNK_SIZE 0x4000 // must be aligned by 0x100 and be less than 0x1000000
+#define GET_CHUNK_SIZE 0x40000 // same requirements as for CHUNK_SIZE
+
+// Delay before showing progress of clipboard data retrieval and interval of its updates
+#define GET_PROGRESS_DELAY_MSEC 500
+#define GET_PROGRESS_INTERVAL_MSEC 200
+
+/** Shows progress of long clipboard data retrieval in console title
+ and checks if user requested cancellation by pressing Escape.
+*/
+class ClipboardGetProgress
+{
+	DWORD _start = WINPORT(GetTickCount)();
+	DWORD _last_update = 0;
+	bool _shown = false;
+	std::wstring _saved_title, _shown_title;
+
+	static bool EscapePressed()
+	{
+		// look only at Escape records at head of queue: input queued before them
+		// belongs to UI and can't be removed without losing or reordering it
+		INPUT_RECORD irs[8];
+		const DWORD n = g_winport_con_in->Peek(irs, ARRAYSIZE(irs));
+		DWORD i = 0;
+		bool pressed = false;
+		for (; i < n && irs[i].EventType == KEY_EVENT
+				&& irs[i].Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE; ++i) {
+			if (irs[i].Event.KeyEvent.bKeyDown) {
+				pressed = true;
+			}
+		}
+		if (pressed) {
+			g_winport_con_in->Dequeue(irs, i); // consume Escape so it will not be processed by UI
+		}
+		return pressed;
+	}
+
+public:
+	~ClipboardGetProgress()
+	{
+		if (_shown && g_winport_con_out->GetTitle() == _shown_title) {
+			g_winport_con_out->SetTitle(_saved_title.c_str());
+		}
+	}
+
+	// returns false if user cancelled transfer
+	bool Update(uint32_t done, uint32_t total)
+	{
+		if (EscapePressed()) {
+			return false;
+		}
+		const DWORD now = WINPORT(GetTickCount)();
+		if (now - _start < GET_PROGRESS_DELAY_MSEC || (_shown && now - _last_update < GET_PROGRESS_INTERVAL_MSEC)) {
+			return true;
+		}
+		if (!_shown) {
+			_saved_title = g_winport_con_out->GetTitle();
+			_shown = true;
+		}
+		_last_update = now;
+		_shown_title = L"{Clipboard ";
+		_shown_title+= std::to_wstring(uint64_t(done) * 100 / total);
+		_shown_title+= L"% of ";
+		_shown_title+= std::to_wstring((total + 1023) / 1024);
+		_shown_title+= L" KB, Esc to cancel} ";
+		_shown_title+= _saved_title;
+		g_winport_con_out->SetTitle(_shown_title.c_str());
+		return true;
+	}
+};
 
 /////////////
 
@@ -264,7 +334,8 @@ bool TTYFar2lClipboardBackend::OnClipboardIsFormatAvailable(UINT format)
 
 /** To improve UI responsivity setting clipboard data is done by separate thread,
  this thread sends data as sequence of CHUNK_SIZE blocks with 8:1 throttling
- to keep some part of bandwidth available for UI communication. Also this send can be
+ to keep some part of bandwidth available for UI communication. Blocks are
+ compressed if server supports it and if that actually reduces their size. Also this send can be
  cancelled at any moment by subsequent clipboard set/empty request.
  To allow getting clipboard data while transfer in progress OnClipboardGetData checks
  if set-data thread still pending and uses its data as current clipboard content if so
@@ -275,15 +346,27 @@ void *TTYFar2lClipboardBackend::SetDataThread::ThreadProc()
 		size_t ofs = 0;
 		StackSerializer stk_ser;
 		if ((_backend->_features & FARTTY_FEATCLIP_CHUNKED_SET) != 0 && _data.size() > CHUNK_SIZE) {
+			std::vector<unsigned char> compressed;
 			DWORD busy_period_start = WINPORT(GetTickCount)();
 			unsigned int i = 0;
 			do {
 				fprintf(stderr, "TTYFar2lClipboardBackend::SetDataThread: chunk @0x%lx of 0x%lx\n",
 					(unsigned long)ofs, (unsigned long)_data.size());
 				++i;
-				stk_ser.Push(&_data[ofs], CHUNK_SIZE);
-				stk_ser.PushNum(uint16_t(CHUNK_SIZE >> 8));
-				stk_ser.PushNum(FARTTY_INTERACT_CLIP_SETDATACHUNK);
+				compressed.clear();
+				if ((_backend->_features & FARTTY_FEATCLIP_COMPRESSION) != 0) {
+					LZBlockCompress(compressed, &_data[ofs], CHUNK_SIZE);
+				}
+				if (!compressed.empty() && compressed.size() < CHUNK_SIZE) {
+					stk_ser.Push(compressed.data(), compressed.size());
+					stk_ser.PushNum(uint32_t(compressed.size()));
+					stk_ser.PushNum(uint16_t(CHUNK_SIZE >> 8));
+					stk_ser.PushNum(FARTTY_INTERACT_CLIP_SETDATACHUNK_COMPRESSED);
+				} else {
+					stk_ser.Push(&_data[ofs], CHUNK_SIZE);
+					stk_ser.PushNum(uint16_t(CHUNK_SIZE >> 8));
+					stk_ser.PushNum(FARTTY_INTERACT_CLIP_SETDATACHUNK);
+				}
 				// wait for reply only each 16th request to reduce round-trip delays
 				_backend->Far2lInteract(stk_ser, (i % 16) == 0);
 				ofs+= CHUNK_SIZE;
@@ -450,6 +533,10 @@ void *TTYFar2lClipboardBackend::InnerClipboardGetData(UINT format, uint32_t &len
 	}
 	fprintf(stderr, "TTYFar2lClipboardBackend::InnerClipboardGetData(0x%x): cache miss\n", format);
 
+	if ((_features & FARTTY_FEATCLIP_CHUNKED_GET) != 0) {
+		return ChunkedClipboardGetData(format, len);
+	}
+
 	try {
 		StackSerializer stk_ser;
 		stk_ser.PushNum(format);
@@ -482,6 +569,95 @@ void *TTYFar2lClipboardBackend::InnerClipboardGetData(UINT format, uint32_t &len
 	return nullptr;
 }
 
+/** Retrieves clipboard data as sequence of GET_CHUNK_SIZE parts, so large data doesn't
+ stuck whole communication within single huge reply. Parts are compressed by server if
+ it supports that. Long retrieval shows its progress and can be cancelled by Escape.
+*/
+void *TTYFar2lClipboardBackend::ChunkedClipboardGetData(UINT format, uint32_t &len)
+{
+	const uint8_t compression = ((_features & FARTTY_FEATCLIP_COMPRESSION) != 0) ? 1 : 0;
+	ClipboardGetProgress progress;
+	std::vector<unsigned char> compressed;
+	unsigned char *data = nullptr;
+	uint64_t id = 0;
+	uint32_t ofs = 0;
+	len = 0;
+
+	try {
+		do {
+			StackSerializer stk_ser;
+			stk_ser.PushNum(compression);
+			stk_ser.PushNum(uint16_t(GET_CHUNK_SIZE >> 8));
+			stk_ser.PushNum(ofs);
+			stk_ser.PushNum(format);
+			stk_ser.PushNum(FARTTY_INTERACT_CLIP_GETDATACHUNK);
+			Far2lInteract(stk_ser, true);
+			const uint32_t total = stk_ser.PopU32();
+			if (total == 0 || total == (uint32_t)-1) {
+				if (ofs != 0) {
+					throw std::runtime_error("transfer interrupted");
+				}
+				return nullptr;
+			}
+			if (!data) {
+				data = (unsigned char *)WINPORT(ClipboardAlloc)(total);
+				if (!data) {
+					throw std::runtime_error("alloc failed");
+				}
+				len = total;
+
+			} else if (total != len) {
+				throw std::runtime_error("total size changed");
+			}
+
+			stk_ser.PopNum(id);
+			const uint32_t part_len = stk_ser.PopU32();
+			const uint8_t part_compressed = stk_ser.PopU8();
+			const uint32_t part_data_len = stk_ser.PopU32();
+			if (part_len == 0 || part_len > len - ofs) {
+				throw std::runtime_error("bad part size");
+			}
+			if (part_compressed) {
+				if (part_data_len > size_t(part_len) + part_len / 255 + 16) {
+					throw std::runtime_error("bad compressed part size");
+				}
+				compressed.resize(part_data_len);
+				stk_ser.Pop(compressed.data(), compressed.size());
+				if (!LZBlockDecompress(data + ofs, part_len, compressed.data(), compressed.size())) {
+					throw std::runtime_error("corrupted compressed part");
+				}
+
+			} else if (part_data_len == part_len) {
+				stk_ser.Pop(data + ofs, part_len);
+
+			} else {
+				throw std::runtime_error("bad part data size");
+			}
+			ofs+= part_len;
+
+			if (ofs < len && !progress.Update(ofs, len)) {
+				throw std::runtime_error("cancelled");
+			}
+		} while (ofs < len);
+
+		fprintf(stderr, "TTYFar2lClipboardBackend::ChunkedClipboardGetData(0x%x): 0x%lx\n",
+			format, (unsigned long)len);
+
+		if (id && (_features & FARTTY_FEATCLIP_DATA_ID) != 0) {
+			SetCachedData(format, data, len, id);
+		}
+		return data;
+
+	} catch (std::exception &e) {
+		fprintf(stderr, "TTYFar2lClipboardBackend::ChunkedClipboardGetData: %s @0x%lx of 0x%lx\n",
+			e.what(), (unsigned long)ofs, (unsigned long)len);
+		WINPORT(ClipboardFree)(data);
+	}
+
+	len = 0;
+	return nullptr;
+}
+
 /////////
 
 UINT TTYFar2lClipboardBackend::OnClipboardRegisterFormat(const wchar_t *lpszFormat)
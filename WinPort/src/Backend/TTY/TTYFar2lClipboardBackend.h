@@ -60,6 +60,7 @@ class TTYFar2lClipboardBackend : public IClipboardBackend
 	void SetCachedData(UINT format, const void *data, uint32_t len, uint64_t id);
 	void OnSetDataThreadComplete(SetDataThread *set_data_thread, StackSerializer &stk_ser);
 	void *InnerClipboardGetData(UINT format, uint32_t &len);
+	void *ChunkedClipboardGetData(UINT format, uint32_t &len);
 
 public:
 	TTYFar2lClipboardBackend(IFar2lInteractor *interactor);
@@ -573,12 +573,30 @@ void TTYOutput::SendFar2lInteract(const StackSerializer &stk_ser)
 	Write(request.c_str(), request.size());
 }
 
+// Terminals limit OSC52 payload size and huge sequence stucks output for long time,
+// so larger data not sent at all, it still remains available in far2l own clipboard.
+#define OSC52_MAX_DATA_SIZE      0x400000
+// Data encoded and written by parts of this size, must be multiple of 3 to keep base64 contiguous
+#define OSC52_ENCODE_PART_SIZE   0x30000
+
 void TTYOutput::SendOSC52ClipSet(const std::string &clip_data)
 {
-	std::string request = ESC "]52;;";
-	base64_encode(request, (const unsigned char *)clip_data.data(), clip_data.size());
-	request+= '\a';
-	Write(request.c_str(), request.size());
+	if (clip_data.size() > OSC52_MAX_DATA_SIZE) {
+		fprintf(stderr, "TTYOutput::SendOSC52ClipSet: skipped too large data - 0x%lx\n",
+			(unsigned long)clip_data.size());
+		return;
+	}
+
+	Write(ESC "]52;;");
+	std::string part;
+	for (size_t ofs = 0; ofs < clip_data.size(); ofs+= OSC52_ENCODE_PART_SIZE) {
+		part.clear();
+		base64_encode(part, (const unsigned char *)clip_data.data() + ofs,
+			std::min(clip_data.size() - ofs, (size_t)OSC52_ENCODE_PART_SIZE));
+		Write(part.c_str(), part.size());
+		Flush();
+	}
+	Write("\a");
 }
 
 void TTYOutput::RequestCellSize()
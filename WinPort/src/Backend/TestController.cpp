@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <LocalSocket.h>
 #include <Event.h>
+#include <sys/resource.h>
 
 static void StrCpyZeroFill(char *dst, size_t dst_len, const std::string &src)
 {
@@ -85,6 +86,10 @@ void TestController::ClientLoop(const std::string &ipc_client)
 				len = ClientDispatchSendMouse(len);
 				break;
 
+			case TEST_CMD_STATS:
+				len = ClientDispatchStats();
+				break;
+
 			default:
 				throw std::runtime_error(StrPrintf("bad command %u", _buf.cmd));
 		}
@@ -307,3 +312,21 @@ size_t TestController::ClientDispatchSync(size_t len)
 	ev->Deref();
 	return sizeof(_buf.rep_sync);
 }
+
+size_t TestController::ClientDispatchStats()
+{
+	ZeroFill(_buf.rep_stats);
+	struct rusage ru{};
+	if (getrusage(RUSAGE_SELF, &ru) == 0) {
+		_buf.rep_stats.user_usec = uint64_t(ru.ru_utime.tv_sec) * 1000000 + ru.ru_utime.tv_usec;
+		_buf.rep_stats.sys_usec = uint64_t(ru.ru_stime.tv_sec) * 1000000 + ru.ru_stime.tv_usec;
+#ifdef __APPLE__
+		_buf.rep_stats.peak_rss_kb = uint64_t(ru.ru_maxrss) / 1024; // bytes on Mac
+#else
+		_buf.rep_stats.peak_rss_kb = uint64_t(ru.ru_maxrss);
+#endif
+	}
+	// change id never zero, so zero-timeout wait just returns its current value
+	_buf.rep_stats.output_change_id = g_winport_con_out->WaitForChange(0, 0);
+	return sizeof(_buf.rep_stats);
+}
@@ -27,6 +27,8 @@ class TestController : protected Threaded
 
 		TestRequestSync req_sync;
 		TestReplySync rep_sync;
+
+		TestReplyStats rep_stats;
 	} _buf;
 
 	virtual void *ThreadProc();
@@ -37,6 +39,7 @@ class TestController : protected Threaded
 	size_t ClientDispatchSendKey(size_t len);
 	size_t ClientDispatchSendMouse(size_t len);
 	size_t ClientDispatchSync(size_t len);
+	size_t ClientDispatchStats();
 
 public:
 	TestController(const std::string &id);
@@ -16,6 +16,7 @@ enum TestCommand
 	TEST_CMD_SEND_KEY,
 	TEST_CMD_SYNC,
 	TEST_CMD_SEND_MOUSE,
+	TEST_CMD_STATS,
 };
 
 struct TestReplyStatus
@@ -92,3 +93,12 @@ struct TestReplySync
 {
 	uint8_t waited;
 };
+
+struct TestReplyStats
+{ // resources consumed by tested process since its start
+	uint64_t user_usec;
+	uint64_t sys_usec;
+	uint64_t peak_rss_kb;
+	uint32_t output_change_id; // incremented on each console output modification, wraps around
+	uint32_t reserved;
+};
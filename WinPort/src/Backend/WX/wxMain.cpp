@@ -7,6 +7,7 @@
 #include <vector>
 #include <memory>
 #include "wxPrinterSupport.h"
+#include "LatencyTrace.h"
 
 #define AREAS_REDUCTION
 
@@ -1778,6 +1779,7 @@ void WinPortPanel::OnPaint( wxPaintEvent& event )
 {
 	//fprintf(stderr, "WinPortPanel::OnPaint\n");
 	_pending_refreshes = 0;
+	const uint64_t latency_painting = LatencyTraceEnabled() ? LatencyTraceNow() : 0;
 
 	wxPaintDC dc(this);
 	if (_mouse_qedit_moved && _mouse_qedit_start_ticks != 0
@@ -1797,6 +1799,10 @@ void WinPortPanel::OnPaint( wxPaintEvent& event )
 	wxRect rc = rgn.GetBox();
 	_images.Paint(dc, rc, _paint_context.FontWidth(), _paint_context.FontHeight());
 
+	if (latency_painting) {
+		LatencyTracePainted(latency_painting);
+	}
+
 	if (_force_size_on_paint_state == 0) {
 		_force_size_on_paint_state = 1;
 	}
@@ -29,6 +29,7 @@
 #include "WinPortRGB.h"
 #include "ConsoleOutput.h"
 #include "ConsoleInput.h"
+#include "LatencyTrace.h"
 #include "WinPortHandle.h"
 #include "ExtClipboardBackend.h"
 #include "PathHelpers.h"
@@ -570,6 +571,7 @@ extern "C" int WinPortMain(const char *full_exe_path, int argc, char **argv, int
 							fprintf(stderr, "Cannot use TTY backend\n");
 						}
 					}
+					LatencyTraceSave();
 					_exit(result);
 				}
 				close(new_notify_pipe[1]);
@@ -585,6 +587,8 @@ extern "C" int WinPortMain(const char *full_exe_path, int argc, char **argv, int
 		}
 	}
 
+	LatencyTraceSave();
+
 	g_winport_con_out = nullptr;
 	g_winport_con_in = nullptr;
 
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include "ConsoleInput.h"
+#include "LatencyTrace.h"
 #include "WinPort.h"
 #include <UtfDefines.h>
 #include <utils.h>
@@ -344,9 +345,15 @@ void ConsoleInput::Enqueue(const INPUT_RECORD *data, DWORD size)
 			}
 		}
 
+		const bool latency_trace = LatencyTraceEnabled();
+		const uint64_t now = latency_trace ? LatencyTraceNow() : 0;
 		std::unique_lock<std::mutex> lock(_mutex);
-		for (DWORD i = 0; i < size; ++i)
+		for (DWORD i = 0; i < size; ++i) {
 			_pending.push_back(data[i]);
+			if (latency_trace && LatencyTraceTracked(data[i])) {
+				_pending_latency_stamps.push_back(now);
+			}
+		}
 
 		_non_empty.notify_all();
 	}
@@ -413,6 +420,10 @@ DWORD ConsoleInput::Dequeue(INPUT_RECORD *data, DWORD size, unsigned int request
 		for (i = 0; (i < size && !_pending.empty()); ++i) {
 			data[i] = _pending.front();
 			_pending.pop_front();
+			if (!_pending_latency_stamps.empty() && LatencyTraceTracked(data[i])) {
+				LatencyTraceDequeued(_pending_latency_stamps.front(), data[i]);
+				_pending_latency_stamps.pop_front();
+			}
 			if (EventBacktraced(data[i])) {
 				while (_backtrace.size() > MAX_INPUT_BACKTRACE_CONUT
 						&& now - _backtrace.front().first > MAX_INPUT_BACKTRACE_SECONDS * 1000) {
@@ -444,6 +455,7 @@ DWORD ConsoleInput::Flush(unsigned int requestor_priority)
 		if (requestor_priority < CurrentPriority())
 			return 0;
 		_pending.swap(flushed);
+		_pending_latency_stamps.clear();
 	}
 	for (auto &it : flushed) {
 		if (it.EventType == CALLBACK_EVENT) {
@@ -536,6 +548,9 @@ void ConsoleInput::ReleaseConsoleInput(IConsoleInput *con_in, bool join)
 		for (const auto &evnt : ci->_pending) {
 			_pending.emplace_back(evnt);
 		}
+		for (const auto &stamp : ci->_pending_latency_stamps) {
+			_pending_latency_stamps.emplace_back(stamp);
+		}
 		_non_empty.notify_all();
 	}
 	delete ci;
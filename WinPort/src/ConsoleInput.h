@@ -10,6 +10,7 @@ class ConsoleInput : public IConsoleInput
 {
 	std::deque<std::pair<clock_t, INPUT_RECORD> > _backtrace;
 	std::deque<INPUT_RECORD> _pending;
+	std::deque<uint64_t> _pending_latency_stamps; // enqueue times of latency-traced pending events
 	std::mutex _mutex;
 	std::condition_variable _non_empty;
 	std::set<unsigned int> _requestor_priorities;
@@ -0,0 +1,308 @@
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utils.h>
+#include "WinPort.h"
+#include "LatencyTrace.h"
+
+#define LATENCY_TRACE_MAX_RECORDS   100000 // how many completed records kept for trace dump
+#define LATENCY_TRACE_MAX_INFLIGHT  256
+#define LATENCY_TRACE_STALE_USEC    10000000ull // in-flight record abandoned if not completed within 10 seconds
+#define LATENCY_HIST_BUCKETS        20 // <64us, <128us ... <16s, >=16s
+
+enum LatencyStamp
+{
+	LTS_QUEUED = 0,
+	LTS_DEQUEUED,
+	LTS_DISPATCHED,
+	LTS_FLUSHED,
+	LTS_PAINTING,
+	LTS_PAINTED,
+	LTS_COUNT
+};
+
+// stages are intervals between subsequent stamps, plus total queued..painted interval
+enum { LATENCY_STAGES = LTS_COUNT };
+
+static const char *s_stage_names[LATENCY_STAGES] = {
+	"queue", "dispatch", "flush", "backend wait", "paint", "total"
+};
+
+struct LatencyRecord
+{
+	uint64_t stamps[LTS_COUNT]{}; // zero if not reached
+	char what[24]{};
+};
+
+struct LatencyTraceState
+{
+	std::mutex mtx;
+	std::string path;
+	std::deque<LatencyRecord> inflight;
+	std::deque<LatencyRecord> done;
+	unsigned long long hist[LATENCY_STAGES][LATENCY_HIST_BUCKETS]{};
+	unsigned long long painted{0}, unchanged{0}, abandoned{0};
+};
+
+static LatencyTraceState *LatencyTraceStateInstance()
+{
+	static LatencyTraceState *s_state = []() -> LatencyTraceState *
+	{
+		const char *path = getenv("FAR2L_LATENCY_TRACE");
+		if (!path || !*path) {
+			return nullptr;
+		}
+		LatencyTraceState *state = new LatencyTraceState;
+		state->path = path;
+		fprintf(stderr, "LatencyTrace: enabled, output to '%s'\n", path);
+		return state;
+	}();
+	return s_state;
+}
+
+bool LatencyTraceEnabled()
+{
+	return LatencyTraceStateInstance() != nullptr;
+}
+
+uint64_t LatencyTraceNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LatencyTraceTracked(const INPUT_RECORD &ir)
+{
+	if (ir.EventType == KEY_EVENT) {
+		return ir.Event.KeyEvent.bKeyDown != FALSE;
+	}
+	if (ir.EventType == MOUSE_EVENT) {
+		return ir.Event.MouseEvent.dwButtonState != 0
+			|| (ir.Event.MouseEvent.dwEventFlags & (MOUSE_WHEELED | MOUSE_HWHEELED)) != 0;
+	}
+	return false;
+}
+
+static unsigned int HistBucket(uint64_t usec)
+{
+	unsigned int out = 0;
+	for (uint64_t limit = 64; out + 1 < LATENCY_HIST_BUCKETS && usec >= limit; limit<<= 1) {
+		++out;
+	}
+	return out;
+}
+
+static void LockedComplete(LatencyTraceState *state, LatencyRecord &rec)
+{
+	for (unsigned int i = 0; i + 1 < LTS_COUNT; ++i) {
+		if (rec.stamps[i] && rec.stamps[i + 1]) {
+			++state->hist[i][HistBucket(rec.stamps[i + 1] - rec.stamps[i])];
+		}
+	}
+	if (rec.stamps[LTS_PAINTED]) {
+		++state->hist[LATENCY_STAGES - 1][HistBucket(rec.stamps[LTS_PAINTED] - rec.stamps[LTS_QUEUED])];
+		++state->painted;
+	} else {
+		++state->unchanged;
+	}
+	if (state->done.size() >= LATENCY_TRACE_MAX_RECORDS) {
+		state->done.pop_front();
+	}
+	state->done.emplace_back(rec);
+}
+
+void LatencyTraceDequeued(uint64_t queued, const INPUT_RECORD &ir)
+{
+	LatencyTraceState *state = LatencyTraceStateInstance();
+	if (!state) {
+		return;
+	}
+	const uint64_t now = LatencyTraceNow();
+	std::lock_guard<std::mutex> lock(state->mtx);
+	while (!state->inflight.empty() && (state->inflight.size() >= LATENCY_TRACE_MAX_INFLIGHT
+			|| now - state->inflight.front().stamps[LTS_DEQUEUED] > LATENCY_TRACE_STALE_USEC)) {
+		state->inflight.pop_front();
+		++state->abandoned;
+	}
+	auto &rec = state->inflight.emplace_back();
+	rec.stamps[LTS_QUEUED] = queued;
+	rec.stamps[LTS_DEQUEUED] = std::max(now, queued);
+	if (ir.EventType == KEY_EVENT) {
+		snprintf(rec.what, sizeof(rec.what), "key 0x%x", (unsigned int)ir.Event.KeyEvent.wVirtualKeyCode);
+	} else {
+		snprintf(rec.what, sizeof(rec.what), "mouse 0x%x", (unsigned int)ir.Event.MouseEvent.dwButtonState);
+	}
+}
+
+void LatencyTraceMark(DWORD stage)
+{
+	LatencyTraceState *state = LatencyTraceStateInstance();
+	if (!state) {
+		return;
+	}
+	const uint64_t now = LatencyTraceNow();
+	std::lock_guard<std::mutex> lock(state->mtx);
+	for (auto it = state->inflight.begin(); it != state->inflight.end();) {
+		auto &stamps = it->stamps;
+		if (!stamps[LTS_FLUSHED]) switch (stage) {
+			case CONSOLE_LATENCY_DISPATCHED:
+				if (!stamps[LTS_DISPATCHED]) {
+					stamps[LTS_DISPATCHED] = now;
+				}
+				break;
+
+			case CONSOLE_LATENCY_FLUSHED:
+				if (!stamps[LTS_DISPATCHED]) {
+					stamps[LTS_DISPATCHED] = now;
+				}
+				stamps[LTS_FLUSHED] = now;
+				break;
+
+			case CONSOLE_LATENCY_UNCHANGED:
+				// event completely processed and no output changes were made after that
+				if (stamps[LTS_DISPATCHED]) {
+					LockedComplete(state, *it);
+					it = state->inflight.erase(it);
+					continue;
+				}
+				break;
+		}
+		++it;
+	}
+}
+
+void LatencyTracePainted(uint64_t painting)
+{
+	LatencyTraceState *state = LatencyTraceStateInstance();
+	if (!state) {
+		return;
+	}
+	const uint64_t now = LatencyTraceNow();
+	std::lock_guard<std::mutex> lock(state->mtx);
+	for (auto it = state->inflight.begin(); it != state->inflight.end();) {
+		if (it->stamps[LTS_FLUSHED] && it->stamps[LTS_FLUSHED] <= painting) {
+			it->stamps[LTS_PAINTING] = painting;
+			it->stamps[LTS_PAINTED] = std::max(now, painting);
+			LockedComplete(state, *it);
+			it = state->inflight.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+static double PercentileMSec(std::vector<uint64_t> &v, unsigned int pct)
+{
+	if (v.empty()) {
+		return 0;
+	}
+	const size_t i = std::min(v.size() - 1, (v.size() * pct) / 100);
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return double(v[i]) / 1000;
+}
+
+static std::string LockedFormatHistogram(LatencyTraceState *state)
+{
+	std::string out = StrPrintf("Input-to-paint latency: %llu painted, %llu without output, %llu abandoned\n",
+		state->painted, state->unchanged, state->abandoned);
+
+	out+= StrPrintf("%-14s %10s %10s %10s %10s %10s\n", "stage", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+	std::vector<uint64_t> durations;
+	for (unsigned int stage = 0; stage < LATENCY_STAGES; ++stage) {
+		const unsigned int from = (stage + 1 < LATENCY_STAGES) ? stage : LTS_QUEUED;
+		const unsigned int to = (stage + 1 < LATENCY_STAGES) ? stage + 1 : LTS_PAINTED;
+		durations.clear();
+		for (const auto &rec : state->done) {
+			if (rec.stamps[from] && rec.stamps[to]) {
+				durations.emplace_back(rec.stamps[to] - rec.stamps[from]);
+			}
+		}
+		const uint64_t max_dur = durations.empty() ? 0 : *std::max_element(durations.begin(), durations.end());
+		const double p50 = PercentileMSec(durations, 50);
+		const double p90 = PercentileMSec(durations, 90);
+		const double p99 = PercentileMSec(durations, 99);
+		out+= StrPrintf("%-14s %10lu %10.3f %10.3f %10.3f %10.3f\n", s_stage_names[stage],
+			(unsigned long)durations.size(), p50, p90, p99, double(max_dur) / 1000);
+	}
+
+	out+= StrPrintf("\n%-10s", "bucket");
+	for (unsigned int stage = 0; stage < LATENCY_STAGES; ++stage) {
+		out+= StrPrintf(" %12s", s_stage_names[stage]);
+	}
+	out+= '\n';
+	for (unsigned int b = 0; b < LATENCY_HIST_BUCKETS; ++b) {
+		const unsigned long long limit = 64ull << b;
+		if (b + 1 < LATENCY_HIST_BUCKETS) {
+			out+= (limit < 1000)
+				? StrPrintf("<%-3lluus    ", limit)
+				: StrPrintf("<%-6.1fms ", double(limit) / 1000);
+		} else {
+			out+= StrPrintf(">=%-6.1fms", double(limit >> 1) / 1000);
+		}
+		for (unsigned int stage = 0; stage < LATENCY_STAGES; ++stage) {
+			out+= StrPrintf(" %12llu", state->hist[stage][b]);
+		}
+		out+= '\n';
+	}
+	return out;
+}
+
+static void LockedWriteChromeTrace(LatencyTraceState *state, FILE *f)
+{
+	const uint64_t base = state->done.empty() ? 0 : state->done.front().stamps[LTS_QUEUED];
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"far2l\"}}",
+		(unsigned int)getpid());
+	unsigned long long n = 0;
+	for (const auto &rec : state->done) {
+		++n;
+		for (unsigned int i = 0; i + 1 < LTS_COUNT; ++i) {
+			if (rec.stamps[i] && rec.stamps[i + 1]) {
+				// odd and even events go to different lanes to keep overlapping ones visible
+				fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"latency\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+					"\"pid\":%u,\"tid\":%u,\"args\":{\"event\":\"%s\",\"seq\":%llu}}",
+					s_stage_names[i],
+					(unsigned long long)(rec.stamps[i] - base),
+					(unsigned long long)(rec.stamps[i + 1] - rec.stamps[i]),
+					(unsigned int)getpid(), (unsigned int)(1 + (n & 1)), rec.what, n);
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+}
+
+void LatencyTraceSave()
+{
+	LatencyTraceState *state = LatencyTraceStateInstance();
+	if (!state) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(state->mtx);
+	if (state->done.empty()) {
+		return;
+	}
+	const std::string &hist = LockedFormatHistogram(state);
+	fprintf(stderr, "%s", hist.c_str());
+
+	FILE *f = fopen((state->path + ".hist").c_str(), "w");
+	if (f) {
+		fwrite(hist.data(), 1, hist.size(), f);
+		fclose(f);
+	} else {
+		perror("LatencyTrace: hist");
+	}
+
+	f = fopen(state->path.c_str(), "w");
+	if (f) {
+		LockedWriteChromeTrace(state, f);
+		fclose(f);
+	} else {
+		perror("LatencyTrace: trace");
+	}
+	state->done.clear();
+}
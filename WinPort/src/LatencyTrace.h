@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include "WinCompat.h"
+
+// Opt-in input-to-paint latency tracing, enabled by FAR2L_LATENCY_TRACE environment
+// variable that specifies path of Chrome trace file to write on exit (chrome://tracing,
+// ui.perfetto.dev). Histogram of per-stage latencies is saved to same path with .hist
+// suffix and also printed to stderr. Tracked input event passes following stamps:
+//  queued     - ConsoleInput::Enqueue
+//  dequeued   - application read event from input queue
+//  dispatched - application finished processing of event (CONSOLE_LATENCY_DISPATCHED)
+//  flushed    - application wrote resulting changes to console (CONSOLE_LATENCY_FLUSHED)
+//  painting   - backend started composing its output from console content
+//  painted    - backend finished output: TTY data drained to terminal, GUI frame painted
+
+bool LatencyTraceEnabled();
+uint64_t LatencyTraceNow(); // usec, monotonic
+
+bool LatencyTraceTracked(const INPUT_RECORD &ir);
+void LatencyTraceDequeued(uint64_t queued, const INPUT_RECORD &ir);
+
+// stage is one of CONSOLE_LATENCY_* values
+void LatencyTraceMark(DWORD stage);
+
+// completes records flushed before given painting stamp
+void LatencyTracePainted(uint64_t painting);
+
+// writes collected trace if there is something to write
+void LatencyTraceSave();
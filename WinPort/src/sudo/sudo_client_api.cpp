@@ -19,6 +19,9 @@
 # include <sys/xattr.h>
 #endif
 #include <map>
+#include <deque>
+#include <vector>
+#include <memory>
 #include <mutex>
 #include <utimens_compat.h>
 #include "sudo_private.h"
@@ -72,11 +75,22 @@ public:
 };
 
 
-static class Client2ServerDIR : protected Client2Server<DIR *, void *>
+struct RemoteDir
+{
+	void *remote;
+	std::string path;
+	std::deque<struct dirent> prefetched;
+	std::vector<std::string> stat_cache_keys;
+	int eod_errno = 0;	// if nonzero - no more entries can be fetched, readdir must end with this errno
+};
+
+typedef std::shared_ptr<RemoteDir> RemoteDirPtr;
+
+static class Client2ServerDIR : protected Client2Server<DIR *, RemoteDirPtr>
 {
 	public:
 
-	DIR *Register(void *remote)
+	DIR *Register(const RemoteDirPtr &remote)
 	{
 		DIR *local = opendir("/");
 		if (local)
@@ -84,28 +98,106 @@ static class Client2ServerDIR : protected Client2Server<DIR *, void *>
 		return local;
 	}
 
-	void *Deregister(DIR *local)
+	RemoteDirPtr Deregister(DIR *local)
 	{
-		void *remote;
+		RemoteDirPtr remote;
 		if (!Client2ServerBase::Deregister(local, remote))
-			return nullptr;
+			return RemoteDirPtr();
 
 		closedir(local);
 		return remote;
 
 	}
 
-	void *Lookup(DIR *local)
+	RemoteDirPtr Lookup(DIR *local)
 	{
-		void *remote;
+		RemoteDirPtr remote;
 		if (!Client2ServerBase::Lookup(local, remote))
-			return nullptr;
+			return RemoteDirPtr();
 
 		return remote;
 	}
 
 } s_c2s_dir;
 
+// Keeps stat-s fetched by batched readdir so following stat/lstat of listed
+// entries done by directory enumerating code served without extra transactions.
+// Entries of remote dir are kept only until its next batch fetched or it closed.
+static class PrefetchedStats
+{
+	struct Entry
+	{
+		int lstat_r{-1}, stat_r{-1};
+		struct stat lst{}, st{};
+	};
+
+	std::map<std::string, Entry> _map;
+	std::mutex _mutex;
+
+	template <class FN>
+		bool LookupCommon(const char *path, struct stat *buf, FN fn)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _map.find(path);
+		if (it == _map.end())
+			return false;
+
+		return fn(it->second, buf);
+	}
+
+public:
+	void Put(RemoteDir &rd, const char *name, int lstat_r, const struct stat &lst, int stat_r, const struct stat &st)
+	{
+		std::string key = rd.path;
+		if (key.empty() || key.back() != '/')
+			key+= '/';
+		key+= name;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		Entry &e = _map[key];
+		e.lstat_r = lstat_r;
+		e.lst = lst;
+		e.stat_r = stat_r;
+		e.st = st;
+		rd.stat_cache_keys.emplace_back(std::move(key));
+	}
+
+	void Forget(RemoteDir &rd)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const auto &key : rd.stat_cache_keys)
+			_map.erase(key);
+		rd.stat_cache_keys.clear();
+	}
+
+	bool LookupLStat(const char *path, struct stat *buf)
+	{
+		return LookupCommon(path, buf, [](const Entry &e, struct stat *buf) {
+			if (e.lstat_r != 0)
+				return false;
+			*buf = e.lst;
+			return true;
+		});
+	}
+
+	bool LookupStat(const char *path, struct stat *buf)
+	{
+		return LookupCommon(path, buf, [](const Entry &e, struct stat *buf) {
+			if (e.lstat_r != 0)
+				return false;
+			if (!S_ISLNK(e.lst.st_mode)) {
+				*buf = e.lst;
+				return true;
+			}
+			if (e.stat_r != 0)
+				return false;
+			*buf = e.st;
+			return true;
+		});
+	}
+
+} s_prefetched_stats;
+
 ////////////////////////////////////////////
 
 
@@ -321,7 +413,11 @@ extern "C" __attribute__ ((visibility("default"))) int sdc_stat(const char *path
 	int saved_errno = errno;
 	ClientReconstructCurDir crcd(path);
 	int r = stat(path, buf);
-	if (r==-1 && IsAccessDeniedErrno() && TouchClientConnection(false)) {
+	if (r==-1 && IsAccessDeniedErrno() && s_prefetched_stats.LookupStat(path, buf)) {
+		errno = saved_errno;
+		r = 0;
+
+	} else if (r==-1 && IsAccessDeniedErrno() && TouchClientConnection(false)) {
 		r = common_stat(SUDO_CMD_STAT, path, buf);
 		if (r==0)
 			errno = saved_errno;
@@ -335,7 +431,11 @@ extern "C" __attribute__ ((visibility("default"))) int sdc_lstat(const char *pat
 	int saved_errno = errno;
 	ClientReconstructCurDir crcd(path);
 	int r = lstat(path, buf);
-	if (r==-1 && IsAccessDeniedErrno() && TouchClientConnection(false)) {
+	if (r==-1 && IsAccessDeniedErrno() && s_prefetched_stats.LookupLStat(path, buf)) {
+		errno = saved_errno;
+		r = 0;
+
+	} else if (r==-1 && IsAccessDeniedErrno() && TouchClientConnection(false)) {
 		r = common_stat(SUDO_CMD_LSTAT, path, buf);
 		if (r==0)
 			errno = saved_errno;
@@ -386,7 +486,10 @@ extern "C" __attribute__ ((visibility("default"))) DIR *sdc_opendir(const char *
 			void *remote;
 			ct.RecvPOD(remote);
 			if (remote) {
-				dir = s_c2s_dir.Register(remote);
+				RemoteDirPtr rd = std::make_shared<RemoteDir>();
+				rd->remote = remote;
+				rd->path = path;
+				dir = s_c2s_dir.Register(rd);
 				if (dir) {
 					errno = saved_errno;
 				} else {
@@ -407,42 +510,81 @@ extern "C" __attribute__ ((visibility("default"))) DIR *sdc_opendir(const char *
 
 extern "C" __attribute__ ((visibility("default"))) int sdc_closedir(DIR *dir)
 {
-	void *remote_dir = s_c2s_dir.Deregister(dir);
-	if (!remote_dir) {
+	RemoteDirPtr rd = s_c2s_dir.Deregister(dir);
+	if (!rd) {
 		return closedir(dir);
 	}
 
+	s_prefetched_stats.Forget(*rd);
+
 	try {
 		ClientTransaction ct(SUDO_CMD_CLOSEDIR);
-		ct.SendPOD(remote_dir);
+		ct.SendPOD(rd->remote);
 		return ct.RecvInt();
 	} catch(std::exception &e) {
-		fprintf(stderr, "sudo_client: closedir(%p -> %p) - error %s\n", dir, remote_dir, e.what());
+		fprintf(stderr, "sudo_client: closedir(%p -> %p) - error %s\n", dir, rd->remote, e.what());
 		return 0;
 	}
 }
 
+// Fetches next portion of entries together with their stat-s in single transaction
+static void ReadDirStatBatch(RemoteDir &rd)
+{
+	s_prefetched_stats.Forget(rd);
+
+	ClientTransaction ct(SUDO_CMD_READDIR_STAT_BATCH);
+	ct.SendPOD(rd.remote);
+	ct.SendPOD((unsigned int)READDIR_BATCH_LIMIT);
+	for (;;) {
+		int marker = ct.RecvInt();
+		if (marker == READDIR_BATCH_MORE)
+			break;
+
+		if (marker != READDIR_BATCH_ENTRY) {
+			rd.eod_errno = marker;
+			break;
+		}
+
+		rd.prefetched.emplace_back();
+		struct dirent &de = rd.prefetched.back();
+		ct.RecvPOD(de);
+
+		struct stat lst{}, st{};
+		int lstat_r = ct.RecvInt(), stat_r = -1;
+		if (lstat_r == 0) {
+			ct.RecvPOD(lst);
+			if (S_ISLNK(lst.st_mode)) {
+				stat_r = ct.RecvInt();
+				if (stat_r == 0)
+					ct.RecvPOD(st);
+			}
+		}
+		s_prefetched_stats.Put(rd, de.d_name, lstat_r, lst, stat_r, st);
+	}
+}
 
 thread_local struct dirent sudo_client_dirent;
 
 extern "C" __attribute__ ((visibility("default"))) struct dirent *sdc_readdir(DIR *dir)
 {
-	void *remote_dir = s_c2s_dir.Lookup(dir);
-	if (!remote_dir)
+	RemoteDirPtr rd = s_c2s_dir.Lookup(dir);
+	if (!rd)
 		return readdir(dir);
 
 	try {
-		ClientTransaction ct(SUDO_CMD_READDIR);
-		ct.SendPOD(remote_dir);
-		ct.SendErrno();
-		int err = ct.RecvInt();
-		if (err==0) {
-			ct.RecvPOD(sudo_client_dirent);
+		if (rd->prefetched.empty() && rd->eod_errno == 0)
+			ReadDirStatBatch(*rd);
+
+		if (!rd->prefetched.empty()) {
+			sudo_client_dirent = rd->prefetched.front();
+			rd->prefetched.pop_front();
 			return &sudo_client_dirent;
-		} else
-			errno = err;
+		}
+
+		errno = rd->eod_errno;
+
 	} catch(std::exception &e) {
-		fprintf(stderr, "sudo_client: readdir(%p -> %p) - error %s\n", dir, remote_dir, e.what());
+		fprintf(stderr, "sudo_client: readdir(%p -> %p) - error %s\n", dir, rd->remote, e.what());
 	}
 	return nullptr;
 }
@@ -155,6 +155,49 @@ namespace Sudo
 		}
 	}
 
+	static void OnSudoDispatch_ReadDirStatBatch(BaseTransaction &bt, OpenedDirs &dirs)
+	{
+		DIR *d;
+		unsigned int limit;
+		bt.RecvPOD(d);
+		bt.RecvPOD(limit);
+		if (!dirs.Check(d)) {
+			bt.SendInt(EBADF);
+			return;
+		}
+
+		const int dfd = dirfd(d);
+		for (unsigned int i = 0; i < limit; ++i) {
+			errno = 0;
+			struct dirent *de = readdir(d);
+			if (!de) {
+				int err = errno;
+				bt.SendInt(err ? err : -1);
+				return;
+			}
+			// see comment in OnSudoDispatch_ReadDir about this copying
+			struct dirent dex{};
+			memcpy(&dex, de, sizeof(dex) - sizeof(dex.d_name));
+			strncpy(dex.d_name, de->d_name, sizeof(dex.d_name));
+			bt.SendInt(READDIR_BATCH_ENTRY);
+			bt.SendPOD(dex);
+
+			struct stat s{};
+			int r = fstatat(dfd, dex.d_name, &s, AT_SYMLINK_NOFOLLOW);
+			bt.SendInt(r);
+			if (r == 0) {
+				bt.SendPOD(s);
+				if (S_ISLNK(s.st_mode)) {
+					r = fstatat(dfd, dex.d_name, &s, 0);
+					bt.SendInt(r);
+					if (r == 0)
+						bt.SendPOD(s);
+				}
+			}
+		}
+		bt.SendInt(READDIR_BATCH_MORE);
+	}
+
 	static void OnSudoDispatch_MkDir(BaseTransaction &bt)
 	{
 		std::string path;
@@ -531,6 +574,10 @@ namespace Sudo
 			case SUDO_CMD_LUTIMES:
 				OnSudoDispatch_LUtimes(bt);
 				break;
+
+			case SUDO_CMD_READDIR_STAT_BATCH:
+				OnSudoDispatch_ReadDirStatBatch(bt, dirs);
+				break;
 				
 			default:
 				throw std::runtime_error("OnSudoDispatch - bad command");
@@ -42,9 +42,17 @@ namespace Sudo
 		SUDO_CMD_FCHMOD,
 		SUDO_CMD_MKFIFO,
 		SUDO_CMD_MKNOD,
-		SUDO_CMD_LUTIMES
+		SUDO_CMD_LUTIMES,
+		SUDO_CMD_READDIR_STAT_BATCH
 	};
 
+	// SUDO_CMD_READDIR_STAT_BATCH reply consists of sequence of markers each followed by data:
+	//  READDIR_BATCH_ENTRY - dirent, lstat's result and if its a symlink - stat's result follows
+	//  READDIR_BATCH_MORE - batch limit reached, more entries may be available
+	//  any other value - end of directory (-1) or errno of readdir failure, terminates reply
+	enum { READDIR_BATCH_ENTRY = 0, READDIR_BATCH_MORE = -2 };
+	enum { READDIR_BATCH_LIMIT = 256 };
+
 	class BaseTransaction
 	{
 		LocalSocket &_sock;
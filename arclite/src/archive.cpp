@@ -1292,6 +1292,8 @@ void Archive<UseVirtualDestructor>::update_hard_link_counts()
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::make_index()
 {
+	ensure_open();
+
 	m_num_indices = 0;
 	in_arc->GetNumberOfItems(&m_num_indices);
 	file_list.clear();
@@ -1587,6 +1589,8 @@ FindData Archive<UseVirtualDestructor>::get_file_info(UInt32 index)
 template<bool UseVirtualDestructor>
 bool Archive<UseVirtualDestructor>::get_main_file(UInt32 &index)
 {
+	ensure_open();
+
 	PropVariant prop;
 
 	if (in_arc->GetArchiveProperty(kpidMainSubfile, prop.ref()) == S_OK && prop.is_uint()) {
@@ -1720,6 +1724,12 @@ DWORD Archive<UseVirtualDestructor>::get_attr(UInt32 index, DWORD *posixattr) co
 		return attr;
 	}
 
+	if (!in_arc) {
+		if (posixattr)
+			*posixattr = listing_props[index].posixattr;
+		return listing_props[index].attr;
+	}
+
 	if (in_arc->GetProperty(index, kpidAttrib, prop.ref()) == S_OK && prop.is_uint()) {
 		attr = static_cast<DWORD>(prop.get_uint());
 		if (attr & 0xF0000000) {
@@ -1814,6 +1824,8 @@ bool Archive<UseVirtualDestructor>::get_encrypted(UInt32 index) const
 	PropVariant prop;
 	if (index >= m_num_indices)
 		return false;
+	else if (!in_arc)
+		return listing_props[index].encrypted;
 	else if (!file_list[index].is_dir && in_arc->GetProperty(index, kpidEncrypted, prop.ref()) == S_OK
 			&& prop.is_bool())
 		return prop.get_bool();
@@ -1843,6 +1855,9 @@ UInt64 Archive<UseVirtualDestructor>::get_size(UInt32 index) const
 	if (index >= m_num_indices)
 		return 0;
 
+	if (!in_arc)
+		return listing_props[index].size;
+
 	if (!file_list[index].is_dir && in_arc->GetProperty(index, kpidSize, prop.ref()) == S_OK && prop.is_uint()) {
 		uint64_t _size = prop.get_uint();
 		const ArcFileInfo &file_info = file_list[index];
@@ -1869,6 +1884,9 @@ UInt64 Archive<UseVirtualDestructor>::get_psize(UInt32 index) const
 	if (index >= m_num_indices)
 		return 0;
 
+	if (!in_arc)
+		return listing_props[index].psize;
+
 	if (!file_list[index].is_dir && in_arc->GetProperty(index, kpidPackSize, prop.ref()) == S_OK && prop.is_uint()) {
 		uint64_t _size = prop.get_uint();
 		const ArcFileInfo &file_info = file_list[index];
@@ -1892,7 +1910,7 @@ template<bool UseVirtualDestructor>
 UInt64 Archive<UseVirtualDestructor>::get_offset(UInt32 index) const
 {
 	PropVariant prop;
-	if (index < m_num_indices)
+	if (index < m_num_indices && in_arc)
 		if (in_arc->GetProperty(index, kpidOffset, prop.ref()) == S_OK && prop.is_uint())
 			return prop.get_uint();
 	return ~0ULL;
@@ -1909,6 +1927,10 @@ FILETIME Archive<UseVirtualDestructor>::get_ctime(UInt32 index) const
 		return nullftime;
 	}
 
+	if (!in_arc) {
+		return listing_props[index].ctime;
+	}
+
 	if (in_arc->GetProperty(index, kpidCTime, prop.ref()) == S_OK && prop.is_filetime()) {
 		ft = prop.get_filetime();
 #if IS_BIG_ENDIAN
@@ -1932,6 +1954,10 @@ FILETIME Archive<UseVirtualDestructor>::get_mtime(UInt32 index) const
 		return nullftime;
 	}
 
+	if (!in_arc) {
+		return listing_props[index].mtime;
+	}
+
 	if (in_arc->GetProperty(index, kpidMTime, prop.ref()) == S_OK && prop.is_filetime()) {
 		ft = prop.get_filetime();
 #if IS_BIG_ENDIAN
@@ -1955,6 +1981,10 @@ FILETIME Archive<UseVirtualDestructor>::get_atime(UInt32 index) const
 		return nullftime;
 	}
 
+	if (!in_arc) {
+		return listing_props[index].atime;
+	}
+
 	if (in_arc->GetProperty(index, kpidATime, prop.ref()) == S_OK && prop.is_filetime()) {
 		ft = prop.get_filetime();
 #if IS_BIG_ENDIAN
@@ -1997,6 +2027,8 @@ unsigned Archive<UseVirtualDestructor>::get_crc(UInt32 index) const
 	PropVariant prop;
 	if (index >= m_num_indices)
 		return 0;
+	else if (!in_arc)
+		return listing_props[index].crc;
 	else if (in_arc->GetProperty(index, kpidCRC, prop.ref()) == S_OK && prop.is_uint())
 		return static_cast<DWORD>(prop.get_uint());
 	else
@@ -2072,6 +2104,8 @@ bool Archive<UseVirtualDestructor>::get_dev(UInt32 index, dev_t &_device) const
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::read_open_results()
 {
+	ensure_open();
+
 	PropVariant prop;
 
 	error_flags = 0;
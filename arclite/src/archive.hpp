@@ -383,6 +383,17 @@ namespace ArchiveGlobals {
 	extern unsigned max_check_size;
 }
 
+// Identity of archive file used to validate persistent listing cache
+struct ListingStamp
+{
+	UInt64 dev{}, ino{}, size{};
+	int64_t mtime_sec{}, mtime_nsec{}, ctime_sec{}, ctime_nsec{};
+	UInt64 head_crc{}, tail_crc{};
+
+	bool read(const std::wstring &path);
+	bool operator==(const ListingStamp &other) const;
+};
+
 template<bool UseVirtualDestructor>
 class Archive : public std::enable_shared_from_this<Archive<UseVirtualDestructor>>
 {
@@ -428,7 +439,8 @@ public:
 	void close();
 	bool open(IInStream<UseVirtualDestructor> *in_stream, const ArcType &type, const bool allow_tail = false, const bool show_progress = true);
 	void reopen();
-	bool is_open() const { return in_arc; }
+	void ensure_open();
+	bool is_open() const { return in_arc || !listing_props.empty(); }
 	bool updatable() const
 	{
 		return arc_chain.size() == 1 && ArcAPI::formats().at(arc_chain.back().type).updatable;
@@ -541,6 +553,22 @@ public:
 private:
 	void load_arc_attr();
 
+	// persistent listing cache
+private:
+	struct ListingProps
+	{
+		DWORD attr, posixattr;
+		UInt64 size, psize;
+		FILETIME ctime, atime, mtime;
+		UInt32 crc;
+		bool encrypted;
+	};
+	std::vector<ListingProps> listing_props;	// contents restored from cache, in_arc is not opened yet
+	ListingStamp listing_stamp;
+
+	bool load_listing_cache(const ArcTypes &arc_types);
+	void save_listing_cache();
+
 public:
 	AttrList arc_attr;
 	AttrList get_attr_list(UInt32 item_index);
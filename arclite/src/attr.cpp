@@ -736,6 +736,7 @@ AttrList Archive<UseVirtualDestructor>::get_attr_list(UInt32 item_index)
 	AttrList attr_list;
 	if (item_index >= m_num_indices)	// fake index
 		return attr_list;
+	ensure_open();
 	UInt32 num_props;
 	CHECK_COM(in_arc->GetNumberOfProperties(&num_props));
 
@@ -989,6 +990,8 @@ void Archive<UseVirtualDestructor>::load_update_props(const ArcType &arc_type)
 	if (m_update_props_defined)
 		return;
 
+	ensure_open();
+
 	m_encrypted = false;
 	PropVariant prop;
 	for (UInt32 i = 0; i < m_num_indices; i++) {
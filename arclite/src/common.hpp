@@ -153,6 +153,7 @@ struct OpenOptions
 	int *open_password_len;
 	bool recursive_panel;
 	char delete_on_close;
+	bool listing_cache;
 	OpenOptions();
 };
 
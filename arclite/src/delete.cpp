@@ -200,6 +200,8 @@ void Archive<UseVirtualDestructor>::enum_deleted_indices(UInt32 file_index, std:
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::delete_files(const std::vector<UInt32> &src_indices)
 {
+	ensure_open();
+
 	std::vector<UInt32> deleted_indices;
 	deleted_indices.reserve(file_list.size());
 	std::for_each(src_indices.begin(), src_indices.end(), [&](UInt32 src_index) {
@@ -1991,6 +1991,8 @@ void Archive<UseVirtualDestructor>::extract(UInt32 src_dir_index, const std::vec
 		const ExtractOptions &options, std::shared_ptr<ErrorLog> error_log,
 		std::vector<UInt32> *extracted_indices)
 {
+	ensure_open();
+
 	DisableSleepMode dsm;
 	HardlinkIndexMap hlmap;
 	PendingHardlinks phl;
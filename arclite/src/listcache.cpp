@@ -0,0 +1,523 @@
+#include "headers.hpp"
+
+#include "msg.hpp"
+#include "utils.hpp"
+#include "sysutils.hpp"
+#include "farutils.hpp"
+#include "common.hpp"
+#include "options.hpp"
+#include "archive.hpp"
+
+#include <crc64.h>
+#include <LZBlock.h>
+
+// Persistent listing cache lets panel show contents of huge archive without parsing
+// its headers and rebuilding directory index again, codec is opened on first real use.
+// Cache entry is valid only for exactly same file: its device, inode, size, modification
+// and status change times (ctime can't be set back by user) and checksums of its head
+// and tail must all match.
+
+static const char c_listing_magic[8] = {'A', 'R', 'C', 'L', 'S', 'T', 'C', '1'};
+static constexpr size_t c_listing_checksum_span = 0x10000;
+static constexpr size_t c_listing_max_files = 64;
+
+static std::string listing_cache_dir()
+{
+	return InMyCache("plugins/arclite/listing");
+}
+
+static std::string listing_cache_path(const std::wstring &arc_path)
+{
+	const std::string &path_mb = StrWide2MB(arc_path);
+	const uint64_t hash = crc64(0, (const unsigned char *)path_mb.data(), path_mb.size());
+	return listing_cache_dir() + StrPrintf("/%016llx.idx", (unsigned long long)hash);
+}
+
+// removes least recently written entries if there are too many of them
+static void prune_listing_cache(const std::string &dir_path)
+{
+	DIR *dir = opendir(dir_path.c_str());
+	if (!dir)
+		return;
+
+	std::vector<std::pair<time_t, std::string>> entries;
+	while (struct dirent *de = readdir(dir)) {
+		const size_t len = strlen(de->d_name);
+		if (len <= 4 || strcmp(de->d_name + len - 4, ".idx") != 0)
+			continue;
+		std::string path = dir_path + '/' + de->d_name;
+		struct stat st{};
+		if (stat(path.c_str(), &st) == 0)
+			entries.emplace_back(st.st_mtime, std::move(path));
+	}
+	closedir(dir);
+
+	if (entries.size() <= c_listing_max_files)
+		return;
+
+	std::sort(entries.begin(), entries.end());
+	for (size_t i = 0; i < entries.size() - c_listing_max_files; ++i)
+		unlink(entries[i].second.c_str());
+}
+
+bool ListingStamp::read(const std::wstring &path)
+{
+	const int fd = sdc_open(StrWide2MB(path).c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st{};
+	bool ok = sdc_fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+	if (ok) {
+		dev = st.st_dev;
+		ino = st.st_ino;
+		size = st.st_size;
+		mtime_sec = st.st_mtim.tv_sec;
+		mtime_nsec = st.st_mtim.tv_nsec;
+		ctime_sec = st.st_ctim.tv_sec;
+		ctime_nsec = st.st_ctim.tv_nsec;
+
+		std::vector<unsigned char> buf(size < c_listing_checksum_span ? size : c_listing_checksum_span);
+		ok = sdc_pread(fd, buf.data(), buf.size(), 0) == (ssize_t)buf.size();
+		if (ok) {
+			head_crc = crc64(0, buf.data(), buf.size());
+			ok = sdc_pread(fd, buf.data(), buf.size(), size - buf.size()) == (ssize_t)buf.size();
+			tail_crc = crc64(0, buf.data(), buf.size());
+		}
+	}
+	sdc_close(fd);
+	return ok;
+}
+
+bool ListingStamp::operator==(const ListingStamp &other) const
+{
+	return dev == other.dev && ino == other.ino && size == other.size
+		&& mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec
+		&& ctime_sec == other.ctime_sec && ctime_nsec == other.ctime_nsec
+		&& head_crc == other.head_crc && tail_crc == other.tail_crc;
+}
+
+class ListingWriter
+{
+private:
+	std::string &data;
+
+public:
+	ListingWriter(std::string &data) : data(data) {}
+
+	void put_u8(uint8_t v) { data+= (char)v; }
+
+	void put_u32(uint32_t v)
+	{
+		for (int i = 0; i < 4; ++i, v>>= 8)
+			data+= (char)(v & 0xff);
+	}
+
+	void put_u64(uint64_t v)
+	{
+		put_u32((uint32_t)v);
+		put_u32((uint32_t)(v >> 32));
+	}
+
+	void put_varint(uint32_t v)
+	{
+		for (; v >= 0x80; v>>= 7)
+			data+= (char)((v & 0x7f) | 0x80);
+		data+= (char)v;
+	}
+
+	void put_bytes(const ByteVector &v)
+	{
+		put_u32(v.size());
+		data.append((const char *)v.data(), v.size());
+	}
+
+	// characters stored as varints, so any wchar_t survives and ASCII stays compact
+	void put_str(const std::wstring &v)
+	{
+		put_u32(v.size());
+		for (const auto ch : v)
+			put_varint((uint32_t)ch);
+	}
+
+	void put_ftime(const FILETIME &v)
+	{
+		put_u32(v.dwLowDateTime);
+		put_u32(v.dwHighDateTime);
+	}
+};
+
+class ListingReader
+{
+private:
+	const unsigned char *cur;
+	const unsigned char *end;
+	bool ok = true;
+
+	bool need(size_t len)
+	{
+		if (ok && size_t(end - cur) >= len)
+			return true;
+		ok = false;
+		return false;
+	}
+
+public:
+	ListingReader(const void *data, size_t len)
+		: cur((const unsigned char *)data), end((const unsigned char *)data + len)
+	{}
+
+	bool good() const { return ok; }
+	size_t left() const { return end - cur; }
+	const unsigned char *pos() const { return cur; }
+
+	uint8_t get_u8() { return need(1) ? *(cur++) : 0; }
+
+	uint32_t get_u32()
+	{
+		if (!need(4))
+			return 0;
+		const uint32_t v = uint32_t(cur[0]) | (uint32_t(cur[1]) << 8) | (uint32_t(cur[2]) << 16) | (uint32_t(cur[3]) << 24);
+		cur+= 4;
+		return v;
+	}
+
+	uint64_t get_u64()
+	{
+		const uint64_t lo = get_u32();
+		return lo | (uint64_t(get_u32()) << 32);
+	}
+
+	uint32_t get_varint()
+	{
+		uint32_t v = 0;
+		for (unsigned shift = 0; shift < 35 && need(1); shift+= 7) {
+			const unsigned char b = *(cur++);
+			v|= uint32_t(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return v;
+		}
+		ok = false;
+		return 0;
+	}
+
+	// count of elements that occupy at least min_size bytes each, rejects counts that can't fit
+	uint32_t get_count(size_t min_size)
+	{
+		const uint32_t v = get_u32();
+		if (ok && v > left() / min_size)
+			ok = false;
+		return ok ? v : 0;
+	}
+
+	void get_bytes(ByteVector &v)
+	{
+		const uint32_t len = get_count(1);
+		v.assign(cur, cur + len);
+		cur+= len;
+	}
+
+	void get_str(std::wstring &v)
+	{
+		const uint32_t len = get_count(1);
+		v.resize(len);
+		for (uint32_t i = 0; i < len; ++i)
+			v[i] = (wchar_t)get_varint();
+	}
+
+	FILETIME get_ftime()
+	{
+		FILETIME v;
+		v.dwLowDateTime = get_u32();
+		v.dwHighDateTime = get_u32();
+		return v;
+	}
+
+	bool get_magic()
+	{
+		if (!need(sizeof(c_listing_magic)) || memcmp(cur, c_listing_magic, sizeof(c_listing_magic)) != 0)
+			return ok = false;
+		cur+= sizeof(c_listing_magic);
+		return true;
+	}
+};
+
+static void put_stamp(ListingWriter &w, const ListingStamp &stamp)
+{
+	w.put_u64(stamp.dev);
+	w.put_u64(stamp.ino);
+	w.put_u64(stamp.size);
+	w.put_u64(stamp.mtime_sec);
+	w.put_u64(stamp.mtime_nsec);
+	w.put_u64(stamp.ctime_sec);
+	w.put_u64(stamp.ctime_nsec);
+	w.put_u64(stamp.head_crc);
+	w.put_u64(stamp.tail_crc);
+}
+
+static void get_stamp(ListingReader &r, ListingStamp &stamp)
+{
+	stamp.dev = r.get_u64();
+	stamp.ino = r.get_u64();
+	stamp.size = r.get_u64();
+	stamp.mtime_sec = r.get_u64();
+	stamp.mtime_nsec = r.get_u64();
+	stamp.ctime_sec = r.get_u64();
+	stamp.ctime_nsec = r.get_u64();
+	stamp.head_crc = r.get_u64();
+	stamp.tail_crc = r.get_u64();
+}
+
+template<bool UseVirtualDestructor>
+void Archive<UseVirtualDestructor>::ensure_open()
+{
+	if (in_arc || listing_props.empty())
+		return;
+
+	ListingStamp stamp;
+	const bool unchanged = stamp.read(arc_path) && stamp == listing_stamp;
+	try {
+		reopen();
+	} catch (...) {
+		in_arc.Release();
+		throw;
+	}
+	listing_props.clear();
+
+	UInt32 num_indices = 0;
+	in_arc->GetNumberOfItems(&num_indices);
+	if (!unchanged || num_indices != m_num_indices) {
+		// archive was replaced after its listing was shown, so indices known to panel are stale
+		fprintf(stderr, "Archive %ls changed after listing was restored from cache\n", arc_path.c_str());
+		hard_link_groups.clear();
+		make_index();
+		FAIL(HRESULT_FROM_WIN32(ESTALE));
+	}
+}
+
+template<bool UseVirtualDestructor>
+bool Archive<UseVirtualDestructor>::load_listing_cache(const ArcTypes &arc_types)
+{
+	std::string data;
+	if (!ReadWholeFile(listing_cache_path(arc_path).c_str(), data))
+		return false;
+
+	ListingReader hr(data.data(), data.size());
+	ListingStamp stamp;
+	std::wstring path;
+	if (!hr.get_magic())
+		return false;
+	get_stamp(hr, stamp);
+	hr.get_str(path);
+	const UInt64 raw_size = hr.get_u64();
+	if (!hr.good() || !(stamp == listing_stamp) || path != arc_path || raw_size > ((UInt64)hr.left() << 8))
+		return false;
+
+	std::string raw(raw_size, 0);
+	if (!LZBlockDecompress((unsigned char *)&raw[0], raw.size(), hr.pos(), hr.left()))
+		return false;
+
+	ListingReader r(raw.data(), raw.size());
+
+	ArcChain chain;
+	for (UInt32 n = r.get_count(20); n; --n) {
+		ArcType type;
+		r.get_bytes(type);
+		const UInt64 sig_pos = r.get_u64();
+		const UInt64 flags = r.get_u64();
+		chain.emplace_back(type, sig_pos, flags);
+	}
+	if (!r.good() || chain.size() != 1 || ArcAPI::formats().count(chain.front().type) == 0
+			|| std::find(arc_types.begin(), arc_types.end(), chain.front().type) == arc_types.end())
+		return false;
+
+	AttrList attrs;
+	for (UInt32 n = r.get_count(8); n; --n) {
+		Attr attr;
+		r.get_str(attr.name);
+		r.get_str(attr.value);
+		attrs.push_back(std::move(attr));
+	}
+
+	const bool has_crc = r.get_u8() != 0;
+	const UInt32 num_indices = r.get_u32();
+
+	FileList files(r.get_count(38));
+	for (auto &fi : files) {
+		fi.parent = r.get_u32();
+		fi.num_links = r.get_u32();
+		fi.hl_group = r.get_u32();
+		fi.fuid = r.get_u32();
+		fi.fgid = r.get_u32();
+		r.get_str(fi.name);
+		r.get_str(fi.desc);
+		r.get_str(fi.owner);
+		r.get_str(fi.group);
+		fi.is_dir = r.get_u8() != 0;
+		fi.is_altstream = r.get_u8() != 0;
+	}
+
+	FileIndex index(r.get_count(4));
+	for (auto &i : index)
+		i = r.get_u32();
+
+	std::vector<HardLinkGroup> groups(r.get_count(4));
+	for (auto &group : groups) {
+		group.resize(r.get_count(4));
+		for (auto &i : group)
+			i = r.get_u32();
+	}
+
+	std::vector<ListingProps> props(r.get_count(53));
+	for (auto &p : props) {
+		p.attr = r.get_u32();
+		p.posixattr = r.get_u32();
+		p.size = r.get_u64();
+		p.psize = r.get_u64();
+		p.ctime = r.get_ftime();
+		p.atime = r.get_ftime();
+		p.mtime = r.get_ftime();
+		p.crc = r.get_u32();
+		p.encrypted = r.get_u8() != 0;
+	}
+
+	if (!r.good() || r.left() != 0 || num_indices == 0 || props.size() != num_indices
+			|| files.size() < num_indices || index.size() != files.size())
+		return false;
+
+	// everything is validated, so corrupted cache can't make getters go out of bounds
+	for (const auto &fi : files) {
+		if (fi.parent != c_root_index && fi.parent != c_dup_index && fi.parent >= files.size())
+			return false;
+		if (fi.hl_group != (UInt32)-1 && fi.hl_group >= groups.size())
+			return false;
+	}
+	for (const auto i : index) {
+		if (i >= files.size())
+			return false;
+	}
+	for (const auto &group : groups) {
+		for (const auto i : group) {
+			if (i >= files.size())
+				return false;
+		}
+	}
+
+	arc_chain = std::move(chain);
+	arc_attr = std::move(attrs);
+	m_has_crc = has_crc;
+	m_num_indices = num_indices;
+	file_list = std::move(files);
+	file_list_index = std::move(index);
+	hard_link_groups = std::move(groups);
+	listing_props = std::move(props);
+	if (!File::get_find_data_nt(arc_path, arc_info))
+		arc_info.set_size(listing_stamp.size);
+	return true;
+}
+
+template<bool UseVirtualDestructor>
+void Archive<UseVirtualDestructor>::save_listing_cache()
+{
+	if (!in_arc || arc_chain.size() != 1 || !volume_names.empty() || !m_password.empty() || m_open_password)
+		return;
+	const auto &type = arc_chain.back().type;
+	if (type == c_mbr || type == c_gpt)	// listing of partitions depends on item offsets
+		return;
+
+	try {
+		read_open_results();
+		if (error_flags || warning_flags || !error_text.empty() || !warning_text.empty())
+			return;
+
+		if (file_list.empty())
+			make_index();
+		if (m_num_indices == 0 || m_num_indices < (UInt32)g_options.listing_cache_min_items)
+			return;
+
+		std::string raw;
+		ListingWriter w(raw);
+
+		w.put_u32(arc_chain.size());
+		for (const auto &entry : arc_chain) {
+			w.put_bytes(entry.type);
+			w.put_u64(entry.sig_pos);
+			w.put_u64(entry.flags);
+		}
+
+		w.put_u32(arc_attr.size());
+		for (const auto &attr : arc_attr) {
+			w.put_str(attr.name);
+			w.put_str(attr.value);
+		}
+
+		w.put_u8(m_has_crc ? 1 : 0);
+		w.put_u32(m_num_indices);
+
+		w.put_u32(file_list.size());
+		for (const auto &fi : file_list) {
+			w.put_u32(fi.parent);
+			w.put_u32(fi.num_links);
+			w.put_u32(fi.hl_group);
+			w.put_u32(fi.fuid);
+			w.put_u32(fi.fgid);
+			w.put_str(fi.name);
+			w.put_str(fi.desc);
+			w.put_str(fi.owner);
+			w.put_str(fi.group);
+			w.put_u8(fi.is_dir ? 1 : 0);
+			w.put_u8(fi.is_altstream ? 1 : 0);
+		}
+
+		w.put_u32(file_list_index.size());
+		for (const auto i : file_list_index)
+			w.put_u32(i);
+
+		w.put_u32(hard_link_groups.size());
+		for (const auto &group : hard_link_groups) {
+			w.put_u32(group.size());
+			for (const auto i : group)
+				w.put_u32(i);
+		}
+
+		w.put_u32(m_num_indices);
+		for (UInt32 i = 0; i < m_num_indices; ++i) {
+			DWORD posixattr = 0;
+			w.put_u32(get_attr(i, &posixattr));
+			w.put_u32(posixattr);
+			w.put_u64(get_size(i));
+			w.put_u64(get_psize(i));
+			w.put_ftime(get_ctime(i));
+			w.put_ftime(get_atime(i));
+			w.put_ftime(get_mtime(i));
+			w.put_u32(get_crc(i));
+			w.put_u8(get_encrypted(i) ? 1 : 0);
+		}
+
+		std::string data(c_listing_magic, sizeof(c_listing_magic));
+		ListingWriter hw(data);
+		put_stamp(hw, listing_stamp);
+		hw.put_str(arc_path);
+		hw.put_u64(raw.size());
+
+		std::vector<unsigned char> packed;
+		LZBlockCompress(packed, (const unsigned char *)raw.data(), raw.size());
+		data.append((const char *)packed.data(), packed.size());
+
+		// write under temporary name and rename, so concurrent reader never sees partial file
+		const std::string &path = listing_cache_path(arc_path);
+		const std::string &tmp_path = StrPrintf("%s.%u", path.c_str(), (unsigned)getpid());
+		if (!WriteWholeFile(tmp_path.c_str(), data) || rename(tmp_path.c_str(), path.c_str()) != 0) {
+			fprintf(stderr, "Failed to save listing cache of %ls\n", arc_path.c_str());
+			unlink(tmp_path.c_str());
+			return;
+		}
+		prune_listing_cache(listing_cache_dir());
+
+	} catch (const Error &) {
+		fprintf(stderr, "Listing cache of %ls not saved\n", arc_path.c_str());
+	}
+}
+
+template class Archive<true>;
+template class Archive<false>;
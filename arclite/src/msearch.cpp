@@ -19,53 +19,97 @@ struct StateElement
 
 const unsigned c_alphabet_size = 256;
 
-class StateMatrix
+// Automaton compiled from signature list. Its immutable once built, so same instance
+// is shared by all msearch calls (including concurrent ones) with same signature set.
+class SignatureAutomaton
 {
 private:
-	StateElement *data;
+	std::vector<StateElement> matrix;
+	// bitmap of byte pairs that may start some signature, lets scan reject most
+	// of positions by single lookup instead of walking matrix
+	std::vector<UInt64> pair_filter;
+
+	void allow_pair(unsigned char first, unsigned char second)
+	{
+		const unsigned pair = first | (unsigned(second) << 8);
+		pair_filter[pair / 64] |= UInt64(1) << (pair % 64);
+	}
 
 public:
-	StateMatrix(size_t max_states)
+	SignatureAutomaton(const std::vector<SigData> &str_list) : pair_filter(0x10000 / 64, 0)
 	{
+		size_t max_states = 1;
+		for (unsigned i = 0; i < str_list.size(); i++) {
+			max_states += str_list[i].signature.size();
+		}
 		assert(max_states <= std::numeric_limits<State>::max());
-		data = new StateElement[max_states * c_alphabet_size];
-		memset(data, 0, max_states * c_alphabet_size * sizeof(StateElement));
+		matrix.resize(max_states * c_alphabet_size);
+		State current_state = 0;
+		for (StrIndex i = 0; i < str_list.size(); i++) {
+			const ByteVector &str = str_list[i].signature;
+			State state = 0;
+			for (unsigned j = 0; j + 1 < str.size(); j++) {
+				StateElement &st_elem = at(state, str[j]);
+				if (st_elem.next_state) {	 // state already present
+					state = st_elem.next_state;
+				} else {
+					current_state++;
+					state = current_state;
+					st_elem.next_state = state;
+				}
+			}
+			if (str.size()) {
+				at(state, str[str.size() - 1]).str_index = i + 1;
+			}
+			if (str.size() > 1) {
+				allow_pair(str[0], str[1]);
+			} else if (str.size() == 1) {
+				for (unsigned second = 0; second < c_alphabet_size; second++)
+					allow_pair(str[0], (unsigned char)second);
+			}
+		}
+		matrix.resize((size_t(current_state) + 1) * c_alphabet_size);
+		matrix.shrink_to_fit();
 	}
-	~StateMatrix() { delete[] data; }
-	StateElement &at(State state, unsigned char value) { return data[state * c_alphabet_size + value]; }
+
+	StateElement &at(State state, unsigned char value) { return matrix[state * c_alphabet_size + value]; }
 	const StateElement &at(State state, unsigned char value) const
 	{
-		return data[state * c_alphabet_size + value];
+		return matrix[state * c_alphabet_size + value];
+	}
+
+	bool may_start(unsigned char first, unsigned char second) const
+	{
+		const unsigned pair = first | (unsigned(second) << 8);
+		return (pair_filter[pair / 64] & (UInt64(1) << (pair % 64))) != 0;
 	}
 };
 
-static std::unique_ptr<StateMatrix> create_state_matrix(const std::vector<SigData> &str_list)
+// Returns automaton for given signature list, building it only if such list wasn't seen recently.
+// Cache is keyed by signatures content, so it remains valid regardless of where list came from.
+static std::shared_ptr<const SignatureAutomaton> get_signature_automaton(const std::vector<SigData> &str_list)
 {
-	size_t max_states = 0;
-	for (unsigned i = 0; i < str_list.size(); i++) {
-		max_states += str_list[i].signature.size();
-	}
-	//  auto matrix = std::make_unique<StateMatrix>(max_states);
-	std::unique_ptr<StateMatrix> matrix(new StateMatrix(max_states));
-	State current_state = 0;
-	for (StrIndex i = 0; i < str_list.size(); i++) {
-		const ByteVector &str = str_list[i].signature;
-		State state = 0;
-		for (unsigned j = 0; j + 1 < str.size(); j++) {
-			StateElement &st_elem = matrix->at(state, str[j]);
-			if (st_elem.next_state) {	 // state already present
-				state = st_elem.next_state;
-			} else {
-				current_state++;
-				state = current_state;
-				st_elem.next_state = state;
-			}
-		}
-		if (str.size()) {
-			matrix->at(state, str[str.size() - 1]).str_index = i + 1;
-		}
+	const size_t c_max_cached = 8;
+	static std::mutex s_mutex;
+	static std::map<std::string, std::shared_ptr<const SignatureAutomaton>> s_cache;
+
+	std::string key;
+	for (const auto &sig : str_list) {
+		const size_t len = sig.signature.size();
+		key.append(1, char(len & 0xff)).append(1, char(len >> 8));
+		key.append((const char *)sig.signature.data(), len);
 	}
-	return matrix;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto it = s_cache.find(key);
+	if (it != s_cache.end())
+		return it->second;
+
+	if (s_cache.size() >= c_max_cached)
+		s_cache.clear();
+	auto automaton = std::make_shared<const SignatureAutomaton>(str_list);
+	s_cache.emplace(std::move(key), automaton);
+	return automaton;
 }
 
 std::vector<StrPos> msearch(unsigned char *data, size_t size, const std::vector<SigData> &str_list, bool eof)
@@ -75,7 +119,7 @@ std::vector<StrPos> msearch(unsigned char *data, size_t size, const std::vector<
 	if (str_list.empty())
 		return result;
 	result.reserve(str_list.size());
-	const auto matrix = create_state_matrix(str_list);
+	const auto automaton = get_signature_automaton(str_list);
 	std::vector<bool> found(str_list.size(), false);
 
 	size_t signatures_checked = 0;
@@ -84,12 +128,14 @@ std::vector<StrPos> msearch(unsigned char *data, size_t size, const std::vector<
 	size_t signatures_added_to_result = 0;
 
 	for (size_t i = 0; i < size; i++) {
+		if (i + 1 < size && !automaton->may_start(data[i], data[i + 1]))
+			continue;
 		State state = 0;
 		for (size_t j = i; j < size; j++) {
-			const StateElement &st_elem = matrix->at(state, data[j]);
+			const StateElement &st_elem = automaton->at(state, data[j]);
 			if (st_elem.str_index) {	// found signature
 				StrIndex str_index = st_elem.str_index - 1;
-				auto format = str_list[str_index].format;
+				const auto &format = str_list[str_index].format;
 
 				signatures_checked++;
 
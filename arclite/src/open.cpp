@@ -36,7 +36,7 @@
 #endif
 
 OpenOptions::OpenOptions()
-	: detect(false), open_ex(true), nochain(false), open_password_len(nullptr), recursive_panel(false), delete_on_close('\0')
+	: detect(false), open_ex(true), nochain(false), open_password_len(nullptr), recursive_panel(false), delete_on_close('\0'), listing_cache(false)
 {}
 
 template<bool UseVirtualDestructor>
@@ -1131,6 +1131,8 @@ public:
 template<bool UseVirtualDestructor>
 bool Archive<UseVirtualDestructor>::get_stream(UInt32 index, IInStream<UseVirtualDestructor> **stream)
 {
+	ensure_open();
+
 	UInt32 num_indices = 0;
 
 	if (in_arc->GetNumberOfItems(&num_indices) != S_OK) {
@@ -1469,6 +1471,21 @@ void Archive<UseVirtualDestructor>::open(const OpenOptions &options, Archives<Us
 	ArchiveOpenStream<UseVirtualDestructor> *stream_impl = nullptr;
 	ComObject<IInStream<UseVirtualDestructor>> stream;
 	FindData arc_info{};
+	ListingStamp listing_stamp;
+	bool use_listing_cache = false;
+
+	if (parent_idx == (size_t)-1 && options.listing_cache && listing_stamp.read(options.arc_path)) {
+		const auto archive = std::make_shared<Archive>();
+		archive->arc_path = options.arc_path;
+		archive->m_password = options.password;
+		archive->listing_stamp = listing_stamp;
+		if (archive->load_listing_cache(options.arc_types)) {
+			fprintf(stderr,"Listing of %ls restored from cache\n", options.arc_path.c_str());
+			archives.push_back(archive);
+			return;
+		}
+		use_listing_cache = true;
+	}
 
 	if (parent_idx == (size_t)-1) {
 		fprintf(stderr,"Opening root archive from file path %ls\n", options.arc_path.c_str());
@@ -1484,6 +1501,7 @@ void Archive<UseVirtualDestructor>::open(const OpenOptions &options, Archives<Us
 		}
 		const ArcType &pArcType = archives[parent_idx]->arc_chain.back().type;
 		UInt32 main_file_index = 0, num_indices = 0;
+		archives[parent_idx]->ensure_open();
 		archives[parent_idx]->in_arc->GetNumberOfItems(&num_indices);
 		if (!num_indices) {
 			fprintf(stderr,"Parent archive has no items - STOPPING\n");
@@ -1816,6 +1834,11 @@ void Archive<UseVirtualDestructor>::open(const OpenOptions &options, Archives<Us
 	fprintf(stderr,"========== archives size = %lu\n", archives.size());
 	if (stream_impl)
 		stream_impl->CacheHeader(nullptr, 0);
+
+	if (use_listing_cache && archives.size() == 1) {
+		archives.back()->listing_stamp = listing_stamp;
+		archives.back()->save_listing_cache();
+	}
 }
 
 template<bool UseVirtualDestructor>
@@ -1873,6 +1896,7 @@ void Archive<UseVirtualDestructor>::close()
 	}
 	file_list.clear();
 	file_list_index.clear();
+	listing_props.clear();
 }
 
 template class Archive<true>;
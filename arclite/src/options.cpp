@@ -308,6 +308,7 @@ Options::Options()
 	max_check_size(1 << 20),
 	relay_buffer_size(64),
 	max_arc_cache_size(128),
+	listing_cache_min_items(0),
 	extract_ignore_errors(false),
 	extract_access_rights(true),
 	extract_owners_groups(0),
@@ -553,6 +554,7 @@ bool Options::load()
 	GET_VALUE_XML(max_check_size, int);
 	GET_VALUE(relay_buffer_size, int);
 	GET_VALUE(max_arc_cache_size, int);
+	GET_VALUE(listing_cache_min_items, int);
 	GET_VALUE(extract_ignore_errors, bool);
 	GET_VALUE(extract_ignore_errors, bool);
 	GET_VALUE(extract_access_rights, bool);
@@ -638,6 +640,7 @@ void Options::save() const
 	SET_VALUE_XML(max_check_size, int);
 	SET_VALUE(relay_buffer_size, int);
 	SET_VALUE(max_arc_cache_size, int);
+	SET_VALUE(listing_cache_min_items, int);
 	SET_VALUE(extract_ignore_errors, bool);
 	SET_VALUE(extract_access_rights, bool);
 	SET_VALUE(extract_owners_groups, int);
@@ -50,6 +50,7 @@ struct Options
 	unsigned max_check_size;
 	int relay_buffer_size;
 	int max_arc_cache_size;
+	int listing_cache_min_items;
 	// extract
 	bool extract_ignore_errors;
 	bool extract_access_rights;
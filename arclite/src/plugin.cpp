@@ -1676,6 +1676,8 @@ static HANDLE analyse_open(const AnalyseInfo *info, bool from_analyse)
 		options.detect = g_detect_next_time == triTrue;
 	}
 
+	options.listing_cache = !pgdn && !options.detect && g_options.listing_cache_min_items > 0;
+
 	int password_len;
 	options.open_password_len = &password_len;
 
@@ -159,6 +159,8 @@ void Archive<UseVirtualDestructor>::prepare_test(UInt32 file_index, std::list<UI
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::test(UInt32 src_dir_index, const std::vector<UInt32> &src_indices)
 {
+	ensure_open();
+
 	DisableSleepMode dsm;
 
 	std::list<UInt32> file_indices;
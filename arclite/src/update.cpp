@@ -2103,6 +2103,8 @@ template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::update(const std::wstring &src_dir, const std::vector<std::wstring> &file_names,
 		const std::wstring &dst_dir, const UpdateOptions &options, std::shared_ptr<ErrorLog> error_log)
 {
+	ensure_open();
+
 	DisableSleepMode dsm;
 
 	const auto ignore_errors = std::make_shared<bool>(options.ignore_errors);
@@ -2168,6 +2170,8 @@ void Archive<UseVirtualDestructor>::update(const std::wstring &src_dir, const st
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::create_dir(const std::wstring &dir_name, const std::wstring &dst_dir)
 {
+	ensure_open();
+
 	DisableSleepMode dsm;
 
 	const auto file_index_map = std::make_shared<FileIndexMap>();
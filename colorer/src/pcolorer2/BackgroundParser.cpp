@@ -0,0 +1,366 @@
+#include "BackgroundParser.h"
+#include "pcolorer.h"
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <utility>
+
+namespace {
+// lines parsed by single validate() call between checks for new requests
+const int CHUNK_LINES = 100;
+// lines of text snapshot's chunk, edited chunk is copied when making new snapshot
+const size_t TEXT_CHUNK_LINES = 256;
+// max time of holding parse mutex at once, so UI actions and other editors don't wait long
+const int CHUNK_MSEC = 20;
+
+/* Moves published regions according to text edit, so redraw done before
+   worker republishes them paints shifted lines by their own colors. Edited
+   lines keep regions of same-numbered old lines, that is mostly correct
+   while typing, inserted lines stay uncolored.
+*/
+std::shared_ptr<const ParsedLines> spliceParsed(const ParsedLines& old, int editBegin, int editOldEnd,
+                                                int editNewEnd)
+{
+  const int keptEnd = std::min(editOldEnd, editNewEnd);
+  const int delta = editNewEnd - editOldEnd;
+  std::vector<std::pair<int, size_t>> mapped;
+  for (size_t i = 0; i < old.lines.size(); i++) {
+    const int lno = old.firstLine + (int) i;
+    if (lno < keptEnd) {
+      mapped.emplace_back(lno, i);
+    }
+    else if (lno >= editOldEnd) {
+      mapped.emplace_back(lno + delta, i);
+    }
+  }
+  if (mapped.empty()) {
+    return nullptr;
+  }
+
+  auto result = std::make_shared<ParsedLines>();
+  result->firstLine = mapped.front().first;
+  result->lines.resize(mapped.back().first - result->firstLine + 1);
+  for (const auto& m : mapped) {
+    result->lines[m.first - result->firstLine] = old.lines[m.second];
+  }
+  return result;
+}
+}  // namespace
+
+const TextLines::Line& TextLines::operator[](size_t lno) const
+{
+  const size_t ci = std::upper_bound(starts.begin(), starts.end(), lno) - starts.begin() - 1;
+  return (*chunks[ci])[lno - starts[ci]];
+}
+
+std::shared_ptr<const TextLines> TextLines::replaced(size_t begin, size_t oldEnd, std::vector<Line> lines) const
+{
+  // chunks [lo, hi) are affected by edit, others are shared with new snapshot
+  size_t lo = std::upper_bound(starts.begin(), starts.end(), begin) - starts.begin();
+  if (lo > 0 && begin < starts[lo - 1] + chunks[lo - 1]->size()) {
+    lo--;
+  }
+  size_t hi = std::lower_bound(starts.begin(), starts.end(), oldEnd) - starts.begin();
+  if (hi < lo) {
+    hi = lo;
+  }
+
+  Chunk merged;
+  if (lo < hi) {
+    const Chunk& first = *chunks[lo];
+    merged.insert(merged.end(), first.begin(), first.begin() + (begin - starts[lo]));
+  }
+  merged.insert(merged.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+  for (size_t ci = lo; ci < hi; ci++) {
+    const Chunk& chunk = *chunks[ci];
+    for (size_t i = std::max(oldEnd, starts[ci]) - starts[ci]; i < chunk.size(); i++) {
+      merged.emplace_back(chunk[i]);
+    }
+  }
+  // avoid fragmentation by lots of small edits
+  while (merged.size() < TEXT_CHUNK_LINES / 2 && hi < chunks.size()) {
+    merged.insert(merged.end(), chunks[hi]->begin(), chunks[hi]->end());
+    hi++;
+  }
+
+  auto result = std::make_shared<TextLines>();
+  result->chunks.assign(chunks.begin(), chunks.begin() + lo);
+  if (!merged.empty()) {
+    const size_t pieces = (merged.size() + TEXT_CHUNK_LINES - 1) / TEXT_CHUNK_LINES;
+    for (size_t i = 0; i < pieces; i++) {
+      result->chunks.emplace_back(std::make_shared<const Chunk>(
+          merged.begin() + merged.size() * i / pieces, merged.begin() + merged.size() * (i + 1) / pieces));
+    }
+  }
+  result->chunks.insert(result->chunks.end(), chunks.begin() + hi, chunks.end());
+  result->starts.reserve(result->chunks.size());
+  for (const auto& chunk : result->chunks) {
+    result->starts.emplace_back(result->count);
+    result->count += chunk->size();
+  }
+  return result;
+}
+
+std::mutex& colorerParseMutex()
+{
+  static std::mutex s_parse_mutex;
+  return s_parse_mutex;
+}
+
+const std::vector<LineRegion>* ParsedLines::getLineRegions(int lno) const
+{
+  if (lno < firstLine || lno >= firstLine + (int) lines.size()) {
+    return nullptr;
+  }
+  return &lines[lno - firstLine];
+}
+
+BackgroundParser::~BackgroundParser()
+{
+  stop();
+}
+
+UnicodeString* BackgroundParser::getLine(size_t lno)
+{
+  if (!parserText || lno >= parserText->size()) {
+    return nullptr;
+  }
+  // parser doesn't modify lines, only their internal conversion buffers
+  return const_cast<UnicodeString*>((*parserText)[lno].get());
+}
+
+void BackgroundParser::start(BaseEditor* editor_)
+{
+  editor = editor_;
+  thread = std::thread([this] { run(); });
+}
+
+// Worker never waits for main thread: colorerRequestSynchro() posts synchro asynchronously,
+// so joining it from editor closing can't deadlock.
+void BackgroundParser::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  cond.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void BackgroundParser::setText(std::shared_ptr<const TextLines> text_, int editBegin, int editOldEnd,
+                               int editNewEnd)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    text = std::move(text_);
+    pendingLine = (pendingLine == -1) ? editBegin : std::min(pendingLine, editBegin);
+    if (parsed) {
+      parsed = spliceParsed(*parsed, editBegin, editOldEnd, editNewEnd);
+    }
+    ++gen;
+    pendingWork = true;
+  }
+  cond.notify_one();
+}
+
+std::shared_ptr<const TextLines> BackgroundParser::getText() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return text;
+}
+
+void BackgroundParser::restart(int line)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    pendingLine = (pendingLine == -1) ? line : std::min(pendingLine, line);
+    ++gen;
+    pendingWork = true;
+  }
+  cond.notify_one();
+}
+
+void BackgroundParser::refresh()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    ++gen;
+    pendingWork = true;
+  }
+  cond.notify_one();
+}
+
+void BackgroundParser::setVisibleWindow(int top, int size)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (windowTop == top && windowSize == size) {
+      return;
+    }
+    windowTop = top;
+    windowSize = size;
+    pendingWork = true;
+  }
+  cond.notify_one();
+}
+
+void BackgroundParser::syncEditor()
+{
+  std::shared_ptr<const TextLines> newText;
+  int line;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    parserGen = gen;
+    if (pendingLine == -1) {
+      return;
+    }
+    newText = text;
+    line = pendingLine;
+    pendingLine = -1;
+  }
+  parserText = std::move(newText);
+  editor->modifyEvent(line);
+  editor->lineCountEvent(parserText ? (int) parserText->size() : 0);
+  parseStalled = false;
+}
+
+std::shared_ptr<const ParsedLines> BackgroundParser::getParsed() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return parsed;
+}
+
+bool BackgroundParser::takeFresh()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return std::exchange(fresh, false);
+}
+
+void BackgroundParser::run()
+{
+  bool more = false;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (!more) {
+        cond.wait(lock, [this] { return stopping || pendingWork; });
+      }
+      if (stopping) {
+        break;
+      }
+      pendingWork = false;
+    }
+    more = step();
+  }
+}
+
+// Does single portion of work, returns false if nothing left to do.
+bool BackgroundParser::step()
+{
+  bool published;
+  {
+    std::lock_guard<std::mutex> parseLock(colorerParseMutex());
+    syncEditor();
+    if (editor->getFileType() == nullptr) {
+      return false;
+    }
+
+    int top, size;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      top = windowTop;
+      size = windowSize;
+    }
+    // lines around visible window, so scrolling by line or page finds them already parsed
+    const int bandTop = std::max(0, top - size);
+    const int bandSize = size * 3;
+
+    if (size <= 0 || (renderedGen == parserGen && renderedTop == bandTop && renderedSize == bandSize)) {
+      if (!editor->haveInvalidLine() || parseStalled) {
+        return false;
+      }
+      parseChunk(INT_MAX);
+      return true;
+    }
+
+    if (editor->getInvalidLine() < bandTop && !parseStalled) {
+      parseChunk(bandTop);
+      return true;
+    }
+
+    published = render(bandTop, bandSize);
+  }
+
+  if (published) {
+    colorerRequestSynchro();
+  }
+  return true;
+}
+
+// Warms parser cache up to given line, stops earlier if time is over or there is new request.
+void BackgroundParser::parseChunk(int toLine)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CHUNK_MSEC);
+  const int lineCount = parserText ? (int) parserText->size() : 0;
+  toLine = std::min(toLine, lineCount);
+
+  while (editor->getInvalidLine() < toLine) {
+    const int invalidLine = editor->getInvalidLine();
+    editor->validate(std::min(invalidLine + CHUNK_LINES, toLine) - 1, false);
+    if (editor->getInvalidLine() <= invalidLine) {
+      parseStalled = true;
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (pendingWork) {
+      break;
+    }
+  }
+}
+
+// Parses lines of given band and publishes their regions, returns false if text changed meanwhile.
+bool BackgroundParser::render(int bandTop, int bandSize)
+{
+  editor->visibleTextEvent(bandTop, bandSize);
+  const int lineCount = parserText ? (int) parserText->size() : 0;
+  const int bandEnd = std::min(bandTop + bandSize, lineCount);
+
+  auto result = std::make_shared<ParsedLines>();
+  result->firstLine = bandTop;
+  for (int lno = bandTop; lno < bandEnd; lno++) {
+    result->lines.emplace_back();
+    auto& regions = result->lines.back();
+    for (const LineRegion* l1 = editor->getLineRegions(lno); l1; l1 = l1->next) {
+      regions.emplace_back(*l1);
+    }
+  }
+  renderedGen = parserGen;
+  renderedTop = bandTop;
+  renderedSize = bandSize;
+
+  std::lock_guard<std::mutex> lock(mtx);
+  if (gen != parserGen) {
+    return false;
+  }
+  parsed = std::move(result);
+  fresh = true;
+  return true;
+}
+
+/* ***** BEGIN LICENSE BLOCK *****
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ * ***** END LICENSE BLOCK ***** */
@@ -0,0 +1,141 @@
+#ifndef _BACKGROUNDPARSER_H_
+#define _BACKGROUNDPARSER_H_
+
+#include <colorer/editor/BaseEditor.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Serializes all colorer parsing within plugin. HRC regexps keep match state
+    inside of objects shared by all parsers, so even different editors must not
+    parse concurrently. Any BaseEditor call that may parse must hold it.
+*/
+std::mutex& colorerParseMutex();
+
+/** Immutable snapshot of editor's text. Lines are kept in chunks shared between
+    subsequent snapshots, so editing makes new snapshot without copying whole text.
+*/
+class TextLines
+{
+ public:
+  using Line = std::shared_ptr<const UnicodeString>;
+
+  [[nodiscard]] size_t size() const { return count; }
+  [[nodiscard]] const Line& operator[](size_t lno) const;
+
+  /** Returns copy of this snapshot with lines [begin, oldEnd) replaced by given ones.
+   */
+  [[nodiscard]] std::shared_ptr<const TextLines> replaced(size_t begin, size_t oldEnd,
+                                                          std::vector<Line> lines) const;
+
+ private:
+  using Chunk = std::vector<Line>;
+
+  std::vector<std::shared_ptr<const Chunk>> chunks;
+  std::vector<size_t> starts;  // first line of each chunk
+  size_t count = 0;
+};
+
+/** Line regions of consecutive lines, published by BackgroundParser.
+    Never changed after publishing, so redraw reads it without any locks.
+*/
+struct ParsedLines
+{
+  int firstLine = 0;
+  std::vector<std::vector<LineRegion>> lines;
+
+  [[nodiscard]] const std::vector<LineRegion>* getLineRegions(int lno) const;
+};
+
+/** Parses editor's text snapshot on worker thread.
+    BaseEditor reads text from this object, so it never touches FAR's editor
+    and can be driven from any thread holding colorerParseMutex(). Worker first
+    renders lines around the visible window, publishes them for redraw and
+    requests synchro event to repaint, then continues parsing the rest of text
+    to keep parser cache warm for on-demand actions and further scrolling.
+*/
+class BackgroundParser : public LineSource
+{
+ public:
+  BackgroundParser() = default;
+  ~BackgroundParser() override;
+
+  UnicodeString* getLine(size_t lno) override;
+
+  void start(BaseEditor* editor);
+  void stop();
+
+  /** Replaces text snapshot. Lines [editBegin, editOldEnd) of previous snapshot
+      became lines [editBegin, editNewEnd) of new one, parsing restarts from editBegin.
+  */
+  void setText(std::shared_ptr<const TextLines> text, int editBegin, int editOldEnd, int editNewEnd);
+  [[nodiscard]] std::shared_ptr<const TextLines> getText() const;
+
+  /** Forces reparse of text starting from given line.
+   */
+  void restart(int line);
+
+  /** Republishes regions without reparsing, e.g. after colors mapping changed.
+   */
+  void refresh();
+
+  void setVisibleWindow(int top, int size);
+
+  /** Passes pending text changes to BaseEditor.
+      Must be called with colorerParseMutex() held before using BaseEditor.
+  */
+  void syncEditor();
+
+  [[nodiscard]] std::shared_ptr<const ParsedLines> getParsed() const;
+
+  /** Returns true once after new regions were published.
+   */
+  bool takeFresh();
+
+ private:
+  void run();
+  bool step();
+  void parseChunk(int toLine);
+  bool render(int bandTop, int bandSize);
+
+  BaseEditor* editor = nullptr;
+  std::thread thread;
+
+  mutable std::mutex mtx;
+  std::condition_variable cond;
+  bool stopping = false;
+  bool pendingWork = false;
+  std::shared_ptr<const TextLines> text;
+  int pendingLine = -1;
+  unsigned int gen = 0;
+  int windowTop = 0;
+  int windowSize = 0;
+  std::shared_ptr<const ParsedLines> parsed;
+  bool fresh = false;
+
+  // following fields are accessed only with colorerParseMutex() held
+  std::shared_ptr<const TextLines> parserText;
+  unsigned int parserGen = 0;
+  unsigned int renderedGen = 0;
+  bool parseStalled = false;
+  int renderedTop = -1;
+  int renderedSize = 0;
+};
+
+#endif
+
+/* ***** BEGIN LICENSE BLOCK *****
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ * ***** END LICENSE BLOCK ***** */
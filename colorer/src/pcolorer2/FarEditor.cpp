@@ -1,4 +1,5 @@
 #include "FarEditor.h"
+#include <algorithm>
 #include <vector>
 
 const UnicodeString DShowCross("show-cross");
@@ -23,21 +24,26 @@ const UnicodeString DFavorite("favorite");
 const UnicodeString DFirstLines("firstlines");
 const UnicodeString DFirstLineBytes("firstlinebytes");
 
+// lines below edited ones compared to tell that the rest of text is unchanged
+const int SYNC_PROBE_LINES = 8;
+
 FarEditor::FarEditor(PluginStartupInfo* inf, ParserFactory* pf) : info(inf), parserFactory(pf)
 {
   UnicodeString dso("def:Outlined");
   UnicodeString dse("def:Error");
-  baseEditor = std::make_unique<BaseEditor>(parserFactory, this);
+  backgroundParser = std::make_unique<BackgroundParser>();
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  baseEditor = std::make_unique<BaseEditor>(parserFactory, backgroundParser.get());
   const Region* def_Outlined = parserFactory->getHrcLibrary().getRegion(&dso);
   const Region* def_Error = parserFactory->getHrcLibrary().getRegion(&dse);
   structOutliner = std::make_unique<Outliner>(baseEditor.get(), def_Outlined);
   errorOutliner = std::make_unique<Outliner>(baseEditor.get(), def_Error);
+  backgroundParser->start(baseEditor.get());
 }
 
-void FarEditor::endJob(size_t lno)
+FarEditor::~FarEditor()
 {
-  (void) lno;
-  ret_str.reset();
+  backgroundParser->stop();
 }
 
 UnicodeString* FarEditor::getLine(size_t lno)
@@ -57,19 +63,122 @@ UnicodeString* FarEditor::getLine(size_t lno)
   return nullptr;
 }
 
+std::shared_ptr<const UnicodeString> FarEditor::fetchLine(int lno) const
+{
+  EditorGetString es {lno};
+
+  if (!info->EditorControl(ECTL_GETSTRING, &es)) {
+    return std::make_shared<const UnicodeString>();
+  }
+  int len = es.StringLength;
+  if (len > maxLineLength && maxLineLength > 0) {
+    len = maxLineLength;
+  }
+  return std::make_shared<const UnicodeString>((char*) es.StringText, len * sizeof(wchar_t),
+                                               Encodings::ENC_UTF32);
+}
+
+bool FarEditor::sameLine(int lno, const UnicodeString& line) const
+{
+  EditorGetString es {lno};
+
+  if (!info->EditorControl(ECTL_GETSTRING, &es)) {
+    return false;
+  }
+  int len = es.StringLength;
+  if (len > maxLineLength && maxLineLength > 0) {
+    len = maxLineLength;
+  }
+  if (line.length() != len) {
+    return false;
+  }
+  for (int i = 0; i < len; i++) {
+    if (line[i] != es.StringText[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Updates text snapshot parsed by background thread. Lines before topLine are known
+// to be unchanged, edited range is narrowed further by comparing lines from the top
+// and then from bottomLine, that is the last line edit likely touched. Few lines
+// below it are checked to be the same as in snapshot and if they are then the rest
+// of text is considered unchanged, otherwise or if bottomLine is unknown (-1) lines
+// are compared up from the end of text.
+void FarEditor::syncText(int topLine, int bottomLine, int totalLines)
+{
+  auto text = backgroundParser->getText();
+  const int oldCount = text ? (int) text->size() : 0;
+  if (textMaxLineLength != maxLineLength) {
+    // lines were cut by other length, refetch all of them
+    text.reset();
+    textMaxLineLength = maxLineLength;
+  }
+
+  int begin = 0;
+  int oldEnd = oldCount;
+  int newEnd = totalLines;
+  if (text) {
+    const int common = std::min(oldCount, totalLines);
+    begin = std::max(0, std::min(topLine, common));
+    while (begin < common && sameLine(begin, *(*text)[begin])) {
+      begin++;
+    }
+
+    const int delta = totalLines - oldCount;
+    if (bottomLine != -1) {
+      newEnd = std::min(std::max(bottomLine + 1, begin + std::max(delta, 0)), totalLines);
+      oldEnd = newEnd - delta;
+      for (int i = 0; i < SYNC_PROBE_LINES && newEnd + i < totalLines; i++) {
+        if (!sameLine(newEnd + i, *(*text)[oldEnd + i])) {
+          newEnd = totalLines;
+          oldEnd = oldCount;
+          break;
+        }
+      }
+    }
+    while (oldEnd > begin && newEnd > begin && sameLine(newEnd - 1, *(*text)[oldEnd - 1])) {
+      oldEnd--;
+      newEnd--;
+    }
+    if (begin == oldEnd && begin == newEnd) {
+      return;
+    }
+  }
+
+  std::vector<TextLines::Line> lines;
+  lines.reserve(newEnd - begin);
+  for (int lno = begin; lno < newEnd; lno++) {
+    lines.emplace_back(fetchLine(lno));
+  }
+  auto newText = (text ? *text : TextLines()).replaced(begin, oldEnd, std::move(lines));
+  backgroundParser->setText(std::move(newText), begin, oldEnd, newEnd);
+}
+
 void FarEditor::chooseFileType(const UnicodeString* fname)
 {
+  syncText(0, -1, getEditorInfo().TotalLines);
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   FileType* ftype = baseEditor->chooseFileType(fname);
-  setFileType(ftype);
+  applyFileType(ftype);
 }
 
 void FarEditor::setFileType(FileType* ftype)
+{
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  applyFileType(ftype);
+}
+
+void FarEditor::applyFileType(FileType* ftype)
 {
   baseEditor->setFileType(ftype);
   // clear Outliner
   structOutliner->modifyEvent(0);
   errorOutliner->modifyEvent(0);
   reloadTypeSettings();
+  backgroundParser->restart(0);
 }
 
 void FarEditor::reloadTypeSettings()
@@ -183,9 +292,11 @@ void FarEditor::setDrawCross(int _drawCross)
       showHorizontalCross = true;
       showVerticalCross = true;
       break;
-    case 2:
+    case 2: {
+      std::lock_guard<std::mutex> lock(colorerParseMutex());
       reloadTypeSettings();
       break;
+    }
   }
 }
 
@@ -211,6 +322,7 @@ void FarEditor::setTrueMod(bool true_mod)
 
 void FarEditor::setRegionMapper(RegionMapper* rs)
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
   baseEditor->setRegionMapper(rs);
   rdBackground = StyledRegion::cast(baseEditor->rd_def_Text);
   horzCrossColor = convert(StyledRegion::cast(baseEditor->rd_def_HorzCross));
@@ -221,10 +333,14 @@ void FarEditor::setRegionMapper(RegionMapper* rs)
     horzCrossColor.concolor = 0x0E;
   if (vertCrossColor.concolor == 0)
     vertCrossColor.concolor = 0x0E;
+
+  backgroundParser->refresh();
 }
 
 void FarEditor::matchPair() const
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   const auto ei = getEditorInfo();
   PairMatch* pm = baseEditor->searchGlobalPair(ei.CurLine, ei.CurPos);
 
@@ -256,6 +372,8 @@ void FarEditor::matchPair() const
 
 void FarEditor::selectPair() const
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   int X1, X2, Y1, Y2;
   const auto ei = getEditorInfo();
   PairMatch* pm = baseEditor->searchGlobalPair(ei.CurLine, ei.CurPos);
@@ -286,6 +404,8 @@ void FarEditor::selectPair() const
 
 void FarEditor::selectBlock() const
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   int X1, X2, Y1, Y2;
   const auto ei = getEditorInfo();
   PairMatch* pm = baseEditor->searchGlobalPair(ei.CurLine, ei.CurPos);
@@ -336,18 +456,24 @@ void FarEditor::selectRegion() const
 
 void FarEditor::listFunctions()
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   baseEditor->validate(-1, false);
   showOutliner(structOutliner.get());
 }
 
 void FarEditor::listErrors()
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   baseEditor->validate(-1, false);
   showOutliner(errorOutliner.get());
 }
 
 void FarEditor::locateFunction()
 {
+  std::lock_guard<std::mutex> lock(colorerParseMutex());
+  backgroundParser->syncEditor();
   // extract word
   auto ei = getEditorInfo();
   UnicodeString& curLine = *getLine(ei.CurLine);
@@ -429,124 +555,90 @@ void FarEditor::locateFunction()
 
 void FarEditor::updateHighlighting()
 {
-  const auto ei = getEditorInfo();
-  baseEditor->validate(ei.TopScreenLine, true);
+  backgroundParser->restart(0);
 }
 
-// Parses pending (invalid) lines for at most msBudget milliseconds and
-// triggers editor redraw once parsed area reaches the visible window.
-// Returns true if there is still work left after the budget is over.
-//
-// Rationale: a single idleJob() call parses at most ~500 lines, while
-// KEY_IDLE arrives roughly twice a second, capping background highlighting
-// at ~1000 lines/sec regardless of CPU speed. Parsing by time budget
-// keeps UI responsive but lets modern CPU parse tens of thousands lines
-// per second; and if work still remains, caller requests a synchro event
-// to continue almost immediately instead of waiting for the next KEY_IDLE.
-static int backgroundBudget = 50;
-bool FarEditor::backgroundParseTick()
+// Called on synchro event, requested by background parser when it publishes regions.
+void FarEditor::backgroundParseTick()
 {
-  if (backgroundBudget < 100)
-    backgroundBudget+= 10;
-  return progressParse(backgroundBudget);
+  if (backgroundParser->takeFresh()) {
+    info->EditorControl(ECTL_REDRAW, nullptr);
+  }
 }
 
 int FarEditor::editorInput(const INPUT_RECORD* ir)
 {
-  if (ir->EventType == KEY_EVENT) {
-    if (ir->Event.KeyEvent.wVirtualKeyCode == 0) {
-      if (progressParse(50)) {
-       auto now = std::chrono::steady_clock::now();
-       const int sinceAllDone = std::chrono::duration_cast<std::chrono::seconds>(now - lastAllDoneTime).count();
-       if (sinceAllDone > 900) { // hardcoded 15 minutes for now, mabe be need to move to the settings
-        if (!backgroundMode) {
-          fprintf(stderr, "* COLORER: background mode activated\n");
-          backgroundMode = true;
-        }
-        backgroundBudget = std::max(backgroundBudget, 20);
-        colorerRequestSynchro();
-       }
-      }
-    } else {
-       backgroundBudget = 10;
-    }
-  }
-
+  (void) ir;
   return 0;
 }
 
-// intentially global variable, so on slow system it will not start from non-optimal value on each file opened
-static int s_idleJobAmount = 100;
-
-bool FarEditor::progressParse(int msBudget)
+// Same as BaseEditor::searchLocalPair, but looks only through regions published
+// by background parser, so redraw never runs parser on its own.
+PairMatch* FarEditor::searchVisiblePair(const ParsedLines& parsed, int lineNo, int pos, int startLine,
+                                        int endLine) const
 {
-  if (!baseEditor->haveInvalidLine()) {
-    parseStartTime = {};
-    return false;
-  }
-  auto deadline = std::chrono::steady_clock::now();
-  if (parseStartTime == std::chrono::time_point<std::chrono::steady_clock>()) {
-    parseStartTime = deadline;
+  const std::vector<LineRegion>* regions = parsed.getLineRegions(lineNo);
+  if (regions == nullptr) {
+    return nullptr;
   }
-  deadline+= std::chrono::milliseconds(msBudget);
-  auto invalid_line1 = baseEditor->getInvalidLine();
-  for (int iterations = 1;; ++iterations) {
-    baseEditor->idleJob(s_idleJobAmount);
-    if (!baseEditor->haveInvalidLine()) {
-      break;
-    }
-    const auto now = std::chrono::steady_clock::now();
-    if (now >= deadline) {
-      const int overdue = std::chrono::duration_cast<std::chrono::milliseconds>(now - deadline).count();
-      auto news_idleJobAmount = s_idleJobAmount;
-      if (s_idleJobAmount > 1 && overdue > msBudget * 20) {
-        news_idleJobAmount = 1;
-      } else if (s_idleJobAmount > 1 && overdue > msBudget * 10) {
-        news_idleJobAmount/= 2;
-      } else if (s_idleJobAmount > 1 && overdue > msBudget) {
-        news_idleJobAmount = news_idleJobAmount * 3 / 4;
-      } else if (s_idleJobAmount < 10 && overdue < msBudget / 10) {
-          news_idleJobAmount*= 2;
-      } else if (s_idleJobAmount < 30 && overdue < msBudget / 8) {
-          news_idleJobAmount+= s_idleJobAmount / 2;
-      } else if (s_idleJobAmount < 50 && overdue < msBudget / 4) {
-          news_idleJobAmount+= s_idleJobAmount / 4;
-      } else if (s_idleJobAmount < 100 && overdue < msBudget / 2) {
-          news_idleJobAmount++;
-      }
-      if (s_idleJobAmount != news_idleJobAmount) {
-        fprintf(stderr, "COLORER: %d iterations in %d msec + %d overdue, s_idleJobAmount: %d -> %d\n",
-            iterations, msBudget, overdue, s_idleJobAmount, news_idleJobAmount);
-        s_idleJobAmount = news_idleJobAmount;
-      }
-      break;
+  const Region* pairStart = baseEditor->def_PairStart;
+  const Region* pairEnd = baseEditor->def_PairEnd;
+
+  int idx = -1;
+  for (size_t i = 0; i < regions->size(); i++) {
+    const LineRegion& lr = (*regions)[i];
+    if (lr.region && pos >= lr.start && pos <= lr.end &&
+        (lr.region->hasParent(pairStart) || lr.region->hasParent(pairEnd)))
+    {
+      idx = (int) i;
     }
   }
-  auto invalid_line2 = baseEditor->getInvalidLine();
-
-  EditorInfo ei = getEditorInfo();
-  if ((invalid_line1 < ei.TopScreenLine && invalid_line2 >= ei.TopScreenLine) ||
-      (invalid_line1 < ei.TopScreenLine + ei.WindowSizeY &&
-       invalid_line2 >= ei.TopScreenLine + ei.WindowSizeY))
-  {
-    info->EditorControl(ECTL_REDRAW, nullptr);
+  if (idx == -1) {
+    return nullptr;
   }
 
-  if (!baseEditor->haveInvalidLine()) {
-    const auto &now = std::chrono::steady_clock::now();
-    int delta = std::chrono::duration_cast<std::chrono::milliseconds>(now - parseStartTime).count();
-    fprintf(stderr, "* COLORER: done in %d msec, s_idleJobAmount=%d %s background mode\n",
-      delta, s_idleJobAmount, backgroundMode ? "with" : "without");
-    backgroundMode = false;
-    lastAllDoneTime = now;
-    parseStartTime = {};
-    return false;
+  auto* startRef = const_cast<LineRegion*>(&(*regions)[idx]);
+  auto* pm = new PairMatch(startRef, lineNo, startRef->region->hasParent(pairStart));
+  pm->setStart(startRef);
+
+  int lno = lineNo;
+  while (true) {
+    if (pm->pairBalance > 0) {
+      do {
+        while (++idx >= (int) regions->size()) {
+          if (++lno > endLine || (regions = parsed.getLineRegions(lno)) == nullptr) {
+            return pm;
+          }
+          idx = -1;
+        }
+      } while (!(*regions)[idx].region);
+    }
+    else {
+      do {
+        while (--idx < 0) {
+          if (--lno < startLine || (regions = parsed.getLineRegions(lno)) == nullptr) {
+            return pm;
+          }
+          idx = (int) regions->size();
+        }
+      } while (!(*regions)[idx].region);
+    }
+    const LineRegion& pair = (*regions)[idx];
+    if (pair.region->hasParent(pairStart)) {
+      pm->pairBalance++;
+    }
+    if (pair.region->hasParent(pairEnd)) {
+      pm->pairBalance--;
+    }
+    if (pm->pairBalance == 0) {
+      pm->eline = lno;
+      pm->setEnd(&pair);
+      break;
+    }
   }
-
-  return true;
+  return pm;
 }
 
-
 int FarEditor::editorEvent(int event, void* param)
 {
   // ignore event
@@ -558,10 +650,6 @@ int FarEditor::editorEvent(int event, void* param)
   WindowSizeX = ei.WindowSizeX;
   WindowSizeY = ei.WindowSizeY;
 
-  baseEditor->visibleTextEvent(ei.TopScreenLine, WindowSizeY);
-
-  baseEditor->lineCountEvent(ei.TotalLines);
-
   if (param == EEREDRAW_CHANGE) {
     int ml = (prevLinePosition < ei.CurLine ? prevLinePosition : ei.CurLine) - 1;
 
@@ -573,8 +661,24 @@ int FarEditor::editorEvent(int event, void* param)
       ml = blockTopPosition;
     }
 
-    baseEditor->modifyEvent(ml);
+    int bl = std::max(prevLinePosition, ei.CurLine);
+    if (ei.BlockType != BTYPE_NONE) {
+      // block operations may change lines far below the cursor
+      bl = -1;
+    }
+
+    syncText(ml, bl, ei.TotalLines);
   }
+  else {
+    const auto text = backgroundParser->getText();
+    if (!text || (int) text->size() != ei.TotalLines || textMaxLineLength != maxLineLength) {
+      syncText(0, -1, ei.TotalLines);
+    }
+  }
+
+  backgroundParser->setVisibleWindow(ei.TopScreenLine, WindowSizeY);
+  backgroundParser->takeFresh();
+  const auto parsed = backgroundParser->getParsed();
 
   prevLinePosition = ei.CurLine;
   blockTopPosition = -1;
@@ -598,10 +702,10 @@ int FarEditor::editorEvent(int event, void* param)
       break;
     }
 
-    LineRegion* l1 = nullptr;
+    const std::vector<LineRegion>* regions = nullptr;
 
-    if (drawSyntax || drawPairs) {
-      l1 = baseEditor->getLineRegions(lno);
+    if ((drawSyntax || drawPairs) && parsed) {
+      regions = parsed->getLineRegions(lno);
     }
 
     // clean line in far editor
@@ -631,8 +735,9 @@ int FarEditor::editorEvent(int event, void* param)
 
     bool vertCrossDone = false;
 
-    if (drawSyntax) {
-      for (; l1; l1 = l1->next) {
+    if (drawSyntax && regions) {
+      for (const auto& region : *regions) {
+        const LineRegion* l1 = &region;
         if (l1->special) {
           continue;
         }
@@ -737,8 +842,9 @@ int FarEditor::editorEvent(int event, void* param)
   /// pair brackets
   PairMatch* pm = nullptr;
 
-  if (drawPairs) {
-    pm = baseEditor->searchLocalPair(ei.CurLine, ei.CurPos);
+  if (drawPairs && parsed) {
+    pm = searchVisiblePair(*parsed, ei.CurLine, ei.CurPos, ei.TopScreenLine,
+                           std::min(ei.TopScreenLine + WindowSizeY, ei.TotalLines) - 1);
   }
 
   if (pm != nullptr) {
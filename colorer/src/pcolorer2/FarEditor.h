@@ -4,8 +4,8 @@
 #include <colorer/editor/BaseEditor.h>
 #include <colorer/editor/Outliner.h>
 #include <colorer/handlers/StyledRegion.h>
+#include "BackgroundParser.h"
 #include "pcolorer.h"
-#include <chrono>
 
 struct color
 {
@@ -58,23 +58,24 @@ extern const UnicodeString DFirstLineBytes;
 /** FAR Editor internal plugin structures.
     Implements text parsing and different
     editor extended functions.
+    Text is parsed by BackgroundParser over its own snapshot,
+    redraw only paints regions published by it.
     @ingroup far_plugin
 */
-class FarEditor : public LineSource
+class FarEditor
 {
  public:
   /** Creates FAR editor instance.
    */
   FarEditor(PluginStartupInfo* inf, ParserFactory* pf);
   /** Drops this editor */
-  ~FarEditor() override = default;
+  ~FarEditor();
 
-  void endJob(size_t lno) override;
   /**
   Returns line number "lno" from FAR interface. Line is only valid until next call of this function,
   it also should not be disposed, this function takes care of this.
   */
-  UnicodeString* getLine(size_t lno) override;
+  UnicodeString* getLine(size_t lno);
 
   /** Changes current assigned file type.
    */
@@ -133,7 +134,8 @@ class FarEditor : public LineSource
   int editorEvent(int event, void* param);
   /** Dispatch editor input event */
   int editorInput(const INPUT_RECORD* ir);
-  bool backgroundParseTick();
+  /** Repaints editor if background parser published new regions */
+  void backgroundParseTick();
 
   void cleanEditor();
 
@@ -142,9 +144,11 @@ class FarEditor : public LineSource
   PluginStartupInfo* info;
 
   ParserFactory* parserFactory;
+  std::unique_ptr<BackgroundParser> backgroundParser;
   std::unique_ptr<BaseEditor> baseEditor;
 
   int maxLineLength = 0;
+  int textMaxLineLength = -1;
   bool fullBackground = true;
 
   int drawCross = 2;  // 0 - off,  1 - always, 2 - if included in the scheme
@@ -174,14 +178,16 @@ class FarEditor : public LineSource
   std::unique_ptr<LineRegion> cursorRegion;
 
   int visibleLevel = 100;
-  std::chrono::time_point<std::chrono::steady_clock> parseStartTime{};
-  std::chrono::time_point<std::chrono::steady_clock> lastAllDoneTime{};
-  bool backgroundMode{false};
   std::unique_ptr<Outliner> structOutliner;
   std::unique_ptr<Outliner> errorOutliner;
 
-  bool progressParse(int msBudget);
+  void applyFileType(FileType* ftype);
   void reloadTypeSettings();
+  void syncText(int topLine, int bottomLine, int totalLines);
+  std::shared_ptr<const UnicodeString> fetchLine(int lno) const;
+  bool sameLine(int lno, const UnicodeString& line) const;
+  PairMatch* searchVisiblePair(const ParsedLines& parsed, int lineNo, int pos, int startLine,
+                               int endLine) const;
   EditorInfo getEditorInfo() const;
   color convert(const StyledRegion* rd) const;
   bool foreDefault(const color& col) const;
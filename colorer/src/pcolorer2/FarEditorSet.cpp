@@ -698,8 +698,8 @@ void FarEditorSet::onSynchroTick()
     return;
   }
   FarEditor* editor = getCurrentEditor();
-  if (editor && editor->backgroundParseTick()) {
-    colorerRequestSynchro();
+  if (editor) {
+    editor->backgroundParseTick();
   }
 }
 
@@ -975,7 +975,8 @@ void FarEditorSet::disableColorer()
   {
     KeyFileHelper(settingsIni).SetInt(cSectionName, cRegEnabled, Opt.rEnabled);
   }
-  dropCurrentEditor(true);
+  // stops background parsers of all editors before factory goes away
+  dropAllEditors(true);
 
   regionMapper.reset();
   parserFactory.reset();
@@ -1,5 +1,6 @@
 #include "pcolorer.h"
 #include <utils.h>
+#include <atomic>
 #include "CerrLogger.h"
 #include "FarEditorSet.h"
 
@@ -10,7 +11,7 @@ UnicodeString* PluginPath = nullptr;
 
 static bool inEventProcess = false;
 static bool inInputProcess = false;
-static bool isSynchroPending = false;
+static std::atomic<bool> isSynchroPending{false};
 
 std::unique_ptr<CerrLogger> logger;
 
@@ -156,9 +157,10 @@ SHAREDSYMBOL int WINAPI ProcessEditorInputW(const INPUT_RECORD* ir)
 
 void colorerRequestSynchro()
 {
-  if (!isSynchroPending) {
-    isSynchroPending = true;
-    Info.AdvControl(Info.ModuleNumber, ACTL_SYNCHRO, nullptr, (void *)(LONG_PTR)FCTL_SYNCHRO_IDLE);
+  // may be called from background parser threads, so use async variant that
+  // doesn't wait for main thread, otherwise editor closing can't join parser
+  if (!isSynchroPending.exchange(true)) {
+    Info.AdvControlAsync(Info.ModuleNumber, ACTL_SYNCHRO, nullptr, (void *)(LONG_PTR)FCTL_SYNCHRO_IDLE);
   }
 }
 
@@ -8,9 +8,9 @@ extern PluginStartupInfo Info;
 extern FarStandardFunctions FSF;
 extern UnicodeString* PluginPath;
 
-// Requests a synchro event to continue background parsing almost
-// immediately (without waiting for the next KEY_IDLE). Collapses
-// repeated requests until the pending one is delivered.
+// Requests a synchro event, so editor gets repainted once background
+// parser published new regions. Collapses repeated requests until the
+// pending one is delivered, can be called from any thread.
 void colorerRequestSynchro();
 
 /** FAR .lng file identifiers. */
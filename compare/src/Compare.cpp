@@ -2,8 +2,22 @@
 #define _UNICODE
 #include <farplug-wide.h>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <ctype.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <utils.h>
+#include <crc64.h>
+#include <ScopeHelpers.h>
+#include <ThreadedWorkQueue.h>
 #include <KeyFileHelper.h>
 
 #ifndef UNICODE
@@ -54,6 +68,7 @@ enum CompareLng
 	MCompareContentsIgnore,
 	MCompareIgnoreNewLines,
 	MCompareIgnoreWhitespace,
+	MCompareContentsCache,
 	MMessageWhenNoDiff,
 
 	MFilePanelsRequired,
@@ -84,7 +99,7 @@ struct Options
 	int ProcessSubfolders, UseMaxScanDepth, MaxScanDepth, ProcessSelected, ProcessHidden,
 			CompareCaseFileNames, CompareTime,
 			LowPrecisionTime, IgnorePossibleTimeZoneDifferences, CompareSize, CompareContents,
-			CompareContentsIgnore, IgnoreWhitespace, IgnoreNewLines, MessageWhenNoDiff;
+			CompareContentsIgnore, IgnoreWhitespace, IgnoreNewLines, CompareContentsCache, MessageWhenNoDiff;
 } Opt;
 
 /****************************************************************************
@@ -149,7 +164,7 @@ static void TrunCopy(TCHAR *cpDest, const TCHAR *cpSrc)
 }
 
 static bool bStart;
-static bool bOpenFail;
+static std::atomic<bool> bOpenFail{false};
 
 /****************************************************************************
  *
@@ -199,11 +214,15 @@ LONG_PTR WINAPI ShowDialogProc(HANDLE hDlg, int Msg, int Param1, LONG_PTR Param2
 						if (Param1 == CompareContents)
 							Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 3, TRUE);
 					}
+					if (Param1 == CompareContents)
+						Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 4, TRUE);
 				} else {
 					Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 1, FALSE);
 					Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 2, FALSE);
-					if (Param1 == CompareContents)
+					if (Param1 == CompareContents) {
 						Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 3, FALSE);
+						Info.SendDlgMessage(hDlg, DM_ENABLE, Param1 + 4, FALSE);
+					}
 				}
 			}
 			break;
@@ -229,7 +248,7 @@ static bool ShowDialog(bool bPluginPanels, bool bSelectionPresent)
 		unsigned int Flags;
 		int *StoreTo;
 	} InitItems[] = {
-			/* 0*/ {DI_DOUBLEBOX, 3, 1, 62, 21, MCmpTitle, 0, NULL, 0, NULL},
+			/* 0*/ {DI_DOUBLEBOX, 3, 1, 62, 22, MCmpTitle, 0, NULL, 0, NULL},
 			/* 1*/ {DI_TEXT, 5, 2, 0, 0, MProcessBox, 0, NULL, 0, NULL},
 			/* 2*/
 			{DI_CHECKBOX, 5, 3, 0, 0, MProcessSubfolders, 0, ("ProcessSubfolders"), 0,
@@ -263,13 +282,16 @@ static bool ShowDialog(bool bPluginPanels, bool bSelectionPresent)
 			/*16*/
 			{DI_RADIOBUTTON, 13, 16, 0, 0, MCompareIgnoreWhitespace, 0, ("IgnoreWhitespace"), 0,
 					&Opt.IgnoreWhitespace},
-			/*17*/ {DI_TEXT, 0, 17, 0, 0, MNoLngStringDefined, 0, NULL, DIF_SEPARATOR, NULL},
-			/*18*/
-			{DI_CHECKBOX, 5, 18, 0, 0, MMessageWhenNoDiff, 0, ("MessageWhenNoDiff"), 0,
+			/*17*/
+			{DI_CHECKBOX, 9, 17, 0, 0, MCompareContentsCache, 0, ("CompareContentsCache"), 0,
+					&Opt.CompareContentsCache},
+			/*18*/ {DI_TEXT, 0, 18, 0, 0, MNoLngStringDefined, 0, NULL, DIF_SEPARATOR, NULL},
+			/*19*/
+			{DI_CHECKBOX, 5, 19, 0, 0, MMessageWhenNoDiff, 0, ("MessageWhenNoDiff"), 0,
 					&Opt.MessageWhenNoDiff},
-			/*19*/ {DI_TEXT, 0, 19, 0, 0, MNoLngStringDefined, 0, NULL, DIF_SEPARATOR, NULL},
-			/*20*/ {DI_BUTTON, 0, 20, 0, 0, MOK, 0, NULL, DIF_CENTERGROUP, NULL},
-			/*21*/ {DI_BUTTON, 0, 20, 0, 0, MCancel, 0, NULL, DIF_CENTERGROUP, NULL}};
+			/*20*/ {DI_TEXT, 0, 20, 0, 0, MNoLngStringDefined, 0, NULL, DIF_SEPARATOR, NULL},
+			/*21*/ {DI_BUTTON, 0, 21, 0, 0, MOK, 0, NULL, DIF_CENTERGROUP, NULL},
+			/*22*/ {DI_BUTTON, 0, 21, 0, 0, MCancel, 0, NULL, DIF_CENTERGROUP, NULL}};
 	struct FarDialogItem DialogItems[ARRAYSIZE(InitItems)];
 	TCHAR Mask[] = _T("99999");
 #ifdef UNICODE
@@ -320,7 +342,7 @@ static bool ShowDialog(bool bPluginPanels, bool bSelectionPresent)
 	for (size_t i = 0; i < ARRAYSIZE(InitItems); i++) {
 		switch (InitItems[i].Data) {
 			case MCompareContents:
-				ASSERT(i + 3 < ARRAYSIZE(InitItems));
+				ASSERT(i + 4 < ARRAYSIZE(InitItems));
 				DlgData+= i;
 				if (bPluginPanels) {
 					DialogItems[i].Flags|= DIF_DISABLE;
@@ -330,10 +352,12 @@ static bool ShowDialog(bool bPluginPanels, bool bSelectionPresent)
 					DialogItems[i + 1].Flags|= DIF_DISABLE;
 					DialogItems[i + 2].Flags|= DIF_DISABLE;
 					DialogItems[i + 3].Flags|= DIF_DISABLE;
+					DialogItems[i + 4].Flags|= DIF_DISABLE;
 				} else {
 					DialogItems[i + 1].Flags&= ~DIF_DISABLE;
 					DialogItems[i + 2].Flags&= ~DIF_DISABLE;
 					DialogItems[i + 3].Flags&= ~DIF_DISABLE;
+					DialogItems[i + 4].Flags&= ~DIF_DISABLE;
 				}
 				break;
 			case MCompareContentsIgnore:
@@ -397,10 +421,10 @@ static bool ShowDialog(bool bPluginPanels, bool bSelectionPresent)
 	}
 
 #ifndef UNICODE
-	int ExitCode = Info.DialogEx(Info.ModuleNumber, -1, -1, 66, 23, _T("Contents"), DialogItems,
+	int ExitCode = Info.DialogEx(Info.ModuleNumber, -1, -1, 66, 24, _T("Contents"), DialogItems,
 			ARRAYSIZE(DialogItems), 0, 0, ShowDialogProc, DlgData);
 #else
-	HANDLE hDlg = Info.DialogInit(Info.ModuleNumber, -1, -1, 66, 23, _T("Contents"), DialogItems,
+	HANDLE hDlg = Info.DialogInit(Info.ModuleNumber, -1, -1, 66, 24, _T("Contents"), DialogItems,
 			ARRAYSIZE(DialogItems), 0, 0, ShowDialogProc, DlgData);
 	if (hDlg == INVALID_HANDLE_VALUE)
 		return false;
@@ -642,30 +666,502 @@ static void FreeDirList(OwnPanelInfo *AInfo)
 	}
 }
 
+/****************************************************************************
+ * Outcome of comparison of some top-level panel items pair. Contents of files
+ * nested into it are compared asynchronously and found difference is reported
+ * here, so remaining comparisons of same pair can be skipped.
+ ****************************************************************************/
+struct CompareVerdict
+{
+	std::atomic<bool> Differs{false};
+};
+
 static bool
-CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bool bCompareAll, int ScanDepth);
+CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bool bCompareAll, int ScanDepth,
+		const std::shared_ptr<CompareVerdict> &Verdict);
 static DWORD bufSize;
 
 #ifdef UNICODE
 static HANDLE AFilter, PFilter;
 #endif
 
-// TODO:
-//
-static char *ABuf, *PBuf;
+static std::unique_ptr<ThreadedWorkQueue> pContentsQueue;
+static std::atomic<bool> bContentsCancelled{false};
+
+static std::mutex ContentsProgressMutex;
+static std::wstring ContentsProgressA, ContentsProgressP;
 
 bool isnewline(int c)
 {
 	return (c == '\r' || c == '\n');
 }
 
+/****************************************************************************
+ *
+ ****************************************************************************/
+static bool ReadBlock(int fd, char *Buf, DWORD Size, DWORD &ReadSize)
+{
+	ReadSize = 0;
+	while (ReadSize < Size) {
+		const ssize_t r = read(fd, Buf + ReadSize, Size - ReadSize);
+		if (r == 0)
+			break;
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		ReadSize+= (DWORD)r;
+	}
+	return true;
+}
+
+/****************************************************************************
+ * Digests of files contents remembered between comparisons, entry is valid
+ * while file's size, modification time and inode remain same.
+ ****************************************************************************/
+struct ContentsDigest
+{
+	uint64_t Crc{0};
+	uint64_t Mix{0};
+
+	bool operator==(const ContentsDigest &other) const { return Crc == other.Crc && Mix == other.Mix; }
+};
+
+class ContentsDigestsCache
+{
+	struct Entry
+	{
+		uint64_t Size, MTimeSec, MTimeNSec, Inode;
+		ContentsDigest Digest;
+		bool Used;
+	};
+
+	static constexpr const char *Signature = "CMPDGST1";
+	static constexpr size_t MaxUnusedEntries = 0x40000;
+
+	std::mutex _mtx;
+	std::unordered_map<std::string, Entry> _entries;
+	bool _modified{false};
+
+	static bool Matches(const Entry &e, const struct stat &s)
+	{
+		return e.Size == (uint64_t)s.st_size && e.MTimeSec == (uint64_t)s.st_mtim.tv_sec
+				&& e.MTimeNSec == (uint64_t)s.st_mtim.tv_nsec && e.Inode == (uint64_t)s.st_ino;
+	}
+
+	template <class T>
+	static bool Fetch(const std::string &data, size_t &pos, T &v)
+	{
+		if (data.size() - pos < sizeof(v))
+			return false;
+		memcpy(&v, data.data() + pos, sizeof(v));
+		pos+= sizeof(v);
+		return true;
+	}
+
+	template <class T>
+	static void Put(std::string &data, const T &v)
+	{
+		data.append((const char *)&v, sizeof(v));
+	}
+
+public:
+	ContentsDigestsCache()
+	{
+		std::string data;
+		if (!ReadWholeFile(InMyCache("compare/digests").c_str(), data)
+				|| data.compare(0, strlen(Signature), Signature) != 0)
+			return;
+
+		size_t pos = strlen(Signature);
+		for (;;) {
+			uint32_t path_len;
+			Entry e{};
+			if (!Fetch(data, pos, path_len) || data.size() - pos < path_len)
+				break;
+			std::string path = data.substr(pos, path_len);
+			pos+= path_len;
+			if (!Fetch(data, pos, e.Size) || !Fetch(data, pos, e.MTimeSec) || !Fetch(data, pos, e.MTimeNSec)
+					|| !Fetch(data, pos, e.Inode) || !Fetch(data, pos, e.Digest.Crc)
+					|| !Fetch(data, pos, e.Digest.Mix))
+				break;
+			_entries[std::move(path)] = e;
+		}
+	}
+
+	~ContentsDigestsCache()
+	{
+		if (!_modified)
+			return;
+
+		// Forget digests of files not met recently if cache grew too much
+		if (_entries.size() > MaxUnusedEntries) {
+			for (auto it = _entries.begin(); it != _entries.end();) {
+				if (it->second.Used)
+					++it;
+				else
+					it = _entries.erase(it);
+			}
+		}
+
+		std::string data(Signature);
+		for (const auto &it : _entries) {
+			Put(data, (uint32_t)it.first.size());
+			data+= it.first;
+			Put(data, it.second.Size);
+			Put(data, it.second.MTimeSec);
+			Put(data, it.second.MTimeNSec);
+			Put(data, it.second.Inode);
+			Put(data, it.second.Digest.Crc);
+			Put(data, it.second.Digest.Mix);
+		}
+		const std::string &path = InMyCache("compare/digests");
+		const std::string &tmp_path = path + "." + std::to_string(getpid()) + ".tmp";
+		if (!WriteWholeFile(tmp_path.c_str(), data) || rename(tmp_path.c_str(), path.c_str()) == -1) {
+			fprintf(stderr, "Compare: failed to save digests cache, errno=%d\n", errno);
+			unlink(tmp_path.c_str());
+		}
+	}
+
+	bool Lookup(const std::string &path, const struct stat &s, ContentsDigest &digest)
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		auto it = _entries.find(path);
+		if (it == _entries.end() || !Matches(it->second, s))
+			return false;
+		it->second.Used = true;
+		digest = it->second.Digest;
+		return true;
+	}
+
+	void Store(const std::string &path, const struct stat &s, const ContentsDigest &digest)
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_entries[path] = Entry{(uint64_t)s.st_size, (uint64_t)s.st_mtim.tv_sec, (uint64_t)s.st_mtim.tv_nsec,
+				(uint64_t)s.st_ino, digest, true};
+		_modified = true;
+	}
+};
+
+static std::unique_ptr<ContentsDigestsCache> pDigestsCache;
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+static bool ComputeDigest(int fd, ContentsDigest &Digest)
+{
+	static constexpr DWORD DigestBlock = 0x40000;	// multiple of 8
+	std::unique_ptr<char[]> Buf(new char[DigestBlock]);
+	Digest = ContentsDigest();
+	DWORD ReadSize;
+	do {
+		if (bContentsCancelled || !ReadBlock(fd, Buf.get(), DigestBlock, ReadSize))
+			return false;
+
+		Digest.Crc = crc64(Digest.Crc, (const unsigned char *)Buf.get(), ReadSize);
+		for (DWORD i = 0; i < ReadSize; i+= sizeof(uint64_t)) {
+			uint64_t w = 0;
+			memcpy(&w, Buf.get() + i, std::min((DWORD)sizeof(w), ReadSize - i));
+			Digest.Mix = (Digest.Mix ^ w) * 0x9e3779b97f4a7c15ULL;
+			Digest.Mix^= Digest.Mix >> 32;
+		}
+	} while (ReadSize == DigestBlock);
+
+	return true;
+}
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+static bool CompareByDigests(int fdA, int fdP, const std::string &PathA, const std::string &PathP,
+		const struct stat &sA, const struct stat &sP)
+{
+	ContentsDigest DigestA, DigestP;
+	if (!pDigestsCache->Lookup(PathA, sA, DigestA)) {
+		if (!ComputeDigest(fdA, DigestA))
+			return false;
+		pDigestsCache->Store(PathA, sA, DigestA);
+	}
+	if (!pDigestsCache->Lookup(PathP, sP, DigestP)) {
+		if (!ComputeDigest(fdP, DigestP))
+			return false;
+		pDigestsCache->Store(PathP, sP, DigestP);
+	}
+	return DigestA == DigestP;
+}
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+static bool ReadBlockAt(int fd, char *Buf, size_t Size, uint64_t Pos, size_t &ReadSize)
+{
+	ReadSize = 0;
+	while (ReadSize < Size) {
+		const ssize_t r = pread(fd, Buf + ReadSize, Size - ReadSize, (off_t)(Pos + ReadSize));
+		if (r == 0)
+			break;
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		ReadSize+= (size_t)r;
+	}
+	return true;
+}
+
+/****************************************************************************
+ * Files that differ usually do that early, so first block is small and only
+ * then remaining contents of big files are read by large blocks. Files are
+ * read rather than mapped: mapping of file truncated meanwhile raises SIGBUS.
+ ****************************************************************************/
+static bool CompareExactContents(int fdA, int fdP, uint64_t Size)
+{
+	static constexpr size_t LargeBlock = 0x400000;
+	static constexpr size_t CancelCheckStep = 0x100000;
+
+	const size_t Alignment = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t BlockSize = (Size > bufSize) ? LargeBlock : (size_t)bufSize;
+	void *RawA = nullptr, *RawP = nullptr;
+	if (posix_memalign(&RawA, Alignment, BlockSize) != 0 || posix_memalign(&RawP, Alignment, BlockSize) != 0) {
+		free(RawA);
+		return false;
+	}
+	std::unique_ptr<char, void (*)(void *)> ABuf((char *)RawA, free), PBuf((char *)RawP, free);
+
+	uint64_t Pos = 0;
+	while (Pos < Size) {
+		if (bContentsCancelled)
+			return false;
+
+		const size_t Len = (size_t)std::min(Size - Pos, (uint64_t)(Pos ? BlockSize : bufSize));
+		size_t ReadSizeA, ReadSizeP;
+		if (!ReadBlockAt(fdA, ABuf.get(), Len, Pos, ReadSizeA)
+				|| !ReadBlockAt(fdP, PBuf.get(), Len, Pos, ReadSizeP) || ReadSizeA != ReadSizeP)
+			return false;
+		for (size_t Ofs = 0; Ofs < ReadSizeA; Ofs+= CancelCheckStep) {
+			if (bContentsCancelled
+					|| memcmp(ABuf.get() + Ofs, PBuf.get() + Ofs, std::min(CancelCheckStep, ReadSizeA - Ofs)) != 0)
+				return false;
+		}
+		if (!ReadSizeA)	// truncated meanwhile
+			break;
+		Pos+= ReadSizeA;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+static bool CompareContentsIgnoring(int fdA, int fdP)
+{
+	std::unique_ptr<char[]> ABufHolder(new char[bufSize]), PBufHolder(new char[bufSize]);
+	char *ABuf = ABufHolder.get(), *PBuf = PBufHolder.get();
+	bool bEqual = true;
+	DWORD ReadSizeA = 1, ReadSizeP = 1;
+	char *PtrA = ABuf + ReadSizeA, *PtrP = PBuf + ReadSizeP;
+	bool bExpectNewLineA = false;
+	bool bExpectNewLineP = false;
+	while (true) {
+		while (PtrA >= ABuf + ReadSizeA && ReadSizeA) {
+			if (bContentsCancelled || !ReadBlock(fdA, ABuf, bufSize, ReadSizeA)) {
+				bEqual = false;
+				break;
+			}
+			PtrA = ABuf;
+		}
+
+		if (!bEqual)
+			break;
+
+		while (PtrP >= PBuf + ReadSizeP && ReadSizeP) {
+			if (bContentsCancelled || !ReadBlock(fdP, PBuf, bufSize, ReadSizeP)) {
+				bEqual = false;
+				break;
+			}
+			PtrP = PBuf;
+		}
+
+		if (!bEqual || (!ReadSizeP && !ReadSizeA))
+			break;
+
+		if (Opt.IgnoreWhitespace) {
+			while (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP && !isspace(*PtrA)
+					&& !isspace(*PtrP)) {
+				if (*PtrA != *PtrP) {
+					bEqual = false;
+					break;
+				}
+				++PtrA;
+				++PtrP;
+			}
+
+			if (!bEqual)
+				break;
+
+			while (PtrA < ABuf + ReadSizeA && isspace(*PtrA))
+				++PtrA;
+
+			while (PtrP < PBuf + ReadSizeP && isspace(*PtrP))
+				++PtrP;
+		} else {
+			if (bExpectNewLineA) {
+				bExpectNewLineA = false;
+				if (PtrA < ABuf + ReadSizeA && *PtrA == '\n')
+					++PtrA;
+			}
+
+			if (bExpectNewLineP) {
+				bExpectNewLineP = false;
+				if (PtrP < PBuf + ReadSizeP && *PtrP == '\n')
+					++PtrP;
+			}
+
+			while (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP && !isnewline(*PtrA)
+					&& !isnewline(*PtrP)) {
+				if (*PtrA != *PtrP) {
+					bEqual = false;
+					break;
+				}
+				++PtrA;
+				++PtrP;
+			}
+
+			if (!bEqual)
+				break;
+
+			if (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP
+					&& (!isnewline(*PtrA) || !isnewline(*PtrP))) {
+				bEqual = false;
+				break;
+			}
+
+			if (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP) {
+				if (*PtrA == '\r')
+					bExpectNewLineA = true;
+
+				if (*PtrP == '\r')
+					bExpectNewLineP = true;
+
+				++PtrA;
+				++PtrP;
+			}
+		}
+
+		if (PtrA < ABuf + ReadSizeA && !ReadSizeP) {
+			bEqual = false;
+			break;
+		}
+
+		if (PtrP < PBuf + ReadSizeP && !ReadSizeA) {
+			bEqual = false;
+			break;
+		}
+	}
+
+	return bEqual;
+}
+
+/****************************************************************************
+ * Invoked from worker threads of pContentsQueue
+ ****************************************************************************/
+static bool CompareFilesContents(const std::wstring &FileA, const std::wstring &FileP)
+{
+	const std::string &PathA = Wide2MB(FileA.c_str()), &PathP = Wide2MB(FileP.c_str());
+	FDScope fdA(PathA.c_str(), O_RDONLY | O_CLOEXEC);
+	if (!fdA.Valid()) {
+		bOpenFail = true;
+		return false;
+	}
+	FDScope fdP(PathP.c_str(), O_RDONLY | O_CLOEXEC);
+	if (!fdP.Valid()) {
+		bOpenFail = true;
+		return false;
+	}
+
+	if (Opt.CompareContentsIgnore)
+		return CompareContentsIgnoring(fdA, fdP);
+
+	struct stat sA{}, sP{};
+	if (fstat(fdA, &sA) == -1 || fstat(fdP, &sP) == -1 || sA.st_size != sP.st_size)
+		return false;
+
+	if (sA.st_dev == sP.st_dev && sA.st_ino == sP.st_ino)
+		return true;
+
+	if (pDigestsCache)
+		return CompareByDigests(fdA, fdP, PathA, PathP, sA, sP);
+
+	posix_fadvise(fdA, 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fdP, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return CompareExactContents(fdA, fdP, (uint64_t)sA.st_size);
+}
+
+struct ContentsCompareItem : IThreadedWorkItem
+{
+	std::shared_ptr<CompareVerdict> Verdict;
+	std::wstring FileA, FileP;
+
+	virtual void WorkProc()
+	{
+		if (bContentsCancelled || Verdict->Differs)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(ContentsProgressMutex);
+			ContentsProgressA = FileA;
+			ContentsProgressP = FileP;
+		}
+
+		if (!CompareFilesContents(FileA, FileP))
+			Verdict->Differs = true;
+	}
+};
+
+/****************************************************************************
+ *
+ ****************************************************************************/
+static void ShowContentsProgress()
+{
+	std::wstring FileA, FileP;
+	{
+		std::lock_guard<std::mutex> lock(ContentsProgressMutex);
+		FileA = ContentsProgressA;
+		FileP = ContentsProgressP;
+	}
+	if (!FileA.empty())
+		ShowMessage(FileA.c_str(), FileP.c_str());
+}
+
+/****************************************************************************
+ * Waits for all queued contents comparisons to complete while keeping
+ * progress message updated and checking for user's interruption request
+ ****************************************************************************/
+static void WaitContentsComparisons()
+{
+	if (!pContentsQueue)
+		return;
+
+	while (!pContentsQueue->Finalize(100)) {
+		if (bBrokenByEsc || CheckForEsc()) {
+			bContentsCancelled = true;
+			pContentsQueue->Finalize();
+			break;
+		}
+		ShowContentsProgress();
+	}
+}
+
 /****************************************************************************
  *
  *
  *
  ****************************************************************************/
 static bool CompareFiles(const FAR_FIND_DATA *AData, const FAR_FIND_DATA *PData, const TCHAR *ACurDir,
-		const TCHAR *PCurDir, int ScanDepth)
+		const TCHAR *PCurDir, int ScanDepth, const std::shared_ptr<CompareVerdict> &Verdict)
 {
 	if (AData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
 		//
@@ -682,7 +1178,7 @@ static bool CompareFiles(const FAR_FIND_DATA *AData, const FAR_FIND_DATA *PData,
 				bBrokenByEsc = true;	//
 				bEqual = false;			//
 			} else
-				bEqual = CompareDirs(&AInfo, &PInfo, false, ScanDepth + 1);
+				bEqual = CompareDirs(&AInfo, &PInfo, false, ScanDepth + 1, Verdict);
 			FreeDirList(&AInfo);
 			FreeDirList(&PInfo);
 			return bEqual;
@@ -759,143 +1255,13 @@ static bool CompareFiles(const FAR_FIND_DATA *AData, const FAR_FIND_DATA *PData,
 					|| AData->ftLastWriteTime.dwHighDateTime != PData->ftLastWriteTime.dwHighDateTime)
 				return false;
 		}
-		if (Opt.CompareContents) {
-			HANDLE hFileA, hFileP;
-			TCHAR cpFileA[MAX_PATH], cpFileP[MAX_PATH];
-			ShowMessage(lstrcpy(cpFileA, BuildFullFilename(ACurDir, AData->_cFileName)),
-					lstrcpy(cpFileP, BuildFullFilename(PCurDir, PData->_cFileName)));
-			if ((hFileA = CreateFile(cpFileA, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
-							FILE_FLAG_SEQUENTIAL_SCAN, NULL))
-					== INVALID_HANDLE_VALUE) {
-				bOpenFail = true;
-				return false;
-			}
-			if ((hFileP = CreateFile(cpFileP, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
-							FILE_FLAG_SEQUENTIAL_SCAN, NULL))
-					== INVALID_HANDLE_VALUE) {
-				CloseHandle(hFileA);
-				bOpenFail = true;
-				return false;
-			}
-
-			bool bEqual = true;
-			DWORD ReadSizeA, ReadSizeP;
-			if (!Opt.CompareContentsIgnore) {
-				do {
-					if (CheckForEsc() || !ReadFile(hFileA, ABuf, bufSize, &ReadSizeA, NULL)
-							|| !ReadFile(hFileP, PBuf, bufSize, &ReadSizeP, NULL) || ReadSizeA != ReadSizeP
-							|| memcmp(ABuf, PBuf, ReadSizeA)) {
-						bEqual = false;
-						break;
-					}
-				} while (ReadSizeA == bufSize);
-			} else {
-				ReadSizeA = 1;
-				ReadSizeP = 1;
-				char *PtrA = ABuf + ReadSizeA, *PtrP = PBuf + ReadSizeP;
-				bool bExpectNewLineA = false;
-				bool bExpectNewLineP = false;
-				while (true) {
-					while (PtrA >= ABuf + ReadSizeA && ReadSizeA) {
-						if (CheckForEsc() || !ReadFile(hFileA, ABuf, bufSize, &ReadSizeA, NULL)) {
-							bEqual = false;
-							break;
-						}
-						PtrA = ABuf;
-					}
-
-					if (!bEqual)
-						break;
-
-					while (PtrP >= PBuf + ReadSizeP && ReadSizeP) {
-						if (CheckForEsc() || !ReadFile(hFileP, PBuf, bufSize, &ReadSizeP, NULL)) {
-							bEqual = false;
-							break;
-						}
-						PtrP = PBuf;
-					}
-
-					if (!bEqual || (!ReadSizeP && !ReadSizeA))
-						break;
-
-					if (Opt.IgnoreWhitespace) {
-						while (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP && !isspace(*PtrA)
-								&& !isspace(*PtrP)) {
-							if (*PtrA != *PtrP) {
-								bEqual = false;
-								break;
-							}
-							++PtrA;
-							++PtrP;
-						}
-
-						if (!bEqual)
-							break;
-
-						while (PtrA < ABuf + ReadSizeA && isspace(*PtrA))
-							++PtrA;
-
-						while (PtrP < PBuf + ReadSizeP && isspace(*PtrP))
-							++PtrP;
-					} else {
-						if (bExpectNewLineA) {
-							bExpectNewLineA = false;
-							if (PtrA < ABuf + ReadSizeA && *PtrA == '\n')
-								++PtrA;
-						}
-
-						if (bExpectNewLineP) {
-							bExpectNewLineP = false;
-							if (PtrP < PBuf + ReadSizeP && *PtrP == '\n')
-								++PtrP;
-						}
-
-						while (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP && !isnewline(*PtrA)
-								&& !isnewline(*PtrP)) {
-							if (*PtrA != *PtrP) {
-								bEqual = false;
-								break;
-							}
-							++PtrA;
-							++PtrP;
-						}
-
-						if (!bEqual)
-							break;
-
-						if (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP
-								&& (!isnewline(*PtrA) || !isnewline(*PtrP))) {
-							bEqual = false;
-							break;
-						}
-
-						if (PtrA < ABuf + ReadSizeA && PtrP < PBuf + ReadSizeP) {
-							if (*PtrA == '\r')
-								bExpectNewLineA = true;
-
-							if (*PtrP == '\r')
-								bExpectNewLineP = true;
-
-							++PtrA;
-							++PtrP;
-						}
-					}
-
-					if (PtrA < ABuf + ReadSizeA && !ReadSizeP) {
-						bEqual = false;
-						break;
-					}
-
-					if (PtrP < PBuf + ReadSizeP && !ReadSizeA) {
-						bEqual = false;
-						break;
-					}
-				}
-			}
-
-			CloseHandle(hFileA);
-			CloseHandle(hFileP);
-			return bEqual;
+		if (Opt.CompareContents && pContentsQueue) {
+			ContentsCompareItem *Item = new ContentsCompareItem;
+			Item->Verdict = Verdict;
+			Item->FileA = BuildFullFilename(ACurDir, AData->_cFileName);
+			Item->FileP = BuildFullFilename(PCurDir, PData->_cFileName);
+			ShowContentsProgress();
+			pContentsQueue->Queue(Item, (size_t)-2);	// don't block here, Esc is checked while scanning
 		}
 	}
 	return true;
@@ -908,7 +1274,8 @@ static bool CompareFiles(const FAR_FIND_DATA *AData, const FAR_FIND_DATA *PData,
  *
  *
  ****************************************************************************/
-static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bool bCompareAll, int ScanDepth)
+static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bool bCompareAll, int ScanDepth,
+		const std::shared_ptr<CompareVerdict> &Verdict)
 {
 #ifndef _UNICODE
 #define _CurDir CurDir
@@ -933,9 +1300,16 @@ static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bo
 		FreePanelIndex(&sfiP);
 		return true;
 	}
+	struct PendingVerdict
+	{
+		std::shared_ptr<CompareVerdict> Verdict;
+		PluginPanelItem *ppiA, *ppiP;
+	};
+	std::vector<PendingVerdict> PendingVerdicts;
 	bool bDifferenceNotFound = true;
 	int i = sfiA.iCount - 1, j = sfiP.iCount - 1;
-	while (i >= 0 && j >= 0 && (bDifferenceNotFound || bCompareAll) && !bBrokenByEsc) {
+	while (i >= 0 && j >= 0 && (bDifferenceNotFound || bCompareAll) && !bBrokenByEsc
+			&& !(Verdict && Verdict->Differs)) {
 		const int iMaxCounter = 256;
 		static int iCounter = iMaxCounter;
 		if (!--iCounter) {
@@ -944,9 +1318,15 @@ static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bo
 				break;
 		}
 		switch (PICompare(&sfiA.ppi[i], &sfiP.ppi[j])) {
-			case 0:							//
+			case 0:	//
+			{
+				// nested items share verdict of top-level item that contains them
+				const std::shared_ptr<CompareVerdict> &ItemVerdict =
+						Verdict ? Verdict : std::make_shared<CompareVerdict>();
 				if (CompareFiles(&sfiA.ppi[i]->FindData, &sfiP.ppi[j]->FindData, AInfo->_CurDir, PInfo->_CurDir,
-							ScanDepth)) {	//
+							ScanDepth, ItemVerdict)) {	//
+					if (!Verdict && pContentsQueue)
+						PendingVerdicts.emplace_back(PendingVerdict{ItemVerdict, sfiA.ppi[i], sfiP.ppi[j]});
 					sfiA.ppi[i--]->Flags&= ~PPIF_SELECTED;
 					sfiP.ppi[j--]->Flags&= ~PPIF_SELECTED;
 				} else {
@@ -955,6 +1335,7 @@ static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bo
 					sfiP.ppi[j--]->Flags|= PPIF_SELECTED;
 				}
 				break;
+			}
 			case 1:		//
 				bDifferenceNotFound = false;
 				sfiA.ppi[i--]->Flags|= PPIF_SELECTED;
@@ -965,7 +1346,16 @@ static bool CompareDirs(const OwnPanelInfo *AInfo, const OwnPanelInfo *PInfo, bo
 				break;
 		}
 	}
+	if (!Verdict)
+		WaitContentsComparisons();
 	if (!bBrokenByEsc) {
+		for (const auto &Pending : PendingVerdicts) {
+			if (Pending.Verdict->Differs) {
+				bDifferenceNotFound = false;
+				Pending.ppiA->Flags|= PPIF_SELECTED;
+				Pending.ppiP->Flags|= PPIF_SELECTED;
+			}
+		}
 		//
 		if (i >= 0) {
 			bDifferenceNotFound = false;
@@ -1195,18 +1585,24 @@ SHAREDSYMBOL HANDLE WINAPI EXP_NAME(OpenPlugin)(int OpenFrom, INT_PTR Item)
 
 	//
 
-	bufSize = KeyFileReadSection(INI_LOCATION, INI_SECTION).GetInt("CompareBufferSize", 32768);
-	if (bufSize > 32768)
+	KeyFileReadSection kfh(INI_LOCATION, INI_SECTION);
+	bufSize = kfh.GetInt("CompareBufferSize", 32768);
+	if (bufSize > 32768 || bufSize == 0)
 		bufSize = 32768;
 
-	ABuf = (char *)malloc(bufSize);
-	PBuf = (char *)malloc(bufSize);
-
 	bBrokenByEsc = false;
+	bContentsCancelled = false;
 	bStart = true;
 	bOpenFail = false;
 	bool bDifferenceNotFound = false;
 
+	if (Opt.CompareContents) {
+		// 0 means to use as many threads as there are CPUs
+		pContentsQueue.reset(new ThreadedWorkQueue(kfh.GetInt("CompareThreads", 0)));
+		if (Opt.CompareContentsCache && !Opt.CompareContentsIgnore)
+			pDigestsCache.reset(new ContentsDigestsCache);
+	}
+
 #ifdef UNICODE
 	AFilter = INVALID_HANDLE_VALUE;
 	PFilter = INVALID_HANDLE_VALUE;
@@ -1219,21 +1615,23 @@ SHAREDSYMBOL HANDLE WINAPI EXP_NAME(OpenPlugin)(int OpenFrom, INT_PTR Item)
 #endif
 
 	//
-	if (ABuf && PBuf
 #ifdef UNICODE
-			&& AFilter != INVALID_HANDLE_VALUE && PFilter != INVALID_HANDLE_VALUE
+	if (AFilter != INVALID_HANDLE_VALUE && PFilter != INVALID_HANDLE_VALUE)
 #endif
-	) {
-		bDifferenceNotFound = CompareDirs(&AInfo, &PInfo, true, 0);
+	{
+		bDifferenceNotFound = CompareDirs(&AInfo, &PInfo, true, 0, nullptr);
 	}
 
+	pContentsQueue.reset();
+	pDigestsCache.reset();
+	ContentsProgressA.clear();
+	ContentsProgressP.clear();
+
 #ifdef UNICODE
 	Info.FileFilterControl(AFilter, FFCTL_FREEFILEFILTER, 0, 0);
 	Info.FileFilterControl(PFilter, FFCTL_FREEFILEFILTER, 0, 0);
 #endif
 
-	free(ABuf);
-	free(PBuf);
 	Info.RestoreScreen(hScreen);
 
 	//
@@ -2289,6 +2289,8 @@ enum PLUGIN_FLAGS
 	PF_VIEWER         = 0x0008,
 	PF_FULLCMDLINE    = 0x0010,
 	PF_DIALOG         = 0x0020,
+	PF_THREADSAFE     = 0x0040, // OpenFilePlugin, GetOpenPluginInfo, Get/FreeFindData, SetDirectory, GetFiles and ClosePlugin
+	                            // may be invoked from different threads at same time, each thread uses own plugin handle
 	PF_PREOPEN        = 0x8000 // early dlopen plugin but initialize it later, when it will be really needed
 };
 
@@ -3,6 +3,7 @@
 #include <KeyFileHelper.h>
 #include "plugins.hpp"
 #include "interf.hpp"
+#include "keyboard.hpp"
 #include "clipboard.hpp"
 #include "pathmix.hpp"
 #include "vmenu.hpp"
@@ -150,6 +151,13 @@ void FarAbout(PluginManager &Plugins)
 	//fs = L"           PID: " + fs2;
 	fs.Format(L"                    PID: %lu", (unsigned long)getpid());
 	ListAbout.AddItem(fs); fs2copy += "\n" + fs;
+	{
+		unsigned long long IdleWakeups;
+		double IdleWakeupsPerSecond;
+		GetIdleWakeupsStats(IdleWakeups, IdleWakeupsPerSecond);
+		fs.Format(L"           Idle wakeups: %llu total, %.2f per second", IdleWakeups, IdleWakeupsPerSecond);
+		ListAbout.AddItem(fs); fs2copy += "\n" + fs;
+	}
 
 	//apiGetEnvironmentVariable("FARLANG", fs2);
 	fs =      L"  Main | Help languages: " + Opt.strLanguage + L" | " + Opt.strHelpLanguage;
@@ -102,6 +102,101 @@ static int LastShiftEnterPressed = FALSE;
 static auto was_repeat = false;
 static auto last_pressed_keycode = static_cast<WORD>(-1);
 
+// Input loop sleeps until nearest deadline of things it does on its own (like KEY_IDLE
+// delivery, clock, panels update etc) or until console input arrives. Everything else that
+// needs main thread attention must wake it up by writing NOOP_EVENT, see KickInputWaiter.
+#define IDLE_FIRST_DELAY_MSEC     30
+#define IDLE_REPEAT_DELAY_MSEC    500
+#define IDLE_WAIT_MAX_MSEC        60000
+#define PANELS_UPDATE_KEY_PAUSE   700
+
+static struct InputWakeupsStats
+{
+	std::mutex Mtx;
+	unsigned long long Total = 0, Window = 0;
+	clock_t WindowStart = 0;
+	double LastRate = 0;
+} s_input_wakeups;
+
+static void AccountIdleWakeup(clock_t Now)
+{
+	std::lock_guard<std::mutex> lock(s_input_wakeups.Mtx);
+	++s_input_wakeups.Total;
+	++s_input_wakeups.Window;
+	if (Now - s_input_wakeups.WindowStart >= 10000) {
+		if (s_input_wakeups.WindowStart) {
+			s_input_wakeups.LastRate = double(s_input_wakeups.Window) * 1000 / (Now - s_input_wakeups.WindowStart);
+		}
+		s_input_wakeups.Window = 0;
+		s_input_wakeups.WindowStart = Now;
+	}
+}
+
+void GetIdleWakeupsStats(unsigned long long &Total, double &PerSecond)
+{
+	const clock_t Now = GetProcessUptimeMSec();
+	std::lock_guard<std::mutex> lock(s_input_wakeups.Mtx);
+	Total = s_input_wakeups.Total;
+	PerSecond = s_input_wakeups.LastRate;
+	if (s_input_wakeups.WindowStart && Now - s_input_wakeups.WindowStart >= 10000) {
+		// no wakeups during whole last window - so its rate is what was counted so far
+		PerSecond = double(s_input_wakeups.Window) * 1000 / (Now - s_input_wakeups.WindowStart);
+	}
+}
+
+void KickInputWaiter()
+{
+	// write some dummy console input to kick pending WaitConsoleInput/ReadConsoleInput
+	INPUT_RECORD ir = {};
+	ir.EventType = NOOP_EVENT;
+	DWORD dw = 0;
+	WINPORT(WriteConsoleInput)(0, &ir, 1, &dw);
+}
+
+static DWORD IdleWaitTimeout(clock_t CurTime, clock_t IdleDue, bool EnableShowTime)
+{
+	DWORD Out = IDLE_WAIT_MAX_MSEC;
+	auto Until = [&](clock_t Deadline) {
+		if (Deadline <= CurTime) {
+			Out = 0;
+		} else if (clock_t(Out) > Deadline - CurTime) {
+			Out = DWORD(Deadline - CurTime);
+		}
+	};
+
+	if (!WaitInMainLoop) {
+		Until(IdleDue);
+	}
+
+	if (EnableShowTime) { // clock shows only minutes, so wake on next minute
+		SYSTEMTIME tm;
+		WINPORT(GetLocalTime)(&tm);
+		Until(CurTime + (60 - tm.wSecond) * 1000 - tm.wMilliseconds + 10);
+	}
+
+	if (Opt.ScreenSaver && Opt.ScreenSaverTime > 0) {
+		Until(StartIdleTime + Opt.ScreenSaverTime * 60000 + 1);
+	}
+
+	if (WaitInMainLoop) {
+		if (Opt.InactivityExit && Opt.InactivityExitTime > 0) {
+			Until(StartIdleTime + Opt.InactivityExitTime * 60000 + 1);
+		}
+
+		if (CtrlObject && CtrlObject->Cp()) {
+			for (Panel *p : {CtrlObject->Cp()->LeftPanel, CtrlObject->Cp()->RightPanel}) {
+				const DWORD PanelTimeout = p ? p->UpdateIfChangedTimeout() : INFINITE;
+				if (PanelTimeout != INFINITE) {
+					Until(std::max(CurTime + clock_t(PanelTimeout),
+						KeyPressedLastTime + PANELS_UPDATE_KEY_PAUSE + 1));
+				}
+			}
+		}
+	}
+
+	return Out;
+}
+
 bool IsRepeatedKey()
 {
 	return was_repeat;
@@ -513,6 +608,12 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 {
 	_KEYMACRO(CleverSysLog Clev(L"GetInputRecord()"));
 	static int LastEventIdle = FALSE;
+	// NOOP wakeups (KickInputWaiter, processed synchro) are not user activity,
+	// so they must not restart idle timers of the next call
+	static bool LastEventWakeup = false;
+	static clock_t IdleDue = 0;
+	const bool ResumeIdle = LastEventWakeup;
+	LastEventWakeup = false;
 	DWORD CalcKey;
 	int NotMacros = FALSE;
 	static int LastMsClickMacroKey = 0;
@@ -624,13 +725,19 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 
 	ScrBuf.Flush();
 
-	if (!LastEventIdle)
-		StartIdleTime = GetProcessUptimeMSec();
+	if (!ResumeIdle) {
+		if (!LastEventIdle)
+			StartIdleTime = GetProcessUptimeMSec();
 
-	LastEventIdle = FALSE;
+		// if nothing happened since previous KEY_IDLE then next one comes not so fast
+		IdleDue = GetProcessUptimeMSec()
+			+ (LastEventIdle ? IDLE_REPEAT_DELAY_MSEC : IDLE_FIRST_DELAY_MSEC);
+
+		LastEventIdle = FALSE;
+	}
 	SetFarConsoleMode();
 
-	for (DWORD LoopCount = 0;;) {
+	for (;;) {
 		/*
 			$ 26.04.2001 VVM
 			! Убрал подмену колесика
@@ -723,13 +830,10 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 
 		ScrBuf.Flush();
 
-		static DWORD sLastIdleWaitConsoleInput = 0;
-		DWORD WaitConsoleInputTmout = (sLastIdleWaitConsoleInput < 5) ? 10 : 160;
+		const DWORD WaitConsoleInputTmout = IdleWaitTimeout(GetProcessUptimeMSec(), IdleDue, EnableShowTime);
 //		fprintf(stderr, " WaitConsoleInputTmout=%u\n", WaitConsoleInputTmout);
-		if (WINPORT(WaitConsoleInput)(NULL, WaitConsoleInputTmout)) {
-			sLastIdleWaitConsoleInput = 0;
-		} else {
-			++sLastIdleWaitConsoleInput;
+		if (!WINPORT(WaitConsoleInput)(NULL, WaitConsoleInputTmout) && WaitConsoleInputTmout != 0) {
+			AccountIdleWakeup(GetProcessUptimeMSec());
 		}
 
 		// Позволяет избежать ситуации блокирования мыши
@@ -760,7 +864,7 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 			if (CheckForInactivityExit())
 				return (KEY_NONE);
 
-			if (!(LoopCount & 3)) {
+			{
 				static int Reenter = 0;
 
 				if (!Reenter) {
@@ -788,7 +892,7 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 
 				static int UpdateReenter = 0;
 
-				if (!UpdateReenter && CurTime - KeyPressedLastTime > 700) {
+				if (!UpdateReenter && CurTime - KeyPressedLastTime > PANELS_UPDATE_KEY_PAUSE) {
 					UpdateReenter = TRUE;
 					CtrlObject->Cp()->LeftPanel->UpdateIfChanged(UIC_UPDATE_NORMAL);
 					CtrlObject->Cp()->RightPanel->UpdateIfChanged(UIC_UPDATE_NORMAL);
@@ -803,7 +907,7 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 				return (KEY_NONE);
 		}
 
-		if (!WaitInMainLoop && LoopCount == 3) {
+		if (!WaitInMainLoop && CurTime >= IdleDue) {
 			LastEventIdle = TRUE;
 			ZeroFill(*rec);
 			rec->EventType = KEY_EVENT;
@@ -813,10 +917,9 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 
 		if (AllowSynchro && PluginSynchroManager.Process(false)) {
 			memset(rec, 0, sizeof(*rec));
+			LastEventWakeup = true;
 			return KEY_NONE;
 		}
-
-		LoopCount++;
 	}	// while (1)
 
 	if (rec->EventType == BRACKETED_PASTE_EVENT) {
@@ -871,6 +974,7 @@ static DWORD GetInputRecordInner(INPUT_RECORD *rec, bool ExcludeMacro, bool Proc
 		Console.ReadInput(*rec);
 		memset(rec, 0, sizeof(*rec));
 		rec->EventType = KEY_EVENT;
+		LastEventWakeup = true;
 		return KEY_NONE;
 	}
 
@@ -82,3 +82,5 @@ bool CheckForEsc();
 bool CheckForEscSilent();
 bool ConfirmAbortOp();
 bool IsRepeatedKey();
+void KickInputWaiter();
+void GetIdleWakeupsStats(unsigned long long &Total, double &PerSecond);
@@ -435,6 +435,7 @@ void ScreenBuf::Flush()
 		return;
 
 	if (!LockCount) {
+		bool Written = false;
 		if (CtrlObject && (CtrlObject->Macro.IsRecording() || CtrlObject->Macro.IsExecuting())) {
 			MacroChar = Buf[0];
 			MacroCharUsed = true;
@@ -452,6 +453,7 @@ void ScreenBuf::Flush()
 			CONSOLE_CURSOR_INFO cci = {CurSize, CurVisible};
 			Console.SetCursorInfo(cci);
 			SBFlags.Set(SBFLAGS_FLUSHEDCURTYPE);
+			Written = true;
 		}
 
 		if (!SBFlags.Check(SBFLAGS_FLUSHED)) {
@@ -529,6 +531,7 @@ void ScreenBuf::Flush()
 					Console.WriteOutput(*Buf, BufferSize, BufferCoord, WriteRegion);
 				}
 				memcpy(Shadow, Buf, BufX * BufY * sizeof(CHAR_INFO));
+				Written = true;
 			}
 		}
 
@@ -544,15 +547,18 @@ void ScreenBuf::Flush()
 			COORD C = {CurX, CurY};
 			Console.SetCursorPosition(C);
 			SBFlags.Set(SBFLAGS_FLUSHEDCURPOS);
+			Written = true;
 		}
 
 		if (!SBFlags.Check(SBFLAGS_FLUSHEDCURTYPE) && CurVisible) {
 			CONSOLE_CURSOR_INFO cci = {CurSize, CurVisible};
 			Console.SetCursorInfo(cci);
 			SBFlags.Set(SBFLAGS_FLUSHEDCURTYPE);
+			Written = true;
 		}
 
 		SBFlags.Set(SBFLAGS_USESHADOW | SBFLAGS_FLUSHED);
+		WINPORT(TraceConsoleLatency)(Written ? CONSOLE_LATENCY_FLUSHED : CONSOLE_LATENCY_UNCHANGED);
 	}
 }
 
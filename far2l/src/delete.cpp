@@ -62,6 +62,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <RandomString.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 enum DeletionResult
 {
@@ -132,6 +140,263 @@ public:
 	}
 };
 
+/*
+	Removes content of directory using descriptors of already opened parent directories,
+	so kernel doesn't resolve full path for each removed item. Each thread walks its
+	directories depth-first and gives subdirectories away to other threads while they
+	have no work, so sibling subtrees are removed in parallel. Directory itself is removed
+	by thread that completed its last child. Any entry that can't be removed by such simple
+	means is left in place, so caller's usual sequential pass will deal with it, including
+	skip modes and sudo. Unless told otherwise, read-only files (and files in read-only
+	directories) are left too, so user gets usual read-only confirmation for them.
+	Root directory itself is not removed.
+*/
+class ParallelTreeRemover
+{
+	struct Dir
+	{
+		std::shared_ptr<Dir> Parent;
+		std::string Path;
+		size_t NameOfs = 0;
+		int FD = -1;
+		std::atomic<int> Pending{1};	// own listing plus not yet completed subdirectories
+		std::atomic<bool> Incomplete{false};
+	};
+	typedef std::shared_ptr<Dir> DirPtr;
+
+	std::mutex Mutex;
+	std::condition_variable WorkCond;
+	std::condition_variable DoneCond;
+	std::vector<DirPtr> Pending;
+	std::vector<std::string> RemovedTopDirs;
+	std::string CurrentPath;
+	size_t Busy = 0;
+	size_t ThreadsCount;
+	bool KeepReadOnly;
+	bool Stopping = false;
+	bool Paused = false;
+	std::atomic<bool> Interrupt{false};	// Stopping or Paused, checked without locking
+	std::atomic<size_t> RemovedCount{0};
+	std::vector<std::thread> Threads;
+
+	bool IsDone() const { return Pending.empty() && !Busy; }
+
+	bool CheckInterrupt()
+	{
+		if (!Interrupt)
+			return false;
+
+		std::unique_lock<std::mutex> lock(Mutex);
+		WorkCond.wait(lock, [this] { return Stopping || !Paused; });
+		return Stopping;
+	}
+
+	void Complete(DirPtr D)
+	{
+		while (D && --D->Pending == 0) {
+			if (D->FD != -1) {
+				close(D->FD);
+				D->FD = -1;
+			}
+			if (!D->Parent)
+				break;
+
+			if (D->Incomplete || unlinkat(D->Parent->FD, D->Path.c_str() + D->NameOfs, AT_REMOVEDIR) == -1) {
+				D->Parent->Incomplete = true;
+			} else {
+				++RemovedCount;
+				if (!D->Parent->Parent) {
+					std::lock_guard<std::mutex> lock(Mutex);
+					RemovedTopDirs.emplace_back(D->Path);
+				}
+			}
+			D = D->Parent;
+		}
+	}
+
+	void Remove(const DirPtr &D)
+	{
+		D->FD = D->Parent
+			? openat(D->Parent->FD, D->Path.c_str() + D->NameOfs, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)
+			: open(D->Path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (D->FD == -1) {
+			D->Incomplete = true;
+			Complete(D);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			CurrentPath = D->Path;
+		}
+
+		// root can unlink from read-only directory, but user must be asked about that
+		bool DirReadOnly = false;
+		if (KeepReadOnly) {
+			struct stat s{};
+			DirReadOnly = fstat(D->FD, &s) == -1 || (s.st_mode & S_IWUSR) == 0;
+		}
+
+		const int DupFD = dup(D->FD);
+		DIR *dir = (DupFD != -1) ? fdopendir(DupFD) : nullptr;
+		if (!dir) {
+			if (DupFD != -1)
+				close(DupFD);
+			D->Incomplete = true;
+			Complete(D);
+			return;
+		}
+
+		for (;;) {
+			if (CheckInterrupt()) {
+				D->Incomplete = true;
+				break;
+			}
+			const struct dirent *de = readdir(dir);
+			if (!de)
+				break;
+			if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2])))
+				continue;
+
+			bool IsDir = (de->d_type == DT_DIR);
+			if (de->d_type == DT_UNKNOWN) {
+				struct stat s{};
+				IsDir = fstatat(D->FD, de->d_name, &s, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(s.st_mode);
+			}
+
+			if (!IsDir) {
+				if (KeepReadOnly && (DirReadOnly || IsReadOnlyEntry(D->FD, de->d_name))) {
+					D->Incomplete = true;
+				} else if (unlinkat(D->FD, de->d_name, 0) == 0 || errno == ENOENT) {
+					++RemovedCount;
+				} else {
+					D->Incomplete = true;
+				}
+				continue;
+			}
+
+			auto Subdir = std::make_shared<Dir>();
+			Subdir->Parent = D;
+			Subdir->Path = D->Path;
+			Subdir->Path+= GOOD_SLASH;
+			Subdir->NameOfs = Subdir->Path.size();
+			Subdir->Path+= de->d_name;
+			++D->Pending;
+
+			std::unique_lock<std::mutex> lock(Mutex);
+			if (Pending.size() + Busy < ThreadsCount) {	// somebody is idle, give it that subtree
+				Pending.emplace_back(std::move(Subdir));
+				WorkCond.notify_one();
+			} else {
+				lock.unlock();
+				Remove(Subdir);
+			}
+		}
+
+		closedir(dir);
+		Complete(D);
+	}
+
+	// Same check as apiMakeWritable does: missing owner's write permission of target,
+	// immutable files can't be unlinked anyway so they stay for sequential pass
+	static bool IsReadOnlyEntry(int DirFD, const char *Name)
+	{
+		struct stat s{};
+		return fstatat(DirFD, Name, &s, 0) == 0 && (s.st_mode & S_IWUSR) == 0;
+	}
+
+	void WorkerProc()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		for (;;) {
+			WorkCond.wait(lock, [this] { return !Pending.empty() || !Busy; });
+			if (IsDone())
+				break;
+
+			DirPtr D = std::move(Pending.back());
+			Pending.pop_back();
+			++Busy;
+			const bool Stopped = Stopping;
+			lock.unlock();
+
+			if (Stopped) {	// don't open it, just let parents release descriptors
+				D->Incomplete = true;
+				Complete(D);
+			} else
+				Remove(D);
+
+			lock.lock();
+			--Busy;
+			if (IsDone()) {
+				WorkCond.notify_all();
+				DoneCond.notify_all();
+			}
+		}
+	}
+
+public:
+	ParallelTreeRemover(const std::string &Root, bool KeepReadOnly_)
+		:
+		ThreadsCount(std::max(2u, std::min(std::thread::hardware_concurrency(), 16u))),
+		KeepReadOnly(KeepReadOnly_)
+	{
+		auto RootDir = std::make_shared<Dir>();
+		RootDir->Path = Root;
+		while (RootDir->Path.size() > 1 && RootDir->Path.back() == GOOD_SLASH)
+			RootDir->Path.pop_back();
+		Pending.emplace_back(std::move(RootDir));
+
+		for (size_t i = 0; i < ThreadsCount; ++i) {
+			Threads.emplace_back([this] { WorkerProc(); });
+		}
+	}
+
+	~ParallelTreeRemover() { Stop(); }
+
+	// Returns true if removal is finished, otherwise waits for it at most given time
+	bool Wait(unsigned int Msec)
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		return DoneCond.wait_for(lock, std::chrono::milliseconds(Msec), [this] { return IsDone(); });
+	}
+
+	// Suspends workers, so nothing gets removed while user is asked about abort
+	void Pause(bool Pause)
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Paused = Pause;
+			Interrupt = Stopping || Paused;
+		}
+		WorkCond.notify_all();
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Stopping = true;
+			Interrupt = true;
+		}
+		WorkCond.notify_all();
+		for (auto &Thread : Threads) {
+			Thread.join();
+		}
+		Threads.clear();
+	}
+
+	size_t Removed() const { return RemovedCount; }
+
+	std::string Current()
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		return CurrentPath;
+	}
+
+	// Paths of removed immediate subdirectories of root, valid after Stop()
+	const std::vector<std::string> &TopDirs() const { return RemovedTopDirs; }
+};
+
 static FARString PanelItemFullName(Panel *SrcPanel, const FARString &strSelName)
 {
 	if (IsAbsolutePath(strSelName))
@@ -169,6 +434,35 @@ static DeletionResult ShellConfirmDirectoryDeletion(const FARString &strFullName
 	return DELETE_YES;
 }
 
+// Quickly removes what can be removed without asking user, returns false if user aborted operation
+static bool ShellFastDeleteDirectoryContent(const FARString &strSelFullName, ShellDeleteMsgState &SDMS,
+		int ItemsCount)
+{
+	const ULONG InitialProcessedItems = ProcessedItems;
+	// read-only files need confirmation unless it's disabled or user already chose 'All'
+	const bool KeepReadOnly = Opt.Confirm.RO && ReadOnlyDeleteMode != 1;
+	ParallelTreeRemover Remover(strSelFullName.GetMB(), KeepReadOnly);
+	FARString strCurrent = strSelFullName;
+	bool Aborted = false;
+	while (!Remover.Wait(100)) {
+		ProcessedItems = InitialProcessedItems + (ULONG)Remover.Removed();
+		strCurrent = Remover.Current();
+		Remover.Pause(true);
+		Aborted = !SDMS.Update(strCurrent, false, ProcessedItems, ItemsCount);
+		Remover.Pause(false);
+		if (Aborted)
+			break;
+	}
+
+	Remover.Stop();
+	ProcessedItems = InitialProcessedItems + (ULONG)Remover.Removed();
+	for (const auto &TopDir : Remover.TopDirs()) {
+		TreeList::DelTreeName(FARString(TopDir));
+	}
+
+	return !Aborted;
+}
+
 static DeletionResult ShellDeleteDirectory(int ItemsCount, bool UpdateDiz, Panel *SrcPanel,
 		FARString strSelName, DWORD FileAttr, bool Wipe, int Opt_DeleteToRecycleBin)
 {
@@ -186,9 +480,15 @@ static DeletionResult ShellDeleteDirectory(int ItemsCount, bool UpdateDiz, Panel
 
 	if (!DirSymLink && (!Opt_DeleteToRecycleBin || Wipe)) {
 		ShellDeleteMsgState SDMS;
-		ScanTree ScTree(TRUE, TRUE, FALSE);
 		FARString strSelFullName = PanelItemFullName(SrcPanel, strSelName);
 
+		// nothing to be asked or wiped in subtree? then remove most of it in parallel
+		// and let following sequential pass deal with items that require attention
+		if (DeleteAllFolders && !Wipe && !UpdateDiz
+				&& !ShellFastDeleteDirectoryContent(strSelFullName, SDMS, ItemsCount))
+			return DELETE_CANCEL;
+
+		ScanTree ScTree(TRUE, TRUE, FALSE);
 		ScTree.SetFindPath(strSelFullName, L"*", 0);
 		FAR_FIND_DATA_EX FindData;
 		FARString strFullName;
@@ -51,6 +51,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "strmix.hpp"
 #include "wakeful.hpp"
 #include "config.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 static void DrawGetDirInfoMsg(const wchar_t *Title, const wchar_t *Name, const UINT64 Size)
 {
@@ -77,6 +83,400 @@ static void PR_DrawGetDirInfoMsg()
 			reinterpret_cast<const UINT64>(preRedrawItem.Param.Param3));
 }
 
+/*
+	Unfiltered requests are served by parallel scan that lists subtrees concurrently.
+	Listing of each directory is reduced to DirSizeRecord and kept in session cache,
+	validated by directory's stat, so repeated requests, requests on parent directories
+	and copy/delete pre-scans only stat directories that were already listed.
+	Note that in-place modification of file doesn't change its directory's times, so
+	sizes of such files may remain stale until directory itself gets changed.
+	Totals are evaluated same way as ScanTree-based loop below does: every node
+	(except single-linked files which cannot be met twice) is counted once per inode,
+	while physical sizes are summed per entry.
+*/
+namespace
+{
+	struct DirSizeStamp
+	{
+		uint64_t UnixDevice{};
+		uint64_t UnixNode{};
+		struct timespec MTime{};
+		struct timespec CTime{};
+
+		DirSizeStamp() = default;
+		DirSizeStamp(const struct stat &s)
+			: UnixDevice(s.st_dev), UnixNode(s.st_ino), MTime(s.st_mtim), CTime(s.st_ctim) {}
+
+		bool operator==(const DirSizeStamp &other) const
+		{
+			return UnixDevice == other.UnixDevice && UnixNode == other.UnixNode
+				&& MTime.tv_sec == other.MTime.tv_sec && MTime.tv_nsec == other.MTime.tv_nsec
+				&& CTime.tv_sec == other.CTime.tv_sec && CTime.tv_nsec == other.CTime.tv_nsec;
+		}
+	};
+
+	struct DirSizeNode
+	{
+		uint64_t UnixDevice;
+		uint64_t UnixNode;
+		uint64_t Size;
+	};
+
+	struct DirSizeNamedNode : DirSizeNode
+	{
+		std::wstring strName;
+		bool Directory;
+	};
+
+	struct DirSizeRecord
+	{
+		DirSizeStamp Stamp;
+		uint32_t Files = 0;					// single-linked non-directories
+		uint64_t FilesSize = 0;
+		uint64_t FilesPhysicalSize = 0;		// all non-directories entries including symlinks
+		uint64_t DirsPhysicalSize = 0;		// all directories entries including symlinks
+		uint64_t LinksSize = 0;				// own sizes of symlinks
+		std::vector<DirSizeNode> HardLinked;
+		std::vector<DirSizeNamedNode> Subdirs;
+		std::vector<DirSizeNamedNode> Links;	// Directory here means symlink's target
+	};
+
+	typedef std::shared_ptr<const DirSizeRecord> DirSizeRecordPtr;
+
+	class DirSizeCache
+	{
+		enum { MAX_RECORDS = 0x40000 };
+
+		std::mutex Mutex;
+		std::unordered_map<std::wstring, DirSizeRecordPtr> Records;
+
+	public:
+		DirSizeRecordPtr Lookup(const std::wstring &Path, const DirSizeStamp &Stamp)
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			auto it = Records.find(Path);
+			if (it == Records.end())
+				return DirSizeRecordPtr();
+
+			if (it->second->Stamp == Stamp)
+				return it->second;
+
+			Records.erase(it);
+			return DirSizeRecordPtr();
+		}
+
+		void Store(const std::wstring &Path, const DirSizeRecordPtr &Record)
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (Records.size() >= MAX_RECORDS)
+				Records.clear();
+			Records[Path] = Record;
+		}
+	} s_DirSizeCache;
+
+	class ParallelDirSizeScan
+	{
+		struct ScanDir
+		{
+			std::wstring strPath;
+			std::wstring strRealPath;
+			uint64_t UnixDevice{};
+			uint64_t UnixNode{};
+			std::shared_ptr<const ScanDir> Parent;
+		};
+		typedef std::shared_ptr<const ScanDir> ScanDirPtr;
+
+		const bool ScanSymlinks;
+		const bool CountDirSize;
+
+		std::mutex Mutex;
+		std::condition_variable WorkCond;
+		std::condition_variable DoneCond;
+		std::vector<ScanDirPtr> Pending;
+		size_t Busy = 0;
+		bool Stopping = false;
+		ScannedINodes ListedDirs;
+		ScannedINodes CountedNodes;
+		uint64_t DirCount = 0;
+		uint64_t FileCount = 0;
+		uint64_t FileSize = 0;
+		uint64_t PhysicalSize = 0;
+		std::vector<std::thread> Threads;
+
+		bool IsDone() const { return Pending.empty() && !Busy; }
+
+		static bool IsRecursion(const ScanDir &Dir)
+		{
+			const std::wstring &RealPath = Dir.strRealPath;
+			for (const ScanDir *It = Dir.Parent.get(); It; It = It->Parent.get()) {
+				const std::wstring &IthPath = It->strRealPath;
+				if ((It->UnixDevice == Dir.UnixDevice && It->UnixNode == Dir.UnixNode)
+						|| (IthPath.compare(0, RealPath.size(), RealPath) == 0
+								&& (IthPath.size() == RealPath.size() || IthPath[RealPath.size()] == GOOD_SLASH
+										|| RealPath.size() == 1)))
+					return true;
+			}
+			return false;
+		}
+
+		static std::wstring JoinPath(const std::wstring &Dir, const std::wstring &Name)
+		{
+			std::wstring out(Dir);
+			if (out.empty() || out.back() != GOOD_SLASH)
+				out+= GOOD_SLASH;
+			out+= Name;
+			return out;
+		}
+
+		static DirSizeRecordPtr ListDir(const std::wstring &Path)
+		{
+			struct stat s{};
+			if (sdc_stat(Wide2MB(Path.c_str()).c_str(), &s) != 0)
+				return DirSizeRecordPtr();
+
+			const DirSizeStamp Stamp(s);
+			if (auto Cached = s_DirSizeCache.Lookup(Path, Stamp))
+				return Cached;
+
+			auto Record = std::make_shared<DirSizeRecord>();
+			Record->Stamp = Stamp;
+
+			const time_t ListingTime = time(nullptr);
+			::FindFile Find(JoinPath(Path, L"*").c_str());
+			FAR_FIND_DATA_EX fdata;
+			while (Find.Get(fdata)) {
+				const bool Directory = (fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+				if (fdata.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+					if (sdc_lstat(Wide2MB(JoinPath(Path, fdata.strFileName.CPtr()).c_str()).c_str(), &s) == 0)
+						Record->LinksSize+= s.st_size;
+					Record->Links.emplace_back(DirSizeNamedNode{
+							{fdata.UnixDevice, fdata.UnixNode, fdata.nFileSize}, fdata.strFileName.CPtr(), Directory});
+
+				} else if (Directory) {
+					Record->Subdirs.emplace_back(DirSizeNamedNode{
+							{fdata.UnixDevice, fdata.UnixNode, fdata.nFileSize}, fdata.strFileName.CPtr(), true});
+
+				} else if (fdata.nHardLinks > 1) {
+					Record->HardLinked.emplace_back(DirSizeNode{fdata.UnixDevice, fdata.UnixNode, fdata.nFileSize});
+
+				} else {
+					Record->Files++;
+					Record->FilesSize+= fdata.nFileSize;
+				}
+
+				if (Directory)
+					Record->DirsPhysicalSize+= fdata.nPhysicalSize;
+				else
+					Record->FilesPhysicalSize+= fdata.nPhysicalSize;
+			}
+
+			// don't cache directory that could be changed within same second as it was listed
+			if (std::max(Stamp.MTime.tv_sec, Stamp.CTime.tv_sec) + 1 < ListingTime)
+				s_DirSizeCache.Store(Path, Record);
+
+			return Record;
+		}
+
+		void CountNode(const DirSizeNode &Node, bool Directory)
+		{
+			if (!CountedNodes.Put(Node.UnixDevice, Node.UnixNode))
+				return;
+
+			if (Directory) {
+				DirCount++;
+				if (CountDirSize)
+					FileSize+= Node.Size;
+			} else {
+				FileCount++;
+				FileSize+= Node.Size;
+			}
+		}
+
+		// Must be called under lock
+		size_t CountRecord(const ScanDirPtr &Dir, const DirSizeRecord &Record, std::vector<std::wstring> &LinkRealPaths)
+		{
+			if (!ListedDirs.Put(Record.Stamp.UnixDevice, Record.Stamp.UnixNode))
+				return 0;
+
+			PhysicalSize+= Record.FilesPhysicalSize;
+			if (CountDirSize) {
+				PhysicalSize+= Record.DirsPhysicalSize;
+				FileSize+= Record.LinksSize;
+			}
+			FileCount+= Record.Files + Record.Links.size();
+			FileSize+= Record.FilesSize;
+
+			for (const auto &Node : Record.HardLinked)
+				CountNode(Node, false);
+
+			const size_t PendingSize = Pending.size();
+			for (const auto &Subdir : Record.Subdirs) {
+				CountNode(Subdir, true);
+				auto Sub = std::make_shared<ScanDir>();
+				Sub->strPath = JoinPath(Dir->strPath, Subdir.strName);
+				Sub->strRealPath = Sub->strPath;
+				Sub->UnixDevice = Subdir.UnixDevice;
+				Sub->UnixNode = Subdir.UnixNode;
+				Sub->Parent = Dir;
+				Pending.emplace_back(std::move(Sub));
+			}
+
+			if (ScanSymlinks) {
+				for (size_t i = 0; i < Record.Links.size(); ++i) {
+					const auto &Link = Record.Links[i];
+					CountNode(Link, Link.Directory);
+					if (!Link.Directory)
+						continue;
+
+					auto Sub = std::make_shared<ScanDir>();
+					Sub->strPath = JoinPath(Dir->strPath, Link.strName);
+					Sub->strRealPath = std::move(LinkRealPaths[i]);
+					Sub->UnixDevice = Link.UnixDevice;
+					Sub->UnixNode = Link.UnixNode;
+					Sub->Parent = Dir;
+					if (!IsRecursion(*Sub))
+						Pending.emplace_back(std::move(Sub));
+				}
+			}
+
+			return Pending.size() - PendingSize;
+		}
+
+		void WorkerProc()
+		{
+			std::vector<std::wstring> LinkRealPaths;
+			std::unique_lock<std::mutex> lock(Mutex);
+			for (;;) {
+				WorkCond.wait(lock, [this] { return Stopping || !Pending.empty() || !Busy; });
+				if (Stopping || IsDone())
+					break;
+
+				ScanDirPtr Dir = std::move(Pending.back());
+				Pending.pop_back();
+				++Busy;
+				lock.unlock();
+
+				const auto Record = ListDir(Dir->strPath);
+				LinkRealPaths.clear();
+				if (Record && ScanSymlinks) {
+					FARString strRealPath;
+					for (const auto &Link : Record->Links) {
+						if (Link.Directory)
+							ConvertNameToReal(JoinPath(Dir->strPath, Link.strName).c_str(), strRealPath);
+						else
+							strRealPath.Clear();
+						LinkRealPaths.emplace_back(strRealPath.CPtr());
+					}
+				}
+
+				lock.lock();
+				const size_t Queued = (Record && !Stopping) ? CountRecord(Dir, *Record, LinkRealPaths) : 0;
+				--Busy;
+
+				if (IsDone()) {
+					WorkCond.notify_all();
+					DoneCond.notify_all();
+				} else if (Queued > 1) {
+					WorkCond.notify_all();
+				} else if (Queued) {
+					WorkCond.notify_one();
+				}
+			}
+		}
+
+	public:
+		ParallelDirSizeScan(const wchar_t *Root, bool ScanSymlinks_, bool CountDirSize_)
+			:
+			ScanSymlinks(ScanSymlinks_), CountDirSize(CountDirSize_)
+		{
+			auto RootDir = std::make_shared<ScanDir>();
+			RootDir->strPath = Root;
+			if (RootDir->strPath.size() > 1 && RootDir->strPath.back() == GOOD_SLASH)
+				RootDir->strPath.pop_back();
+			FARString strRealPath;
+			ConvertNameToReal(RootDir->strPath.c_str(), strRealPath);
+			RootDir->strRealPath = strRealPath.CPtr();
+			Pending.emplace_back(std::move(RootDir));
+
+			const unsigned int ThreadsCount = std::max(2u, std::min(std::thread::hardware_concurrency(), 16u));
+			for (unsigned int i = 0; i < ThreadsCount; ++i) {
+				Threads.emplace_back([this] { WorkerProc(); });
+			}
+		}
+
+		~ParallelDirSizeScan() { Stop(); }
+
+		// Returns true if scan is finished, otherwise waits for it at most given time
+		bool Wait(unsigned int Msec)
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			return DoneCond.wait_for(lock, std::chrono::milliseconds(Msec), [this] { return IsDone(); });
+		}
+
+		void Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Stopping = true;
+			}
+			WorkCond.notify_all();
+			for (auto &Thread : Threads) {
+				Thread.join();
+			}
+			Threads.clear();
+		}
+
+		uint64_t ScannedSize()
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			return FileSize;
+		}
+
+		void GetTotals(uint32_t &Dirs, uint32_t &Files, uint64_t &Size, uint64_t &Physical)
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Dirs+= static_cast<uint32_t>(DirCount);
+			Files+= static_cast<uint32_t>(FileCount);
+			Size+= FileSize;
+			Physical+= PhysicalSize;
+		}
+	};
+}
+
+// Returns 1 to continue scan, 0 if user cancelled it, -1 if key pressed with GETDIRINFO_ENHBREAK
+static int CheckGetDirInfoBreak(DWORD Flags)
+{
+	INPUT_RECORD rec;
+
+	switch (PeekInputRecord(&rec)) {
+		case 0:
+		case KEY_IDLE:
+			break;
+		case KEY_NONE:
+		case KEY_ALT:
+		case KEY_CTRL:
+		case KEY_SHIFT:
+		case KEY_RALT:
+		case KEY_RCTRL:
+			GetInputRecord(&rec);
+			break;
+		case KEY_ESC:
+		case KEY_BREAK:
+			GetInputRecord(&rec);
+			return 0;
+		default:
+
+			if (Flags & GETDIRINFO_ENHBREAK) {
+				return -1;
+			}
+
+			GetInputRecord(&rec);
+			break;
+	}
+
+	return 1;
+}
+
 int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount, uint32_t &FileCount,
 		uint64_t &FileSize, uint64_t &PhysicalSize, uint32_t &ClusterSize, clock_t MsgWaitTime,
 		FileFilter *Filter, DWORD Flags)
@@ -88,9 +488,6 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 	UndoGlobalSaveScrPtr UndSaveScr(&SaveScr);
 	TPreRedrawFuncGuard preRedrawFuncGuard(PR_DrawGetDirInfoMsg);
 	wakeful W;
-	ScanTree ScTree(FALSE, TRUE,
-			((Flags & GETDIRINFO_SCANSYMLINKDEF) ? -1 : ((Flags & GETDIRINFO_SCANSYMLINK) != 0)));
-	FAR_FIND_DATA_EX FindData;
 	clock_t StartTime = GetProcessUptimeMSec();
 	SetCursorType(FALSE, 0);
 	/*
@@ -116,11 +513,11 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 	DirCount = FileCount = 0;
 	FileSize = PhysicalSize = 0;
 	ClusterSize = 0;
-	ScTree.SetFindPath(DirName, L"*", 0);
-	ScannedINodes scanned_inodes;
 	const bool count_dir_size = !Opt.OnlyFilesSize;
 	const bool use_filter = (Flags & GETDIRINFO_USEFILTER) != 0;
-	const bool scan_symlinks = ScTree.IsSymlinksScanEnabled();
+	const bool scan_symlinks = (Flags & GETDIRINFO_SCANSYMLINKDEF)
+			? Opt.ScanJunction != 0
+			: (Flags & GETDIRINFO_SCANSYMLINK) != 0;
 	const bool can_break = !CtrlObject->Macro.IsExecuting() && !WinPortTesting();
 
 	struct stat s = {0};
@@ -132,37 +529,7 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 		ClusterSize = s.st_blksize;		// TODO: check if its best thing to be used here
 	}
 
-	while (ScTree.GetNextName(&FindData, strFullName)) {
-		if (can_break) {
-			INPUT_RECORD rec;
-
-			switch (PeekInputRecord(&rec)) {
-				case 0:
-				case KEY_IDLE:
-					break;
-				case KEY_NONE:
-				case KEY_ALT:
-				case KEY_CTRL:
-				case KEY_SHIFT:
-				case KEY_RALT:
-				case KEY_RCTRL:
-					GetInputRecord(&rec);
-					break;
-				case KEY_ESC:
-				case KEY_BREAK:
-					GetInputRecord(&rec);
-					return 0;
-				default:
-
-					if (Flags & GETDIRINFO_ENHBREAK) {
-						return -1;
-					}
-
-					GetInputRecord(&rec);
-					break;
-			}
-		}
-
+	auto UpdateProgress = [&](uint64_t ScannedSize) {
 		if (MsgWaitTime != -1) {
 			clock_t CurTime = GetProcessUptimeMSec();
 
@@ -171,9 +538,38 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 				MsgWaitTime = 500;
 				OldTitle.Set(L"%ls %ls", Msg::ScanningFolder.CPtr(), ShowDirName);	// покажем заголовок консоли
 				SetCursorType(FALSE, 0);
-				DrawGetDirInfoMsg(Title, ShowDirName, FileSize);
+				DrawGetDirInfoMsg(Title, ShowDirName, ScannedSize);
+			}
+		}
+	};
+
+	if (!use_filter) {
+		ParallelDirSizeScan Scan(strFullDirName, scan_symlinks, count_dir_size);
+		while (!Scan.Wait(100)) {
+			if (can_break) {
+				const int r = CheckGetDirInfoBreak(Flags);
+				if (r <= 0)
+					return r;
 			}
+			UpdateProgress(FileSize + Scan.ScannedSize());
 		}
+		Scan.GetTotals(DirCount, FileCount, FileSize, PhysicalSize);
+		return 1;
+	}
+
+	ScanTree ScTree(FALSE, TRUE, scan_symlinks);
+	FAR_FIND_DATA_EX FindData;
+	ScTree.SetFindPath(DirName, L"*", 0);
+	ScannedINodes scanned_inodes;
+
+	while (ScTree.GetNextName(&FindData, strFullName)) {
+		if (can_break) {
+			const int r = CheckGetDirInfoBreak(Flags);
+			if (r <= 0)
+				return r;
+		}
+
+		UpdateProgress(FileSize);
 
 		const DWORD file_attributes = FindData.dwFileAttributes;
 		const bool is_directory = (file_attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
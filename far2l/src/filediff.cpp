@@ -465,14 +465,65 @@ bool LinesSimilar(const FARString &Left, const FARString &Right)
 	return Common * 3 >= MaxLength * 2;
 }
 
-bool RowsSimilar(const DiffRow &Deleted, const DiffRow &Added, const std::vector<FARString> &Left,
-		const std::vector<FARString> &Right)
+uint64_t HashLine(const FARString &Line)
 {
-	return Deleted.Left >= 0 && Added.Right >= 0 && LinesSimilar(Left[Deleted.Left], Right[Added.Right]);
+	constexpr uint64_t Offset = 1469598103934665603ull;
+	constexpr uint64_t Prime = 1099511628211ull;
+
+	uint64_t Hash = Offset;
+	const wchar_t *Data = Line.CPtr();
+	for (size_t I = 0, End = Line.GetLength(); I < End; ++I) {
+		Hash^= static_cast<uint64_t>(static_cast<uint32_t>(Data[I]));
+		Hash*= Prime;
+	}
+	return Hash;
 }
 
-std::vector<DiffRow> CoalesceChanges(std::vector<DiffRow> Rows,
-		const std::vector<FARString> &Left, const std::vector<FARString> &Right)
+struct LineHasher
+{
+	size_t operator()(const FARString &Line) const { return static_cast<size_t>(HashLine(Line)); }
+};
+
+// Maps each distinct line content to small integer so diff compares and hashes
+// integers instead of strings. Same interner used for both files, so equal ids
+// mean equal lines.
+class LineInterner
+{
+	std::unordered_map<FARString, uint32_t, LineHasher> m_ids;
+
+public:
+	uint32_t Intern(const FARString &Line)
+	{
+		return m_ids.emplace(Line, static_cast<uint32_t>(m_ids.size())).first->second;
+	}
+
+	size_t Size() const { return m_ids.size(); }
+	void Clear() { m_ids.clear(); }
+};
+
+struct DiffLines
+{
+	const std::vector<FARString> &Left;
+	const std::vector<FARString> &Right;
+	const std::vector<uint32_t> &LeftIds;
+	const std::vector<uint32_t> &RightIds;
+};
+
+// Lines [Begin, OldEnd) of previous content were replaced by lines [Begin, NewEnd)
+struct LineEdit
+{
+	bool Valid = false;
+	size_t Begin = 0;
+	size_t OldEnd = 0;
+	size_t NewEnd = 0;
+};
+
+bool RowsSimilar(const DiffRow &Deleted, const DiffRow &Added, const DiffLines &Lines)
+{
+	return Deleted.Left >= 0 && Added.Right >= 0 && LinesSimilar(Lines.Left[Deleted.Left], Lines.Right[Added.Right]);
+}
+
+std::vector<DiffRow> CoalesceChanges(std::vector<DiffRow> Rows, const DiffLines &Lines)
 {
 	size_t Write = 0;
 	for (size_t I = 0; I < Rows.size();) {
@@ -494,7 +545,7 @@ std::vector<DiffRow> CoalesceChanges(std::vector<DiffRow> Rows,
 		const size_t ChangedCount = std::min(DeletedCount, AddedCount);
 		std::vector<bool> Similar(ChangedCount);
 		for (size_t N = 0; N < ChangedCount; ++N) {
-			Similar[N] = RowsSimilar(Rows[I + N], Rows[J + N], Left, Right);
+			Similar[N] = RowsSimilar(Rows[I + N], Rows[J + N], Lines);
 			if (Similar[N])
 				Rows[Write++] = {Rows[I + N].Left, Rows[J + N].Right, DiffKind::Changed};
 			else
@@ -515,8 +566,8 @@ std::vector<DiffRow> CoalesceChanges(std::vector<DiffRow> Rows,
 	return Rows;
 }
 
-void EmitFallbackRange(const std::vector<FARString> &Left, const std::vector<FARString> &Right,
-		size_t LeftBegin, size_t LeftEnd, size_t RightBegin, size_t RightEnd, std::vector<DiffRow> &Rows)
+void EmitFallbackRange(const DiffLines &Lines, size_t LeftBegin, size_t LeftEnd,
+		size_t RightBegin, size_t RightEnd, std::vector<DiffRow> &Rows)
 {
 	const size_t LeftCount = LeftEnd - LeftBegin;
 	const size_t RightCount = RightEnd - RightBegin;
@@ -528,9 +579,9 @@ void EmitFallbackRange(const std::vector<FARString> &Left, const std::vector<FAR
 			Rows.push_back({L, R, DiffKind::Added});
 		else if (R < 0)
 			Rows.push_back({L, R, DiffKind::Deleted});
-		else if (Left[L] == Right[R])
+		else if (Lines.LeftIds[L] == Lines.RightIds[R])
 			Rows.push_back({L, R, DiffKind::Equal});
-		else if (LinesSimilar(Left[L], Right[R]))
+		else if (LinesSimilar(Lines.Left[L], Lines.Right[R]))
 			Rows.push_back({L, R, DiffKind::Changed});
 		else {
 			Rows.push_back({L, -1, DiffKind::Deleted});
@@ -576,32 +627,18 @@ struct DiffAnchor
 	bool Valid() const { return Length != 0; }
 };
 
-uint64_t HashLine(const FARString &Line)
-{
-	constexpr uint64_t Offset = 1469598103934665603ull;
-	constexpr uint64_t Prime = 1099511628211ull;
-
-	uint64_t Hash = Offset;
-	const wchar_t *Data = Line.CPtr();
-	for (size_t I = 0, End = Line.GetLength(); I < End; ++I) {
-		Hash^= static_cast<uint64_t>(static_cast<uint32_t>(Data[I]));
-		Hash*= Prime;
-	}
-	return Hash;
-}
-
-DiffAnchor FindHistogramAnchor(const std::vector<FARString> &Left, const std::vector<FARString> &Right,
+DiffAnchor FindHistogramAnchor(const std::vector<uint32_t> &Left, const std::vector<uint32_t> &Right,
 		size_t LeftBegin, size_t LeftEnd, size_t RightBegin, size_t RightEnd)
 {
-	std::unordered_map<uint64_t, size_t> LeftCounts;
+	std::unordered_map<uint32_t, size_t> LeftCounts;
 	LeftCounts.reserve(LeftEnd - LeftBegin);
 	for (size_t I = LeftBegin; I < LeftEnd; ++I)
-		++LeftCounts[HashLine(Left[I])];
+		++LeftCounts[Left[I]];
 
-	std::unordered_map<uint64_t, HistogramEntry> RightHistogram;
+	std::unordered_map<uint32_t, HistogramEntry> RightHistogram;
 	RightHistogram.reserve(RightEnd - RightBegin);
 	for (size_t I = RightBegin; I < RightEnd; ++I) {
-		HistogramEntry &Entry = RightHistogram[HashLine(Right[I])];
+		HistogramEntry &Entry = RightHistogram[Right[I]];
 		Entry.AddPosition(I);
 	}
 
@@ -609,20 +646,16 @@ DiffAnchor FindHistogramAnchor(const std::vector<FARString> &Left, const std::ve
 	Best.Frequency = InvalidIndex;
 
 	for (size_t LeftPos = LeftBegin; LeftPos < LeftEnd; ++LeftPos) {
-		const uint64_t Hash = HashLine(Left[LeftPos]);
-		const auto LeftCount = LeftCounts.find(Hash);
-		const auto RightEntry = RightHistogram.find(Hash);
-		if (LeftCount == LeftCounts.end() || RightEntry == RightHistogram.end())
+		const auto RightEntry = RightHistogram.find(Left[LeftPos]);
+		if (RightEntry == RightHistogram.end())
 			continue;
 
-		const size_t Frequency = LeftCount->second + RightEntry->second.Count;
+		const size_t Frequency = LeftCounts[Left[LeftPos]] + RightEntry->second.Count;
 		if (Frequency > MaxUsefulHistogramFrequency || Frequency > Best.Frequency)
 			continue;
 
 		for (size_t PositionIndex = 0; PositionIndex < RightEntry->second.StoredPositionCount(); ++PositionIndex) {
 			const size_t RightPos = RightEntry->second.StoredPosition(PositionIndex);
-			if (Left[LeftPos] != Right[RightPos])
-				continue;
 
 			size_t LB = LeftPos;
 			size_t RB = RightPos;
@@ -657,10 +690,11 @@ DiffAnchor FindHistogramAnchor(const std::vector<FARString> &Left, const std::ve
 	return Best;
 }
 
-void BuildHistogramDiff(const std::vector<FARString> &Left, const std::vector<FARString> &Right,
-		size_t LeftBegin, size_t LeftEnd, size_t RightBegin, size_t RightEnd, std::vector<DiffRow> &Rows,
-		int Depth = 0)
+void BuildHistogramDiff(const DiffLines &Lines, size_t LeftBegin, size_t LeftEnd,
+		size_t RightBegin, size_t RightEnd, std::vector<DiffRow> &Rows, int Depth = 0)
 {
+	const std::vector<uint32_t> &Left = Lines.LeftIds;
+	const std::vector<uint32_t> &Right = Lines.RightIds;
 	while (LeftBegin < LeftEnd && RightBegin < RightEnd && Left[LeftBegin] == Right[RightBegin]) {
 		Rows.push_back({static_cast<int>(LeftBegin++), static_cast<int>(RightBegin++), DiffKind::Equal});
 	}
@@ -674,19 +708,19 @@ void BuildHistogramDiff(const std::vector<FARString> &Left, const std::vector<FA
 	RightEnd-= Suffix;
 
 	if (LeftBegin == LeftEnd || RightBegin == RightEnd || Depth > 64) {
-		EmitFallbackRange(Left, Right, LeftBegin, LeftEnd, RightBegin, RightEnd, Rows);
+		EmitFallbackRange(Lines, LeftBegin, LeftEnd, RightBegin, RightEnd, Rows);
 	} else {
 		const DiffAnchor Anchor = FindHistogramAnchor(Left, Right, LeftBegin, LeftEnd, RightBegin, RightEnd);
 		if (Anchor.Valid()) {
-			BuildHistogramDiff(Left, Right, LeftBegin, Anchor.LeftBegin, RightBegin, Anchor.RightBegin, Rows, Depth + 1);
+			BuildHistogramDiff(Lines, LeftBegin, Anchor.LeftBegin, RightBegin, Anchor.RightBegin, Rows, Depth + 1);
 			for (size_t I = 0; I < Anchor.Length; ++I) {
 				Rows.push_back({static_cast<int>(Anchor.LeftBegin + I), static_cast<int>(Anchor.RightBegin + I),
 						DiffKind::Equal});
 			}
-			BuildHistogramDiff(Left, Right, Anchor.LeftBegin + Anchor.Length, LeftEnd,
+			BuildHistogramDiff(Lines, Anchor.LeftBegin + Anchor.Length, LeftEnd,
 					Anchor.RightBegin + Anchor.Length, RightEnd, Rows, Depth + 1);
 		} else {
-			EmitFallbackRange(Left, Right, LeftBegin, LeftEnd, RightBegin, RightEnd, Rows);
+			EmitFallbackRange(Lines, LeftBegin, LeftEnd, RightBegin, RightEnd, Rows);
 		}
 	}
 
@@ -698,12 +732,64 @@ void BuildHistogramDiff(const std::vector<FARString> &Left, const std::vector<FA
 	}
 }
 
-std::vector<DiffRow> BuildLineDiff(const std::vector<FARString> &Left, const std::vector<FARString> &Right)
+std::vector<DiffRow> BuildLineDiff(const DiffLines &Lines)
+{
+	std::vector<DiffRow> Rows;
+	Rows.reserve(Lines.Left.size() + Lines.Right.size());
+	BuildHistogramDiff(Lines, 0, Lines.Left.size(), 0, Lines.Right.size(), Rows);
+	return CoalesceChanges(std::move(Rows), Lines);
+}
+
+bool RowBeforeEdit(int Line, const LineEdit &Edit)
+{
+	return !Edit.Valid || Line < 0 || static_cast<size_t>(Line) < Edit.Begin;
+}
+
+bool RowAfterEdit(int Line, const LineEdit &Edit)
+{
+	return !Edit.Valid || Line < 0 || static_cast<size_t>(Line) >= Edit.OldEnd;
+}
+
+int ShiftLine(int Line, const LineEdit &Edit)
 {
+	return (Line < 0 || !Edit.Valid) ? Line : static_cast<int>(Line + Edit.NewEnd - Edit.OldEnd);
+}
+
+// Re-diffs only lines between nearest unchanged equal rows that surround edited
+// ranges, rows outside of that region are kept from previous diff result.
+std::vector<DiffRow> UpdateLineDiff(const DiffLines &Lines, const std::vector<DiffRow> &OldRows,
+		const LineEdit &LeftEdit, const LineEdit &RightEdit)
+{
+	size_t Head = 0;
+	for (size_t I = 0; I < OldRows.size() && RowBeforeEdit(OldRows[I].Left, LeftEdit)
+			&& RowBeforeEdit(OldRows[I].Right, RightEdit); ++I) {
+		if (OldRows[I].Kind == DiffKind::Equal)
+			Head = I + 1;
+	}
+
+	size_t Tail = OldRows.size();
+	for (size_t I = OldRows.size(); I > Head && RowAfterEdit(OldRows[I - 1].Left, LeftEdit)
+			&& RowAfterEdit(OldRows[I - 1].Right, RightEdit); --I) {
+		if (OldRows[I - 1].Kind == DiffKind::Equal)
+			Tail = I - 1;
+	}
+
+	const size_t LeftBegin = Head ? OldRows[Head - 1].Left + 1 : 0;
+	const size_t RightBegin = Head ? OldRows[Head - 1].Right + 1 : 0;
+	const size_t LeftEnd = Tail < OldRows.size() ? ShiftLine(OldRows[Tail].Left, LeftEdit) : Lines.Left.size();
+	const size_t RightEnd = Tail < OldRows.size() ? ShiftLine(OldRows[Tail].Right, RightEdit) : Lines.Right.size();
+
+	std::vector<DiffRow> Middle;
+	BuildHistogramDiff(Lines, LeftBegin, LeftEnd, RightBegin, RightEnd, Middle);
+	Middle = CoalesceChanges(std::move(Middle), Lines);
+
 	std::vector<DiffRow> Rows;
-	Rows.reserve(Left.size() + Right.size());
-	BuildHistogramDiff(Left, Right, 0, Left.size(), 0, Right.size(), Rows);
-	return CoalesceChanges(std::move(Rows), Left, Right);
+	Rows.reserve(Head + Middle.size() + (OldRows.size() - Tail));
+	Rows.insert(Rows.end(), OldRows.begin(), OldRows.begin() + Head);
+	Rows.insert(Rows.end(), Middle.begin(), Middle.end());
+	for (size_t I = Tail; I < OldRows.size(); ++I)
+		Rows.push_back({ShiftLine(OldRows[I].Left, LeftEdit), ShiftLine(OldRows[I].Right, RightEdit), OldRows[I].Kind});
+	return Rows;
 }
 
 uint32_t ComposeRgb(int R, int G, int B)
@@ -895,6 +981,7 @@ class DiffEditorPane
 	bool m_codepageDetectedByHeuristics = false;
 	bool m_heuristicEncodingSaveConfirmed = false;
 	std::vector<FARString> m_lines;
+	LineEdit m_lineEdit;
 	std::unique_ptr<Editor> m_editor;
 	bool m_colorerOpened = false;
 	int m_syncedTopLine = -1;
@@ -1128,12 +1215,41 @@ public:
 		AppendRawLines(RawData, RawLength, NewLines);
 		free(RawData);
 
-		if (NewLines == m_lines)
+		size_t Prefix = 0;
+		while (Prefix < m_lines.size() && Prefix < NewLines.size() && m_lines[Prefix] == NewLines[Prefix])
+			++Prefix;
+
+		if (Prefix == m_lines.size() && Prefix == NewLines.size())
 			return false;
 
+		size_t Suffix = 0;
+		while (Suffix < m_lines.size() - Prefix && Suffix < NewLines.size() - Prefix
+				&& m_lines[m_lines.size() - Suffix - 1] == NewLines[NewLines.size() - Suffix - 1]) {
+			++Suffix;
+		}
+
+		// merge with edit(s) not yet taken by diff
+		if (m_lineEdit.Valid) {
+			Prefix = std::min(Prefix, m_lineEdit.Begin);
+			Suffix = std::min(Suffix, m_lines.size() - m_lineEdit.NewEnd);
+			m_lineEdit.OldEnd = m_lineEdit.OldEnd + m_lines.size() - m_lineEdit.NewEnd;
+			m_lineEdit.OldEnd-= Suffix;
+		} else {
+			m_lineEdit.Valid = true;
+			m_lineEdit.OldEnd = m_lines.size() - Suffix;
+		}
+		m_lineEdit.Begin = Prefix;
+		m_lineEdit.NewEnd = NewLines.size() - Suffix;
+
 		m_lines = std::move(NewLines);
 		return true;
 	}
+	LineEdit TakeLineEdit()
+	{
+		LineEdit Out = m_lineEdit;
+		m_lineEdit = LineEdit();
+		return Out;
+	}
 	bool Save()
 	{
 		if (!m_editor)
@@ -1395,6 +1511,9 @@ class FileDiffFrame : public Frame
 	FARString m_rightPath;
 	DiffEditorPane m_leftPane;
 	DiffEditorPane m_rightPane;
+	LineInterner m_interner;
+	std::vector<uint32_t> m_leftIds;
+	std::vector<uint32_t> m_rightIds;
 	std::vector<DiffRow> m_rows;
 	std::vector<DiffHunk> m_hunks;
 	std::vector<std::unique_ptr<InlineDiff>> m_inlineDiffs;
@@ -2092,12 +2211,41 @@ private:
 
 	void RebuildDiffModel()
 	{
-		m_rows = BuildLineDiff(m_leftPane.Lines(), m_rightPane.Lines());
+		const LineEdit LeftEdit = m_leftPane.TakeLineEdit();
+		const LineEdit RightEdit = m_rightPane.TakeLineEdit();
+		const DiffLines Lines{m_leftPane.Lines(), m_rightPane.Lines(), m_leftIds, m_rightIds};
+
+		// lines of previous contents stay interned, so start over when they dominate
+		const bool Incremental = !m_rows.empty()
+				&& m_interner.Size() <= 2 * (Lines.Left.size() + Lines.Right.size()) + 0x1000;
+		if (Incremental) {
+			UpdateLineIds(m_leftIds, Lines.Left, LeftEdit);
+			UpdateLineIds(m_rightIds, Lines.Right, RightEdit);
+			m_rows = UpdateLineDiff(Lines, m_rows, LeftEdit, RightEdit);
+		} else {
+			m_interner.Clear();
+			UpdateLineIds(m_leftIds, Lines.Left, LineEdit{true, 0, m_leftIds.size(), Lines.Left.size()});
+			UpdateLineIds(m_rightIds, Lines.Right, LineEdit{true, 0, m_rightIds.size(), Lines.Right.size()});
+			m_rows = BuildLineDiff(Lines);
+		}
 		BuildDiffHunks();
 		ResetInlineDiffs();
 		RebuildScreenRows();
 	}
 
+	void UpdateLineIds(std::vector<uint32_t> &Ids, const std::vector<FARString> &Lines, const LineEdit &Edit)
+	{
+		if (!Edit.Valid)
+			return;
+
+		std::vector<uint32_t> NewIds;
+		NewIds.reserve(Edit.NewEnd - Edit.Begin);
+		for (size_t I = Edit.Begin; I < Edit.NewEnd; ++I)
+			NewIds.emplace_back(m_interner.Intern(Lines[I]));
+		Ids.erase(Ids.begin() + Edit.Begin, Ids.begin() + Edit.OldEnd);
+		Ids.insert(Ids.begin() + Edit.Begin, NewIds.begin(), NewIds.end());
+	}
+
 	void ScheduleDiffRefresh(ActivePane PluginPane = ActivePane::None)
 	{
 		if (PluginPane != ActivePane::None)
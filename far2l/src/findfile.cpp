@@ -78,6 +78,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "SafeMMap.hpp"
 #include <atomic>
 #include <algorithm>
+#include <mutex>
+#include <optional>
 #include <fcntl.h>
 
 // mmap'ed window size limit, must be multiple of any sane page size (0x1000 on intel)
@@ -212,6 +214,13 @@ public:
 		strFindMessage = From;
 	}
 
+	// makes own copy of string, so can be used from any thread
+	void SetFindMessage(const wchar_t *From)
+	{
+		CriticalSectionLock Lock(DataCS);
+		strFindMessage = From;
+	}
+
 	void GetFindListItem(size_t index, FINDLIST &Item)
 	{
 		CriticalSectionLock Lock(DataCS);
@@ -326,6 +335,9 @@ static FARString strLastDirName;
 static FARString strPluginSearchPath;
 
 static std::unique_ptr<ThreadedWorkQueue> pWorkQueue;
+static std::unique_ptr<ThreadedWorkQueue> pArcWorkQueue;	// opens and walks archives concurrently
+static std::vector<Plugin *> ThreadSafeArcPlugins;
+static bool ArcSearchFallback = true;	// there are plugins that can't be used by archive search workers
 static std::unique_ptr<MountInfo> pMountInfo;
 // static CriticalSection PluginCS;
 
@@ -355,6 +367,40 @@ public:
 
 bool PluginLocker::s_locked = false;
 
+// State of archive being walked by archive search worker thread. Such worker walks
+// own plugin handle of thread-safe plugin and doesn't touch globals that describe
+// archive walked by find thread. Found items are collected and reported by find
+// thread after archive completed, so they aren't mixed with other archives' items.
+struct ConcurrentArcScan
+{
+	struct FoundItem
+	{
+		std::wstring FullName;
+		FAR_FIND_DATA_EX FindData;
+	};
+
+	HANDLE hPlugin = INVALID_HANDLE_VALUE;
+	size_t ArcIndex = LIST_INDEX_NONE;
+	FARString strSearchPath;
+	std::vector<FoundItem> Found;
+	std::vector<std::wstring> NestedArchives;	// to be searched by find thread
+};
+
+static thread_local ConcurrentArcScan *tConcurrentArcScan = nullptr;
+
+// Locks plugins calls of find thread, while archive search workers use thread-safe plugins without locking
+class PluginScanLocker
+{
+	std::optional<PluginLocker> _locker;
+
+public:
+	PluginScanLocker()
+	{
+		if (!tConcurrentArcScan)
+			_locker.emplace();
+	}
+};
+
 static std::atomic<bool> PauseFlag{false}, StopFlag{false};
 
 static bool UseFilter = false;
@@ -372,6 +418,16 @@ static CFileMask FileMaskForFindFile;
 
 static FileFilter *Filter;
 
+// Filter and FileMaskForFindFile are shared by find thread with archive search workers
+static std::mutex FilterMutex;
+
+template <class FIND_DATA_T>
+static bool FileInFilterLocked(const FIND_DATA_T &FindData, enumFileInFilterType *foundType = nullptr)
+{
+	std::lock_guard<std::mutex> lock(FilterMutex);
+	return Filter->FileInFilter(FindData, foundType);
+}
+
 enum ADVANCEDDLG
 {
 	AD_DOUBLEBOX,
@@ -1138,14 +1194,17 @@ static void AnalyzeFileItem(HANDLE hDlg, PluginPanelItem *FileItem, const wchar_
 	if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 && !Opt.FindOpt.FindFolders)
 		return;
 
-	if (!FileMaskForFindFile.Compare(FileName, !Opt.FindOpt.FindCaseSensitiveFileMask))
-		return;
+	{
+		std::lock_guard<std::mutex> lock(FilterMutex);
+		if (!FileMaskForFindFile.Compare(FileName, !Opt.FindOpt.FindCaseSensitiveFileMask))
+			return;
+	}
 
-	size_t ArcIndex = itd.GetFindFileArcIndex();
+	size_t ArcIndex = tConcurrentArcScan ? tConcurrentArcScan->ArcIndex : itd.GetFindFileArcIndex();
 
 	FARString FileToReport = FileName;
 	if (ArcIndex != LIST_INDEX_NONE) {
-		FileToReport.Insert(0, strPluginSearchPath);
+		FileToReport.Insert(0, tConcurrentArcScan ? tConcurrentArcScan->strSearchPath : strPluginSearchPath);
 	} else if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
 
 	{	// If searching files content and file's size smaller than length of searched string's
@@ -1164,7 +1223,9 @@ static void AnalyzeFileItem(HANDLE hDlg, PluginPanelItem *FileItem, const wchar_
 	bool RemoveTemp = false;
 
 	HANDLE hPlugin = INVALID_HANDLE_VALUE;
-	if (ArcIndex != LIST_INDEX_NONE) {
+	if (tConcurrentArcScan) {
+		hPlugin = tConcurrentArcScan->hPlugin;
+	} else if (ArcIndex != LIST_INDEX_NONE) {
 		ARCLIST ArcItem;
 		itd.GetArcListItem(ArcIndex, ArcItem);
 		hPlugin = ArcItem.hPlugin;
@@ -1191,7 +1252,8 @@ static void AnalyzeFileItem(HANDLE hDlg, PluginPanelItem *FileItem, const wchar_
 	} else
 		FileToScan = FileName;
 
-	if (pMountInfo->IsMultiThreadFriendly(FileToScan.GetMB())) {
+	// archive search worker is already one of parallel threads, so it scans by itself
+	if (!tConcurrentArcScan && pMountInfo->IsMultiThreadFriendly(FileToScan.GetMB())) {
 		ScanFileWorkItem *wi = new (std::nothrow)
 				ScanFileWorkItem(hDlg, FileToScan, FileToReport, RemoveTemp, FindData, ArcIndex);
 		if (wi) {	// do file contents scan and following logic asynchronously
@@ -2030,7 +2092,9 @@ static int AddMenuRecordSynched(HANDLE hDlg, const wchar_t *FullName, const FAR_
 
 static void AddMenuRecord(HANDLE hDlg, const wchar_t *FullName, const FAR_FIND_DATA_EX &FindData, size_t ArcIndex)
 {
-	if (!hDlg) {
+	if (tConcurrentArcScan) {
+		tConcurrentArcScan->Found.emplace_back(ConcurrentArcScan::FoundItem{FullName, FindData});
+	} else if (!hDlg) {
 		fprintf(stderr, "%s: !hDlg\n", __FUNCTION__);
 	} else if (InterThreadCall<int, -1>(std::bind(AddMenuRecordSynched, hDlg, FullName, FindData, ArcIndex)) < 0) {
 		fprintf(stderr, "%s: InterThreadCall failed\n", __FUNCTION__);
@@ -2108,6 +2172,123 @@ static void ArchiveSearch(HANDLE hDlg, const wchar_t *ArcName)
 	SearchMode = SaveSearchMode;
 }
 
+static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &RecurseLevel);
+
+// Opens archive by thread-safe plugin and walks it within archive search worker thread.
+// Archive not recognized by thread-safe plugins is searched by find thread as usually.
+// Items destroyed by find thread in same order as queued, so results keep order of archives.
+class ArchiveSearchWorkItem : public IThreadedWorkItem
+{
+	HANDLE _hDlg;
+	std::wstring _ArcName;
+	bool _Opened = false;
+	ConcurrentArcScan _Scan;
+
+public:
+	ArchiveSearchWorkItem(HANDLE hDlg, const wchar_t *ArcName)
+		:
+		_hDlg(hDlg), _ArcName(ArcName)
+	{}
+
+	virtual ~ArchiveSearchWorkItem()
+	{
+		if (!_Opened) {
+			if (ArcSearchFallback && !StopFlag)
+				ArchiveSearch(_hDlg, _ArcName.c_str());
+			return;
+		}
+
+		if (!_Scan.Found.empty()) {
+			strLastDirName.Clear();
+			for (const auto &Item : _Scan.Found)
+				AddMenuRecord(_hDlg, Item.FullName.c_str(), Item.FindData, _Scan.ArcIndex);
+		}
+
+		for (const auto &NestedArcName : _Scan.NestedArchives) {
+			if (StopFlag)
+				break;
+			ArchiveSearch(_hDlg, NestedArcName.c_str());
+		}
+	}
+
+	virtual void WorkProc()
+	{
+		if (StopFlag)
+			return;
+
+		SudoClientRegion scr;
+		SudoSilentQueryRegion ssqr;
+		HANDLE hArc = CtrlObject->Plugins.OpenFilePluginConcurrently(_ArcName.c_str(), OPM_FIND,
+				ThreadSafeArcPlugins);
+		if (hArc == INVALID_HANDLE_VALUE)
+			return;
+
+		_Opened = true;
+		OpenPluginInfo Info;
+		CtrlObject->Plugins.GetOpenPluginInfo(hArc, &Info, false);
+		// worker's handle is closed right after walk, so UI will open archive by itself if needed
+		_Scan.ArcIndex = itd.AddArcListItem(_ArcName.c_str(), INVALID_HANDLE_VALUE, Info.Flags, Info.CurDir);
+		if (_Scan.ArcIndex != LIST_INDEX_NONE) {
+			_Scan.hPlugin = hArc;
+			_Scan.strSearchPath = Info.CurDir;
+			if (!_Scan.strSearchPath.IsEmpty())
+				AddEndSlash(_Scan.strSearchPath);
+
+			int RecurseLevel = 0;
+			tConcurrentArcScan = &_Scan;
+			ScanPluginTree(_hDlg, hArc, Info.Flags, RecurseLevel);
+			tConcurrentArcScan = nullptr;
+			_Scan.hPlugin = INVALID_HANDLE_VALUE;
+		}
+
+		CtrlObject->Plugins.ClosePlugin(hArc);
+	}
+};
+
+static void QueueArchiveSearch(HANDLE hDlg, const wchar_t *ArcName)
+{
+	if (pArcWorkQueue) {
+		ArchiveSearchWorkItem *wi = new (std::nothrow) ArchiveSearchWorkItem(hDlg, ArcName);
+		if (wi) {
+			pArcWorkQueue->Queue(wi);
+			return;
+		}
+	}
+
+	ArchiveSearch(hDlg, ArcName);
+}
+
+// Starts archive search workers if there are thread-safe plugins that can open archives,
+// count of workers limits count of archives opened at same time
+struct ArcWorkQueueScope
+{
+	ArcWorkQueueScope()
+	{
+		ArcSearchFallback = true;
+		if (!SearchInArchives)
+			return;
+
+		{
+			PluginLocker Lock;
+			ArcSearchFallback = !CtrlObject->Plugins.GetThreadSafeFilePlugins(ThreadSafeArcPlugins);
+		}
+
+		if (!ThreadSafeArcPlugins.empty()) {
+			pArcWorkQueue.reset(new ThreadedWorkQueue(std::min(BestThreadsCount(), 4u)));
+		}
+	}
+
+	~ArcWorkQueueScope()
+	{
+		if (pArcWorkQueue) {
+			pArcWorkQueue->Finalize();
+			pArcWorkQueue.reset();
+		}
+		ThreadSafeArcPlugins.clear();
+		ArcSearchFallback = true;
+	}
+};
+
 static void DoScanTree(HANDLE hDlg, FARString &strRoot)
 {
 	ScanTree ScTree(FALSE, !(SearchMode == FINDAREA_CURRENT_ONLY || SearchMode == FINDAREA_INPATH),
@@ -2152,7 +2333,7 @@ static void DoScanTree(HANDLE hDlg, FARString &strRoot)
 				if (UseFilter) {
 					enumFileInFilterType foundType;
 
-					if (!Filter->FileInFilter(FindData, &foundType)) {
+					if (!FileInFilterLocked(FindData, &foundType)) {
 						// сюда заходим, если не попали в фильтр или попали в Exclude-фильтр
 						if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 								&& foundType == FIFT_EXCLUDE)
@@ -2184,7 +2365,7 @@ static void DoScanTree(HANDLE hDlg, FARString &strRoot)
 			}
 
 			if (SearchInArchives)
-				ArchiveSearch(hDlg, strFullName);
+				QueueArchiveSearch(hDlg, strFullName);
 		}
 
 		if (SearchMode != FINDAREA_SELECTED)
@@ -2197,9 +2378,12 @@ static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &Recurs
 	PluginPanelItem *PanelData = nullptr;
 	int ItemCount = 0;
 	bool GetFindDataResult = false;
+	// archive search worker walks whole archive from its current directory
+	const int ScanSearchMode = tConcurrentArcScan ? FINDAREA_FROM_CURRENT : SearchMode;
+	FARString &strSearchPath = tConcurrentArcScan ? tConcurrentArcScan->strSearchPath : strPluginSearchPath;
 	{
 		if (!StopFlag) {
-			PluginLocker Lock;
+			PluginScanLocker Lock;
 			GetFindDataResult =
 					CtrlObject->Plugins.GetFindData(hPlugin, &PanelData, &ItemCount, OPM_FIND) != FALSE;
 		}
@@ -2210,7 +2394,7 @@ static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &Recurs
 
 	RecurseLevel++;
 
-	if (SearchMode != FINDAREA_SELECTED || RecurseLevel != 1) {
+	if (ScanSearchMode != FINDAREA_SELECTED || RecurseLevel != 1) {
 		for (int I = 0; I < ItemCount && !StopFlag; I++) {
 			// WINPORT(Sleep)(0);
 			while (PauseFlag)
@@ -2222,55 +2406,59 @@ static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &Recurs
 			if (!StrCmp(strCurName, L".") || TestParentFolderName(strCurName))
 				continue;
 
-			if (!UseFilter || Filter->FileInFilter(CurPanelItem->FindData)) {
+			if (!UseFilter || FileInFilterLocked(CurPanelItem->FindData)) {
 				if (((CurPanelItem->FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 							&& strFindStr.IsEmpty())
 						|| (!(CurPanelItem->FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 								&& !strFindStr.IsEmpty())) {
-					itd.SetFindMessage(strPluginSearchPath + strCurName);
+					itd.SetFindMessage((strSearchPath + strCurName).CPtr());
 				}
 
 				AnalyzeFileItem(hDlg, CurPanelItem, strCurName, CurPanelItem->FindData);
 
-				if (SearchInArchives && (hPlugin != INVALID_HANDLE_VALUE) && (Flags & OPIF_REALNAMES))
-					ArchiveSearch(hDlg, strPluginSearchPath + strCurName);
+				if (SearchInArchives && (hPlugin != INVALID_HANDLE_VALUE) && (Flags & OPIF_REALNAMES)) {
+					if (tConcurrentArcScan) {
+						tConcurrentArcScan->NestedArchives.emplace_back((strSearchPath + strCurName).CPtr());
+					} else
+						ArchiveSearch(hDlg, strSearchPath + strCurName);
+				}
 			}
 		}
 	}
 
-	if (SearchMode != FINDAREA_CURRENT_ONLY) {
+	if (ScanSearchMode != FINDAREA_CURRENT_ONLY) {
 		for (int I = 0; I < ItemCount && !StopFlag; I++) {
 			PluginPanelItem *CurPanelItem = PanelData + I;
 			FARString strCurName = CurPanelItem->FindData.lpwszFileName;
 
 			if ((CurPanelItem->FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 					&& StrCmp(strCurName, L".") && !TestParentFolderName(strCurName)
-					&& (!UseFilter || Filter->FileInFilter(CurPanelItem->FindData))
-					&& (SearchMode != FINDAREA_SELECTED || RecurseLevel != 1
+					&& (!UseFilter || FileInFilterLocked(CurPanelItem->FindData))
+					&& (ScanSearchMode != FINDAREA_SELECTED || RecurseLevel != 1
 							|| CtrlObject->Cp()->ActivePanel->IsSelected(strCurName))) {
 				bool SetDirectoryResult = false;
 				{
-					PluginLocker Lock;
+					PluginScanLocker Lock;
 					SetDirectoryResult =
 							CtrlObject->Plugins.SetDirectory(hPlugin, strCurName, OPM_FIND) != FALSE;
 				}
 				if (SetDirectoryResult) {
-					strPluginSearchPath+= strCurName;
-					strPluginSearchPath+= WGOOD_SLASH;
+					strSearchPath+= strCurName;
+					strSearchPath+= WGOOD_SLASH;
 					ScanPluginTree(hDlg, hPlugin, Flags, RecurseLevel);
 
 					size_t pos = 0;
-					if (strPluginSearchPath.RPos(pos, GOOD_SLASH))
-						strPluginSearchPath.Truncate(pos);
+					if (strSearchPath.RPos(pos, GOOD_SLASH))
+						strSearchPath.Truncate(pos);
 
-					if (strPluginSearchPath.RPos(pos, GOOD_SLASH))
-						strPluginSearchPath.Truncate(pos + 1);
+					if (strSearchPath.RPos(pos, GOOD_SLASH))
+						strSearchPath.Truncate(pos + 1);
 					else
-						strPluginSearchPath.Clear();
+						strSearchPath.Clear();
 
 					bool SetDirectoryResult = false;
 					{
-						PluginLocker Lock;
+						PluginScanLocker Lock;
 						SetDirectoryResult =
 								CtrlObject->Plugins.SetDirectory(hPlugin, L"..", OPM_FIND) != FALSE;
 					}
@@ -2283,7 +2471,7 @@ static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &Recurs
 	}
 
 	{
-		PluginLocker Lock;
+		PluginScanLocker Lock;
 		CtrlObject->Plugins.FreeFindData(hPlugin, PanelData, ItemCount);
 	}
 	RecurseLevel--;
@@ -2292,6 +2480,7 @@ static void ScanPluginTree(HANDLE hDlg, HANDLE hPlugin, DWORD Flags, int &Recurs
 static void DoPrepareFileList(HANDLE hDlg)
 {
 	ThreadedWorkQueuePtrScope wqs(pWorkQueue);
+	ArcWorkQueueScope aqs;
 	FARString strRoot;
 	CtrlObject->CmdLine->GetCurDir(strRoot);
 
@@ -33,15 +33,70 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "headers.hpp"
 #include <algorithm>
+#include <sys/file.h>
 
 #include "poscache.hpp"
 #include "udlist.hpp"
 #include "config.hpp"
 #include "ConfigOptSaveLoad.hpp"
+#include "KeyFileHelper.h"
+#include "ScopeHelpers.h"
+
+/*
+	Log file consists of records, each one is PosRecordHeader followed by key,
+	then by ParCount of Param values and then by PosCount[i] values of each Position[i].
+	Record with all counts zero removes its key. Record with mismatching check value
+	is a tail being written by other instance or remains of interrupted write, so
+	parsing stops on it and continues from there next time.
+*/
+#define POSCACHE_DB_SIGNATURE 0x31425050	// 'PPB1'
+
+struct PosRecordHeader
+{
+	uint32_t Signature;
+	uint32_t Check;		// FNV-1a of record with this field zeroed
+	uint64_t TS;
+	uint16_t KeyLen;
+	unsigned char ParCount;
+	unsigned char PosCount[POSCACHE_POSITION_COUNT];
+	unsigned char Reserved;
+};
+
+static uint32_t PosRecordCheck(const void *data, size_t len, uint32_t hash = 0x811c9dc5)
+{
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ ((const unsigned char *)data)[i]) * 0x01000193;
+	}
+	return hash;
+}
+
+static void AppendPosRecord(std::string &out, const std::string &key, const unsigned char ParCount,
+		const unsigned char *PosCount, const DWORD64 *values)
+{
+	PosRecordHeader hdr{};
+	hdr.Signature = POSCACHE_DB_SIGNATURE;
+	hdr.TS = time(NULL);
+	hdr.KeyLen = (uint16_t)key.size();
+	hdr.ParCount = ParCount;
+	size_t values_count = ParCount;
+	for (size_t i = 0; i < POSCACHE_POSITION_COUNT; ++i) {
+		hdr.PosCount[i] = PosCount ? PosCount[i] : 0;
+		values_count+= hdr.PosCount[i];
+	}
+
+	uint32_t check = PosRecordCheck(&hdr, sizeof(hdr));
+	check = PosRecordCheck(key.data(), key.size(), check);
+	check = PosRecordCheck(values, values_count * sizeof(DWORD64), check);
+	hdr.Check = check;
+
+	out.append((const char *)&hdr, sizeof(hdr));
+	out.append(key);
+	out.append((const char *)values, values_count * sizeof(DWORD64));
+}
 
 FilePositionCache::FilePositionCache(FilePositionCacheKind kind)
 	:
-	_kind(kind), _kf_path(InMyConfig((kind == FPCK_VIEWER) ? "history/viewer.pos" : "history/editor.pos"))
+	_kind(kind), _db_path(InMyConfig((kind == FPCK_VIEWER) ? "history/viewer.posdb" : "history/editor.posdb"))
 {}
 
 FilePositionCache::~FilePositionCache()
@@ -49,37 +104,265 @@ FilePositionCache::~FilePositionCache()
 	CheckForSave();
 }
 
+bool FilePositionCache::SaveEnabled() const
+{
+	return (_kind == FPCK_VIEWER && Opt.ViOpt.SavePos) || (_kind == FPCK_EDITOR && Opt.EdOpt.SavePos);
+}
+
+void FilePositionCache::Initialize()
+{
+	if (_initialized) {
+		return;
+	}
+	_initialized = true;
+
+	FDScope fd(_db_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd.Valid()) {
+		Refresh(fd);
+
+	} else if (errno == ENOENT) {
+		// positions of previous versions are imported once, original file is left untouched
+		ImportKeyFile(InMyConfig((_kind == FPCK_VIEWER) ? "history/viewer.pos" : "history/editor.pos"));
+	}
+}
+
+void FilePositionCache::ImportKeyFile(const std::string &kf_path)
+{
+	KeyFileHelper kfh(kf_path, true);
+	std::vector<std::string> sections = kfh.EnumSections();
+	std::vector<std::pair<unsigned long long, const std::string *>> ordered;
+	ordered.reserve(sections.size());
+	for (const auto &section : sections) {
+		ordered.emplace_back(kfh.GetULL(section, "TS", 0), &section);
+	}
+	std::sort(ordered.begin(), ordered.end());
+
+	for (const auto &it : ordered) {
+		const KeyFileValues *values = kfh.GetSectionValues(*it.second);
+		if (!values) {
+			continue;
+		}
+
+		DWORD64 par[POSCACHE_PARAM_COUNT]{};
+		size_t len = values->GetBytes((unsigned char *)&par[0], sizeof(par), "Par");
+		Entry &e = PutEntry(*it.second);
+		e.ParCount = (unsigned char)(len / sizeof(DWORD64));
+		e.Values.assign(&par[0], &par[e.ParCount]);
+		for (unsigned int i = 0; i < POSCACHE_POSITION_COUNT; ++i) {
+			DWORD64 pos[POSCACHE_BOOKMARK_COUNT];
+			char key[64];
+			snprintf(key, sizeof(key), "Pos%u", i);
+			len = values->GetBytes((unsigned char *)&pos[0], sizeof(pos), key);
+			e.PosCount[i] = (unsigned char)(len / sizeof(DWORD64));
+			e.Values.insert(e.Values.end(), &pos[0], &pos[e.PosCount[i]]);
+		}
+		e.Unsaved = true;
+		_unsaved = true;
+	}
+
+	ApplyElementsLimit();
+}
+
+FilePositionCache::Entry &FilePositionCache::PutEntry(const std::string &key)
+{
+	auto ir = _entries.emplace(key, Entry{});
+	Entry &e = ir.first->second;
+	if (ir.second) {
+		_recent.emplace_front(key);
+	} else {
+		_recent.erase(e.Recent);
+		_recent.emplace_front(key);
+	}
+	e.Recent = _recent.begin();
+	e.Unsaved = false;
+	return e;
+}
+
+void FilePositionCache::RemoveEntry(const std::string &key)
+{
+	auto it = _entries.find(key);
+	if (it != _entries.end()) {
+		_recent.erase(it->second.Recent);
+		_entries.erase(it);
+	}
+}
+
 void FilePositionCache::ApplyElementsLimit()
 {
 	ConfigOptAssertLoaded();
-	int MaxPositionCache = Opt.MaxPositionCache;
+	const size_t MaxPositionCache = (size_t)std::max(Opt.MaxPositionCache, 0);
+
+	while (_entries.size() > MaxPositionCache) {
+		_entries.erase(_recent.back());
+		_recent.pop_back();
+	}
+}
+
+bool FilePositionCache::ParseRecords(const char *data, size_t len, size_t &parsed)
+{
+	parsed = 0;
+	while (len - parsed >= sizeof(PosRecordHeader)) {
+		PosRecordHeader hdr;
+		memcpy(&hdr, data + parsed, sizeof(hdr));
+		size_t values_count = hdr.ParCount;
+		for (size_t i = 0; i < POSCACHE_POSITION_COUNT; ++i) {
+			values_count+= hdr.PosCount[i];
+		}
+		const size_t rec_len = sizeof(hdr) + hdr.KeyLen + values_count * sizeof(DWORD64);
+		if (hdr.Signature != POSCACHE_DB_SIGNATURE || hdr.ParCount > POSCACHE_PARAM_COUNT
+				|| values_count > POSCACHE_PARAM_COUNT + POSCACHE_POSITION_COUNT * POSCACHE_BOOKMARK_COUNT
+				|| rec_len > len - parsed) {
+			return false;
+		}
+
+		const uint32_t check = hdr.Check;
+		hdr.Check = 0;
+		if (PosRecordCheck(data + parsed + sizeof(hdr), rec_len - sizeof(hdr), PosRecordCheck(&hdr, sizeof(hdr)))
+				!= check) {
+			return false;
+		}
+
+		const std::string key(data + parsed + sizeof(hdr), hdr.KeyLen);
+		auto it = _entries.find(key);
+		if (it == _entries.end() || !it->second.Unsaved) { // own not yet saved changes are newer
+			if (values_count) {
+				Entry &e = PutEntry(key);
+				e.ParCount = hdr.ParCount;
+				memcpy(e.PosCount, hdr.PosCount, sizeof(e.PosCount));
+				const DWORD64 *values = (const DWORD64 *)(data + parsed + sizeof(hdr) + hdr.KeyLen);
+				e.Values.resize(values_count);
+				memcpy(e.Values.data(), values, values_count * sizeof(DWORD64));
+			} else {
+				RemoveEntry(key);
+			}
+		}
 
-	if ((int)_kfh->SectionsCount() > MaxPositionCache + MaxPositionCache / 4 + 16) {
-		std::vector<std::string> sections = _kfh->EnumSections();
-		std::sort(sections.begin(), sections.end(), [&](const std::string &a, const std::string &b) -> bool {
-			return _kfh->GetULL(a, "TS", 0) < _kfh->GetULL(b, "TS", 0);
-		});
+		parsed+= rec_len;
+		++_db_records;
+	}
+
+	return true;
+}
+
+void FilePositionCache::Refresh(int fd)
+{
+	struct stat s{};
+	if (fstat(fd, &s) == -1) {
+		return;
+	}
+
+	if (s.st_dev != _db_dev || s.st_ino != _db_ino || s.st_size < _db_parsed) {
+		// file was compacted or replaced: forget everything except own unsaved changes
+		for (auto it = _entries.begin(); it != _entries.end();) {
+			if (it->second.Unsaved) {
+				++it;
+			} else {
+				_recent.erase(it->second.Recent);
+				it = _entries.erase(it);
+			}
+		}
+		_db_dev = s.st_dev;
+		_db_ino = s.st_ino;
+		_db_parsed = 0;
+		_db_records = 0;
+	}
 
-		int cnt = (int)sections.size() - MaxPositionCache;
-		for (int i = 0; i < cnt; ++i) {
-			_kfh->RemoveSection(sections[i]);
+	if (s.st_size > _db_parsed) {
+		std::string data(size_t(s.st_size - _db_parsed), 0);
+		const ssize_t r = pread(fd, &data[0], data.size(), _db_parsed);
+		if (r > 0) {
+			size_t parsed = 0;
+			ParseRecords(data.data(), size_t(r), parsed);
+			_db_parsed+= parsed;
 		}
 	}
+
+	ApplyElementsLimit();
+}
+
+void FilePositionCache::Compact()
+{
+	std::string content;
+	for (auto it = _recent.rbegin(); it != _recent.rend(); ++it) {
+		const Entry &e = _entries[*it];
+		AppendPosRecord(content, *it, e.ParCount, e.PosCount, e.Values.data());
+	}
+
+	const std::string tmp = StrPrintf("%s.%u", _db_path.c_str(), getpid());
+	if (!WriteWholeFile(tmp.c_str(), content, 0600) || rename(tmp.c_str(), _db_path.c_str()) == -1) {
+		fprintf(stderr, "FilePositionCache: errno=%u while compacting '%s'\n", errno, _db_path.c_str());
+		unlink(tmp.c_str());
+		return;
+	}
+
+	// content of new file is exactly what we have, so just switch to it
+	struct stat s{};
+	if (stat(_db_path.c_str(), &s) == 0) {
+		_db_dev = s.st_dev;
+		_db_ino = s.st_ino;
+		_db_parsed = s.st_size;
+		_db_records = _entries.size();
+	}
 }
 
 void FilePositionCache::CheckForSave()
 {
-	// If saving enabled then save _kfh to file and release,
-	// so other instances will see changes immediately and our instance
-	// will see other's changes too.
-	// If save is disabled then keep _kfh - it will serve as in memory
-	// storage for our instance lifetime or until user will enable saving.
+	// If saving enabled then append own changes to log file, catching up changes
+	// made by other instances first, so everyone sees each other's changes.
+	// If save is disabled then changes are kept in memory for our instance
+	// lifetime or until user will enable saving.
+
+	if (!_unsaved || !SaveEnabled()) {
+		return;
+	}
 
-	if (_kfh
-			&& ((_kind == FPCK_VIEWER && Opt.ViOpt.SavePos) || (_kind == FPCK_EDITOR && Opt.EdOpt.SavePos))) {
-		if (_kfh->Save()) {
-			_kfh.reset();
+	FDScope fd;
+	for (;;) {
+		fd = open(_db_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (!fd.Valid() || flock(fd, LOCK_EX) == -1) {
+			fprintf(stderr, "FilePositionCache: errno=%u while opening '%s'\n", errno, _db_path.c_str());
+			return;
 		}
+		// other instance could replace file while we were waiting for lock
+		struct stat s_fd{}, s_path{};
+		if (fstat(fd, &s_fd) == 0 && stat(_db_path.c_str(), &s_path) == 0
+				&& s_fd.st_dev == s_path.st_dev && s_fd.st_ino == s_path.st_ino) {
+			break;
+		}
+	}
+
+	Refresh(fd);
+
+	std::string content;
+	std::vector<std::string> removed;
+	size_t appended = 0;
+	for (auto &it : _entries) {
+		if (it.second.Unsaved) {
+			Entry &e = it.second;
+			AppendPosRecord(content, it.first, e.ParCount, e.PosCount, e.Values.data());
+			++appended;
+			e.Unsaved = false;
+			if (e.Values.empty()) {
+				removed.emplace_back(it.first);
+			}
+		}
+	}
+	for (const auto &key : removed) {
+		RemoveEntry(key);
+	}
+
+	// drop incomplete tail, if any, before appending after it
+	if (ftruncate(fd, _db_parsed) == -1
+			|| pwrite(fd, content.data(), content.size(), _db_parsed) != (ssize_t)content.size()) {
+		fprintf(stderr, "FilePositionCache: errno=%u while writing '%s'\n", errno, _db_path.c_str());
+		return;
+	}
+
+	_unsaved = false;
+	_db_parsed+= content.size();
+	_db_records+= appended;
+	if (_db_records > _entries.size() * 2 + 64) {
+		Compact();
 	}
 }
 
@@ -123,98 +406,91 @@ static size_t PositionCountToSave(const DWORD64 *position)
 
 void FilePositionCache::AddPosition(const wchar_t *name, PosCache &poscache)
 {
-	if (!_kfh) {
-		_kfh.reset(new KeyFileHelper(_kf_path));
-	}
+	Initialize();
 
-	ApplyElementsLimit();
-
-	bool have_some_to_save = true;
-	std::string section;
-	MakeSectionName(name, section);
-
-	size_t save_count = ParamCountToSave(poscache.Param);
-	if (save_count) {
-		_kfh->SetBytes(section, "Par", (unsigned char *)&poscache.Param[0],
-				save_count * sizeof(poscache.Param[0]));
+	std::string key;
+	MakeSectionName(name, key);
+	if (key.size() > 0xffff) {
+		return;
+	}
 
-	} else {
-		have_some_to_save = false;
-		for (unsigned int i = 0; i < ARRAYSIZE(poscache.Position); ++i) {
-			if (PositionCountToSave(poscache.Position[i])) {
-				have_some_to_save = true;
-				break;
-			}
-		}
-		if (have_some_to_save) {
-			_kfh->RemoveKey(section, "Par");
-		}
+	unsigned char pos_count[POSCACHE_POSITION_COUNT];
+	size_t values_count = ParamCountToSave(poscache.Param);
+	const unsigned char par_count = (unsigned char)values_count;
+	for (unsigned int i = 0; i < ARRAYSIZE(poscache.Position); ++i) {
+		pos_count[i] = (unsigned char)PositionCountToSave(poscache.Position[i]);
+		values_count+= pos_count[i];
 	}
 
-	if (have_some_to_save) {
+	Entry &e = PutEntry(key);
+	e.ParCount = par_count;
+	memcpy(e.PosCount, pos_count, sizeof(e.PosCount));
+	e.Values.clear();
+	if (values_count) {
+		e.Values.reserve(values_count);
+		e.Values.insert(e.Values.end(), &poscache.Param[0], &poscache.Param[par_count]);
 		for (unsigned int i = 0; i < ARRAYSIZE(poscache.Position); ++i) {
-			char key[64];
-			snprintf(key, sizeof(key), "Pos%u", i);
-			save_count = PositionCountToSave(poscache.Position[i]);
-			if (save_count) {
-				_kfh->SetBytes(section, key, (unsigned char *)poscache.Position[i],
-						save_count * sizeof(poscache.Position[i][0]));
-			} else {
-				_kfh->RemoveKey(section, key);
+			if (pos_count[i]) {
+				e.Values.insert(e.Values.end(), poscache.Position[i], poscache.Position[i] + pos_count[i]);
 			}
 		}
-
-		_kfh->SetULL(section, "TS", time(NULL));
-
-	} else {
-		_kfh->RemoveSection(section);
 	}
+	e.Unsaved = true;
+	_unsaved = true;
 
+	ApplyElementsLimit();
 	CheckForSave();
 }
 
 bool FilePositionCache::GetPosition(const wchar_t *name, PosCache &poscache)
 {
-	std::string section;
-	MakeSectionName(name, section);
+	Initialize();
 
-	std::unique_ptr<KeyFileReadSection> tmp_kfrs;
-	const KeyFileValues *values;
-	if (_kfh) {
-		values = _kfh->GetSectionValues(section);
-		if (!values) {
-			return false;
+	{ // catch up changes made by other instances
+		FDScope fd(_db_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd.Valid()) {
+			Refresh(fd);
 		}
+	}
 
-	} else {
-		tmp_kfrs.reset(new KeyFileReadSection(_kf_path, section));
-		if (!tmp_kfrs->SectionLoaded()) {
-			return false;
-		}
-		values = tmp_kfrs.get();
+	std::string key;
+	MakeSectionName(name, key);
+
+	auto it = _entries.find(key);
+	if (it == _entries.end() || it->second.Values.empty()) {
+		return false;
 	}
 
+	const Entry &e = it->second;
+	const DWORD64 *values = e.Values.data();
+
 	memset(&poscache.Param[0], 0, sizeof(poscache.Param));
-	values->GetBytes((unsigned char *)&poscache.Param[0], sizeof(poscache.Param), "Par");
+	memcpy(&poscache.Param[0], values, e.ParCount * sizeof(DWORD64));
+	values+= e.ParCount;
 
-	for (unsigned int i = 0; i < ARRAYSIZE(poscache.Position); ++i)
+	for (unsigned int i = 0; i < ARRAYSIZE(poscache.Position); ++i) {
 		if (poscache.Position[i]) {
 			memset(poscache.Position[i], 0xff, sizeof(poscache.Position[i][0]) * POSCACHE_BOOKMARK_COUNT);
-			char key[64];
-			snprintf(key, sizeof(key), "Pos%u", i);
-			values->GetBytes((unsigned char *)poscache.Position[i],
-					sizeof(poscache.Position[i][0]) * POSCACHE_BOOKMARK_COUNT, key);
+			memcpy(poscache.Position[i], values, std::min(e.PosCount[i], (unsigned char)POSCACHE_BOOKMARK_COUNT) * sizeof(DWORD64));
 		}
+		values+= e.PosCount[i];
+	}
 
 	return true;
 }
 
 void FilePositionCache::ResetPosition(const wchar_t *name)
 {
-	std::string section;
-	MakeSectionName(name, section);
-	if (!_kfh) {
-		_kfh.reset(new KeyFileHelper(_kf_path));
+	Initialize();
+
+	std::string key;
+	MakeSectionName(name, key);
+	auto it = _entries.find(key);
+	if (it != _entries.end()) {
+		it->second.Values.clear();
+		it->second.ParCount = 0;
+		memset(it->second.PosCount, 0, sizeof(it->second.PosCount));
+		it->second.Unsaved = true;
+		_unsaved = true;
 	}
-	_kfh->RemoveSection(section);
 }
@@ -1,5 +1,8 @@
 #pragma once
-#include "KeyFileHelper.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 /*
 poscache.hpp
 
@@ -89,14 +92,41 @@ enum FilePositionCacheKind
 	FPCK_EDITOR,
 };
 
+// Positions are kept in binary append-only log that is indexed in memory by hashed lookup.
+// Each change appends single record, so concurrently running instances merge their changes
+// record by record and log gets compacted once it accumulates too many outdated records.
 class FilePositionCache
 {
 private:
+	struct Entry
+	{
+		unsigned char ParCount;
+		unsigned char PosCount[POSCACHE_POSITION_COUNT];
+		bool Unsaved;
+		std::vector<DWORD64> Values;
+		std::list<std::string>::iterator Recent;
+	};
+
 	FilePositionCacheKind _kind;
-	std::string _kf_path;
-	std::unique_ptr<KeyFileHelper> _kfh;
+	std::string _db_path;
+	std::unordered_map<std::string, Entry> _entries;
+	std::list<std::string> _recent;	// most recently used go first
+	dev_t _db_dev{};
+	ino_t _db_ino{};
+	off_t _db_parsed{};
+	size_t _db_records{};
+	bool _initialized{false};
+	bool _unsaved{false};
 
+	bool SaveEnabled() const;
+	void Initialize();
+	void ImportKeyFile(const std::string &kf_path);
+	Entry &PutEntry(const std::string &key);
+	void RemoveEntry(const std::string &key);
 	void ApplyElementsLimit();
+	bool ParseRecords(const char *data, size_t len, size_t &parsed);
+	void Refresh(int fd);
+	void Compact();
 	void CheckForSave();
 
 public:
@@ -740,6 +740,8 @@ void Manager::ProcessMainLoop()
 			ProcessMouse(&mer);
 		} else
 			ProcessKey(Key);
+
+		WINPORT(TraceConsoleLatency)(CONSOLE_LATENCY_DISPATCHED);
 	}
 }
 
@@ -1,18 +1,166 @@
 #include "headers.hpp"
 #include "GitTools.hpp"
+#include <sys/stat.h>
+#include <unordered_map>
+
+// Branch name is resolved natively by reading HEAD of repository found by walking
+// up from given path, so prompt redraws never spawn git. Results are cached per
+// git directory and revalidated by HEAD's stat, git always replaces HEAD via rename
+// so any change gives it new inode and modification time.
+namespace
+{
+    struct FileStamp
+    {
+        dev_t dev{};
+        ino_t ino{};
+        off_t size{};
+        struct timespec mtim{};
+
+        FileStamp() = default;
+        FileStamp(const struct stat &s)
+            : dev(s.st_dev), ino(s.st_ino), size(s.st_size), mtim(s.st_mtim) {}
+
+        bool operator==(const FileStamp &other) const
+        {
+            return dev == other.dev && ino == other.ino && size == other.size
+                && mtim.tv_sec == other.mtim.tv_sec && mtim.tv_nsec == other.mtim.tv_nsec;
+        }
+    };
+
+    struct CachedGitFile // '.git' file of worktree or submodule
+    {
+        FileStamp stamp;
+        std::string gitdir;
+    };
+
+    struct CachedHead
+    {
+        FileStamp stamp;
+        std::string branch;
+    };
+
+    std::unordered_map<std::string, CachedGitFile> s_git_files;
+    std::unordered_map<std::string, CachedHead> s_heads;
+
+    // Resolves 'gitdir: <path>' redirection of .git file, relative path is relative to file's directory
+    bool ResolveGitFile(const std::string &dir, const std::string &git_file, const struct stat &s, std::string &gitdir)
+    {
+        const FileStamp stamp(s);
+        auto it = s_git_files.find(git_file);
+        if (it != s_git_files.end() && it->second.stamp == stamp) {
+            gitdir = it->second.gitdir;
+            return !gitdir.empty();
+        }
+
+        std::string content;
+        if (!ReadWholeFile(git_file.c_str(), content, 0x1000)) {
+            return false;
+        }
+        StrTrim(content, " \t\r\n");
+        if (!StrStartsFrom(content, "gitdir:")) {
+            gitdir.clear();
+        } else {
+            gitdir = content.substr(7);
+            StrTrim(gitdir, " \t");
+            if (!gitdir.empty() && gitdir[0] != '/') {
+                gitdir.insert(0, dir + '/');
+            }
+        }
+        s_git_files[git_file] = CachedGitFile{stamp, gitdir};
+        return !gitdir.empty();
+    }
+
+    // Finds git directory of repository that contains given path, same way as git does it
+    bool FindGitDir(std::string dir, std::string &gitdir)
+    {
+        while (dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+        struct stat s{};
+        while (!dir.empty()) {
+            const std::string git_entry = (dir == "/") ? "/.git" : dir + "/.git";
+            if (stat(git_entry.c_str(), &s) == 0) {
+                if (S_ISDIR(s.st_mode)) {
+                    gitdir = git_entry;
+                    return true;
+                }
+                if (S_ISREG(s.st_mode)) {
+                    return ResolveGitFile(dir, git_entry, s, gitdir);
+                }
+            }
+            if (dir == "/") {
+                break;
+            }
+            const size_t slash = dir.rfind('/');
+            if (slash == std::string::npos) {
+                break;
+            }
+            dir.resize(slash ? slash : 1);
+        }
+        return false;
+    }
+
+    // Gives same output as 'git rev-parse --abbrev-ref HEAD' for usual cases
+    bool ReadHeadBranch(const std::string &gitdir, std::string &branch)
+    {
+        const std::string head = gitdir + "/HEAD";
+        struct stat s{};
+        if (stat(head.c_str(), &s) != 0) {
+            s_heads.erase(gitdir);
+            return false;
+        }
+
+        const FileStamp stamp(s);
+        auto it = s_heads.find(gitdir);
+        if (it != s_heads.end() && it->second.stamp == stamp) {
+            branch = it->second.branch;
+            return !branch.empty();
+        }
+
+        std::string content;
+        if (!ReadWholeFile(head.c_str(), content, 0x1000)) {
+            return false;
+        }
+        StrTrim(content, " \t\r\n");
+        if (StrStartsFrom(content, "ref:")) {
+            branch = content.substr(4);
+            StrTrim(branch, " \t");
+            if (StrStartsFrom(branch, "refs/heads/")) {
+                branch.erase(0, 11);
+            } else if (StrStartsFrom(branch, "refs/")) {
+                branch.erase(0, 5);
+            }
+        } else if (!content.empty()) {
+            branch = "HEAD"; // detached
+        } else {
+            branch.clear();
+        }
+        s_heads[gitdir] = CachedHead{stamp, branch};
+        return !branch.empty();
+    }
+}
 
 FARString GetGitBranchName(FARString const &path)
 {
     try {
-        std::string cmd = "git -C \"";
-        cmd += EscapeCmdStr(path.GetMB());
-        cmd += "\" rev-parse --abbrev-ref HEAD";
-
         std::string branchName;
-        if (!POpen(branchName, cmd.c_str()))
-            return {};
+        if (getenv("GIT_DIR")) {
+            // repository explicitly overridden by environment, let git itself handle it
+            std::string cmd = "git -C \"";
+            cmd += EscapeCmdStr(path.GetMB());
+            cmd += "\" rev-parse --abbrev-ref HEAD";
+
+            if (!POpen(branchName, cmd.c_str()))
+                return {};
+
+            StrTrim(branchName, " \t\r\n");
+
+        } else {
+            std::string gitdir;
+            if (!FindGitDir(path.GetMB(), gitdir) || !ReadHeadBranch(gitdir, branchName))
+                return {};
+        }
 
-        StrTrim(branchName, " \t\r\n");
         if (branchName.empty())
             return {};
 
@@ -24,4 +172,4 @@ FARString GetGitBranchName(FARString const &path)
     } catch (const std::exception &e) {
         return {};
     }
-}
\ No newline at end of file
+}
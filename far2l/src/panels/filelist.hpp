@@ -318,6 +318,7 @@ public:
 		Используется для Update после исполнения команды.
 	*/
 	virtual int UpdateIfChanged(int UpdateMode);
+	virtual DWORD UpdateIfChangedTimeout();
 
 	/*
 		$ 19.03.2002 DJ
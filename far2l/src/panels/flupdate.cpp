@@ -55,6 +55,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "dirmix.hpp"
 #include "strmix.hpp"
 #include "mix.hpp"
+#include "treelist.hpp"
+#include <algorithm>
 
 // Флаги для ReadDiz()
 enum ReadDizFlags
@@ -472,6 +474,42 @@ void FileList::ReadFileNames(int KeepSelection, int IgnoreVisible, int DrawMessa
 	FarChDir(strSaveDir);	//???
 }
 
+static void GetSubdirNames(ListDataVec &List, std::vector<std::wstring> &Names)
+{
+	for (int i = 0; i < List.Count(); ++i) {
+		const FileListItem *Item = List[i];
+		if ((Item->FileAttr & FILE_ATTRIBUTE_DIRECTORY) && !TestParentFolderName(Item->strName))
+			Names.emplace_back(Item->strName.CPtr());
+	}
+	std::sort(Names.begin(), Names.end());
+}
+
+// Passes subdirectories created or removed by someone else to tree cache, so tree panel
+// sees them without rescan. Changes done by far2l itself are already there.
+static void ApplySubdirsChanges(const FARString &strDir, const std::vector<std::wstring> &OldNames,
+		const std::vector<std::wstring> &NewNames)
+{
+	std::vector<std::wstring> Added, Removed;
+	std::set_difference(NewNames.begin(), NewNames.end(), OldNames.begin(), OldNames.end(),
+			std::back_inserter(Added));
+	std::set_difference(OldNames.begin(), OldNames.end(), NewNames.begin(), NewNames.end(),
+			std::back_inserter(Removed));
+
+	FARString strPath;
+	for (const auto &Name : Removed) {
+		strPath = strDir;
+		AddEndSlash(strPath);
+		strPath+= Name.c_str();
+		TreeList::DelTreeName(strPath);
+	}
+	for (const auto &Name : Added) {
+		strPath = strDir;
+		AddEndSlash(strPath);
+		strPath+= Name.c_str();
+		TreeList::AddTreeName(strPath);
+	}
+}
+
 /*
 	$ 22.06.2001 SKV
 	Добавлен параметр для вызова после исполнения команды.
@@ -493,8 +531,9 @@ int FileList::UpdateIfChanged(int UpdateMode)
 				$ 24.12.2002 VVM
 				! Поменяем логику обновления панелей.
 			*/
+			const bool Notified = (PanelMode == NORMAL_PANEL && ListChange && ListChange->Check());
 			if (	// Нормальная панель, на ней установлено уведомление и есть сигнал
-					(PanelMode == NORMAL_PANEL && ListChange && ListChange->Check()) ||
+					Notified ||
 					// Или Нормальная панель, но нет уведомления и мы попросили обновить через UPDATE_FORCE
 					(PanelMode == NORMAL_PANEL && !ListChange && UpdateMode == UIC_UPDATE_FORCE) ||
 					// Или плагинная панель и обновляем через UPDATE_FORCE
@@ -508,8 +547,18 @@ int FileList::UpdateIfChanged(int UpdateMode)
 						AnotherPanel->Redraw();
 				}
 
+				std::vector<std::wstring> OldSubdirs, NewSubdirs;
+				const FARString strNotifiedDir = strCurDir;
+				if (Notified)
+					GetSubdirNames(ListData, OldSubdirs);
+
 				Update(UPDATE_KEEP_SELECTION);
 
+				if (Notified && strCurDir == strNotifiedDir) {
+					GetSubdirNames(ListData, NewSubdirs);
+					ApplySubdirsChanges(strCurDir, OldSubdirs, NewSubdirs);
+				}
+
 				if (UpdateMode == UIC_UPDATE_NORMAL)
 					Show();
 
@@ -521,6 +570,20 @@ int FileList::UpdateIfChanged(int UpdateMode)
 	return FALSE;
 }
 
+DWORD FileList::UpdateIfChangedTimeout()
+{
+	if (!IsVisible() || (Opt.AutoUpdateLimit && DWORD(ListData.Count()) > Opt.AutoUpdateLimit))
+		return INFINITE;
+
+	// plugin panels get FE_IDLE regularly, normal panel needs update only after change
+	// notification that also kicks input loop, see CreateChangeNotification
+	if (PanelMode == NORMAL_PANEL && !(ListChange && ListChange->Check()))
+		return INFINITE;
+
+	const clock_t Elapsed = GetProcessUptimeMSec() - LastUpdateTime;
+	return (Elapsed > 2000) ? 0 : DWORD(2000 - Elapsed) + 1;
+}
+
 void FileList::CreateChangeNotification(int CheckTree)
 {
 	wchar_t RootDir[4] = L" :/";
@@ -534,7 +597,7 @@ void FileList::CreateChangeNotification(int CheckTree)
 
 	if (Opt.AutoUpdateRemoteDrive || (!Opt.AutoUpdateRemoteDrive && DriveType != DRIVE_REMOTE)) {
 		ListChange.reset();
-		ListChange.reset(IFSNotify_Create(strCurDir.GetMB(), CheckTree != FALSE, FSNW_NAMES_AND_STATS));
+		ListChange.reset(IFSNotify_Create(strCurDir.GetMB(), CheckTree != FALSE, FSNW_NAMES_AND_STATS, KickInputWaiter));
 	}
 }
 
@@ -222,6 +222,9 @@ public:
 		Используется для Update после исполнения команды.
 	*/
 	virtual int UpdateIfChanged(int UpdateMode) { return 0; };
+	// msec after which UpdateIfChanged(UIC_UPDATE_NORMAL) wants to be called from input loop,
+	// INFINITE if there is nothing to update unless some input event wakes up that loop
+	virtual DWORD UpdateIfChangedTimeout() { return INFINITE; };
 	/*
 		$ 19.03.2002 DJ
 		UpdateIfRequired() - обновить, если апдейт был пропущен из-за того,
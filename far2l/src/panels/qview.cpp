@@ -444,6 +444,11 @@ int QuickView::UpdateIfChanged(int UpdateMode)
 	return FALSE;
 }
 
+DWORD QuickView::UpdateIfChangedTimeout()
+{
+	return (IsVisible() && !strCurFileName.IsEmpty() && Directory == 2) ? 1000 : INFINITE;
+}
+
 void QuickView::SetTitle()
 {
 	if (GetFocus()) {
@@ -79,6 +79,7 @@ public:
 	virtual void QViewDelTempName();
 
 	virtual int UpdateIfChanged(int UpdateMode);
+	virtual DWORD UpdateIfChangedTimeout();
 	virtual void SetTitle();
 	virtual FARString &GetTitle(FARString &Title, int SubLen = -1, int TruncSize = 0);
 	virtual void SetFocus();
@@ -80,8 +80,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "filestr.hpp"
 #include "wakeful.hpp"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
 
-static int _cdecl SortCacheList(const void *el1, const void *el2);
 static int StaticSortNumeric;
 static int StaticSortCaseSensitive;
 static int TreeCmp(const wchar_t *Str1, const wchar_t *Str2, int Numeric, int CaseSensitive);
@@ -98,85 +102,327 @@ private:
 	BitFlags &Flags;
 };
 
+struct TreeCacheLess
+{
+	bool operator()(const FARString &a, const FARString &b) const
+	{
+		int r = TreeCmp(a, b, FALSE, FALSE);
+		if (!r)
+			r = TreeCmp(a, b, FALSE, TRUE);
+		return r < 0;
+	}
+};
+
+/*
+	Tree file of some root directory loaded to apply changes made by far2l's own
+	file operations and seen by panels' change notifications without rescanning.
+	Maps full directory names to flags char of tree file records, written back
+	to tree file by FlushCache().
+*/
 static struct TreeListCache
 {
 	FARString strTreeName;
-	wchar_t **ListName;
-	int TreeCount;
-	int TreeSize;
+	FARString strRoot;
+	std::map<FARString, wchar_t, TreeCacheLess> Names;
+	bool Modified = false;
 
-	TreeListCache()
+	void Clean()
 	{
-		ListName = nullptr;
-		TreeCount = 0;
-		TreeSize = 0;
+		Names.clear();
+		Modified = false;
+		strTreeName.Clear();
+		strRoot.Clear();
 	}
 
-	void Resize()
+	// Iterates over Name and its subdirectories, items that differ only by case are skipped
+	template <class CallbackT>
+	void ForEachInSubtree(const FARString &Name, CallbackT Callback)
 	{
-		if (TreeCount == TreeSize) {
-			TreeSize+= TreeSize ? TreeSize >> 2 : 32;
-			wchar_t **NewPtr = (wchar_t **)realloc(ListName, sizeof(wchar_t *) * TreeSize);
+		const int Length = static_cast<int>(Name.GetLength());
+		for (auto it = Names.lower_bound(Name); it != Names.end();) {
+			const wchar_t *DirName = it->first.CPtr();
+			if (StrCmpNI(DirName, Name, Length) || (DirName[Length] && !IsSlash(DirName[Length])))
+				break;
+			auto next = std::next(it);
+			if (!StrCmpN(DirName, Name, Length))
+				Callback(it);
+			it = next;
+		}
+	}
 
-			if (!NewPtr)
-				return;
+} TreeCache, tempTreeCache;
+
+// Nearest directory that has tree file among parents of last looked up path
+static struct TreeRootLookup
+{
+	FARString strDir;
+	FARString strRoot;
+	FARString strTreeName;
+	bool Valid = false;
+} LastTreeRootLookup;
+
+static FARString MkTreeRecord(const FARString &strName, size_t RootLength, wchar_t Flags)
+{
+	FARString line;
+	if (RootLength >= strName.GetLength())
+		line = L"/";
+	else
+		line = strName.CPtr() + RootLength;
+
+	line+= L'\2';
+	line+= Flags;
+	line+= L'\n';
+	return line;
+}
+
+// Invokes Callback(strDirName, Flags) for each record of tree file with given root
+template <class CallbackT>
+static void ParseTreeFile(File &TreeFile, const FARString &strRoot, CallbackT Callback)
+{
+	const size_t RootLength = strRoot.IsEmpty() ? 0 : strRoot.GetLength() - 1;
+	GetFileString GetStr(TreeFile);
+	LPWSTR Record = nullptr;
+	int RecordLength = 0;
+	FARString prefix;
+	if (RootLength)
+		prefix = FARString(strRoot, RootLength);
+
+	std::vector<wchar_t> last_record;
+	size_t last_record_len = 0;
+	while (GetStr.GetString(&Record, CP_WIDE_LE, RecordLength) > 0) {
+		if (!Record || RecordLength <= 0)
+			continue;
+		wchar_t* begin = Record;
+		wchar_t* end   = Record + RecordLength;
 
-			ListName = NewPtr;
+		if (end > begin && *(end - 1) == L'\n')
+			--end;
+
+		size_t record_len = static_cast<size_t>(end - begin);
+		if (!record_len)
+			continue;
+
+		if (record_len == last_record_len &&
+			(last_record_len == 0 || memcmp(begin, last_record.data(), record_len * sizeof(wchar_t)) == 0)) {
+			continue;
+		}
+
+		last_record.assign(begin, end);
+		last_record_len = record_len;
+
+		wchar_t Flags = L'0';
+		if (record_len >= 2 && *(end - 2) == L'\2')
+		{
+			Flags = *(end - 1);
+			end -= 2;
+			record_len -= 2;
+			if (!record_len)
+				continue;
+		}
+
+		FARString strDirName;
+		if (RootLength)
+			strDirName = prefix;
+
+		strDirName.Append(begin, record_len);
+
+		if (RootLength > 0 && strDirName.At(RootLength - 1) != L':' && IsSlash(strDirName.At(RootLength))
+				&& !strDirName.At(RootLength + 1)) {
+			strDirName.Truncate(RootLength);
 		}
+
+		Callback(strDirName, Flags);
 	}
+}
 
-	void Add(const wchar_t *name)
+/*
+	Walks directory tree by several threads for ReadTree and ExpandDirectory.
+	Each thread lists single directory at once and queues found subdirectories,
+	so both wide and deep trees are spread evenly among threads. Descending
+	rules are same as of ScanTree: directories that match exclusion mask or
+	are beyond depth limit are reported as expandable but not scanned, symlinks
+	are scanned only if enabled and if they don't point into scanned path.
+*/
+class ParallelTreeScan
+{
+	struct ScanDir
 	{
-		Resize();
-		ListName[TreeCount++] = wcsdup(name);
-	}
+		FARString strPath;
+		FARString strRealPath;
+		uint64_t UnixDevice{};
+		uint64_t UnixNode{};
+		int Level = 1;
+		std::shared_ptr<const ScanDir> Parent;
+	};
+	typedef std::shared_ptr<const ScanDir> ScanDirPtr;
+
+	const int MaxDepth;
+	const bool ScanSymlinks;
+	const FARString strExclMask;
+
+	std::mutex Mutex;
+	std::condition_variable WorkCond;
+	std::condition_variable DoneCond;
+	std::vector<ScanDirPtr> Pending;
+	std::vector<std::unique_ptr<TreeItem>> Found;
+	size_t Busy = 0;
+	bool Stopping = false;
+	std::atomic<size_t> FoundCount{0};
+	std::vector<std::thread> Threads;
+
+	bool IsDone() const { return Pending.empty() && !Busy; }
 
-	void Insert(int idx, const wchar_t *name)
+	static bool IsRecursion(const ScanDir &Dir)
 	{
-		Resize();
-		memmove(ListName + idx + 1, ListName + idx, sizeof(wchar_t *) * (TreeCount - idx));
-		ListName[idx] = wcsdup(name);
-		TreeCount++;
+		const FARString &RealPath = Dir.strRealPath;
+		for (const ScanDir *It = Dir.Parent.get(); It; It = It->Parent.get()) {
+			const FARString &IthPath = It->strRealPath;
+			if ((It->UnixDevice == Dir.UnixDevice && It->UnixNode == Dir.UnixNode)
+					|| (IthPath.Begins(RealPath)
+							&& (IthPath.GetLength() == RealPath.GetLength()
+									|| IthPath.At(RealPath.GetLength()) == GOOD_SLASH || RealPath.GetLength() == 1)))
+				return true;
+		}
+		return false;
 	}
 
-	void Delete(int idx)
+	void ScanOne(const ScanDirPtr &Dir, const FileMasksProcessor &ExclMask,
+			std::vector<std::unique_ptr<TreeItem>> &Items, std::vector<ScanDirPtr> &Subdirs)
 	{
-		if (ListName[idx])
-			free(ListName[idx]);
+		FARString strMask(Dir->strPath);
+		if (strMask.GetLength() > 1)
+			strMask+= GOOD_SLASH;
+		strMask+= L'*';
+
+		::FindFile Find(strMask, ScanSymlinks, FIND_FILE_FLAG_NO_FILES | FIND_FILE_FLAG_NO_DEVICES);
+		FAR_FIND_DATA_EX fdata;
+		while (Find.Get(fdata)) {
+			if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				continue;
 
-		memmove(ListName + idx, ListName + idx + 1, sizeof(wchar_t *) * (TreeCount - idx - 1));
-		TreeCount--;
+			auto item = std::make_unique<TreeItem>();
+			item->strName = Dir->strPath;
+			if (item->strName.GetLength() > 1)
+				item->strName+= GOOD_SLASH;
+			item->strName+= fdata.strFileName;
+
+			const bool Symlink = (fdata.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+			if (ExclMask.Compare(fdata.strFileName, false) || (MaxDepth > 0 && Dir->Level > MaxDepth)) {
+				item->Expandable = true;
+
+			} else if (!Symlink || ScanSymlinks) {
+				auto Subdir = std::make_shared<ScanDir>();
+				Subdir->strPath = item->strName;
+				if (Symlink)
+					ConvertNameToReal(Subdir->strPath, Subdir->strRealPath);
+				else
+					Subdir->strRealPath = Subdir->strPath;
+				Subdir->UnixDevice = fdata.UnixDevice;
+				Subdir->UnixNode = fdata.UnixNode;
+				Subdir->Level = Dir->Level + 1;
+				Subdir->Parent = Dir;
+				if (!Symlink || !IsRecursion(*Subdir))
+					Subdirs.emplace_back(std::move(Subdir));
+			}
+
+			Items.emplace_back(std::move(item));
+		}
 	}
 
-	void Clean()
+	void WorkerProc()
 	{
-		if (!TreeSize)
-			return;
+		FileMasksProcessor ExclMask;	// per thread as regexp masks keep matching state
+		if (!strExclMask.IsEmpty())
+			ExclMask.Set(strExclMask, FMF_ADDASTERISK);
+
+		std::vector<std::unique_ptr<TreeItem>> Items;
+		std::vector<ScanDirPtr> Subdirs;
+		std::unique_lock<std::mutex> lock(Mutex);
+		for (;;) {
+			WorkCond.wait(lock, [this] { return Stopping || !Pending.empty() || !Busy; });
+			if (Stopping || IsDone())
+				break;
 
-		for (int i = 0; i < TreeCount; i++) {
-			if (ListName[i])
-				free(ListName[i]);
+			ScanDirPtr Dir = std::move(Pending.back());
+			Pending.pop_back();
+			++Busy;
+			lock.unlock();
+
+			ScanOne(Dir, ExclMask, Items, Subdirs);
+			FoundCount+= Items.size();
+
+			lock.lock();
+			for (auto &Item : Items)
+				Found.emplace_back(std::move(Item));
+			for (auto &Subdir : Subdirs)
+				Pending.emplace_back(std::move(Subdir));
+			--Busy;
+
+			if (IsDone()) {
+				WorkCond.notify_all();
+				DoneCond.notify_all();
+			} else if (Subdirs.size() > 1) {
+				WorkCond.notify_all();
+			} else if (!Subdirs.empty()) {
+				WorkCond.notify_one();
+			}
+			Items.clear();
+			Subdirs.clear();
 		}
+	}
 
-		if (ListName)
-			free(ListName);
+public:
+	ParallelTreeScan(const wchar_t *Root, int MaxDepth_, const wchar_t *ExclMask)
+		:
+		MaxDepth(MaxDepth_), ScanSymlinks(Opt.ScanJunction != 0), strExclMask(ExclMask)
+	{
+		auto RootDir = std::make_shared<ScanDir>();
+		RootDir->strPath = *Root ? Root : L".";
+		if (RootDir->strPath != L"/")
+			DeleteEndSlash(RootDir->strPath);
+		ConvertNameToReal(RootDir->strPath, RootDir->strRealPath);
+		Pending.emplace_back(std::move(RootDir));
 
-		ListName = nullptr;
-		TreeCount = 0;
-		TreeSize = 0;
-		strTreeName.Clear();
+		const unsigned int ThreadsCount = std::max(2u, std::min(std::thread::hardware_concurrency(), 16u));
+		for (unsigned int i = 0; i < ThreadsCount; ++i) {
+			Threads.emplace_back([this] { WorkerProc(); });
+		}
 	}
 
-	// TODO: необходимо оптимизировать!
-	void Copy(TreeListCache *Dest)
+	~ParallelTreeScan() { Stop(); }
+
+	// Returns true if scan is finished, otherwise waits for it at most given time
+	bool Wait(unsigned int Msec)
 	{
-		Dest->Clean();
+		std::unique_lock<std::mutex> lock(Mutex);
+		return DoneCond.wait_for(lock, std::chrono::milliseconds(Msec), [this] { return IsDone(); });
+	}
 
-		for (int I = 0; I < TreeCount; I++)
-			Dest->Add(ListName[I]);
+	size_t FoundDirs() const { return FoundCount; }
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Stopping = true;
+		}
+		WorkCond.notify_all();
+		for (auto &Thread : Threads) {
+			Thread.join();
+		}
+		Threads.clear();
 	}
 
-} TreeCache, tempTreeCache;
+	// Moves found directories to Dest, in arbitrary order
+	void Fetch(std::vector<std::unique_ptr<TreeItem>> &Dest)
+	{
+		Stop();
+		Dest.reserve(Dest.size() + Found.size());
+		for (auto &Item : Found)
+			Dest.emplace_back(std::move(Item));
+		Found.clear();
+	}
+};
 
 TreeList::TreeList(int IsPanel)
 	:
@@ -472,11 +718,8 @@ int TreeList::ReadTree(int depth)
 	ChangePriority ChPriority(ChangePriority::NORMAL);
 	// SaveScreen SaveScr;
 	TPreRedrawFuncGuard preRedrawFuncGuard(TreeList::PR_MsgReadTree);
-	ScanTree ScTree(FALSE);
-	FAR_FIND_DATA_EX fdata;
-	FARString strFullName;
-	SaveState();
 	FlushCache();
+	SaveState();
 	GetRoot();
 
 	TreeCount = 0;
@@ -499,35 +742,27 @@ int TreeList::ReadTree(int depth)
 	RefreshFrameManager frref(ScrX, ScrY, TreeStartTime, FALSE);	// DontRedrawFrame);
 
 	if (depth < 0 && Opt.Tree.ScanDepthEnabled)
-		ScTree.SetMaxDepth(Opt.Tree.DefaultScanDepth);
-	else
-		ScTree.SetMaxDepth(depth);
+		depth = Opt.Tree.DefaultScanDepth;
 
-	ScTree.SetFindPath(strRoot, L"*", FSCANTREE_NOFILES | FSCANTREE_NODEVICES, Opt.Tree.ExclSubTreeMask);
 	LastScrX = ScrX;
 	LastScrY = ScrY;
 	wakeful W;
-	while (ScTree.GetNextName(&fdata, strFullName)) {
+	{
+		// directories are scanned by worker threads while this one shows progress and handles abort
+		ParallelTreeScan Scan(strRoot, depth, Opt.Tree.ExclSubTreeMask);
+		while (!Scan.Wait(100)) {
+			TreeList::MsgReadTree(static_cast<int>(Scan.FoundDirs()) + 1, FirstCall);
 
-		TreeList::MsgReadTree(TreeCount, FirstCall);
+			if (CheckForEscSilent()) {
+				AscAbort = ConfirmAbortOp();
+				FirstCall = TRUE;
+			}
 
-		if (CheckForEscSilent()) {
-			AscAbort = ConfirmAbortOp();
-			FirstCall = TRUE;
+			if (AscAbort)
+				break;
 		}
 
-		if (AscAbort)
-			break;
-
-		if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-			continue;
-
-		auto item = std::make_unique<TreeItem>();
-		item->Clear();
-		item->strName = strFullName;
-		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_PINNED)
-			item->Expandable = true;
-		ListData.emplace_back(std::move(item));
+		Scan.Fetch(ListData);
 		TreeCount = static_cast<long>(ListData.size());
 	}
 
@@ -565,6 +800,12 @@ void TreeList::SaveTreeFile()
 	long I;
 	size_t RootLength = strRoot.IsEmpty() ? 0 : strRoot.GetLength() - 1;
 	MkTreeFileName(strRoot, strName);
+
+	// saved list supersedes changes cached for same tree, also new tree file may appear
+	if (TreeCache.strTreeName == strName)
+		ClearCache(1);
+	LastTreeRootLookup.Valid = false;
+
 	// получим и сразу сбросим атрибуты (если получится)
 	DWORD FileAttributes = apiGetFileAttributes(strName);
 
@@ -578,11 +819,15 @@ void TreeList::SaveTreeFile()
 			$ 16.10.2000 tran
 			если диск должен кешироваться, то и пытаться не стоит
 		*/
-		if (MustBeCached(strRoot))
-			if (!GetCacheTreeName(strRoot, strName, TRUE)
-					|| !TreeFile.Open(strName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+		if (MustBeCached(strRoot)) {
+			if (!GetCacheTreeName(strRoot, strName, TRUE))
+				return;
+			if (TreeCache.strTreeName == strName)
+				ClearCache(1);
+			if (!TreeFile.Open(strName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
 							FILE_ATTRIBUTE_NORMAL))
 				return;
+		}
 
 		/* tran $ */
 	}
@@ -590,16 +835,8 @@ void TreeList::SaveTreeFile()
 	bool Success = true;
 	CachedWrite Cache(TreeFile);
 	for (I = 0; I < TreeCount && Success; I++) {
-		FARString line;
-		if (RootLength >= ListData[I]->strName.GetLength())
-			line = L"/";
-		else
-			line = ListData[I]->strName.SubStr(RootLength);
-
-		line+= L'\2';
-		line+= (L'0' + (ListData[I]->Expandable ? 1 : 0) + (ListData[I]->Collapsed  ? 2 : 0));
-		line+= L'\n';
-
+		const FARString &line = MkTreeRecord(ListData[I]->strName, RootLength,
+				L'0' + (ListData[I]->Expandable ? 1 : 0) + (ListData[I]->Collapsed ? 2 : 0));
 		DWORD Size = static_cast<DWORD>(line.GetLength() * sizeof(WCHAR));
 		Success = Cache.Write(line.CPtr(), Size);
 	}
@@ -617,12 +854,13 @@ int TreeList::GetCacheTreeName(const wchar_t *Root, FARString &strName, int Crea
 {
 	unsigned long long fsid = 0;
 	struct statfs sfs{};
-	memcpy(&fsid, &sfs.f_fsid, std::min(sizeof(fsid), sizeof(sfs.f_fsid)));
 
 	if (sdc_statfs(Wide2MB(Root).c_str(), &sfs) != 0) {
 		return FALSE;
 	}
 
+	memcpy(&fsid, &sfs.f_fsid, std::min(sizeof(fsid), sizeof(sfs.f_fsid)));
+
 	FARString strFolderName;
 	FARString strFarPath;
 	MkTreeCacheFolderName(strFarPath, strFolderName);
@@ -716,6 +954,8 @@ void TreeList::SyncDir()
 							const int prevTreeCount = TreeCount;
 							ExpandDirectory(parentDir.CPtr());
 							expanded = TreeCount > prevTreeCount;
+							if (expanded)
+								SaveTreeFile();
 							break;
 						}
 					}
@@ -844,56 +1084,39 @@ bool TreeList::ExpandDirectory(const wchar_t *Path, int depth)
 	TreePreparationGuard guard(Flags);
 	ChangePriority ChPriority(ChangePriority::NORMAL);
 	TPreRedrawFuncGuard preRedrawFuncGuard(TreeList::PR_MsgReadTree);
-	ScanTree ScTree(FALSE);
-	FAR_FIND_DATA_EX fdata;
 	FARString strDirName;
-	FARString strFullName;
 	DWORD FileAttr = apiGetFileAttributes(Path);
 
 	if (FileAttr == INVALID_FILE_ATTRIBUTES || !(FileAttr & FILE_ATTRIBUTE_DIRECTORY))
 		return false;
 
 	const size_t originalSize = ListData.size();
-	int Count = 0;
 	int FirstCall = TRUE;
 	bool AscAbort = false;
 
 	ConvertNameToFull(Path, strDirName);
-	AddTreeName(strDirName);
 
 	if (depth < 0 && Opt.Tree.ScanDepthEnabled)
-		ScTree.SetMaxDepth(Opt.Tree.DefaultScanDepth);
-	else
-		ScTree.SetMaxDepth(depth);
+		depth = Opt.Tree.DefaultScanDepth;
 
-	ScTree.SetFindPath(strDirName, L"*", 0, Opt.Tree.ExclSubTreeMask);
 	LastScrX = ScrX;
 	LastScrY = ScrY;
+	{
+		ParallelTreeScan Scan(strDirName, depth, Opt.Tree.ExclSubTreeMask);
+		while (!Scan.Wait(100)) {
+			TreeList::MsgReadTree(static_cast<int>(Scan.FoundDirs()) + 1, FirstCall);
 
-	while (ScTree.GetNextName(&fdata, strFullName)) {
-		if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-			continue;
-
-		TreeList::MsgReadTree(Count + 1, FirstCall);
+			if (CheckForEscSilent()) {
+				AscAbort = ConfirmAbortOp();
+				FirstCall = TRUE;
+			}
 
-		if (CheckForEscSilent()) {
-			AscAbort = ConfirmAbortOp();
-			FirstCall = TRUE;
+			if (AscAbort)
+				break;
 		}
 
-		if (AscAbort)
-			break;
-
-		AddTreeName(strFullName);
-
-		auto item = std::make_unique<TreeItem>();
-		item->Clear();
-		item->strName = strFullName;
-		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_PINNED)
-			item->Expandable = true;
-		ListData.emplace_back(std::move(item));
-
-		++Count;
+		if (!AscAbort)
+			Scan.Fetch(ListData);
 	}
 
 	if (!ModalMode) {	// Перерисуем другую панель - удалим следы сообщений :)
@@ -1682,7 +1905,6 @@ void TreeList::ProcessEnter()
 
 int TreeList::ReadTreeFile()
 {
-	size_t RootLength = strRoot.IsEmpty() ? 0 : strRoot.GetLength() - 1;
 	FARString strName;
 	// SaveState();
 	FlushCache();
@@ -1706,69 +1928,14 @@ int TreeList::ReadTreeFile()
 	if (file_size > 0)
 		ListData.reserve(static_cast<size_t>(file_size / 64)); 
 
-	{
-		FARString strLastDirName;
-		GetFileString GetStr(TreeFile);
-		LPWSTR Record = nullptr;
-		int RecordLength = 0;
-		FARString prefix;
-		if (RootLength)
-			prefix = FARString(strRoot, RootLength);
-
-		std::vector<wchar_t> last_record;
-		size_t last_record_len = 0;
-		while (GetStr.GetString(&Record, CP_WIDE_LE, RecordLength) > 0) {
-			if (!Record || RecordLength <= 0)
-				continue;
-			wchar_t* begin = Record;
-			wchar_t* end   = Record + RecordLength;
-
-			if (end > begin && *(end - 1) == L'\n')
-				--end;
-
-			size_t record_len = static_cast<size_t>(end - begin);
-			if (!record_len)
-				continue;
-
-			if (record_len == last_record_len &&
-				(last_record_len == 0 || memcmp(begin, last_record.data(), record_len * sizeof(wchar_t)) == 0)) {
-				continue;
-			}
-
-			last_record.assign(begin, end);
-			last_record_len = record_len;
-
-			bool expandableFlag = false;
-			bool collapsedFlag = false;
-			if (record_len >= 2 && *(end - 2) == L'\2')
-			{
-				expandableFlag = (*(end - 1) - L'0') & 1;
-				collapsedFlag = (*(end - 1) - L'0') & 2;
-				end -= 2;
-				record_len -= 2;
-				if (!record_len)
-					continue;
-			}
-
-			FARString strDirName;
-			if (RootLength)
-				strDirName = prefix;
-
-			strDirName.Append(begin, record_len);
-
-			if (RootLength > 0 && strDirName.At(RootLength - 1) != L':' && IsSlash(strDirName.At(RootLength))
-					&& !strDirName.At(RootLength + 1)) {
-				strDirName.Truncate(RootLength);
-			}
-
-			auto item = std::make_unique<TreeItem>();
-			item->Clear();
-			item->strName = strDirName;
-			item->Expandable = expandableFlag;
-			item->Collapsed = collapsedFlag;
-			ListData.emplace_back(std::move(item));
-		}
-	}
+	ParseTreeFile(TreeFile, strRoot, [&](FARString &strDirName, wchar_t RecordFlags) {
+		auto item = std::make_unique<TreeItem>();
+		item->Clear();
+		item->strName = strDirName;
+		item->Expandable = ((RecordFlags - L'0') & 1) != 0;
+		item->Collapsed = ((RecordFlags - L'0') & 2) != 0;
+		ListData.emplace_back(std::move(item));
+	});
 
 	TreeFile.Close();
 
@@ -1780,7 +1947,6 @@ int TreeList::ReadTreeFile()
 	CaseSensitiveSort = FALSE;
 //	Assume cache sorted
 //	SortAndDeduplicate();
-	far_qsort(TreeCache.ListName, TreeCache.TreeCount, sizeof(wchar_t *), SortCacheList);
 	return FillLastData();
 }
 
@@ -1862,24 +2028,22 @@ void TreeList::AddTreeName(const wchar_t *Name)
 
 	FARString strFullName;
 	ConvertNameToFull(Name, strFullName);
-	Name = strFullName;
+	DeleteEndSlash(strFullName);
 
-	if (!LastSlash(Name))
+	if (!LastSlash(strFullName) || !ReadCache(strFullName))
 		return;
 
-	ReadCache(strFullName);
-
-	for (long CachePos = 0; CachePos < TreeCache.TreeCount; CachePos++) {
-		int Result = StrCmpI(TreeCache.ListName[CachePos], Name);
+	// add only into scanned directory, so subtrees skipped due to exclusion mask
+	// or depth limit stay expandable same way as after ReadTree
+	size_t Pos;
+	strFullName.RPos(Pos, GOOD_SLASH);
+	const auto Parent = TreeCache.Names.find(FARString(strFullName, Pos ? Pos : 1));
 
-		if (!Result)
-			break;
+	if (Parent == TreeCache.Names.end() || ((Parent->second - L'0') & 1))
+		return;
 
-		if (Result > 0) {
-			TreeCache.Insert(CachePos, Name);
-			break;
-		}
-	}
+	if (TreeCache.Names.emplace(strFullName, L'0').second)
+		TreeCache.Modified = true;
 }
 
 void TreeList::DelTreeName(const wchar_t *Name)
@@ -1889,22 +2053,15 @@ void TreeList::DelTreeName(const wchar_t *Name)
 
 	FARString strFullName;
 	ConvertNameToFull(Name, strFullName);
-	Name = strFullName;
-	ReadCache(strFullName);
-
-	for (long CachePos = 0; CachePos < TreeCache.TreeCount; CachePos++) {
-		const wchar_t *wszDirName = TreeCache.ListName[CachePos];
-		int Length = StrLength(Name);
-		int DirLength = StrLength(wszDirName);
+	DeleteEndSlash(strFullName);
 
-		if (DirLength < Length)
-			continue;
+	if (!ReadCache(strFullName))
+		return;
 
-		if (!StrCmpNI(Name, wszDirName, Length) && (!wszDirName[Length] || IsSlash(wszDirName[Length]))) {
-			TreeCache.Delete(CachePos);
-			CachePos--;
-		}
-	}
+	TreeCache.ForEachInSubtree(strFullName, [](decltype(TreeCache.Names)::iterator it) {
+		TreeCache.Names.erase(it);
+		TreeCache.Modified = true;
+	});
 }
 
 void TreeList::RenTreeName(const wchar_t *SrcName, const wchar_t *DestName)
@@ -1912,25 +2069,40 @@ void TreeList::RenTreeName(const wchar_t *SrcName, const wchar_t *DestName)
 	if (!*SrcName || !*DestName)
 		return;
 
-	FARString SrcNameFull, DestNameFull;
-	ConvertNameToFull(SrcName, SrcNameFull);
-	ConvertNameToFull(DestName, DestNameFull);
-	ReadCache(SrcNameFull);
-	int SrcLength = StrLength(SrcName);
+	FARString strSrcFullName, strDestFullName;
+	ConvertNameToFull(SrcName, strSrcFullName);
+	ConvertNameToFull(DestName, strDestFullName);
+	DeleteEndSlash(strSrcFullName);
+	DeleteEndSlash(strDestFullName);
 
-	for (int CachePos = 0; CachePos < TreeCache.TreeCount; CachePos++) {
-		const wchar_t *DirName = TreeCache.ListName[CachePos];
+	if (!ReadCache(strSrcFullName)) {
+		AddTreeName(strDestFullName);
+		return;
+	}
+
+	// subtree is moved as whole, destination may belong to another tree file
+	std::vector<std::pair<FARString, wchar_t>> Moved;
+	const size_t SrcLength = strSrcFullName.GetLength();
+	TreeCache.ForEachInSubtree(strSrcFullName, [&](decltype(TreeCache.Names)::iterator it) {
+		Moved.emplace_back(it->first.CPtr() + SrcLength, it->second);
+		TreeCache.Names.erase(it);
+		TreeCache.Modified = true;
+	});
 
-		if (!StrCmpNI(SrcName, DirName, SrcLength) && (!DirName[SrcLength] || IsSlash(DirName[SrcLength]))) {
-			FARString strNewName = DestName;
-			strNewName+= DirName + SrcLength;
+	if (Moved.empty()) {
+		AddTreeName(strDestFullName);
+		return;
+	}
 
-			if (TreeCache.ListName[CachePos])
-				free(TreeCache.ListName[CachePos]);
+	AddTreeName(strDestFullName);
+	if (TreeCache.strTreeName.IsEmpty()
+			|| TreeCache.Names.find(strDestFullName) == TreeCache.Names.end())
+		return;
 
-			TreeCache.ListName[CachePos] = wcsdup(strNewName);
-		}
+	for (auto &Item : Moved) {
+		TreeCache.Names[strDestFullName + Item.first] = Item.second;
 	}
+	TreeCache.Modified = true;
 }
 
 void TreeList::ReadSubTree(const wchar_t *Path)
@@ -1981,90 +2153,120 @@ void TreeList::ReadSubTree(const wchar_t *Path)
 void TreeList::ClearCache(int EnableFreeMem)
 {
 	TreeCache.Clean();
+	LastTreeRootLookup.Valid = false;
 }
 
-void TreeList::ReadCache(const wchar_t *TreeRoot)
+/*
+	Loads into TreeCache tree file of nearest parent directory of given path
+	that has tree file. Returns false if there is no such tree file.
+*/
+bool TreeList::ReadCache(const wchar_t *Name)
 {
-	FARString strTreeName;
-	FILE *TreeFile = nullptr;
-
-	if (!StrCmp(MkTreeFileName(TreeRoot, strTreeName), TreeCache.strTreeName))
-		return;
+	FARString strDir(Name);
+	size_t Pos;
 
-	if (TreeCache.TreeCount)
-		FlushCache();
+	if (!strDir.RPos(Pos, GOOD_SLASH))
+		return false;
 
-	if (MustBeCached(TreeRoot) || !(TreeFile = fopen(Wide2MB(strTreeName).c_str(), FOPEN_READ)))
-		if (!GetCacheTreeName(TreeRoot, strTreeName, FALSE)
-				|| !(TreeFile = fopen(Wide2MB(strTreeName).c_str(), FOPEN_READ))) {
-			ClearCache(1);
-			return;
-		}
+	strDir.Truncate(Pos ? Pos : 1);
+	FARString strRoot, strTreeName;
 
-	TreeCache.strTreeName = strTreeName;
-	wchar_t *DirName = new (std::nothrow) wchar_t[NT_MAX_PATH];
+	if (LastTreeRootLookup.Valid && LastTreeRootLookup.strDir == strDir) {
+		strRoot = LastTreeRootLookup.strRoot;
+		strTreeName = LastTreeRootLookup.strTreeName;
+	} else {
+		FARString strParent, strParentCacheName;
+		for (FARString strCheck(strDir);;) {
+			if (apiGetFileAttributes(MkTreeFileName(strCheck, strTreeName)) != INVALID_FILE_ATTRIBUTES) {
+				strRoot = strCheck;
+				break;
+			}
 
-	if (DirName) {
-		while (fgetws(DirName, NT_MAX_PATH, TreeFile)) {
-			if (!IsSlash(*DirName))
-				continue;
+			strParent = strCheck;
+			const bool HasParent = strParent.GetLength() > 1 && strParent.RPos(Pos, GOOD_SLASH);
+			if (HasParent)
+				strParent.Truncate(Pos ? Pos : 1);
+
+			// same as ReadTreeFile fall back to cached tree, that is named by filesystem,
+			// so take it as root only at topmost directory of that filesystem
+			if (GetCacheTreeName(strCheck, strTreeName, FALSE)
+					&& apiGetFileAttributes(strTreeName) != INVALID_FILE_ATTRIBUTES
+					&& (!HasParent || !GetCacheTreeName(strParent, strParentCacheName, FALSE)
+						|| strParentCacheName != strTreeName)) {
+				strRoot = strCheck;
+				break;
+			}
 
-			wchar_t *ChPtr = wcschr(DirName, L'\n');
+			if (!HasParent)
+				break;
 
-			if (ChPtr)
-				*ChPtr = 0;
+			strCheck = strParent;
+		}
+		if (strRoot.IsEmpty())
+			strTreeName.Clear();
+	}
 
-			ChPtr = wcschr(DirName, L'\2');
+	if (!strRoot.IsEmpty() && strRoot == TreeCache.strRoot && !TreeCache.strTreeName.IsEmpty())
+		return true;
 
-			if (ChPtr)
-				*ChPtr = 0;
+	FlushCache();
+	LastTreeRootLookup.strDir = strDir;
+	LastTreeRootLookup.strRoot = strRoot;
+	LastTreeRootLookup.strTreeName = strTreeName;
+	LastTreeRootLookup.Valid = true;
 
-			TreeCache.Add(DirName);
-		}
+	if (strRoot.IsEmpty())
+		return false;
 
-		delete[] DirName;
-	}
+	File TreeFile;
+	if (!TreeFile.Open(strTreeName, FILE_READ_DATA, FILE_SHARE_READ, nullptr, OPEN_EXISTING))
+		return false;
 
-	fclose(TreeFile);
+	TreeCache.strTreeName = strTreeName;
+	TreeCache.strRoot = strRoot;
+	ParseTreeFile(TreeFile, strRoot, [](FARString &strDirName, wchar_t RecordFlags) {
+		TreeCache.Names.emplace(strDirName, RecordFlags);
+	});
+	TreeFile.Close();
+	return true;
 }
 
 void TreeList::FlushCache()
 {
-	FILE *TreeFile;
-
-	if (!TreeCache.strTreeName.IsEmpty()) {
-		DWORD FileAttributes = apiGetFileAttributes(TreeCache.strTreeName);
+	if (!TreeCache.strTreeName.IsEmpty() && TreeCache.Modified) {
+		const FARString strName = TreeCache.strTreeName;
+		const size_t RootLength = TreeCache.strRoot.GetLength() - 1;
+		DWORD FileAttributes = apiGetFileAttributes(strName);
 
 		if (FileAttributes != INVALID_FILE_ATTRIBUTES)
-			apiSetFileAttributes(TreeCache.strTreeName, FILE_ATTRIBUTE_NORMAL);
+			apiSetFileAttributes(strName, FILE_ATTRIBUTE_NORMAL);
 
-		if (!(TreeFile = fopen(Wide2MB(TreeCache.strTreeName).c_str(), FOPEN_WRITE))) {
+		File TreeFile;
+		if (!TreeFile.Open(strName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+					FILE_ATTRIBUTE_NORMAL)) {
 			ClearCache(1);
 			return;
 		}
 
-		far_qsort(TreeCache.ListName, TreeCache.TreeCount, sizeof(wchar_t *), SortCacheList);
-
-		bool SaveFailed = false;
-		for (int i = 0; i < TreeCache.TreeCount; i++) {
-			if (fwprintf(TreeFile, L"%ls\n", TreeCache.ListName[i]) < 0)
-				SaveFailed = true;
+		bool Success = true;
+		CachedWrite Cache(TreeFile);
+		for (auto it = TreeCache.Names.begin(); it != TreeCache.Names.end() && Success; ++it) {
+			const FARString &line = MkTreeRecord(it->first, RootLength, it->second);
+			Success = Cache.Write(line.CPtr(), static_cast<DWORD>(line.GetLength() * sizeof(WCHAR)));
 		}
+		if (!Cache.Flush())
+			Success = false;
+		TreeFile.Close();
 
-		if (fflush(TreeFile) == EOF)
-			SaveFailed = true;
-
-		fclose(TreeFile);
-
-		if (SaveFailed) {
-			apiDeleteFile(TreeCache.strTreeName);
-			Message(MSG_WARNING | MSG_ERRORTYPE, 1, Msg::Error, Msg::CannotSaveTree, TreeCache.strTreeName,
-					Msg::Ok);
+		if (!Success) {
+			apiDeleteFile(strName);
+			ClearCache(1);
+			Message(MSG_WARNING | MSG_ERRORTYPE, 1, Msg::Error, Msg::CannotSaveTree, strName, Msg::Ok);
 		} else if (FileAttributes != INVALID_FILE_ATTRIBUTES)	// вернем атрибуты (если получится :-)
-			apiSetFileAttributes(TreeCache.strTreeName, FileAttributes);
+			apiSetFileAttributes(strName, FileAttributes);
 	}
 
-	ClearCache(1);
+	TreeCache.Clean();
 }
 
 void TreeList::UpdateViewPanel()
@@ -2139,11 +2341,6 @@ int TreeList::GetFileName(FARString &strName, int Pos, DWORD &FileAttr)
 	return TRUE;
 }
 
-int _cdecl SortCacheList(const void *el1, const void *el2)
-{
-	return TreeCmp(*(wchar_t **)el1, *(wchar_t **)el2, StaticSortNumeric, 0);
-}
-
 int TreeCmp(const wchar_t *Str1, const wchar_t *Str2, int Numeric, int CaseSensitive)
 {
 	typedef int(__cdecl * CMPFUNC)(const wchar_t *, int, const wchar_t *, int);
@@ -2392,7 +2589,7 @@ bool TreeList::SaveState()
 
 			SaveTreeCount = TreeCount;
 			SaveWorkDir = WorkDir;
-			TreeCache.Copy(&tempTreeCache);
+			tempTreeCache = TreeCache;
 			return true;
 		}
 	}
@@ -2416,7 +2613,7 @@ bool TreeList::RestoreState()
 		TreeCount = SaveTreeCount;
 		WorkDir = SaveWorkDir;
 		FillLastData();
-		tempTreeCache.Copy(&TreeCache);
+		TreeCache = tempTreeCache;
 		tempTreeCache.Clean();
 		return true;
 	}
@@ -198,7 +198,7 @@ public:
 	static void RenTreeName(const wchar_t *SrcName, const wchar_t *DestName);
 	static void ReadSubTree(const wchar_t *Path);
 	static void ClearCache(int EnableFreeMem);
-	static void ReadCache(const wchar_t *TreeRoot);
+	static bool ReadCache(const wchar_t *Name);
 	static void FlushCache();
 
 	static int MustBeCached(const wchar_t *Root);	// $ 16.10.2000 tran - функция, определяющая необходимость кеширования файла
@@ -620,6 +620,67 @@ HANDLE PluginManager::OpenFilePlugin(const wchar_t *Name, int OpMode, OPENFILEPL
 	return hResult;
 }
 
+bool PluginManager::GetThreadSafeFilePlugins(std::vector<Plugin *> &Plugins)
+{
+	LoadIfCacheAbsent();
+	KeyFileReadHelper kfh(PluginsIni());
+	PluginInfo Info{};
+	bool AllThreadSafe = true;
+
+	for (int i = 0; i < PluginsCount; i++) {
+		Plugin *pPlugin = PluginsData[i];
+
+		if (!pPlugin->HasOpenFilePlugin() && !(pPlugin->HasAnalyse() && pPlugin->HasOpenPlugin()))
+			continue;
+
+		DWORD PluginFlags = 0;
+		if (pPlugin->CheckWorkFlags(PIWF_CACHED)) {
+			PluginFlags = kfh.GetUInt(pPlugin->GetSettingsName(), "Flags", 0);
+		} else if (pPlugin->GetPluginInfo(&Info)) {
+			PluginFlags = Info.Flags;
+		}
+
+		// Analyse-based opening goes through OpenPlugin that isn't safe to be called concurrently,
+		// also load plugin right now, so concurrent callers will never race on lazy loading
+		if ((PluginFlags & PF_THREADSAFE) != 0 && pPlugin->HasOpenFilePlugin() && pPlugin->Load()) {
+			Plugins.emplace_back(pPlugin);
+		} else {
+			AllThreadSafe = false;
+		}
+	}
+
+	return AllThreadSafe;
+}
+
+HANDLE PluginManager::OpenFilePluginConcurrently(const wchar_t *Name, int OpMode,
+		const std::vector<Plugin *> &Plugins)
+{
+	std::unique_ptr<SafeMMap> smm;
+	try {
+		smm.reset(new SafeMMap(Wide2MB(Name).c_str(), SafeMMap::M_READ, Opt.PluginMaxReadData));
+	} catch (std::exception &e) {
+		fprintf(stderr, "PluginManager::OpenFilePluginConcurrently: %s\n", e.what());
+		return INVALID_HANDLE_VALUE;
+	}
+
+	for (auto *pPlugin : Plugins) {
+		HANDLE hPlugin = pPlugin->OpenFilePlugin(Name, (const unsigned char *)smm->View(),
+				(DWORD)smm->Length(), OpMode);
+
+		if (hPlugin == (HANDLE)-2)	// plugin processed file by itself, nothing to walk through
+			break;
+
+		if (hPlugin != INVALID_HANDLE_VALUE) {
+			PluginHandle *pResult = new PluginHandle;
+			pResult->hPlugin = hPlugin;
+			pResult->pPlugin = pPlugin;
+			return reinterpret_cast<HANDLE>(pResult);
+		}
+	}
+
+	return INVALID_HANDLE_VALUE;
+}
+
 HANDLE PluginManager::OpenFindListPlugin(const PluginPanelItem *PanelItem, int ItemsNumber)
 {
 	ChangePriority ChPriority(ChangePriority::NORMAL);
@@ -964,7 +1025,7 @@ int PluginManager::PutFiles(HANDLE hPlugin, PluginPanelItem *PanelItem, int Item
 	return Code;
 }
 
-void PluginManager::GetOpenPluginInfo(HANDLE hPlugin, OpenPluginInfo *Info)
+void PluginManager::GetOpenPluginInfo(HANDLE hPlugin, OpenPluginInfo *Info, bool SyncCurDir)
 {
 //	fprintf(stderr, " [GetOpenPluginInfo];\n");
 
@@ -979,7 +1040,8 @@ void PluginManager::GetOpenPluginInfo(HANDLE hPlugin, OpenPluginInfo *Info)
 	if (!Info->CurDir)	// хмм...
 		Info->CurDir = L"";
 
-	if ((Info->Flags & OPIF_REALNAMES) && (CtrlObject->Cp()->ActivePanel->GetPluginHandle() == hPlugin)
+	if (SyncCurDir && (Info->Flags & OPIF_REALNAMES)
+			&& (CtrlObject->Cp()->ActivePanel->GetPluginHandle() == hPlugin)
 			&& *Info->CurDir && !IsNetworkServerPath(Info->CurDir))
 		apiSetCurrentDirectory(Info->CurDir, false);
 
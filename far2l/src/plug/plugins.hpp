@@ -40,6 +40,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "PluginW.hpp"
 #include <string>
 #include <map>
+#include <vector>
 #include <mutex>
 
 extern const char *FmtDiskMenuStringD;
@@ -243,11 +244,17 @@ public:
 	HANDLE OpenFilePlugin(const wchar_t *Name, int OpMode, OPENFILEPLUGINTYPE Type,
 			Plugin *pDesiredPlugin = nullptr);
 	HANDLE OpenFindListPlugin(const PluginPanelItem *PanelItem, int ItemsNumber);
+	// loads plugins that declared PF_THREADSAFE and can open files, must be invoked with plugins calls serialized
+	// returns true if there are no other plugins that can open files
+	bool GetThreadSafeFilePlugins(std::vector<Plugin *> &Plugins);
+	// silent OpenFilePlugin that tries only given thread-safe plugins and may be invoked from any thread
+	HANDLE OpenFilePluginConcurrently(const wchar_t *Name, int OpMode, const std::vector<Plugin *> &Plugins);
 	HANDLE GetRealPluginHandle(HANDLE hPlugin);
 	FARString GetPluginModuleName(HANDLE hPlugin);
 	void ClosePlugin(HANDLE hPlugin);	// decreases refcnt and actually closes plugin if refcnt reached zero
 	void RetainPlugin(HANDLE hPlugin);	// increments refcnt
-	void GetOpenPluginInfo(HANDLE hPlugin, OpenPluginInfo *Info);
+	// SyncCurDir=false must be used outside of main thread: it skips panel check needed to follow real-names plugin's dir
+	void GetOpenPluginInfo(HANDLE hPlugin, OpenPluginInfo *Info, bool SyncCurDir = true);
 	int GetFindData(HANDLE hPlugin, PluginPanelItem **pPanelItem, int *pItemsNumber, int Silent);
 	void FreeFindData(HANDLE hPlugin, PluginPanelItem *PanelItem, int ItemsNumber);
 	int
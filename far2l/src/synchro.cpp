@@ -33,6 +33,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "synchro.hpp"
 #include "plclass.hpp"
+#include "keyboard.hpp"
 #include <farplug-wide.h>
 
 PluginSynchro PluginSynchroManager;
@@ -49,6 +50,7 @@ void PluginSynchro::Synchro(bool Plugin, INT_PTR ModuleNumber, void *Param, LONG
 	item->ModuleNumber = ModuleNumber;
 	item->Param = Param;
 	RecursiveMutex.unlock();
+	KickInputWaiter();
 }
 
 bool PluginSynchro::Process(bool idle)
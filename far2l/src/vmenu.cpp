@@ -61,6 +61,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cmdline.hpp"
 #include "UsedChars.hpp"
 #include "help.hpp"
+#include <Threaded.h>
+#include <string_view>
+#include <list>
 
 namespace
 {
@@ -71,6 +74,59 @@ FARString MenuDisplayText(const FARString &text)
 	ReplaceStrings(display, L"\n", L"\x21B5", -1);
 	return display;
 }
+
+// Matches filter against items in [Begin, End) range. Invoked also within worker threads, so it
+// must not copy any FARString cause of its not thread-safe reference counters.
+class FilterMatchChunk : protected Threaded
+{
+	MenuItemEx **_Item;
+	unsigned char *_Matches;
+	int _Begin, _End;
+	const std::wstring &_FilterKey;
+	bool _OnlyVisible;
+
+	virtual void *ThreadProc()
+	{
+		DoNow();
+		return nullptr;
+	}
+
+public:
+	FilterMatchChunk(MenuItemEx **Item, unsigned char *Matches, int Begin, int End,
+			const std::wstring &FilterKey, bool OnlyVisible)
+		:
+		_Item(Item), _Matches(Matches), _Begin(Begin), _End(End),
+		_FilterKey(FilterKey), _OnlyVisible(OnlyVisible)
+	{}
+
+	virtual ~FilterMatchChunk() { WaitThread(); }
+
+	void DoNow()
+	{
+		for (int i = _Begin; i < _End; ++i) {
+			MenuItemEx *PItem = _Item[i];
+			if ((PItem->Flags & LIF_SEPARATOR) != 0
+					|| ((PItem->Flags & LIF_HIDDEN) != 0 && (_OnlyVisible || !PItem->FilteredOut))) {
+				_Matches[i] = 2;	// not a subject of filtering
+				continue;
+			}
+			// string_view::find looks up first char using wmemchr and verifies rest by wmemcmp
+			_Matches[i] = (std::wstring_view(PItem->GetFilterKey()).find(_FilterKey)
+					!= std::wstring_view::npos) ? 1 : 0;
+		}
+	}
+
+	bool DoAsync() { return StartThread(); }
+};
+}
+
+const std::wstring &MenuItemEx::GetFilterKey()
+{
+	if (FilterKey.empty() && !strName.IsEmpty()) {
+		FilterKey.assign(strName.CPtr(), strName.GetLength());
+		LowerBuf(&FilterKey[0], (int)FilterKey.size());
+	}
+	return FilterKey;
 }
 
 VMenu::VMenu(const wchar_t *Title,		// заголовок меню
@@ -495,6 +551,7 @@ int VMenu::UpdateItem(const FarListUpdate *NewItem)
 		FarList2MenuItem(&NewItem->Item, &MItem);
 
 		PItem->strName = MItem.strName;
+		PItem->FilterKey.clear();
 		// текст пункта заменён - старая подсветка к нему уже не относится
 		PItem->HiliteStart = 0;
 		PItem->HiliteLength = 0;
@@ -627,6 +684,7 @@ void VMenu::RestoreFilteredItems()
 	}
 
 	ItemHiddenCount = 0;
+	strAppliedFilterKey.clear();
 
 	if (SelectPos < 0)
 		SetSelectPos(0, 1);
@@ -634,11 +692,40 @@ void VMenu::RestoreFilteredItems()
 
 void VMenu::FilterStringUpdated(bool bLonger)
 {
+	std::wstring FilterKey(strFilter.CPtr(), strFilter.GetLength());
+	if (!FilterKey.empty())
+		LowerBuf(&FilterKey[0], (int)FilterKey.size());
+
+	// if filter string was only lengthened then only currently visible items may become filtered out,
+	// otherwise need also to recheck already filtered out items - they may match shortened filter
+	const bool OnlyVisible = bLonger && FilterKey.compare(0, strAppliedFilterKey.size(), strAppliedFilterKey) == 0;
+
+	std::vector<unsigned char> Matches(ItemCount);
+
+	const int sItemCountTrh = 0x4000;	// below this matching is faster than threads spawning
+	unsigned int BestThreadsNum = std::max(BestThreadsCount(), 1u);
+	std::list<FilterMatchChunk> async_fmc;
+	int Begin = 0;
+
+	if (ItemCount >= sItemCountTrh && BestThreadsNum > 1) {
+		const int ItemsPerCPU = std::max(ItemCount / (int)BestThreadsNum, 0x1000);
+
+		while (ItemCount - Begin > ItemsPerCPU && async_fmc.size() + 1 < BestThreadsNum) {
+			async_fmc.emplace_back(Item, Matches.data(), Begin, Begin + ItemsPerCPU, FilterKey, OnlyVisible);
+			if (!async_fmc.back().DoAsync()) {
+				async_fmc.pop_back();
+				break;
+			}
+			Begin+= ItemsPerCPU;
+		}
+	}
 
-	if (bLonger) {
-		// строка фильтра увеличилась
-		for (int i = 0; i < ItemCount; i++) {
-			if (ItemIsVisible(Item[i]->Flags) && !ItemIsSeparator(Item[i]->Flags) && !StrStrI(Item[i]->strName, strFilter)) {
+	FilterMatchChunk(Item, Matches.data(), Begin, ItemCount, FilterKey, OnlyVisible).DoNow();
+	async_fmc.clear();	// waits for threads completion
+
+	for (int i = 0; i < ItemCount; i++) {
+		if (Matches[i] == 0) {
+			if (ItemIsVisible(Item[i]->Flags)) {
 				Item[i]->Flags|= LIF_HIDDEN;
 				Item[i]->FilteredOut = true;
 				ItemHiddenCount++;
@@ -647,29 +734,33 @@ void VMenu::FilterStringUpdated(bool bLonger)
 					SelectPos = -1;
 				}
 			}
-		}
-	} else {
-		// строка фильтра сократилась
-		for (int i = 0; i < ItemCount; i++) {
-			if (Item[i]->FilteredOut && !ItemIsSeparator(Item[i]->Flags) && StrStrI(Item[i]->strName, strFilter)) {
-				Item[i]->Flags&= ~LIF_HIDDEN;
-				Item[i]->FilteredOut = false;
-				ItemHiddenCount--;
-			}
+		} else if (Matches[i] == 1 && Item[i]->FilteredOut) {
+			Item[i]->Flags&= ~LIF_HIDDEN;
+			Item[i]->FilteredOut = false;
+			ItemHiddenCount--;
 		}
 	}
 
-	// hide all separators that dont precede any visible menu items
-	for (int i = 0; i < ItemCount; i++) {
-		if (ItemIsSeparator(Item[i]->Flags)) {
-			bool PrecedesVisibleItems = false;
-			int j;
-			for (j = i + 1; j < ItemCount && !ItemIsSeparator(Item[j]->Flags); ++j) {
-				if (ItemIsVisible(Item[j]->Flags)) {
-					PrecedesVisibleItems = true;
-					break;
-				}
-			}
+	strAppliedFilterKey.swap(FilterKey);
+
+	UpdateSeparatorsVisibility();
+
+	if (SelectPos < 0)
+		SetSelectPos(0, 1);
+}
+
+// hide all separators that dont precede any visible menu items,
+// walking backward allows to do this in single pass
+void VMenu::UpdateSeparatorsVisibility()
+{
+	bool PrecedesVisibleItems = false;
+
+	for (int i = ItemCount - 1; i >= 0; --i) {
+		if (!ItemIsSeparator(Item[i]->Flags)) {
+			if (ItemIsVisible(Item[i]->Flags))
+				PrecedesVisibleItems = true;
+
+		} else {
 			if (!PrecedesVisibleItems) {
 				if (ItemIsVisible(Item[i]->Flags)) {
 					Item[i]->Flags|= LIF_HIDDEN;
@@ -681,12 +772,9 @@ void VMenu::FilterStringUpdated(bool bLonger)
 				Item[i]->FilteredOut = false;
 				ItemHiddenCount--;
 			}
-			i = j - 1; // loop will ++
+			PrecedesVisibleItems = false;
 		}
 	}
-
-	if (SelectPos < 0)
-		SetSelectPos(0, 1);
 }
 
 bool VMenu::IsFilterEditKey(FarKey Key)
@@ -2836,6 +2924,7 @@ void VMenu::EnableFilter(bool Enable)
 	bFilterEnabled = Enable;
 	bFilterLocked = false;
 	strFilter.Clear();
+	strAppliedFilterKey.clear();
 
 	if (!Enable)
 		RestoreFilteredItems();
@@ -43,6 +43,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "frame.hpp"
 #include "bitflags.hpp"
 #include "CriticalSections.hpp"
+#include <string>
 
 // Цветовые атрибуты - индексы в массиве цветов
 enum
@@ -116,6 +117,10 @@ struct MenuItemEx
 	int HiliteLength;
 	short AmpPos;	// Позиция автоназначенной подсветки
 	bool FilteredOut;
+	// Lowercased strName used by filter matching, built on demand and dropped when strName changes
+	std::wstring FilterKey;
+
+	const std::wstring &GetFilterKey();
 
 	DWORD SetCheck(uint32_t Value)
 	{
@@ -155,6 +160,7 @@ struct MenuItemEx
 		AccelKey = 0;
 		strName.Clear();
 		FilteredOut = false;
+		FilterKey.clear();
 		UserDataSize = 0;
 		UserData = nullptr;
 		AmpPos = 0;
@@ -178,6 +184,7 @@ struct MenuItemEx
 		if (this != &srcMenu) {
 			Flags = srcMenu.Flags;
 			strName = srcMenu.strName;
+			FilterKey.clear();
 			AccelKey = srcMenu.AccelKey;
 			UserDataSize = 0;
 			UserData = nullptr;
@@ -268,6 +275,7 @@ private:
 	bool bFilterEnabled;
 	bool bFilterLocked;
 	FARString strFilter;
+	std::wstring strAppliedFilterKey;	// lowercased filter that current FilteredOut marks correspond to
 
 	MenuItemEx **Item;
 
@@ -302,6 +310,7 @@ private:
 	void UpdateInternalCounters(DWORD OldFlags, DWORD NewFlags);
 	void RestoreFilteredItems();
 	void FilterStringUpdated(bool bLonger);
+	void UpdateSeparatorsVisibility();
 	bool IsFilterEditKey(FarKey Key);
 	bool ShouldSendKeyToFilter(FarKey Key);
 	bool AddToFilter(const wchar_t *str);
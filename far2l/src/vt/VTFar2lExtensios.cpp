@@ -1,5 +1,6 @@
 #include <base64.h>
 #include <crc64.h>
+#include <LZBlock.h>
 #include <utils.h>
 #include <UtfConvert.hpp>
 #include <fcntl.h>
@@ -305,6 +306,7 @@ char VTFar2lExtensios::ClipboardAuthorize(std::string client_id)
 void VTFar2lExtensios::OnInteract_ClipboardOpen(StackSerializer &stk_ser)
 {
 	_clipboard_chunks.clear();
+	_clipboard_get_snapshot = ClipboardSnapshot();
 	const std::string &client_id = stk_ser.PopStr();
 	char out = ClipboardAuthorize(client_id);
 	if (out == 1) {
@@ -315,7 +317,8 @@ void VTFar2lExtensios::OnInteract_ClipboardOpen(StackSerializer &stk_ser)
 
 	stk_ser.Clear();
 	// report supported features
-	stk_ser.PushNum(uint64_t(FARTTY_FEATCLIP_DATA_ID | FARTTY_FEATCLIP_CHUNKED_SET));
+	stk_ser.PushNum(uint64_t(FARTTY_FEATCLIP_DATA_ID | FARTTY_FEATCLIP_CHUNKED_SET
+		| FARTTY_FEATCLIP_CHUNKED_GET | FARTTY_FEATCLIP_COMPRESSION));
 	stk_ser.PushNum(out);
 }
 
@@ -323,6 +326,7 @@ void VTFar2lExtensios::OnInteract_ClipboardClose(StackSerializer &stk_ser)
 {
 	_clipboard_chunks.clear();
 	_clipboard_chunks.shrink_to_fit();
+	_clipboard_get_snapshot = ClipboardSnapshot();
 
 	char out = -1;
 	if (_clipboard_opens > 0) {
@@ -377,6 +381,29 @@ void VTFar2lExtensios::OnInteract_ClipboardSetDataChunk(StackSerializer &stk_ser
 	stk_ser.Clear();
 }
 
+void VTFar2lExtensios::OnInteract_ClipboardSetDataChunkCompressed(StackSerializer &stk_ser)
+{
+	if (_clipboard_opens > 0) {
+		uint16_t encoded_chunk_size = 0;
+		uint32_t compressed_size = 0;
+		stk_ser.PopNum(encoded_chunk_size);
+		stk_ser.PopNum(compressed_size);
+		const size_t chunk_size = size_t(encoded_chunk_size) << 8;
+		if (!chunk_size || compressed_size > chunk_size + chunk_size / 255 + 16) {
+			throw std::runtime_error("Bad compressed clipboard chunk size");
+		}
+		std::vector<unsigned char> compressed(compressed_size);
+		stk_ser.Pop(compressed.data(), compressed.size());
+		const size_t prev_size = _clipboard_chunks.size();
+		_clipboard_chunks.resize(prev_size + chunk_size);
+		if (!LZBlockDecompress(_clipboard_chunks.data() + prev_size, chunk_size, compressed.data(), compressed.size())) {
+			_clipboard_chunks.clear();
+			throw std::runtime_error("Corrupted compressed clipboard chunk");
+		}
+	}
+	stk_ser.Clear();
+}
+
 void VTFar2lExtensios::OnInteract_ClipboardSetData(StackSerializer &stk_ser)
 {
 	char out = -1;
@@ -476,6 +503,86 @@ void VTFar2lExtensios::OnInteract_ClipboardGetDataID(StackSerializer &stk_ser)
 	stk_ser.PushNum(id);
 }
 
+void VTFar2lExtensios::TakeClipboardSnapshot(UINT fmt)
+{
+	_clipboard_get_snapshot = ClipboardSnapshot();
+	if (!IsAllowedClipboardRead()) {
+		return;
+	}
+
+	void *data = WINPORT(GetClipboardData)(fmt);
+	if (data) {
+		uint32_t len = WINPORT(ClipboardSize)(data);
+		_clipboard_get_snapshot.id = CalculateDataID(fmt, data, len);
+		_clipboard_get_snapshot.fmt = fmt;
+#if (__WCHAR_MAX__ <= 0xffff)
+		if (fmt == CF_UNICODETEXT) { // UTF16 -> UTF32
+			UtfConverter<uint16_t, uint32_t> cvt((const uint16_t *)data, len / sizeof(uint16_t));
+			std::vector<uint32_t> utf32;
+			cvt.CopyToVector(utf32);
+			_clipboard_get_snapshot.data.assign((const unsigned char *)utf32.data(),
+				(const unsigned char *)(utf32.data() + utf32.size()));
+		} else
+#endif
+		_clipboard_get_snapshot.data.assign((const unsigned char *)data, (const unsigned char *)data + len);
+	}
+
+	AllowClipboardRead(true); // prolong allowance
+}
+
+void VTFar2lExtensios::OnInteract_ClipboardGetDataChunk(StackSerializer &stk_ser)
+{
+	UINT fmt = 0;
+	uint32_t ofs = 0;
+	uint16_t encoded_chunk_size = 0;
+	uint8_t compression = 0;
+	stk_ser.PopNum(fmt);
+	stk_ser.PopNum(ofs);
+	stk_ser.PopNum(encoded_chunk_size);
+	stk_ser.PopNum(compression);
+	stk_ser.Clear();
+
+	if (_clipboard_opens <= 0) {
+		stk_ser.PushNum((uint32_t)-1);
+		return;
+	}
+
+	if (ofs == 0) {
+		TakeClipboardSnapshot(fmt);
+	}
+
+	const auto &snapshot = _clipboard_get_snapshot;
+	const uint32_t total = uint32_t(snapshot.data.size());
+	if (encoded_chunk_size == 0 || snapshot.fmt != fmt || ofs >= total) {
+		_clipboard_get_snapshot = ClipboardSnapshot();
+		stk_ser.PushNum((uint32_t)0);
+		return;
+	}
+
+	const uint32_t chunk_size = std::min(uint32_t(encoded_chunk_size) << 8, total - ofs);
+	const unsigned char *chunk = snapshot.data.data() + ofs;
+	std::vector<unsigned char> compressed;
+	if (compression) {
+		LZBlockCompress(compressed, chunk, chunk_size);
+	}
+	if (!compressed.empty() && compressed.size() < chunk_size) {
+		stk_ser.Push(compressed.data(), compressed.size());
+		stk_ser.PushNum(uint32_t(compressed.size()));
+		stk_ser.PushNum(uint8_t(1));
+	} else {
+		stk_ser.Push(chunk, chunk_size);
+		stk_ser.PushNum(chunk_size);
+		stk_ser.PushNum(uint8_t(0));
+	}
+	stk_ser.PushNum(chunk_size);
+	stk_ser.PushNum(snapshot.id);
+	stk_ser.PushNum(total);
+
+	if (ofs + chunk_size >= total) { // last part retrieved - no need to keep snapshot anymore
+		_clipboard_get_snapshot = ClipboardSnapshot();
+	}
+}
+
 void VTFar2lExtensios::OnInteract_ClipboardRegisterFormat(StackSerializer &stk_ser)
 {
 	const std::wstring &fmt_name = StrMB2Wide(stk_ser.PopStr());
@@ -496,9 +603,11 @@ void VTFar2lExtensios::OnInteract_Clipboard(StackSerializer &stk_ser)
 		case FARTTY_INTERACT_CLIP_EMPTY: OnInteract_ClipboardEmpty(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_ISAVAIL: OnInteract_ClipboardIsFormatAvailable(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_SETDATACHUNK: OnInteract_ClipboardSetDataChunk(stk_ser); break;
+		case FARTTY_INTERACT_CLIP_SETDATACHUNK_COMPRESSED: OnInteract_ClipboardSetDataChunkCompressed(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_SETDATA: OnInteract_ClipboardSetData(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_GETDATA: OnInteract_ClipboardGetData(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_GETDATAID: OnInteract_ClipboardGetDataID(stk_ser); break;
+		case FARTTY_INTERACT_CLIP_GETDATACHUNK: OnInteract_ClipboardGetDataChunk(stk_ser); break;
 		case FARTTY_INTERACT_CLIP_REGISTER_FORMAT: OnInteract_ClipboardRegisterFormat(stk_ser); break;
 
 		default:
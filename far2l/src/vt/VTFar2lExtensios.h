@@ -22,6 +22,13 @@ class VTFar2lExtensios
 	std::set<std::string> _autheds;
 	std::vector<unsigned char> _clipboard_chunks;
 
+	struct ClipboardSnapshot
+	{
+		std::vector<unsigned char> data;
+		uint64_t id = 0;
+		UINT fmt = 0;
+	} _clipboard_get_snapshot; // data being retrieved by chunks
+
 	char ClipboardAuthorize(std::string client_id);
 
 	bool IsAllowedClipboardRead();
@@ -32,9 +39,12 @@ class VTFar2lExtensios
 	void OnInteract_ClipboardEmpty(StackSerializer &stk_ser);
 	void OnInteract_ClipboardIsFormatAvailable(StackSerializer &stk_ser);
 	void OnInteract_ClipboardSetDataChunk(StackSerializer &stk_ser);
+	void OnInteract_ClipboardSetDataChunkCompressed(StackSerializer &stk_ser);
 	void OnInteract_ClipboardSetData(StackSerializer &stk_ser);
 	void OnInteract_ClipboardGetData(StackSerializer &stk_ser);
 	void OnInteract_ClipboardGetDataID(StackSerializer &stk_ser);
+	void OnInteract_ClipboardGetDataChunk(StackSerializer &stk_ser);
+	void TakeClipboardSnapshot(UINT fmt);
 	void OnInteract_ClipboardRegisterFormat(StackSerializer &stk_ser);
 	void OnInteract_Clipboard(StackSerializer &stk_ser);
 
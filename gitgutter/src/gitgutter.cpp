@@ -10,14 +10,19 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cwchar>
 #include <mutex>
 #include <thread>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -83,6 +88,18 @@ static void SplitLines(const std::string &s, std::vector<std::string> &out)
 	}
 }
 
+// keeps line feeds, so last line without it differs from same line that has it
+static void SplitDiffLines(const std::string &s, std::vector<std::string> &out)
+{
+	out.clear();
+	for (size_t pos = 0; pos < s.size();) {
+		size_t eol = s.find('\n', pos);
+		eol = (eol == std::string::npos) ? s.size() : eol + 1;
+		out.emplace_back(s, pos, eol - pos);
+		pos = eol;
+	}
+}
+
 static bool FileExists(const std::string &path)
 {
 	return access(path.c_str(), F_OK) == 0;
@@ -246,9 +263,14 @@ struct EditorState
 	std::string repo_root;
 	bool repo_lookup_failed = false;
 	std::vector<std::string> repo_watch_paths;
+	std::string repo_watch_baseline;
 	uint64_t repo_watch_state = 0;
 	std::string rel_path;
 	std::string temp_path;
+	std::string base_key; // identifies baseline content cached in base_lines
+	std::string base_effective;
+	std::vector<std::string> base_lines;
+	bool base_found = false;
 	std::wstring baseline_label;
 	uint64_t last_update_ms = 0;
 	bool dirty = true;
@@ -704,12 +726,38 @@ static bool GetRelativePath(const std::string &repo_root, const std::string &fil
 	return !rel_path.empty();
 }
 
-static bool WriteEditorBufferToTemp(std::string &path)
+static bool GetEditorBufferText(std::string &text)
 {
+	text.clear();
 	EditorInfo ei{};
 	if (!GetEditorInfo(ei)) {
 		return false;
 	}
+	EditorGetString egs{};
+	for (int i = 0; i < ei.TotalLines; ++i) {
+		egs.StringNumber = i;
+		if (!g_info.EditorControl(ECTL_GETSTRING, &egs)) {
+			return false;
+		}
+		if (egs.StringText && egs.StringLength > 0) {
+			std::wstring wline(egs.StringText, egs.StringText + egs.StringLength);
+			text+= Wide2MB(wline.c_str());
+		}
+		if (egs.StringEOL && *egs.StringEOL) {
+			text+= Wide2MB(egs.StringEOL);
+		} else if (i + 1 < ei.TotalLines) {
+			text+= '\n';
+		}
+	}
+	return true;
+}
+
+static bool WriteEditorBufferToTemp(std::string &path)
+{
+	std::string text;
+	if (!GetEditorBufferText(text)) {
+		return false;
+	}
 	FILE *f = nullptr;
 	if (path.empty()) {
 		if (!MakeTempFile(path, f)) {
@@ -725,41 +773,15 @@ static bool WriteEditorBufferToTemp(std::string &path)
 			}
 		}
 	}
-	EditorGetString egs{};
-	for (int i = 0; i < ei.TotalLines; ++i) {
-		egs.StringNumber = i;
-		if (!g_info.EditorControl(ECTL_GETSTRING, &egs)) {
-			fclose(f);
-			unlink(path.c_str());
-			path.clear();
-			return false;
-		}
-		if (egs.StringText && egs.StringLength > 0) {
-			std::wstring wline(egs.StringText, egs.StringText + egs.StringLength);
-			const std::string mb = Wide2MB(wline.c_str());
-			if (!mb.empty()) {
-				fwrite(mb.data(), 1, mb.size(), f);
-			}
-		}
-		if (egs.StringEOL && *egs.StringEOL) {
-			const std::string eol_mb = Wide2MB(egs.StringEOL);
-			if (!eol_mb.empty()) {
-				fwrite(eol_mb.data(), 1, eol_mb.size(), f);
-			}
-		} else if (i + 1 < ei.TotalLines) {
-			fwrite("\n", 1, 1, f);
-		}
+	if (!text.empty()) {
+		fwrite(text.data(), 1, text.size(), f);
 	}
 	fclose(f);
 	return true;
 }
 
-static bool WriteBaselineToTemp(const std::string &repo_root, const std::string &rel_path,
-		const std::string &baseline, std::string &path)
+static bool BaselineSpec(const std::string &baseline, const std::string &rel_path, std::string &spec)
 {
-	std::string root_arg = repo_root;
-	QuoteCmdArgIfNeed(root_arg);
-	std::string spec;
 	if (baseline == "head") {
 		spec = "HEAD:" + rel_path;
 	} else if (baseline == "index") {
@@ -769,6 +791,18 @@ static bool WriteBaselineToTemp(const std::string &repo_root, const std::string
 	} else {
 		spec = baseline + ":" + rel_path;
 	}
+	return true;
+}
+
+static bool WriteBaselineToTemp(const std::string &repo_root, const std::string &rel_path,
+		const std::string &baseline, std::string &path)
+{
+	std::string root_arg = repo_root;
+	QuoteCmdArgIfNeed(root_arg);
+	std::string spec;
+	if (!BaselineSpec(baseline, rel_path, spec)) {
+		return false;
+	}
 	std::string spec_arg = spec;
 	QuoteCmdArgIfNeed(spec_arg);
 	const std::string cmd = "git -C " + root_arg + " show " + spec_arg;
@@ -941,14 +975,34 @@ static bool RepoStateChanged(EditorState &st)
 	if (st.repo_root.empty()) {
 		return false;
 	}
+	if (st.repo_watch_baseline != g_settings.baseline) {
+		st.repo_watch_paths.clear();
+		st.repo_watch_state = 0;
+	}
 	if (st.repo_watch_paths.empty()) {
 		std::string root_arg = st.repo_root;
 		QuoteCmdArgIfNeed(root_arg);
+		std::string cmd = "git -C " + root_arg
+				+ " rev-parse --git-path HEAD --git-path logs/HEAD --git-path index --git-path packed-refs";
 		std::string out;
-		if (!RunCommand("git -C " + root_arg
-				+ " rev-parse --git-path HEAD --git-path logs/HEAD --git-path index --git-path packed-refs", out)) {
+		if (IsCustomBaseline(g_settings.baseline)) {
+			// custom baseline's ref file (if any) changes on fetch or commit to other branch
+			std::string base_arg = g_settings.baseline;
+			QuoteCmdArgIfNeed(base_arg);
+			if (RunCommand("git -C " + root_arg + " rev-parse --symbolic-full-name " + base_arg + " 2>/dev/null", out)) {
+				const std::string ref = TrimLineEnd(out);
+				if (!ref.empty() && ref.find('\n') == std::string::npos) {
+					std::string ref_arg = ref;
+					QuoteCmdArgIfNeed(ref_arg);
+					cmd += " --git-path " + ref_arg;
+				}
+			}
+			out.clear();
+		}
+		if (!RunCommand(cmd, out)) {
 			return false;
 		}
+		st.repo_watch_baseline = g_settings.baseline;
 		SplitLines(out, st.repo_watch_paths);
 		for (std::string &path : st.repo_watch_paths) {
 			if (!path.empty() && path[0] != '/')
@@ -960,10 +1014,15 @@ static bool RepoStateChanged(EditorState &st)
 	for (const std::string &path : st.repo_watch_paths) {
 		struct stat stbuf {};
 		if (stat(path.c_str(), &stbuf) == 0)
-			state = state * 33 + stbuf.st_ino + stbuf.st_size + stbuf.st_mtime;
+			state = state * 33 + stbuf.st_ino + stbuf.st_size + stbuf.st_mtim.tv_sec * 1000000000ull + stbuf.st_mtim.tv_nsec;
+		else
+			state = state * 33 + 1; // ref file may be packed or appear later
 	}
 	const bool changed = st.repo_watch_state && state != st.repo_watch_state;
 	st.repo_watch_state = state;
+	if (changed) {
+		st.base_key.clear();
+	}
 	return changed;
 }
 
@@ -1010,6 +1069,381 @@ static bool RunDiffCommand(const std::string &repo_root, const std::string &file
 	return false;
 }
 
+// Long-living `git cat-file --batch` of some repository, reads baseline blobs
+// without spawning git and looking up repository on each update.
+class GitCatFile
+{
+	pid_t _pid = -1;
+	int _request = -1;
+	int _reply = -1;
+	std::string _buf;
+
+	bool FillBuffer()
+	{
+		char tmp[0x10000];
+		for (;;) {
+			const ssize_t r = read(_reply, tmp, sizeof(tmp));
+			if (r > 0) {
+				_buf.append(tmp, r);
+				return true;
+			}
+			if (r == 0 || errno != EINTR) {
+				return false;
+			}
+		}
+	}
+
+	bool ReadLine(std::string &line)
+	{
+		for (size_t scanned = 0;;) {
+			const size_t eol = _buf.find('\n', scanned);
+			if (eol != std::string::npos) {
+				line.assign(_buf, 0, eol);
+				_buf.erase(0, eol + 1);
+				return true;
+			}
+			scanned = _buf.size();
+			if (!FillBuffer()) {
+				return false;
+			}
+		}
+	}
+
+	bool ReadExact(size_t len, std::string &data)
+	{
+		while (_buf.size() < len) {
+			if (!FillBuffer()) {
+				return false;
+			}
+		}
+		data.assign(_buf, 0, len);
+		_buf.erase(0, len);
+		return true;
+	}
+
+public:
+	GitCatFile(const std::string &repo_root)
+	{
+		int request[2] = {-1, -1}, reply[2] = {-1, -1};
+		if (pipe(request) == -1) {
+			return;
+		}
+		if (pipe(reply) == -1) {
+			close(request[0]);
+			close(request[1]);
+			return;
+		}
+		_pid = fork();
+		if (_pid == 0) {
+			dup2(request[0], 0);
+			dup2(reply[1], 1);
+			const int null_fd = open("/dev/null", O_WRONLY);
+			if (null_fd != -1) {
+				dup2(null_fd, 2);
+			}
+			execlp("git", "git", "-C", repo_root.c_str(), "cat-file", "--batch", (const char *)nullptr);
+			_exit(127);
+		}
+		close(request[0]);
+		close(reply[1]);
+		if (_pid == -1) {
+			close(request[1]);
+			close(reply[0]);
+			return;
+		}
+		_request = request[1];
+		_reply = reply[0];
+		MakeFDCloexec(_request);
+		MakeFDCloexec(_reply);
+	}
+
+	~GitCatFile()
+	{
+		if (_request != -1) {
+			close(_request);
+		}
+		if (_reply != -1) {
+			close(_reply);
+		}
+		if (_pid > 0) {
+			kill(_pid, SIGTERM);
+			waitpid(_pid, nullptr, 0);
+		}
+	}
+
+	bool Valid() const { return _request != -1 && _reply != -1; }
+
+	uint64_t last_used_ms = 0;
+
+	// returns false if process failed, otherwise found tells if spec names existing blob
+	bool Read(const std::string &spec, bool &found, std::string &content)
+	{
+		found = false;
+		content.clear();
+		if (!Valid() || spec.find('\n') != std::string::npos) {
+			return false;
+		}
+		const std::string request = spec + '\n';
+		if (WriteAll(_request, request.data(), request.size()) != request.size()) {
+			return false;
+		}
+		std::string header;
+		if (!ReadLine(header)) {
+			return false;
+		}
+		// "<oid> <type> <size>" or "<spec> missing", "<spec> ambiguous" where spec may contain spaces
+		if (StrEndsBy(header, " missing") || StrEndsBy(header, " ambiguous")) {
+			return true;
+		}
+		const size_t type_pos = header.find(' ');
+		const size_t size_pos = header.rfind(' ');
+		if (type_pos == std::string::npos || size_pos == type_pos
+				|| header.find(' ', type_pos + 1) != size_pos
+				|| header.find_first_not_of("0123456789abcdef") != type_pos
+				|| size_pos + 1 == header.size()
+				|| header.find_first_not_of("0123456789", size_pos + 1) != std::string::npos) {
+			return false; // unexpected reply, dont know how much to skip
+		}
+		const std::string type = header.substr(type_pos + 1, size_pos - type_pos - 1);
+		const size_t size = strtoul(header.c_str() + size_pos + 1, nullptr, 10);
+		std::string trailer;
+		if (!ReadExact(size, content) || !ReadExact(1, trailer)) {
+			return false;
+		}
+		found = (type == "blob");
+		if (!found) {
+			content.clear();
+		}
+		return true;
+	}
+};
+
+static std::unordered_map<std::string, std::unique_ptr<GitCatFile>> g_cat_files;
+
+#define CAT_FILE_IDLE_MS (5 * 60 * 1000)
+
+// stops processes of repositories not used by any editor or not used for long time
+static void ReapCatFiles()
+{
+	const uint64_t now = NowMs();
+	for (auto it = g_cat_files.begin(); it != g_cat_files.end();) {
+		bool used = it->second && now - it->second->last_used_ms < CAT_FILE_IDLE_MS;
+		if (used) {
+			used = std::any_of(g_editors.begin(), g_editors.end(),
+				[&](const std::pair<const int, EditorState> &kv) { return kv.second.repo_root == it->first; });
+		}
+		if (used) {
+			++it;
+		} else {
+			it = g_cat_files.erase(it);
+		}
+	}
+}
+
+// returns false if baseline can't be read without spawning git on its own
+static bool ReadBaselineBlob(const std::string &repo_root, const std::string &spec, bool &found, std::string &content)
+{
+	ReapCatFiles();
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		auto &cat_file = g_cat_files[repo_root];
+		if (!cat_file) {
+			cat_file.reset(new GitCatFile(repo_root));
+		}
+		cat_file->last_used_ms = NowMs();
+		if (cat_file->Read(spec, found, content)) {
+			return true;
+		}
+		cat_file.reset(); // process died? retry with new one
+	}
+	g_cat_files.erase(repo_root);
+	return false;
+}
+
+static bool LoadBaseline(EditorState &st, const std::string &rel_path, std::string &effective_baseline)
+{
+	std::string key, content;
+	bool found = false;
+	if (g_settings.baseline == "unstaged") {
+		struct stat s{};
+		if (stat(st.file.c_str(), &s) == 0) {
+			key = "unstaged:" + std::to_string(s.st_size) + ':' + std::to_string(s.st_mtim.tv_sec)
+					+ '.' + std::to_string(s.st_mtim.tv_nsec) + ':' + std::to_string(s.st_ino);
+		} else {
+			key = "unstaged:";
+		}
+		if (key == st.base_key) {
+			effective_baseline = st.base_effective;
+			return true;
+		}
+		ReadWholeFile(st.file.c_str(), content); // missing file means everything added
+		found = true;
+		effective_baseline = g_settings.baseline;
+
+	} else {
+		if (rel_path.empty() || rel_path[0] == '/') {
+			return false;
+		}
+		key = g_settings.baseline + ':' + rel_path;
+		if (key == st.base_key) {
+			effective_baseline = st.base_effective;
+			return true;
+		}
+		std::string spec;
+		BaselineSpec(g_settings.baseline, rel_path, spec);
+		if (!ReadBaselineBlob(st.repo_root, spec, found, content)) {
+			return false;
+		}
+		effective_baseline = g_settings.baseline;
+		if (!found && IsCustomBaseline(g_settings.baseline)) {
+			BaselineSpec("head", rel_path, spec);
+			if (!ReadBaselineBlob(st.repo_root, spec, found, content)) {
+				return false;
+			}
+			effective_baseline = "head";
+		}
+		if (!found) {
+			effective_baseline = g_settings.baseline;
+		}
+	}
+
+	st.base_key = key;
+	st.base_effective = effective_baseline;
+	st.base_found = found;
+	SplitDiffLines(content, st.base_lines);
+	return true;
+}
+
+static void AppendHunk(std::string &out, const std::vector<std::string> &old_lines, size_t old_begin, size_t old_end,
+		const std::vector<std::string> &new_lines, size_t new_begin, size_t new_end)
+{
+	auto append_range = [&out](char kind, size_t begin, size_t count)
+	{
+		out+= ' ';
+		out+= kind;
+		out+= std::to_string(count ? begin + 1 : begin);
+		if (count != 1) {
+			out+= ',';
+			out+= std::to_string(count);
+		}
+	};
+	auto append_lines = [&out](char kind, const std::vector<std::string> &lines, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i) {
+			out+= kind;
+			out+= lines[i];
+			if (lines[i].empty() || lines[i].back() != '\n') {
+				out+= "\n\\ No newline at end of file\n";
+			}
+		}
+	};
+	out+= "@@";
+	append_range('-', old_begin, old_end - old_begin);
+	append_range('+', new_begin, new_end - new_begin);
+	out+= " @@\n";
+	append_lines('-', old_lines, old_begin, old_end);
+	append_lines('+', new_lines, new_begin, new_end);
+}
+
+// Myers diff producing same unified=0 output as git diff does. Returns false if files
+// differ too much, so caller falls back to git that handles such cases better.
+static bool BuildUnifiedDiff(const std::vector<std::string> &old_lines, const std::vector<std::string> &new_lines,
+		std::string &out)
+{
+	static constexpr int MAX_EDIT_DISTANCE = 1000;
+
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<uint32_t> a, b;
+	a.reserve(old_lines.size());
+	b.reserve(new_lines.size());
+	for (const auto &line : old_lines) {
+		a.emplace_back(ids.emplace(line, static_cast<uint32_t>(ids.size())).first->second);
+	}
+	for (const auto &line : new_lines) {
+		b.emplace_back(ids.emplace(line, static_cast<uint32_t>(ids.size())).first->second);
+	}
+
+	const int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+	const int offset = MAX_EDIT_DISTANCE + 1;
+	std::vector<int> v(2 * offset + 1, 0);
+	std::vector<std::vector<int>> trace; // trace[d] = v[-d-1 .. d+1] before step d
+	int found_d = -1;
+	for (int d = 0; d <= MAX_EDIT_DISTANCE && found_d == -1; ++d) {
+		trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+		for (int k = -d; k <= d; k+= 2) {
+			int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+					? v[offset + k + 1] : v[offset + k - 1] + 1;
+			int y = x - k;
+			while (x < n && y < m && a[x] == b[y]) {
+				++x;
+				++y;
+			}
+			v[offset + k] = x;
+			if (x >= n && y >= m) {
+				found_d = d;
+				break;
+			}
+		}
+	}
+	if (found_d == -1) {
+		return false;
+	}
+
+	std::vector<std::pair<int, int>> matches;
+	int x = n, y = m;
+	for (int d = found_d; d > 0; --d) {
+		const std::vector<int> &pv = trace[d];
+		auto prev_v = [&](int k) { return pv[k + d + 1]; };
+		const int k = x - y;
+		const int prev_k = (k == -d || (k != d && prev_v(k - 1) < prev_v(k + 1))) ? k + 1 : k - 1;
+		const int prev_x = prev_v(prev_k);
+		const int prev_y = prev_x - prev_k;
+		while (x > prev_x && y > prev_y) {
+			matches.emplace_back(--x, --y);
+		}
+		x = prev_x;
+		y = prev_y;
+	}
+	while (x > 0 && y > 0) {
+		matches.emplace_back(--x, --y);
+	}
+	std::reverse(matches.begin(), matches.end());
+	matches.emplace_back(n, m);
+
+	out.clear();
+	int old_pos = 0, new_pos = 0;
+	for (const auto &match : matches) {
+		if (match.first > old_pos || match.second > new_pos) {
+			AppendHunk(out, old_lines, old_pos, match.first, new_lines, new_pos, match.second);
+		}
+		old_pos = match.first + 1;
+		new_pos = match.second + 1;
+	}
+	return true;
+}
+
+static bool TryInProcessDiff(EditorState &st, std::string &out, std::string &effective_baseline)
+{
+	std::string rel_path;
+	if (g_settings.baseline != "unstaged" && !GetRelativePath(st.repo_root, st.file, rel_path)) {
+		return false;
+	}
+	if (!LoadBaseline(st, rel_path, effective_baseline)) {
+		return false;
+	}
+	out.clear();
+	if (!st.base_found) { // not in baseline (e.g. untracked file) - nothing to mark
+		return true;
+	}
+
+	std::string text;
+	std::vector<std::string> buffer_lines;
+	if (!GetEditorBufferText(text)) {
+		return false;
+	}
+	SplitDiffLines(text, buffer_lines);
+	return BuildUnifiedDiff(st.base_lines, buffer_lines, out);
+}
+
 static bool TryRunEditorBufferDiff(EditorState &st, std::string &out, std::string &effective_baseline)
 {
 	if (!WriteEditorBufferToTemp(st.temp_path)) {
@@ -1094,6 +1528,7 @@ static void UpdateEditorState(EditorState &st)
 		st.repo_watch_paths.clear();
 		st.repo_watch_state = 0;
 		st.rel_path.clear();
+		st.base_key.clear();
 	}
 
 	if (st.file.empty()) {
@@ -1116,7 +1551,8 @@ static void UpdateEditorState(EditorState &st)
 
 	std::string out;
 	std::string effective_baseline = g_settings.baseline;
-	if (!TryRunEditorBufferDiff(st, out, effective_baseline)) {
+	if (!TryInProcessDiff(st, out, effective_baseline)
+			&& !TryRunEditorBufferDiff(st, out, effective_baseline)) {
 		RunDiffCommand(st.repo_root, st.file, out, effective_baseline);
 	}
 
@@ -2001,6 +2437,7 @@ SHAREDSYMBOL int WINAPI ProcessEditorEventW(int Event, void *Param)
 			}
 			g_editors.erase(ei.EditorID);
 		}
+		ReapCatFiles();
 		g_watch_active = !g_editors.empty();
 		g_tick_cv.notify_one();
 		return 0;
@@ -2129,5 +2566,6 @@ SHAREDSYMBOL void WINAPI ExitFARW()
 {
 	StopTickThread();
 	g_editors.clear();
+	g_cat_files.clear();
 	g_watch_active = false;
 }
@@ -0,0 +1,196 @@
+/**************************************************************************
+ *  Hexitor plug-in for FAR 3.0 modifed by m32 2024 for far2l             *
+ *  Copyright (C) 2010-2014 by Artem Senichev <artemsen@gmail.com>        *
+ *  https://sourceforge.net/projects/farplugs/                            *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include "document.h"
+#include "file.h"
+#include <algorithm>
+
+
+document::document(const file& f)
+:	_file(f),
+	_size(0)
+{
+}
+
+
+void document::reset()
+{
+	_pieces.clear();
+	_added.clear();
+	_size = _file.size();
+	if (_size)
+		_pieces.push_back(piece{ 0, _size, false });
+	normalize();
+}
+
+
+bool document::modified() const
+{
+	if (_size != _file.size())
+		return true;
+	if (_pieces.empty())
+		return false;
+	return _pieces.size() != 1 || _pieces.front().added || _pieces.front().offset != 0;
+}
+
+
+bool document::in_place() const
+{
+	if (_size != _file.size())
+		return false;
+
+	for (size_t i = 0; i < _pieces.size(); ++i) {
+		if (!_pieces[i].added && _pieces[i].offset != _starts[i])
+			return false;
+	}
+
+	return true;
+}
+
+
+DWORD document::read(const UINT64 offset, vector<BYTE>& buffer, const size_t sz, vector<BYTE>* upd /*= nullptr*/) const
+{
+	assert(offset < _size);
+
+	const size_t length = static_cast<size_t>(min(static_cast<UINT64>(sz), _size - offset));
+	buffer.resize(length);
+	if (upd)
+		upd->assign(length, 0);
+
+	size_t idx = static_cast<size_t>(upper_bound(_starts.begin(), _starts.end(), offset) - _starts.begin()) - 1;
+	size_t filled = 0;
+	while (filled < length) {
+		assert(idx < _pieces.size());
+		const piece& p = _pieces[idx];
+		const UINT64 piece_offset = offset + filled - _starts[idx];
+		const size_t count = static_cast<size_t>(min(p.length - piece_offset, static_cast<UINT64>(length - filled)));
+		if (p.added) {
+			memcpy(&buffer[filled], &_added[static_cast<size_t>(p.offset + piece_offset)], count);
+			if (upd)
+				memset(&(*upd)[filled], 1, count);
+		}
+		else {
+			size_t rd = 0;
+			const DWORD rc = _file.read(p.offset + piece_offset, &buffer[filled], count, rd);
+			if (rc != ERROR_SUCCESS || rd != count) {
+				buffer.resize(filled + rd);
+				if (upd)
+					upd->resize(buffer.size());
+				return rc;
+			}
+		}
+		filled += count;
+		++idx;
+	}
+
+	return ERROR_SUCCESS;
+}
+
+
+document::change document::replace(const UINT64 offset, const UINT64 del_len, const BYTE* data, const size_t len)
+{
+	assert(offset <= _size && del_len <= _size - offset);
+
+	change chg;
+	chg.offset = offset;
+	if (len) {
+		chg.inserted.push_back(piece{ _added.size(), len, true });
+		_added.insert(_added.end(), data, data + len);
+	}
+	chg.removed = splice(offset, del_len, chg.inserted);
+	return chg;
+}
+
+
+void document::undo(const change& chg)
+{
+	splice(chg.offset, total_length(chg.inserted), chg.removed);
+}
+
+
+void document::redo(const change& chg)
+{
+	splice(chg.offset, total_length(chg.removed), chg.inserted);
+}
+
+
+UINT64 document::total_length(const vector<piece>& pieces)
+{
+	UINT64 length = 0;
+	for (vector<piece>::const_iterator it = pieces.begin(); it != pieces.end(); ++it)
+		length += it->length;
+	return length;
+}
+
+
+size_t document::split(const UINT64 offset)
+{
+	if (offset >= _size)
+		return _pieces.size();
+
+	const size_t idx = static_cast<size_t>(upper_bound(_starts.begin(), _starts.end(), offset) - _starts.begin()) - 1;
+	if (_starts[idx] == offset)
+		return idx;
+
+	piece& left = _pieces[idx];
+	const UINT64 left_length = offset - _starts[idx];
+	const piece right = { left.offset + left_length, left.length - left_length, left.added };
+	left.length = left_length;
+	_pieces.insert(_pieces.begin() + idx + 1, right);
+	_starts.insert(_starts.begin() + idx + 1, offset);
+	return idx + 1;
+}
+
+
+vector<document::piece> document::splice(const UINT64 offset, const UINT64 length, const vector<piece>& ins)
+{
+	const size_t first = split(offset);
+	const size_t last = split(offset + length);
+
+	vector<piece> removed(_pieces.begin() + first, _pieces.begin() + last);
+	_pieces.erase(_pieces.begin() + first, _pieces.begin() + last);
+	_pieces.insert(_pieces.begin() + first, ins.begin(), ins.end());
+	_size = _size - length + total_length(ins);
+	normalize();
+
+	return removed;
+}
+
+
+void document::normalize()
+{
+	size_t out = 0;
+	for (size_t i = 0; i < _pieces.size(); ++i) {
+		const piece& p = _pieces[i];
+		if (!p.length)
+			continue;
+		if (out && _pieces[out - 1].added == p.added && _pieces[out - 1].offset + _pieces[out - 1].length == p.offset)
+			_pieces[out - 1].length += p.length;
+		else
+			_pieces[out++] = p;
+	}
+	_pieces.resize(out);
+
+	_starts.resize(_pieces.size());
+	UINT64 start = 0;
+	for (size_t i = 0; i < _pieces.size(); ++i) {
+		_starts[i] = start;
+		start += _pieces[i].length;
+	}
+}
@@ -0,0 +1,147 @@
+/**************************************************************************
+ *  Hexitor plug-in for FAR 3.0 modifed by m32 2024 for far2l             *
+ *  Copyright (C) 2010-2014 by Artem Senichev <artemsen@gmail.com>        *
+ *  https://sourceforge.net/projects/farplugs/                            *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#pragma once
+
+#include "common.h"
+
+class file;
+
+/**
+ * Edited content: piece table over original file data and append-only buffer of added data.
+ * Content is never copied, any edit only splits pieces around changed range.
+ */
+class document
+{
+public:
+	//Piece of content
+	struct piece {
+		UINT64	offset;			///< Offset in the file or in the added data buffer
+		UINT64	length;			///< Length
+		bool	added;			///< Piece refers to added data buffer
+	};
+
+	//Change description (for undo/redo operations)
+	struct change {
+		UINT64			offset;		///< Changed range offset
+		vector<piece>	removed;	///< Pieces removed from the range
+		vector<piece>	inserted;	///< Pieces inserted into the range
+	};
+
+	document(const file& f);
+
+	/**
+	 * Reset to unmodified file content
+	 */
+	void reset();
+
+	/**
+	 * Get content size
+	 * \return content size in bytes
+	 */
+	inline UINT64 size() const			{ return _size; }
+
+	/**
+	 * Check if content differs from original file
+	 * \return true if content was modified
+	 */
+	bool modified() const;
+
+	/**
+	 * Check if content can be saved by writing added pieces over the file
+	 * \return true if all original pieces remain at their places
+	 */
+	bool in_place() const;
+
+	/**
+	 * Read content, touching only pieces that overlap requested range
+	 * \param offset start position
+	 * \param buffer buffer to read
+	 * \param sz max buffer size
+	 * \param upd optional array to receive flags of modified bytes
+	 * \return error code (ERROR_SUCCESS if no error)
+	 */
+	DWORD read(const UINT64 offset, vector<BYTE>& buffer, const size_t sz, vector<BYTE>* upd = nullptr) const;
+
+	/**
+	 * Replace range (overwrite, insert or delete data)
+	 * \param offset range offset
+	 * \param del_len range length to delete
+	 * \param data data to insert
+	 * \param len data length
+	 * \return change description
+	 */
+	change replace(const UINT64 offset, const UINT64 del_len, const BYTE* data, const size_t len);
+
+	/**
+	 * Revert change
+	 * \param chg change description
+	 */
+	void undo(const change& chg);
+
+	/**
+	 * Apply reverted change again
+	 * \param chg change description
+	 */
+	void redo(const change& chg);
+
+	/**
+	 * Get pieces
+	 * \return pieces array
+	 */
+	inline const vector<piece>& pieces() const	{ return _pieces; }
+
+	/**
+	 * Get data of added piece
+	 * \param p piece
+	 * \return pointer to piece's data
+	 */
+	inline const BYTE* added_data(const piece& p) const	{ return &_added[static_cast<size_t>(p.offset)]; }
+
+private:
+	static UINT64 total_length(const vector<piece>& pieces);
+
+	/**
+	 * Split piece to make boundary at given position
+	 * \param offset position
+	 * \return index of the piece that starts at given position
+	 */
+	size_t split(const UINT64 offset);
+
+	/**
+	 * Replace pieces of range with new ones
+	 * \param offset range offset
+	 * \param length range length
+	 * \param ins new pieces
+	 * \return removed pieces
+	 */
+	vector<piece> splice(const UINT64 offset, const UINT64 length, const vector<piece>& ins);
+
+	/**
+	 * Merge adjacent pieces that refer to contiguous data and rebuild offsets index
+	 */
+	void normalize();
+
+private:
+	const file&		_file;		///< Original file
+	vector<piece>	_pieces;	///< Pieces
+	vector<UINT64>	_starts;	///< Content offset of each piece
+	vector<BYTE>	_added;		///< Added data buffer
+	UINT64			_size;		///< Content size
+};
@@ -47,6 +47,68 @@ UINT64 find_prev_utf8_start(const editor* ed, UINT64 current_offset)
 	return offset;
 }
 
+//Masked search helpers: mask selects the bits of the sequence to compare,
+//a fully defined byte (anchor) is used to skip mismatches quickly
+static size_t seq_anchor(const vector<BYTE>& mask)
+{
+	for (size_t i = 0; i < mask.size(); ++i) {
+		if (mask[i] == 0xff)
+			return i;
+	}
+	return mask.size();
+}
+
+static inline bool seq_match(const BYTE* data, const vector<BYTE>& seq, const vector<BYTE>& mask)
+{
+	for (size_t i = 0; i < seq.size(); ++i) {
+		if ((data[i] & mask[i]) != (seq[i] & mask[i]))
+			return false;
+	}
+	return true;
+}
+
+//Find first sequence position in buffer (string::npos if not found)
+static size_t seq_find_first(const BYTE* buf, const size_t sz, const vector<BYTE>& seq, const vector<BYTE>& mask, const size_t anchor)
+{
+	const size_t seq_size = seq.size();
+	if (sz < seq_size)
+		return string::npos;
+
+	if (anchor < seq_size) {
+		const BYTE* end = buf + sz - seq_size + anchor + 1;
+		for (const BYTE* p = buf + anchor; p < end; ++p) {
+			p = reinterpret_cast<const BYTE*>(memchr(p, seq[anchor], end - p));
+			if (!p)
+				break;
+			if (seq_match(p - anchor, seq, mask))
+				return static_cast<size_t>(p - anchor - buf);
+		}
+		return string::npos;
+	}
+
+	for (size_t pos = 0; pos + seq_size <= sz; ++pos) {
+		if (seq_match(buf + pos, seq, mask))
+			return pos;
+	}
+	return string::npos;
+}
+
+//Find last sequence position in buffer (string::npos if not found)
+static size_t seq_find_last(const BYTE* buf, const size_t sz, const vector<BYTE>& seq, const vector<BYTE>& mask, const size_t anchor)
+{
+	const size_t seq_size = seq.size();
+	if (sz < seq_size)
+		return string::npos;
+
+	for (size_t pos = sz - seq_size + 1; pos-- > 0; ) {
+		if (anchor < seq_size && buf[pos + anchor] != seq[anchor])
+			continue;
+		if (seq_match(buf + pos, seq, mask))
+			return pos;
+	}
+	return string::npos;
+}
+
 #define MIN_WIDTH		100		//Minimum width width size of main edit window
 #define MIN_HEIGHT	3		//Minimum height width size of main edit window
 
@@ -104,7 +166,8 @@ static inline auto msg_box(const FARMESSAGEFLAGS f, const wchar_t* (&msgs)[N]) {
 //#############################################################################
 
 editor::editor()
-:	_cursor_offset(0), _cursor_fbp(true), _cursor_iha(true),
+:	_doc(_file), _insert_mode(false),
+	_cursor_offset(0), _cursor_fbp(true), _cursor_iha(true),
 	_view_offset(0),
 	_undo_pos(string::npos)
 {
@@ -132,7 +195,8 @@ bool editor::edit(const wchar_t* file_name, const UINT64 file_offset /*= 0*/)
 		return false;
 	}
 
-	if (_file.size() == 0)
+	_doc.reset();
+	if (_doc.size() == 0)
 		return false;
 
 	//Initialize screen controls
@@ -150,6 +214,7 @@ bool editor::edit(const wchar_t* file_name, const UINT64 file_offset /*= 0*/)
 
 	_statusbar.write_filename(file_name);
 	_statusbar.write_mode_flag(_file.writable());
+	_statusbar.write_insert_flag(_insert_mode);
 	_statusbar.write_codepage(_hexeditor.get_codepage());
 	_statusbar.write_offset(file_offset);
 	_statusbar.write_position(0);
@@ -188,8 +253,8 @@ bool editor::edit(const wchar_t* file_name, const UINT64 file_offset /*= 0*/)
 			_view_offset = _cursor_offset - _cursor_offset % 0x10;
 	}
 
-	if (_cursor_offset >= _file.size())
-		_cursor_offset = _file.size() - 1;
+	if (_cursor_offset >= _doc.size())
+		_cursor_offset = _doc.size() - 1;
 	if (!update_buffer(_view_offset))
 		return false;
 
@@ -330,7 +395,7 @@ bool editor::handle_key_down(int key){
 
 bool editor::save()
 {
-	if (_upd_data.empty())
+	if (!_doc.modified())
 		return true;
 
 	if (_file.read_only()) {
@@ -349,8 +414,22 @@ bool editor::save()
 		}
 	}
 
+	progress progress_wnd(I18N(ps_sav_title), 0, _doc.size());
+
 	DWORD save_status;
-	while ((save_status = _file.save(_upd_data)) != ERROR_SUCCESS) {
+	bool damaged;
+	while ((save_status = _file.save(_doc, &editor::copy_progress_routine, &progress_wnd, damaged)) != ERROR_SUCCESS) {
+		if (save_status == ERROR_REQUEST_ABORTED)
+			return false;
+		if (damaged) {
+			//Document refers to partially overwritten file now, so can't be saved again
+			const wstring backup_name = _file.backup_name();
+			const wchar_t* err_msg[] = {
+				I18N(ps_sav_title), I18N(ps_err_save_file), _file.name(), I18N(ps_err_save_kept), backup_name.c_str()
+			};
+			msg_box(FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, err_msg);
+			return false;
+		}
 		const wchar_t* err_msg[] = {
 			I18N(ps_sav_title), I18N(ps_err_save_file), _file.name()
 		};
@@ -358,7 +437,12 @@ bool editor::save()
 			return false;
 	}
 
-	_upd_data.clear();
+	progress_wnd.hide();
+
+	//Saved content becomes the original one, so old changes can't be reverted anymore
+	_doc.reset();
+	_undo.clear();
+	_undo_pos = string::npos;
 	update_buffer(_view_offset);	//Re-read
 	_statusbar.write_update_flag(false);
 	update_screen();
@@ -384,11 +468,11 @@ void editor::save_as()
 			return;
 	}
 
-	progress progress_wnd(I18N(ps_sav_title), 0, _file.size());
+	progress progress_wnd(I18N(ps_sav_title), 0, _doc.size());
 
 	DWORD save_status;
-	while ((save_status = _file.save_as(new_file_name, _upd_data, &editor::copy_progress_routine, &progress_wnd)) != ERROR_SUCCESS) {
-		if (save_status != NO_ERROR)
+	while ((save_status = _file.save_as(new_file_name, _doc, &editor::copy_progress_routine, &progress_wnd)) != ERROR_SUCCESS) {
+		if (save_status == ERROR_REQUEST_ABORTED)
 			return;
 		const wchar_t* err_msg[] = {
 			I18N(ps_sav_title), I18N(ps_err_save_file), _file.name()
@@ -397,7 +481,11 @@ void editor::save_as()
 			return;
 	}
 
-	_upd_data.clear();
+	progress_wnd.hide();
+
+	_doc.reset();
+	_undo.clear();
+	_undo_pos = string::npos;
 	update_buffer(_view_offset);	//Re-read
 
 	_statusbar.write_mode_flag(_file.writable());
@@ -439,7 +527,7 @@ bool editor::move_handle_key(int key)
 		case KEY_END:
 			_cursor_fbp = true;
 			if (ctrl_pressed) {
-				_cursor_offset = _file.size() - 1;
+				_cursor_offset = _doc.size() - 1;
 				if (_cursor_offset > _hexeditor.showed_data_size()) {
 					const UINT64 needed_offset = _cursor_offset - (_cursor_offset % 0x10) + 0x10 - _hexeditor.showed_data_size();
 					if (_view_offset != needed_offset)
@@ -448,8 +536,8 @@ bool editor::move_handle_key(int key)
 			}
 			else {
 				_cursor_offset = _cursor_offset + 0x10 - (_cursor_offset % 0x10) - 1;
-				if (_cursor_offset >= _file.size())
-					_cursor_offset = _file.size() - 1;
+				if (_cursor_offset >= _doc.size())
+					_cursor_offset = _doc.size() - 1;
 				if (!_cursor_iha && _hexeditor.get_codepage() == CP_UTF16LE)
 					--_cursor_offset;
 			}
@@ -498,17 +586,17 @@ bool editor::move_handle_key(int key)
 			if (ctrl_pressed) {
 				_cursor_fbp = true;
 				_cursor_offset = _cursor_offset + 0x4 - (_cursor_offset % 0x4);
-				if (_cursor_offset >= _file.size())
-					_cursor_offset = _file.size() - 1;
+				if (_cursor_offset >= _doc.size())
+					_cursor_offset = _doc.size() - 1;
 			} else {
 				if (!_cursor_iha && _hexeditor.get_codepage() == CP_UTF8) {
 					// Move to the beginning of the next UTF-8 character
-					if (_cursor_offset < _file.size()) {
+					if (_cursor_offset < _doc.size()) {
 						int len = get_utf8_char_len(get_current_value(_cursor_offset));
-						if (_cursor_offset + len < _file.size()) {
+						if (_cursor_offset + len < _doc.size()) {
 							_cursor_offset += len;
 						} else {
-							_cursor_offset = _file.size() -1;
+							_cursor_offset = _doc.size() -1;
 						}
 						_cursor_fbp = true;
 					}
@@ -546,7 +634,7 @@ bool editor::move_handle_key(int key)
 		case KEY_NUMPAD2:
 		case KEY_DOWN:
 			if (ctrl_pressed) {
-				if (_view_offset + _hexeditor.showed_data_size() < _file.size()) {
+				if (_view_offset + _hexeditor.showed_data_size() < _doc.size()) {
 					if (!_cursor_iha)
 						_cursor_fbp = true;
 					_cursor_offset += 0x10;
@@ -554,7 +642,7 @@ bool editor::move_handle_key(int key)
 				}
 			}
 			else {
-				if (_cursor_offset  + 0x10 < _file.size()) {
+				if (_cursor_offset  + 0x10 < _doc.size()) {
 					if (!_cursor_iha)
 						_cursor_fbp = true;
 					_cursor_offset += 0x10;
@@ -584,20 +672,20 @@ bool editor::move_handle_key(int key)
 
 		case KEY_NUMPAD3:
 		case KEY_PGDN:
-			if (_view_offset + _hexeditor.showed_data_size() * 2 < _file.size()) {
+			if (_view_offset + _hexeditor.showed_data_size() * 2 < _doc.size()) {
 				if (!_cursor_iha)
 					_cursor_fbp = true;
 				update_buffer(_view_offset + _hexeditor.showed_data_size());
 				_cursor_offset += _hexeditor.showed_data_size();
 			}
 			else {
-				const UINT64 needed_offset = _file.size() <= _hexeditor.showed_data_size() ? 0 : _file.size() - _hexeditor.showed_data_size() + ((_file.size() % 0x10) ? 0x10 - (_file.size() % 0x10) : 0);
+				const UINT64 needed_offset = _doc.size() <= _hexeditor.showed_data_size() ? 0 : _doc.size() - _hexeditor.showed_data_size() + ((_doc.size() % 0x10) ? 0x10 - (_doc.size() % 0x10) : 0);
 				if (_view_offset != needed_offset) {
 					if (!_cursor_iha)
 						_cursor_fbp = true;
 					_cursor_offset += needed_offset - _view_offset;
-					if (_cursor_offset >= _file.size())
-						_cursor_offset = _file.size() - 1;
+					if (_cursor_offset >= _doc.size())
+						_cursor_offset = _doc.size() - 1;
 					update_buffer(needed_offset);
 				}
 			}
@@ -632,8 +720,8 @@ bool editor::move_handle_mouse(int msg, int ctrl, MOUSE_EVENT_RECORD *rec)
 			bool first_part = true;
 			bool hex_area = true;
 			if (_hexeditor.offset_from_cursor(_view_offset, rec->dwMousePosition, offset, first_part, hex_area)) {
-				if (offset >= _file.size()) {
-					offset = _file.size() - 1;
+				if (offset >= _doc.size()) {
+					offset = _doc.size() - 1;
 					if (hex_area)
 						first_part = false;
 				}
@@ -656,7 +744,7 @@ bool editor::move_handle_mouse(int msg, int ctrl, MOUSE_EVENT_RECORD *rec)
 			}
 			else {
 				//Down wheel
-				if (_view_offset + _hexeditor.showed_data_size() < _file.size()) {
+				if (_view_offset + _hexeditor.showed_data_size() < _doc.size()) {
 					if (!_cursor_iha)
 						_cursor_fbp = true;
 					_cursor_offset += 0x10;
@@ -696,7 +784,7 @@ bool editor::sckey_handle(const int key)
 		case KEY_F10:
 			if (keyx == KEY_ESC || (!ctrl_pressed && !alt_pressed && !shift_pressed)) {
 				even_handled = true;
-				bool can_exit = _upd_data.empty();
+				bool can_exit = !_doc.modified();
 				if (!can_exit) {
 					const wchar_t* msg[] = {
 						I18N(ps_sav_title), I18N(ps_sav_modifq)
@@ -741,7 +829,7 @@ bool editor::sckey_handle(const int key)
 				even_handled = true;
 				goto_dlg dlg;
 				UINT64 offset = _cursor_offset;
-				if (dlg.show(_file.size(), offset)) {
+				if (dlg.show(_doc.size(), offset)) {
 					_cursor_offset = offset;
 					if (_cursor_offset < _view_offset || _cursor_offset >= _view_offset + _hexeditor.showed_data_size())
 						update_buffer(_cursor_offset - _cursor_offset % 0x10);
@@ -822,10 +910,17 @@ bool editor::sckey_handle(const int key)
 			break;
 
 		case KEY_INS:
+		case KEY_NUMPAD0:
 			if (!ctrl_pressed && shift_pressed && !alt_pressed) {
 				even_handled = true;
 				paste();
 			}
+			else if (!ctrl_pressed && !shift_pressed && !alt_pressed) {
+				even_handled = true;
+				_insert_mode = !_insert_mode;
+				_statusbar.write_insert_flag(_insert_mode);
+				update_screen();
+			}
 			break;
 
 		case 'V':
@@ -850,8 +945,25 @@ bool editor::edkey_handle(int key)
 		return false;
 
 	if (key == KEY_DEL || key == KEY_NUMDEL) {
-		// Disable DELETE key for now
-		return true; // Event handled, do nothing
+		if (_doc.size() <= 1)
+			return true;	//Empty content is not supported
+
+		if (!_file.writable()) {
+			const wchar_t* msg[] = {
+				I18N(ps_title), I18N(ps_swmod_warn), I18N(ps_swmod_quest)
+			};
+			if (msg_box(FMSG_MB_YESNO, msg) != 0)
+				return false;
+			if (!switch_mode())
+				return false;
+		}
+
+		replace_data(_cursor_offset, 1, nullptr, 0);
+		_cursor_fbp = true;
+
+		move_far_cursor();
+		update_screen();
+		return true;
 	}
 	if( key & KEY_CTRLMASK )
 		return false;
@@ -880,9 +992,16 @@ bool editor::edkey_handle(int key)
 				return false;
 		}
 
-		const BYTE old_val = get_current_value(_cursor_offset);
-		const BYTE new_val = _cursor_fbp ? ((old_val & 0x0f) | (key_code << 4)) : ((old_val & 0xf0) | key_code);
-		update_data(_cursor_offset, new_val);
+		if (_insert_mode && _cursor_fbp) {
+			//New byte is inserted by its first part, second part overwrites it
+			const BYTE new_val = key_code << 4;
+			replace_data(_cursor_offset, 0, &new_val, 1);
+		}
+		else {
+			const BYTE old_val = get_current_value(_cursor_offset);
+			const BYTE new_val = _cursor_fbp ? ((old_val & 0x0f) | (key_code << 4)) : ((old_val & 0xf0) | key_code);
+			update_data(_cursor_offset, new_val);
+		}
 		move_right(true);
 	}
 	else {
@@ -900,7 +1019,33 @@ bool editor::edkey_handle(int key)
 		}
 		const wchar_t key_value = static_cast<wchar_t>(key);
 
-		if (_hexeditor.get_codepage() == CP_UTF8) {
+		if (_insert_mode) {
+			//Insert encoded character
+			vector<BYTE> enc;
+			if (_hexeditor.get_codepage() == CP_UTF8) {
+				UtfConverter<wchar_t, uint8_t, false> utf8_seq(&key_value, 1);
+				for (size_t i = 0; i < utf8_seq.size(); ++i)
+					enc.push_back(utf8_seq[i]);
+			}
+			else if (_hexeditor.get_codepage() == CP_UTF16LE) {
+				enc.push_back(LOBYTE(key_value));
+				enc.push_back(HIBYTE(key_value));
+			}
+			else {
+				BYTE new_val;
+				WideCharToMultiByte(_hexeditor.get_codepage(), 0, &key_value, 1, reinterpret_cast<LPSTR>(&new_val), 1, nullptr, nullptr);
+				enc.push_back(new_val);
+			}
+			if (enc.empty())
+				return true;
+			replace_data(_cursor_offset, 0, &enc.front(), enc.size());
+
+			_cursor_offset += enc.size();
+			if (_cursor_offset >= _doc.size())
+				_cursor_offset = _doc.size() - 1;
+			_cursor_fbp = true;
+		}
+		else if (_hexeditor.get_codepage() == CP_UTF8) {
 			// Get length of the character we are about to replace
 			const int old_len = get_utf8_char_len(get_current_value(_cursor_offset));
 
@@ -913,7 +1058,7 @@ bool editor::edkey_handle(int key)
 
 			// Overwrite bytes
 			for (int i = 0; i < loop_len; ++i) {
-				if (_cursor_offset + i >= _file.size()) break; // End of file check
+				if (_cursor_offset + i >= _doc.size()) break; // End of file check
 
 				if (i < new_len) {
 					// Write new character's byte
@@ -926,15 +1071,15 @@ bool editor::edkey_handle(int key)
 
 			// Advance cursor by the length of the *new* character for continuous typing
 			_cursor_offset += new_len;
-			if (_cursor_offset >= _file.size()) {
-				_cursor_offset = _file.size() - 1;
+			if (_cursor_offset >= _doc.size()) {
+				_cursor_offset = _doc.size() - 1;
 			}
 			_cursor_fbp = true;
 		}
 		else {
 			if (_hexeditor.get_codepage() == CP_UTF16LE) {
 				update_data(_cursor_offset, LOBYTE(key_value));
-				if (_cursor_offset + 1 < _file.size())
+				if (_cursor_offset + 1 < _doc.size())
 					update_data(_cursor_offset + 1, HIBYTE(key_value));
 			}
 			else {
@@ -959,7 +1104,7 @@ bool editor::edkey_handle(int key)
 
 bool editor::switch_mode()
 {
-	if (!_upd_data.empty()) {
+	if (_doc.modified()) {
 		assert(_file.writable());
 		const wchar_t* msg[] = {
 			I18N(ps_title), I18N(ps_sav_modifq)
@@ -969,8 +1114,10 @@ bool editor::switch_mode()
 		if (ret < 0 || ret == 2)
 			return false;
 		else if (ret == 1) {
-			_statusbar.write_update_flag(false);
-			_upd_data.clear();
+			_doc.reset();
+			_undo.clear();
+			_undo_pos = string::npos;
+			on_content_changed();
 		}
 		else if (ret == 0 && !save())
 			return false;
@@ -999,7 +1146,7 @@ void editor::move_right(const bool ingnore_settings)
 {
 	if (_cursor_iha && _cursor_fbp && (ingnore_settings || settings.move_inside_byte))
 		_cursor_fbp = false;
-	else if (_cursor_offset + (_hexeditor.get_codepage() == CP_UTF16LE && !_cursor_iha ? 2 : 1) < _file.size()) {
+	else if (_cursor_offset + (_hexeditor.get_codepage() == CP_UTF16LE && !_cursor_iha ? 2 : 1) < _doc.size()) {
 		_cursor_fbp = true;
 		_cursor_offset += (_hexeditor.get_codepage() == CP_UTF16LE && !_cursor_iha ? 2 : 1);
 	}
@@ -1025,20 +1172,48 @@ void editor::update_data(const UINT64 offset, const BYTE new_val)
 	if (old_val == new_val)
 		return;
 
-	_upd_data[offset] = new_val;
-	_statusbar.write_update_flag(true);
+	replace_data(offset, 1, &new_val, 1);
+}
+
+//###
+
+void editor::replace_data(const UINT64 offset, const UINT64 del_len, const BYTE* data, const size_t len)
+{
+	const document::change chg = _doc.replace(offset, del_len, data, len);
 
 	//Prepare undo operation
 	if (_undo_pos == string::npos)
 		_undo.clear();
 	else if (_undo_pos != _undo.size() - 1)
 		_undo.erase(_undo.begin() + _undo_pos + 1, _undo.end());
-	if (!_undo.empty() && _undo.back().offset == offset)
-		_undo.back().new_val = new_val;	//Replace value
+	const bool overwrite = del_len == 1 && len == 1;
+	if (overwrite && !_undo.empty() && _undo.back().chg.offset == offset &&
+		_undo.back().chg.removed.size() == 1 && _undo.back().chg.removed.front().length == 1 &&
+		_undo.back().chg.inserted.size() == 1 && _undo.back().chg.inserted.front().length == 1)
+		_undo.back().chg.inserted = chg.inserted;	//Replace value
 	else {
-		_undo.push_back(undo_t(offset, old_val, new_val));
+		_undo.push_back(undo_t(chg));
 		_undo_pos = _undo.size() - 1;
 	}
+
+	on_content_changed();
+}
+
+//###
+
+void editor::on_content_changed()
+{
+	_statusbar.write_update_flag(_doc.modified());
+
+	if (_cursor_offset >= _doc.size()) {
+		_cursor_offset = _doc.size() - 1;
+		_cursor_fbp = true;
+	}
+
+	UINT64 view_offset = _view_offset;
+	if (_cursor_offset < view_offset || _cursor_offset >= view_offset + _hexeditor.showed_data_size())
+		view_offset = _cursor_offset - _cursor_offset % 0x10;
+	update_buffer(view_offset);	//Re-read
 }
 
 //###
@@ -1051,29 +1226,13 @@ void editor::undo()
 		return;	//Start position
 
 	const undo_t& undo_action = _undo[_undo_pos];
-
-	map<UINT64, BYTE>::iterator itup = _upd_data.find(undo_action.offset);
-	if (itup == _upd_data.end()) {
-		_upd_data[undo_action.offset] = undo_action.old_val;
-	}
-	else {
-		vector<BYTE> buff;
-		if (_file.read(undo_action.offset, buff, 1) == ERROR_SUCCESS && buff.front() == undo_action.old_val)
-			_upd_data.erase(itup);
-		else
-			itup->second = undo_action.old_val;
-	}
+	_doc.undo(undo_action.chg);
 
 	--_undo_pos;
-	_cursor_offset = undo_action.offset;
+	_cursor_offset = undo_action.chg.offset;
 	_cursor_fbp = true;
 
-	if (_cursor_offset < _view_offset || _cursor_offset >= _view_offset + _hexeditor.showed_data_size())
-		update_buffer(_cursor_offset - _cursor_offset % 0x10);
-
-	if (_upd_data.empty())
-		_statusbar.write_update_flag(false);
-
+	on_content_changed();
 	move_far_cursor();
 	update_screen();
 }
@@ -1090,16 +1249,12 @@ void editor::redo()
 	++_undo_pos;
 
 	const undo_t& redo_action = _undo[_undo_pos];
+	_doc.redo(redo_action.chg);
 
-	_upd_data[redo_action.offset] = redo_action.new_val;
-	_statusbar.write_update_flag(true);
-
-	_cursor_offset = redo_action.offset;
+	_cursor_offset = redo_action.chg.offset;
 	_cursor_fbp = true;
 
-	if (_cursor_offset < _view_offset || _cursor_offset >= _view_offset + _hexeditor.showed_data_size())
-		update_buffer(_cursor_offset - _cursor_offset % 0x10);
-
+	on_content_changed();
 	move_far_cursor();
 	update_screen();
 }
@@ -1149,7 +1304,7 @@ void editor::paste()
 
 	for (vector<BYTE>::const_iterator it = paste_array.begin(); it != paste_array.end(); ++it) {
 		update_data(_cursor_offset, *it);
-		if (_cursor_offset + 1 >= _file.size())
+		if (_cursor_offset + 1 >= _doc.size())
 			break;	//EOF
 		++_cursor_offset;
 	}
@@ -1171,28 +1326,30 @@ void editor::find(const bool forward, const bool force_dlg)
 
 	if (force_dlg || _search_seq.empty()) {
 		find_dlg dlg;
-		if (!dlg.show(_search_seq, dir_forward))
+		if (!dlg.show(_search_seq, _search_mask, dir_forward))
 			return;
 	}
 
 	assert(!_search_seq.empty());
+	assert(_search_mask.size() == _search_seq.size());
 
 	UINT64 seq_offset = MAXUINT64;
 
 	bool interrupted_by_user = false;
-	const size_t init_buff_size = 4096;
+	const size_t init_buff_size = 0x80000;
 	const size_t seq_size = _search_seq.size();
-	const BYTE* seq_ptr = &_search_seq.front();
+	const size_t anchor = seq_anchor(_search_mask);
+	vector<BYTE> search_buff;
 
-	if (dir_forward && _cursor_offset + 1 < _file.size()) {
+	if (dir_forward && _cursor_offset + 1 < _doc.size()) {
 		//Initialize progress bar window
-		progress progress_wnd(I18N(ps_find_title), _cursor_offset, _file.size());
+		progress progress_wnd(I18N(ps_find_title), _cursor_offset, _doc.size());
 
 		//Initial read position
 		UINT64 read_offset = _cursor_offset + 1;
 
 		//Let's search!
-		while (seq_offset == MAXUINT64 && read_offset < _file.size()) {
+		while (seq_offset == MAXUINT64 && read_offset < _doc.size()) {
 			//Show progress window and check for Esc press
 			progress_wnd.update(read_offset);
 			if (progress::aborted()) {
@@ -1200,29 +1357,19 @@ void editor::find(const bool forward, const bool force_dlg)
 				break;
 			}
 
-			//Read file
-			vector<BYTE> search_buff;
-			if (_file.read(read_offset, search_buff, init_buff_size) != ERROR_SUCCESS)
+			//Read content (only pieces overlapping the window are touched)
+			if (_doc.read(read_offset, search_buff, init_buff_size) != ERROR_SUCCESS)
 				break;
 			const size_t search_buff_sz = search_buff.size();
 			if (search_buff_sz < seq_size)
 				break;
 
-			//Apply current updates
-			for (map<UINT64, BYTE>::const_iterator it = _upd_data.begin(); it != _upd_data.end(); ++it) {
-				if (it->first >= read_offset && it->first < read_offset + search_buff_sz)
-					search_buff[static_cast<size_t>(it->first - read_offset)] = it->second;
-			}
-
 			//Search for sequence
-			for (size_t i = 0; seq_offset == MAXUINT64 && i < search_buff_sz && search_buff_sz - i >= seq_size; ++i) {
-				if (memcmp(seq_ptr, &search_buff[i], seq_size) == 0)
-					seq_offset = read_offset + i;
-			}
-
-			//Calculate next read position
-			if (seq_offset == MAXUINT64)
-				read_offset += init_buff_size - seq_size;
+			const size_t pos = seq_find_first(&search_buff.front(), search_buff_sz, _search_seq, _search_mask, anchor);
+			if (pos != string::npos)
+				seq_offset = read_offset + pos;
+			else
+				read_offset += search_buff_sz - seq_size + 1;	//Next window overlaps current one
 		}
 
 		progress_wnd.hide();
@@ -1232,12 +1379,13 @@ void editor::find(const bool forward, const bool force_dlg)
 		//Initialize progress bar window
 		progress progress_wnd(I18N(ps_find_title), _cursor_offset, 0);
 
-		//Initial read position
-		UINT64 read_offset_start = _cursor_offset < init_buff_size ? 0 : _cursor_offset - init_buff_size;
-		UINT64 read_offset_end = _cursor_offset + seq_size;
+		//Initial window end: last checked sequence starts before cursor
+		UINT64 read_offset_end = min(_cursor_offset - 1 + seq_size, _doc.size());
 
 		//Let's search!
-		while (seq_offset == MAXUINT64) {
+		while (seq_offset == MAXUINT64 && read_offset_end >= seq_size) {
+			const UINT64 read_offset_start = read_offset_end > init_buff_size ? read_offset_end - init_buff_size : 0;
+
 			//Show progress window and check for Esc press
 			progress_wnd.update(read_offset_start);
 			if (progress::aborted()) {
@@ -1245,33 +1393,19 @@ void editor::find(const bool forward, const bool force_dlg)
 				break;
 			}
 
-			//Read file
-			vector<BYTE> search_buff;
-			if (_file.read(read_offset_start, search_buff, static_cast<size_t>(read_offset_end - read_offset_start)) != ERROR_SUCCESS)
-				break;
-			const size_t search_buff_sz = search_buff.size();
-			if (search_buff_sz < seq_size)
+			//Read content (only pieces overlapping the window are touched)
+			const size_t search_buff_sz = static_cast<size_t>(read_offset_end - read_offset_start);
+			if (_doc.read(read_offset_start, search_buff, search_buff_sz) != ERROR_SUCCESS || search_buff.size() != search_buff_sz)
 				break;
 
-			//Apply current updates
-			for (map<UINT64, BYTE>::const_iterator it = _upd_data.begin(); it != _upd_data.end(); ++it) {
-				if (it->first >= read_offset_start && it->first < read_offset_end)
-					search_buff[static_cast<size_t>(it->first - read_offset_start)] = it->second;
-			}
-
 			//Search for sequence
-			for (INT64 i = static_cast<INT64>(search_buff_sz - seq_size) - 1; seq_offset == MAXUINT64 && i > 0; --i) {
-				if (memcmp(seq_ptr, &search_buff[static_cast<size_t>(i)], seq_size) == 0)
-					seq_offset = read_offset_start + i;
-			}
-
-			//Calculate next read position
-			if (seq_offset == MAXUINT64) {
-				if (read_offset_start == 0)
-					break;	//Start position already reached
-				read_offset_start = read_offset_start > init_buff_size ? read_offset_start - init_buff_size : 0;
-				read_offset_end = read_offset_start + search_buff_sz;
-			}
+			const size_t pos = seq_find_last(&search_buff.front(), search_buff_sz, _search_seq, _search_mask, anchor);
+			if (pos != string::npos)
+				seq_offset = read_offset_start + pos;
+			else if (read_offset_start == 0)
+				break;	//Start position already reached
+			else
+				read_offset_end = read_offset_start + seq_size - 1;	//Next window overlaps current one
 		}
 
 		progress_wnd.hide();
@@ -1298,24 +1432,16 @@ void editor::find(const bool forward, const bool force_dlg)
 
 BYTE editor::get_current_value(const UINT64 offset) const
 {
-	assert(offset < _file.size());
+	assert(offset < _doc.size());
 
 	BYTE val = 0;
 
-	if (offset < _file.size()) {
-		map<UINT64, BYTE>::const_iterator itup = _upd_data.find(offset); // Corrected: use offset, not _cursor_offset
-		if (itup != _upd_data.end())
-			val = itup->second;
-		else {
-			if (offset >= _view_offset && offset < _view_offset + _ori_data.size()) // Corrected: use _ori_data.size()
-				val = _ori_data[static_cast<size_t>(offset - _view_offset)];
-			else {
-				//Read from file
-				vector<BYTE> buff;
-				if (_file.read(offset, buff, 1) == ERROR_SUCCESS && !buff.empty())
-					val = buff.front();
-			}
-		}
+	if (offset >= _view_offset && offset < _view_offset + _view_data.size())
+		val = _view_data[static_cast<size_t>(offset - _view_offset)];
+	else if (offset < _doc.size()) {
+		vector<BYTE> buff;
+		if (_doc.read(offset, buff, 1) == ERROR_SUCCESS && !buff.empty())
+			val = buff.front();
 	}
 
 	return val;
@@ -1325,10 +1451,10 @@ BYTE editor::get_current_value(const UINT64 offset) const
 
 bool editor::update_buffer(const UINT64 offset)
 {
-	assert(offset < _file.size());
+	assert(offset < _doc.size());
 	assert(!(offset % 0x10));
 
-	const DWORD read_status = _file.read(offset, _ori_data, _hexeditor.showed_data_size());
+	const DWORD read_status = _doc.read(offset, _view_data, _hexeditor.showed_data_size(), &_view_upd);
 	if (read_status != ERROR_SUCCESS) {
 		const wchar_t* msg[] = {
 			I18N(ps_title), I18N(ps_err_read_file), _file.name()
@@ -1341,10 +1467,10 @@ bool editor::update_buffer(const UINT64 offset)
 
 		//Calculate position
 		unsigned char percent = 0;
-		if (_view_offset + _hexeditor.showed_data_size() >= _file.size())
+		if (_view_offset + _hexeditor.showed_data_size() >= _doc.size())
 			percent = 100;
 		else if (_view_offset != 0)
-			percent = static_cast<unsigned char>(_view_offset * 100 / _file.size());
+			percent = static_cast<unsigned char>(_view_offset * 100 / _doc.size());
 		_statusbar.write_position(percent);
 
 		return true;
@@ -1356,7 +1482,7 @@ bool editor::update_buffer(const UINT64 offset)
 void editor::update_screen()
 {
     _PSI.SendDlgMessage(_dialog, DM_ENABLEREDRAW, FALSE, 0);
-	_hexeditor.update(_view_offset, _ori_data, _upd_data, _cursor_offset, _cursor_iha);
+	_hexeditor.update(_view_offset, _view_data, _view_upd, _cursor_offset, _cursor_iha);
     _PSI.SendDlgMessage(_dialog, DM_ENABLEREDRAW, TRUE, 0);
 }
 
@@ -21,6 +21,7 @@
 
 #include "common.h"
 #include "file.h"
+#include "document.h"
 #include "statusbar_ctl.h"
 #include "hex_ctl.h"
 #include "keybar_ctl.h"
@@ -113,6 +114,20 @@ private:
 	 */
 	void update_data(const UINT64 offset, const BYTE new_val);
 
+	/**
+	 * Replace data range (overwrite, insert or delete)
+	 * \param offset range offset
+	 * \param del_len range length to delete
+	 * \param data data to insert
+	 * \param len data length
+	 */
+	void replace_data(const UINT64 offset, const UINT64 del_len, const BYTE* data, const size_t len);
+
+	/**
+	 * Content change handler: update status, fix cursor position and re-read view buffer
+	 */
+	void on_content_changed();
+
 	/**
 	 * Undo operation handler
 	 */
@@ -160,6 +175,8 @@ private:
 	keybar_ctl		_keybar;		///< Key bar screen control
 
 	file			_file;			///< Edited file
+	document		_doc;			///< Edited content
+	bool			_insert_mode;	///< Insert mode flag (true = insert, false = overwrite)
 
 	UINT64			_cursor_offset;	///< Cursor offset (absolute value)
 	bool			_cursor_fbp;	///< Cursor position inside byte (true = first part, false = second part)
@@ -167,20 +184,19 @@ private:
 
 	UINT64			_view_offset;	///< Current view offset
 
-	vector<BYTE>		_ori_data;	///< Original file data array
-	map<UINT64, BYTE>	_upd_data;	///< Updated file data map (offset, new value)
+	vector<BYTE>	_view_data;		///< Showed data array
+	vector<BYTE>	_view_upd;		///< Flags of updated bytes in showed data array
 
 	//Undo description
 	struct undo_t {
-		undo_t(const UINT64	off, const BYTE ov, const BYTE nv) : offset(off), old_val(ov), new_val(nv) {}
-		UINT64	offset;				///< Offset
-		BYTE	old_val;			///< Old value
-		BYTE	new_val;			///< New value
+		undo_t(const document::change& c) : chg(c) {}
+		document::change	chg;	///< Content change
 	};
 	vector<undo_t>	_undo;			///< Available undo operations array
 	size_t			_undo_pos;		///< Undo position
 
 	vector<BYTE>	_search_seq;	///< Search sequence
+	vector<BYTE>	_search_mask;	///< Search mask (bits of sequence to compare)
 };
 
 void CreateEditor(const wchar_t *file_name, const UINT64 offset);
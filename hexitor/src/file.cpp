@@ -18,8 +18,11 @@
  **************************************************************************/
 
 #include "file.h"
+#include "document.h"
 #include <vector>
 
+#define CONTENT_CHUNK_SIZE	0x80000	//Size of chunk used to stream content
+
 file::file()
 :	_rw_mode(true),
 	_handle(INVALID_HANDLE_VALUE),
@@ -96,89 +99,133 @@ DWORD file::switch_mode()
 
 
 DWORD file::read(const UINT64 offset, vector<BYTE>& buffer, const size_t sz) const
+{
+	buffer.resize(sz);
+	size_t length = 0;
+	const DWORD rc = read(offset, buffer.data(), sz, length);
+	buffer.resize(length);
+
+	return rc;
+}
+
+
+DWORD file::read(const UINT64 offset, BYTE* buffer, const size_t sz, size_t& rd) const
 {
 	assert(_handle != INVALID_HANDLE_VALUE);
 	assert(sz && sz < 1024 * 1024);
 	assert(offset < _size);
 
+	rd = 0;
 	DWORD rc = set_position(offset);
 
 	if (rc == ERROR_SUCCESS) {
-		buffer.resize(sz);
 		DWORD length = 0;
-		if (!ReadFile(_handle, &buffer.front(), static_cast<DWORD>(sz), &length, nullptr))
+		if (!ReadFile(_handle, buffer, static_cast<DWORD>(sz), &length, nullptr))
 			rc = GetLastError();
-		buffer.resize(length);
+		rd = length;
 	}
 
 	return rc;
 }
 
 
-DWORD file::save(const map<UINT64, BYTE>& upd_data)
+DWORD file::write(const UINT64 offset, const BYTE* buffer, const size_t sz)
+{
+	DWORD rc = set_position(offset);
+
+	for (size_t written = 0; rc == ERROR_SUCCESS && written < sz; ) {
+		const DWORD chunk = static_cast<DWORD>(min(sz - written, static_cast<size_t>(CONTENT_CHUNK_SIZE)));
+		DWORD bytes_written = 0;
+		if (!WriteFile(_handle, buffer + written, chunk, &bytes_written, nullptr))
+			rc = GetLastError();
+		else if (bytes_written != chunk)
+			rc = ERROR_WRITE_FAULT;
+		written += bytes_written;
+	}
+
+	return rc;
+}
+
+
+DWORD file::save(const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data, bool& damaged)
 {
 	assert(_handle != INVALID_HANDLE_VALUE);
 	assert(_rw_mode);
 
 	DWORD rc = ERROR_SUCCESS;
+	damaged = false;
+
+	if (doc.in_place()) {
+		//Only overwritten ranges have to be written
+		UINT64 offset = 0;
+		const vector<document::piece>& pieces = doc.pieces();
+		for (vector<document::piece>::const_iterator it = pieces.begin(); rc == ERROR_SUCCESS && it != pieces.end(); ++it) {
+			if (it->added)
+				rc = write(offset, doc.added_data(*it), static_cast<size_t>(it->length));
+			offset += it->length;
+		}
+		return rc;
+	}
 
-	for (map<UINT64, BYTE>::const_iterator it = upd_data.begin(); rc == ERROR_SUCCESS && it != upd_data.end(); ++it) {
-		rc = set_position(it->first);
-		if (rc == ERROR_SUCCESS) {
-			DWORD bytes_written = 0;
-			if (!WriteFile(_handle, &it->second, 1, &bytes_written, nullptr))
+	//Data was inserted or deleted: stream content to temporary file, then copy it
+	//over the original one, so file keeps its identity, permissions and links
+	const wstring tmp_name = backup_name();
+	rc = write_content(tmp_name.c_str(), doc, progress_routine, data);
+	if (rc != ERROR_SUCCESS)
+		return rc;
+
+	HANDLE fi = CreateFile(tmp_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fi == INVALID_HANDLE_VALUE)
+		rc = GetLastError();
+	else {
+		rc = set_position(0);
+		damaged = (rc == ERROR_SUCCESS);
+		vector<BYTE> buf(CONTENT_CHUNK_SIZE);
+		LARGE_INTEGER copied = {0};
+		while (rc == ERROR_SUCCESS) {
+			//Original is partially overwritten from here, so cancel request is ignored
+			if (progress_routine)
+				progress_routine({}, copied, {}, {}, 0, 0, nullptr, nullptr, data);
+			DWORD nb = 0;
+			if (!ReadFile(fi, buf.data(), static_cast<DWORD>(buf.size()), &nb, nullptr)) {
+				rc = GetLastError();
+				break;
+			}
+			if (!nb)
+				break;
+			DWORD written = 0;
+			if (!WriteFile(_handle, buf.data(), nb, &written, nullptr))
 				rc = GetLastError();
+			else if (written != nb)
+				rc = ERROR_WRITE_FAULT;
+			else
+				copied.QuadPart += written;
+		}
+		if (rc == ERROR_SUCCESS && !SetEndOfFile(_handle))
+			rc = GetLastError();
+		if (rc == ERROR_SUCCESS) {
+			damaged = false;
+			rc = get_file_size(_handle, _size);
 		}
+		CloseHandle(fi);
 	}
 
+	//Keep temporary copy if original file could be damaged
+	if (!damaged)
+		DeleteFile(tmp_name.c_str());
+
 	return rc;
 }
 
 
-DWORD file::save_as(const wchar_t* file_name, const map<UINT64, BYTE>& upd_data, LPPROGRESS_ROUTINE progress_routine, LPVOID data)
+DWORD file::save_as(const wchar_t* file_name, const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data)
 {
 	assert(file_name && *file_name);
 	assert(_handle != INVALID_HANDLE_VALUE);
 
-	//assert(wcsicmp(file_name, _name.c_str()) != 0);
-
-	DWORD rc = ERROR_SUCCESS;
-	/*
-	if (!CopyFileEx(_name.c_str(), file_name, progress_routine, data, nullptr, 0))
-		rc = GetLastError();
-	*/
-	LARGE_INTEGER file_size;
-	if( !GetFileSizeEx(_handle, &file_size) )
-		return GetLastError();
-	HANDLE fo = CreateFile(file_name, GENERIC_WRITE,
-						FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS,	//&sa
-						FILE_FLAG_SEQUENTIAL_SCAN, NULL);
-	if( fo == INVALID_HANDLE_VALUE )
-		return GetLastError();
-	SetFilePointer(_handle, 0, NULL, FILE_BEGIN);
-	LARGE_INTEGER copied = {0};
-	std::vector<unsigned char> buf(4096);
-	DWORD nb=0;
-	while( (rc == ERROR_SUCCESS) && (copied.QuadPart < file_size.QuadPart) ){
-		if( progress_routine && progress_routine({}, copied, {}, {}, 0, 0, nullptr, nullptr, data) == PROGRESS_CANCEL ){
-			rc = ERROR_WRITE_FAULT;
-			break;
-		}
-		if( ReadFile(_handle, buf.data(), buf.size(), &nb, NULL) )
-		{
-			if( WriteFile(fo, buf.data(), nb, &nb, NULL) )
-				copied.QuadPart += nb;
-			else
-				rc = GetLastError();
-		}
-		else
-			rc = GetLastError();
-	};
-	CloseHandle(fo);
-	if( rc != ERROR_SUCCESS ){
-		DeleteFile(file_name);
+	DWORD rc = write_content(file_name, doc, progress_routine, data);
+	if (rc != ERROR_SUCCESS)
 		return rc;
-	}
 
 	file new_instance;
 	rc = new_instance.open(file_name);
@@ -189,13 +236,50 @@ DWORD file::save_as(const wchar_t* file_name, const map<UINT64, BYTE>& upd_data,
 		_name = new_instance._name;
 		_rw_mode = new_instance._rw_mode;
 		new_instance._handle = INVALID_HANDLE_VALUE;
-		rc = save(upd_data);
 	}
 
 	return rc;
 }
 
 
+DWORD file::write_content(const wchar_t* file_name, const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data) const
+{
+	HANDLE fo = CreateFile(file_name, GENERIC_WRITE,
+						FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS,
+						FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fo == INVALID_HANDLE_VALUE)
+		return GetLastError();
+
+	DWORD rc = ERROR_SUCCESS;
+	LARGE_INTEGER copied = {0};
+	vector<BYTE> buf;
+	while (rc == ERROR_SUCCESS && static_cast<UINT64>(copied.QuadPart) < doc.size()) {
+		if (progress_routine && progress_routine({}, copied, {}, {}, 0, 0, nullptr, nullptr, data) == PROGRESS_CANCEL) {
+			rc = ERROR_REQUEST_ABORTED;
+			break;
+		}
+		rc = doc.read(copied.QuadPart, buf, CONTENT_CHUNK_SIZE);
+		if (rc == ERROR_SUCCESS && buf.empty())
+			rc = ERROR_WRITE_FAULT;	//Unexpected end of content
+		if (rc == ERROR_SUCCESS) {
+			DWORD nb = 0;
+			if (!WriteFile(fo, buf.data(), static_cast<DWORD>(buf.size()), &nb, NULL))
+				rc = GetLastError();
+			else if (nb != buf.size())
+				rc = ERROR_WRITE_FAULT;
+			else
+				copied.QuadPart += nb;
+		}
+	}
+	CloseHandle(fo);
+
+	if (rc != ERROR_SUCCESS)
+		DeleteFile(file_name);
+
+	return rc;
+}
+
+
 DWORD file::open_file(const bool rw_mode, HANDLE& fh) const
 {
 	DWORD rc = ERROR_SUCCESS;
@@ -21,6 +21,8 @@
 
 #include "common.h"
 
+class document;
+
 typedef DWORD CALLBACK LPPROGRESS_ROUTINE(LARGE_INTEGER, LARGE_INTEGER, LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID);
 #define PROGRESS_CANCEL 0
 #define PROGRESS_CONTINUE 1
@@ -65,21 +67,34 @@ public:
 	DWORD read(const UINT64 offset, vector<BYTE>& buffer, const size_t sz) const;
 
 	/**
-	 * Save file
-	 * \param upd_data map with updated data description (offset, byte value)
+	 * Read file
+	 * \param offset start position
+	 * \param buffer buffer to read
+	 * \param sz buffer size
+	 * \param rd count of bytes read
 	 * \return error code (ERROR_SUCCESS if no error)
 	 */
-	DWORD save(const map<UINT64, BYTE>& upd_data);
+	DWORD read(const UINT64 offset, BYTE* buffer, const size_t sz, size_t& rd) const;
+
+	/**
+	 * Save file
+	 * \param doc edited content, unmodified pieces of it must refer to this file
+	 * \param progress_routine pointer to progress routine function
+	 * \param data data passed to progress_routine
+	 * \param damaged set if original file could be damaged, saved content is kept in backup_name() then
+	 * \return error code (ERROR_SUCCESS if no error, ERROR_REQUEST_ABORTED if operation aborted by user)
+	 */
+	DWORD save(const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data, bool& damaged);
 
 	/**
 	 * Save file with new name
 	 * \param file_name new file name
-	 * \param upd_data map with updated data description (offset, byte value)
+	 * \param doc edited content, unmodified pieces of it must refer to this file
 	 * \param progress_routine pointer to progress routine function
 	 * \param data data passed to progress_routine
 	 * \return error code (ERROR_SUCCESS if no error, ERROR_REQUEST_ABORTED if operation aborted by user)
 	 */
-	DWORD save_as(const wchar_t* file_name, const map<UINT64, BYTE>& upd_data, LPPROGRESS_ROUTINE progress_routine, LPVOID data);
+	DWORD save_as(const wchar_t* file_name, const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data);
 
 	/**
 	 * Check for file read only attribute
@@ -93,6 +108,12 @@ public:
 	 */
 	inline const wchar_t* name() const	{ return _name.c_str(); }
 
+	/**
+	 * Get name of temporary copy used while saving with changed size
+	 * \return temporary copy name
+	 */
+	inline wstring backup_name() const	{ return _name + L".hexitor~"; }
+
 	/**
 	 * Get file size
 	 * \return file size
@@ -144,6 +165,25 @@ private:
 	 */
 	DWORD set_position(const UINT64 offset) const;
 
+	/**
+	 * Write whole content to the new file
+	 * \param file_name file name
+	 * \param doc edited content
+	 * \param progress_routine pointer to progress routine function
+	 * \param data data passed to progress_routine
+	 * \return error code (ERROR_SUCCESS if no error)
+	 */
+	DWORD write_content(const wchar_t* file_name, const document& doc, LPPROGRESS_ROUTINE progress_routine, LPVOID data) const;
+
+	/**
+	 * Write data to the file
+	 * \param offset start position
+	 * \param buffer data to write
+	 * \param sz data size
+	 * \return error code (ERROR_SUCCESS if no error)
+	 */
+	DWORD write(const UINT64 offset, const BYTE* buffer, const size_t sz);
+
 private:
 	wstring	_name;			///< File name
 	bool	_rw_mode;		///< Flag that file is opened in read/write mode
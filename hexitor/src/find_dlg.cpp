@@ -32,13 +32,35 @@ static const wchar_t u16Hist[]{ L"HexitorFindUtf16" };
 static const wchar_t u8Hist[]{  L"HexitorFindUtf8"  };
 
 //
-bool find_dlg::show(vector<unsigned char>& seq, bool& forward_search)
+//Parse hex digit or '?' (any value) of the hex field
+static bool parse_nibble(const wchar_t ch, unsigned char& val, unsigned char& mask)
 {
-	wstring mask_edit(MAX_SEQ_SIZE * 3, L'H' );
-	for (size_t i = 0; i < MAX_SEQ_SIZE; ++i) mask_edit[3*i + 2] = L' '; // 128 x "HH "
+	mask = 0x0f;
+	if (ch >= L'0' && ch <= L'9')
+		val = static_cast<unsigned char>(ch - L'0');
+	else if (ch >= L'A' && ch <= L'F')
+		val = static_cast<unsigned char>(10 + ch - L'A');
+	else if (ch >= L'a' && ch <= L'f')
+		val = static_cast<unsigned char>(10 + ch - L'a');
+	else if (ch == L'?')
+		val = mask = 0;
+	else
+		return false;
+	return true;
+}
+
+//
+bool find_dlg::show(vector<unsigned char>& seq, vector<unsigned char>& mask, bool& forward_search)
+{
+	//Any char allowed to accept '?' as wildcard nibble, hex digits are checked on parse
+	wstring mask_edit(MAX_SEQ_SIZE * 3, L'X' );
+	for (size_t i = 0; i < MAX_SEQ_SIZE; ++i) mask_edit[3*i + 2] = L' '; // 128 x "XX "
 
 	_seq.reserve(MAX_SEQ_SIZE);
 	_seq = seq;
+	_mask = mask;
+	if (_mask.size() != _seq.size())
+		_mask.assign(_seq.size(), 0xff);
 	const auto f = forward_search ? 0 : 1;
 
 	#define LIF_NONE 0
@@ -77,6 +99,7 @@ bool find_dlg::show(vector<unsigned char>& seq, bool& forward_search)
 	const intptr_t rc = _PSI.DialogRun(_dialog);
 	if (rc >= 0 && rc != DLGID_BTN_CANCEL) {
 		_seq.swap(seq);
+		_mask.swap(mask);
 		forward_search = !(_PSI.SendDlgMessage(_dialog, DM_GETCHECK, 12, (LONG_PTR)nullptr) == BSTATE_CHECKED);
 		_PSI.DialogFree(_dialog);
 		return true;
@@ -88,9 +111,14 @@ bool find_dlg::show(vector<unsigned char>& seq, bool& forward_search)
 
 void find_dlg::fill_hex()
 {
+	static const wchar_t digits[] = L"0123456789ABCDEF";
 	wchar_t txt[MAX_SEQ_SIZE*3 + 1]={};
 	const size_t len = std::min(_seq.size(), MAX_SEQ_SIZE);
-	for (size_t i = 0; i < len; ++i) swprintf_ws2ls(&txt[i*3], ARRAYSIZE(txt), L"%02X ", (unsigned)_seq[i]);
+	for (size_t i = 0; i < len; ++i) {
+		txt[i*3 + 0] = (_mask[i] & 0xf0) ? digits[_seq[i] >> 4] : L'?';
+		txt[i*3 + 1] = (_mask[i] & 0x0f) ? digits[_seq[i] & 0x0f] : L'?';
+		txt[i*3 + 2] = L' ';
+	}
 	FarDialogItemData item_data{ len*3, txt };
 	_PSI.SendDlgMessage(_dialog, DM_SETTEXT, DLGID_HEX_EDIT, (LONG_PTR)&item_data);
 }
@@ -172,12 +200,21 @@ intptr_t WINAPI find_dlg::dlg_proc(HANDLE dlg, intptr_t msg, int param1, void* p
 
 		if (param1 == DLGID_HEX_EDIT) {
 			instance->_seq.clear();
+			instance->_mask.clear();
 			size_t pos = 0;
 			while (pos < val_len) {
-				if (val[pos] <= L' ')
+				unsigned char hi_val, hi_mask, lo_val, lo_mask;
+				if (!parse_nibble(val[pos], hi_val, hi_mask))
 					break;
-				const auto v = wcstoul(val + pos, nullptr, 16);
-				instance->_seq.push_back(static_cast<unsigned char>(v));
+				if (pos + 1 < val_len && parse_nibble(val[pos + 1], lo_val, lo_mask)) {
+					instance->_seq.push_back((hi_val << 4) | lo_val);
+					instance->_mask.push_back((hi_mask << 4) | lo_mask);
+				}
+				else {
+					//Single digit is a low nibble
+					instance->_seq.push_back(hi_val);
+					instance->_mask.push_back(0xf0 | hi_mask);
+				}
 				pos += 3;
 			}
 			instance->fill_ans();
@@ -189,6 +226,7 @@ intptr_t WINAPI find_dlg::dlg_proc(HANDLE dlg, intptr_t msg, int param1, void* p
 			instance->_seq.resize(val_len);
 			if (val_len)
 				WideCharToMultiByte(CP_ACP, 0, val, (int)val_len, (LPSTR)&instance->_seq.front(), (int)instance->_seq.size(), nullptr, nullptr);
+			instance->_mask.assign(instance->_seq.size(), 0xff);
 			instance->fill_hex();
 			instance->fill_oem();
 			instance->fill_u16();
@@ -198,6 +236,7 @@ intptr_t WINAPI find_dlg::dlg_proc(HANDLE dlg, intptr_t msg, int param1, void* p
 			instance->_seq.resize(val_len);
 			if (val_len)
 				WideCharToMultiByte(CP_OEMCP, 0, val, (int)val_len, (LPSTR)&instance->_seq.front(), (int)instance->_seq.size(), nullptr, nullptr);
+			instance->_mask.assign(instance->_seq.size(), 0xff);
 			instance->fill_hex();
 			instance->fill_ans();
 			instance->fill_u16();
@@ -207,6 +246,7 @@ intptr_t WINAPI find_dlg::dlg_proc(HANDLE dlg, intptr_t msg, int param1, void* p
 			instance->_seq.resize(val_len * 2);
 			if (val_len)
 				memcpy(&instance->_seq.front(), val, val_len * 2);
+			instance->_mask.assign(instance->_seq.size(), 0xff);
 			instance->fill_hex();
 			instance->fill_ans();
 			instance->fill_oem();
@@ -222,6 +262,7 @@ intptr_t WINAPI find_dlg::dlg_proc(HANDLE dlg, intptr_t msg, int param1, void* p
 				// Second call to perform the conversion
 				WideCharToMultiByte(CP_UTF8, 0, val, (int)val_len, (LPSTR)&instance->_seq.front(), required_size, nullptr, nullptr);
 			}
+			instance->_mask.assign(instance->_seq.size(), 0xff);
 			instance->fill_hex();
 			instance->fill_ans();
 			instance->fill_oem();
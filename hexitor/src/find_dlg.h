@@ -28,10 +28,11 @@ public:
 	/**
 	 * Show 'find' dialog
 	 * \param seq search sequence
+	 * \param mask search mask (bits to compare, 0x0f/0xf0 for wildcard nibbles)
 	 * \param forward_search forward search flag
 	 * \return false if dialog canceled
 	 */
-	bool show(vector<unsigned char>& seq, bool& forward_search);
+	bool show(vector<unsigned char>& seq, vector<unsigned char>& mask, bool& forward_search);
 
 private:
 	//Field fillers
@@ -48,5 +49,6 @@ private:
 private:
 	HANDLE			_dialog;		///< Dialog window handle
 	vector<unsigned char>	_seq;
+	vector<unsigned char>	_mask;
 	bool		_can_update;
 };
\ No newline at end of file
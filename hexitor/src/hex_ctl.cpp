@@ -42,11 +42,12 @@ void hex_ctl::resize(const size_t width, const size_t height)
 }
 
 
-void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const map<UINT64, BYTE>& upd_data, const UINT64 cursor, const bool hex_area)
+void hex_ctl::update(const UINT64 offset, const vector<BYTE>& data, const vector<BYTE>& upd, const UINT64 cursor, const bool hex_area)
 {
-	assert(_height * 0x10 >= ori_data.size());
+	assert(_height * 0x10 >= data.size());
+	assert(upd.size() == data.size());
 	assert(!(offset % 0x10));
-	assert(cursor >= offset && cursor < offset + ori_data.size());
+	assert(cursor >= offset && cursor < offset + data.size());
 
 	//Reset content and colors
 	reset();
@@ -55,7 +56,7 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 		_byte_to_col_map.assign(showed_data_size(), -1);
 	}
 
-	const size_t length = ori_data.size();
+	const size_t length = data.size();
 
 	//Fill buffer
 	const size_t total_row = length / 16;
@@ -68,8 +69,7 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 
 		//Hex values area (common for all codepages)
 		for (size_t col = 0; col < 16 && row * 16 + col < length; ++col) {
-			map<UINT64, BYTE>::const_iterator itup = upd_data.find(offset + static_cast<UINT64>(row) * 0x10 + col);
-			const BYTE val = itup == upd_data.end() ? ori_data[row * 0x10 + col] : itup->second;
+			const BYTE val = data[row * 0x10 + col];
 
 			//Hex value
 			wchar_t hex_val[3];
@@ -77,7 +77,7 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 			write(row, 15 + col * 3, hex_val, hex_val_len);
 
 			 //Set color for updated data
-			if (itup != upd_data.end()) {
+			if (upd[row * 0x10 + col]) {
 				write(row, 15 + col * 3 + 0, settings.clr_updated);
 				write(row, 15 + col * 3 + 1, settings.clr_updated);
 			}
@@ -87,15 +87,11 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 		if (_codepage == CP_UTF8) {
 			size_t text_col = 0;
 			for (size_t col = 0; col < 16 && row * 16 + col < length; ) {
-				const UINT64 current_offset_abs = offset + static_cast<UINT64>(row) * 0x10 + col;
 				const size_t current_offset_rel = row * 16 + col;
 
 				BYTE sequence[4];
-				bool is_updated = false;
-
-				map<UINT64, BYTE>::const_iterator itup = upd_data.find(current_offset_abs);
-				sequence[0] = (itup == upd_data.end()) ? ori_data[current_offset_rel] : itup->second;
-				if (itup != upd_data.end()) is_updated = true;
+				sequence[0] = data[current_offset_rel];
+				bool is_updated = upd[current_offset_rel] != 0;
 
 				int expected_len = 0;
 				if ((sequence[0] & 0x80) == 0)      expected_len = 1;
@@ -108,9 +104,8 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 				}
 
 				for (int i = 1; i < expected_len; ++i) {
-					itup = upd_data.find(current_offset_abs + i);
-					sequence[i] = (itup == upd_data.end()) ? ori_data[current_offset_rel + i] : itup->second;
-					if (itup != upd_data.end()) is_updated = true;
+					sequence[i] = data[current_offset_rel + i];
+					if (upd[current_offset_rel + i]) is_updated = true;
 				}
 
 				wchar_t pval[2] = {0};
@@ -140,9 +135,7 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 			}
 		} else { // Other codepages (ANSI, OEM, UTF-16)
 			for (size_t col = 0; col < 16 && row * 16 + col < length; ++col) {
-				const UINT64 current_offset_abs = offset + static_cast<UINT64>(row) * 0x10 + col;
-				map<UINT64, BYTE>::const_iterator itup = upd_data.find(current_offset_abs);
-				const BYTE val = itup == upd_data.end() ? ori_data[row * 16 + col] : itup->second;
+				const BYTE val = data[row * 16 + col];
 
 				if (_codepage != CP_UTF16LE) {
 					wchar_t pval = L' ';
@@ -150,11 +143,10 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 					write(row, 64 + col, pval);
 				}
 				else if (col % 2 == 0) {
-					map<UINT64, BYTE>::const_iterator itup2 = upd_data.find(current_offset_abs + 1);
-					const BYTE val_second = (itup2 != upd_data.end() ? itup2->second : row * 16 + col + 1 < ori_data.size() ? ori_data[row * 16 + col + 1] : 0);
+					const BYTE val_second = row * 16 + col + 1 < length ? data[row * 16 + col + 1] : 0;
 					write(row, 64 + col / 2, (wchar_t)MAKEWORD(val, val_second));
 				}
-				if (itup != upd_data.end()) {
+				if (upd[row * 16 + col]) {
 					write(row, 64 + col / (_codepage == CP_UTF16LE ? 2 : 1), settings.clr_updated);
 				}
 			}
@@ -176,22 +168,19 @@ void hex_ctl::update(const UINT64 offset, const vector<BYTE>& ori_data, const ma
 
 		// Find the beginning of the character by moving backwards
 		int limit = 6; // Sane limit for backward search
-		while (rel_offset > 0 && limit-- > 0 && (ori_data[rel_offset] & 0xC0) == 0x80) {
+		while (rel_offset > 0 && limit-- > 0 && (data[rel_offset] & 0xC0) == 0x80) {
 			start_char_offset--;
 			rel_offset--;
 		}
 
 		// Determine character length
-		BYTE first_byte = (start_char_offset >= offset) ? ori_data[rel_offset] : 0;
-		if (upd_data.count(start_char_offset)) {
-			first_byte = upd_data.at(start_char_offset);
-		}
+		const BYTE first_byte = data[rel_offset];
 
 		int char_len = get_utf8_char_len(first_byte);
 
 		// Highlight all bytes of the character in the hex area
 		for (int i = 0; i < char_len; ++i) {
-			if (start_char_offset + i < offset + ori_data.size()) {
+			if (start_char_offset + i < offset + length) {
 				const COORD pos_hex_byte = cursor_from_offset(offset, start_char_offset + i, true);
 				write(pos_hex_byte.Y, pos_hex_byte.X + 0, settings.clr_active);
 				write(pos_hex_byte.Y, pos_hex_byte.X + 1, settings.clr_active);
@@ -52,12 +52,12 @@ public:
 	/**
 	 * Update content buffer
 	 * \param offset start offset value
-	 * \param ori_data original data array
-	 * \param upd_data updated data map
+	 * \param data data array (current content)
+	 * \param upd array of flags of updated bytes
 	 * \param cursor cursor position (offset)
 	 * \param hex_area cursor in hex area flag
 	 */
-	void update(const UINT64 offset, const vector<BYTE>& ori_data, const map<UINT64, BYTE>& upd_data, const UINT64 cursor, const bool hex_area);
+	void update(const UINT64 offset, const vector<BYTE>& data, const vector<BYTE>& upd, const UINT64 cursor, const bool hex_area);
 
 	/**
 	 * Calculate display cursor coordinates from offset
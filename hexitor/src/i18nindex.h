@@ -21,6 +21,7 @@ ps_cfg_std_csize,
 ps_err_open_file,
 ps_err_read_file,
 ps_err_save_file,
+ps_err_save_kept,
 ps_find_backward,
 ps_find_empty,
 ps_find_not_found,
@@ -56,6 +56,12 @@ void statusbar_ctl::write_mode_flag(const bool rw)
 }
 
 
+void statusbar_ctl::write_insert_flag(const bool ins)
+{
+	write(0, 52, ins ? L'I' : L' ');
+}
+
+
 void statusbar_ctl::write_update_flag(const bool upd)
 {
 	write(0, 53, upd ? L'*' : L' ');
@@ -46,6 +46,12 @@ public:
 	 */
 	void write_mode_flag(const bool rw);
 
+	/**
+	 * Write insert/overwrite mode flag to the status line
+	 * \param ins true if insert mode is on
+	 */
+	void write_insert_flag(const bool ins);
+
 	/**
 	 * Write 'updated' flag state to the status line
 	 * \param upd new state flag
@@ -0,0 +1,43 @@
+// measures reading, sorting and redrawing panel with 200k entries
+mydir=WorkDir()
+profile=mydir + "/profile"
+home=mydir + "/home"
+bigdir=mydir + "/bigdir"
+MkdirsAll([profile, home, bigdir], 0700)
+MkEmptyFiles(bigdir, "file", 200000)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", home, "-cd", home]);
+ExpectString("Help - FAR2L");
+TypeEscape()
+ExpectString("OSC52");
+TypeEscape()
+Sync(0)
+
+AutoSync(0)
+BenchBegin("panel-open-200k")
+TypeText("cd '" + bigdir + "'")
+TypeEnter()
+Sync(600000)
+ExpectString("bigdir", 0, 0, 0, 1)
+BenchEnd()
+
+BenchBegin("panel-scroll-200k")
+TypeEnd()
+TypeHome()
+TypePageDown(50)
+Sync(600000)
+BenchEnd()
+
+BenchBegin("panel-reread-200k")
+ToggleLCtrl(true)
+TypeText("R")
+ToggleLCtrl(false)
+Sync(600000)
+BenchEnd()
+AutoSync(10000)
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?")
+TypeEnter()
+ExpectAppExit(0, 60000)
+0;
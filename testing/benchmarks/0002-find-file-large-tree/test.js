@@ -0,0 +1,39 @@
+// measures Find File over tree of 400 directories containing 100 files each
+mydir=WorkDir()
+profile=mydir + "/profile"
+tree=mydir + "/tree"
+MkdirsAll([profile, tree], 0700)
+for (i = 0; i < 20; ++i) {
+	for (j = 0; j < 20; ++j) {
+		dir = tree + "/d" + i + "/d" + j
+		MkdirAll(dir, 0700)
+		MkEmptyFiles(dir, "f", 100)
+	}
+}
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", tree, "-cd", tree]);
+ExpectString("Help - FAR2L");
+TypeEscape()
+ExpectString("OSC52");
+TypeEscape()
+Sync(0)
+
+AutoSync(0)
+BenchBegin("find-file-names")
+ToggleLAlt(true)
+TypeFKey(7)
+ToggleLAlt(false)
+ExpectString("═══ Find file")
+TypeEnter()
+ExpectString("Search done.", 0, 0, 0, 0, 600000)
+BenchEnd()
+
+TypeEscape()
+ExpectNoString("═══ Find file")
+AutoSync(10000)
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?")
+TypeEnter()
+ExpectAppExit(0, 60000)
+0;
@@ -0,0 +1,41 @@
+// measures loading of 1GB text file into editor and jumping to its end
+mydir=WorkDir()
+profile=mydir + "/profile"
+dir=mydir + "/dir"
+MkdirsAll([profile, dir], 0700)
+MkTextFile(dir + "/big.txt", 1024 * 1024 * 1024, 100)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", dir, "-cd", dir]);
+ExpectString("Help - FAR2L");
+TypeEscape()
+ExpectString("OSC52");
+TypeEscape()
+TypeDown()
+Sync(0)
+
+AutoSync(0)
+BenchBegin("edit-open-1gb")
+TypeFKey(4)
+ExpectString("00000000 The quick", 0, 0, 0, 0, 600000)
+Sync(600000)
+BenchEnd()
+
+BenchBegin("edit-goto-end-1gb")
+ToggleLCtrl(true)
+TypeEnd()
+ToggleLCtrl(false)
+ExpectString("10737418 The quick", 0, 0, 0, 0, 600000)
+BenchEnd()
+
+BenchBegin("edit-close-1gb")
+TypeEscape()
+ExpectNoString("big.txt", 0, 0, 0, 1, 600000)
+Sync(600000)
+BenchEnd()
+AutoSync(10000)
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?")
+TypeEnter()
+ExpectAppExit(0, 60000)
+0;
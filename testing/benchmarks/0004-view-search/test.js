@@ -0,0 +1,34 @@
+// measures viewer search through 256MB file for string that is absent there
+mydir=WorkDir()
+profile=mydir + "/profile"
+dir=mydir + "/dir"
+MkdirsAll([profile, dir], 0700)
+MkTextFile(dir + "/big.txt", 256 * 1024 * 1024, 100)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", dir, "-cd", dir]);
+ExpectString("Help - FAR2L");
+TypeEscape()
+ExpectString("OSC52");
+TypeEscape()
+TypeDown()
+TypeFKey(3)
+ExpectString("dir/big.txt")
+Sync(0)
+
+AutoSync(0)
+BenchBegin("view-search-absent-256mb")
+TypeFKey(7)
+ExpectString("═══ Search ═══")
+TypeText("NoSuchNeedleHere")
+TypeEnter()
+ExpectString("Could not find the string", 0, 0, 0, 0, 600000)
+BenchEnd()
+TypeEscape()
+AutoSync(10000)
+
+TypeEscape()
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?")
+TypeEnter()
+ExpectAppExit(0, 60000)
+0;
@@ -0,0 +1,36 @@
+// measures VT throughput: cat of 100MB log file in built-in terminal
+mydir=WorkDir()
+profile=mydir + "/profile"
+dir=mydir + "/dir"
+MkdirsAll([profile, dir], 0700)
+MkTextFile(mydir + "/big.log", 100 * 1024 * 1024, 120)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", dir, "-cd", dir]);
+ExpectString("Help - FAR2L");
+TypeEscape()
+ExpectString("OSC52");
+TypeEscape()
+
+ToggleLCtrl(true)
+TypeText("O")
+ToggleLCtrl(false)
+ExpectNoString("dir", 0, 0, 0, 1);
+
+TypeText("echo 'VT' 'Shell' 'ready'")
+TypeEnter()
+ExpectString("VT Shell ready")
+ExpectString("↑", -1, -2, 1, 1)
+
+AutoSync(0)
+BenchBegin("vt-cat-100mb")
+TypeText("cat '" + mydir + "/big.log'; echo 'CAT' 'DONE'")
+TypeEnter()
+ExpectString("CAT DONE", 0, 0, 0, 0, 600000)
+ExpectString("↑", -1, -2, 1, 1, 600000)
+BenchEnd()
+AutoSync(10000)
+
+TypeText("exit far")
+TypeEnter()
+ExpectAppExit(0, 60000)
+0;
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+set -e
+
+APP="$1"
+if [ "$APP" = "" ]; then
+	echo 'Please specify path to far2l binary as argument'
+	echo 'Note that far2l must be built with -DTESTING=Yes'
+	echo 'Optional 2nd argument is prefix of benchmarks to run'
+	echo 'Results are written to JSON file specified by BENCH_RESULTS env (bench-results.json by default)'
+	exit 1
+fi
+RESULTS="${BENCH_RESULTS:-bench-results.json}"
+cd src
+make
+cd ..
+
+echo 'Cleaning up...'
+for bench in benchmarks/*; do
+	rm -rf "$bench"/workdir
+done
+
+if [ "$2" == "clean" ]; then
+	exit 0
+fi
+
+echo 'Starting benchmarks:' benchmarks/"$2"*
+for bench in benchmarks/*; do
+	mkdir -p "$bench"/workdir
+done
+
+./far2l-smoke -t 600 -j "$RESULTS" "$APP" benchmarks/"$2"*
+
+echo 'Cleaning up...'
+for bench in benchmarks/*; do
+	rm -rf "$bench"/workdir
+done
@@ -0,0 +1,146 @@
+package main
+
+import (
+	"os"
+	"log"
+	"fmt"
+	"time"
+	"bufio"
+	"strings"
+	"path/filepath"
+	"encoding/json"
+	"encoding/binary"
+)
+
+type far2l_Stats struct {
+	UserMSec float64
+	SysMSec float64
+	PeakRSSKB uint64
+	OutputChanges uint32
+}
+
+type bench_Result struct {
+	Test string `json:"test"`
+	Name string `json:"name"`
+	WallMSec float64 `json:"wall_ms"`
+	UserMSec float64 `json:"user_ms"`
+	SysMSec float64 `json:"sys_ms"`
+	PeakRSSKB uint64 `json:"peak_rss_kb"`
+	ConsoleWrites uint32 `json:"console_writes"`
+}
+
+type bench_Pending struct {
+	Name string
+	Started time.Time
+	Stats far2l_Stats
+}
+
+const far2lStatsPacketSize = 32
+
+var g_bench_json string
+var g_bench_test string
+var g_bench_pending []bench_Pending
+var g_bench_results []bench_Result
+
+func far2l_ReqRecvStats() far2l_Stats {
+	binary.LittleEndian.PutUint32(g_buf[0:], 8) // TEST_CMD_STATS
+	far2l_WriteToPeer(g_buf[0:4])
+	far2l_ReadSocket(far2lStatsPacketSize, 0)
+	return far2l_Stats {
+		UserMSec: float64(binary.LittleEndian.Uint64(g_buf[0:])) / 1000,
+		SysMSec: float64(binary.LittleEndian.Uint64(g_buf[8:])) / 1000,
+		PeakRSSKB: binary.LittleEndian.Uint64(g_buf[16:]),
+		OutputChanges: binary.LittleEndian.Uint32(g_buf[24:]),
+	}
+}
+
+func far2l_AppStats() far2l_Stats {
+	performAutoSync()
+	return far2l_ReqRecvStats()
+}
+
+func bench_Begin(name string) {
+	performAutoSync()
+	g_bench_pending = append(g_bench_pending, bench_Pending{Name: name, Stats: far2l_ReqRecvStats(), Started: time.Now()})
+	log.Println("BenchBegin:", name)
+}
+
+func bench_End() bench_Result {
+	// not doing autosync here: caller already awaited completion by some Expect* so
+	// waiting for idle input queue would only add unrelated latency into measurement
+	ended := time.Now()
+	if len(g_bench_pending) == 0 {
+		setErrorString("BenchEnd without BenchBegin")
+		return bench_Result{}
+	}
+	pending := g_bench_pending[len(g_bench_pending) - 1]
+	g_bench_pending = g_bench_pending[:len(g_bench_pending) - 1]
+	stats := far2l_ReqRecvStats()
+	result := bench_Result {
+		Test: g_bench_test,
+		Name: pending.Name,
+		WallMSec: float64(ended.Sub(pending.Started).Microseconds()) / 1000,
+		UserMSec: stats.UserMSec - pending.Stats.UserMSec,
+		SysMSec: stats.SysMSec - pending.Stats.SysMSec,
+		PeakRSSKB: stats.PeakRSSKB,
+		ConsoleWrites: stats.OutputChanges - pending.Stats.OutputChanges,
+	}
+	g_bench_results = append(g_bench_results, result)
+	log.Printf("BenchEnd: %s wall=%.1fms user=%.1fms sys=%.1fms peak_rss=%dKB console_writes=%d",
+		result.Name, result.WallMSec, result.UserMSec, result.SysMSec, result.PeakRSSKB, result.ConsoleWrites)
+	return result
+}
+
+func bench_SaveResults() {
+	if g_bench_json == "" {
+		return
+	}
+	data, err := json.MarshalIndent(g_bench_results, "", "\t")
+	if err == nil {
+		err = os.WriteFile(g_bench_json, append(data, '\n'), 0644)
+	}
+	if err != nil {
+		log.Println("\x1b[1;31mFailed to save benchmark results: " + err.Error() + "\x1b[39;22m")
+	} else {
+		log.Println("Benchmark results saved to", g_bench_json)
+	}
+}
+
+// Creates count empty files named prefix0, prefix1... in given directory, much faster than Mkfiles
+func aux_MkEmptyFiles(dir string, prefix string, count int) bool {
+	performAutoSync()
+	for i := 0; i < count; i++ {
+		f, err := os.OpenFile(filepath.Join(dir, fmt.Sprintf("%s%d", prefix, i)), os.O_CREATE | os.O_WRONLY, 0644)
+		if !assertNoError(err) {
+			return false
+		}
+		f.Close()
+	}
+	return true
+}
+
+// Creates text file of given size composed of numbered lines of printable characters
+func aux_MkTextFile(path string, size uint64, line_len uint32) bool {
+	performAutoSync()
+	if line_len < 16 {
+		line_len = 16
+	}
+	f, err := os.Create(path)
+	if !assertNoError(err) {
+		return false
+	}
+	defer f.Close()
+	w := bufio.NewWriterSize(f, 1024 * 1024)
+	filler := strings.Repeat("The quick brown fox jumps over the lazy dog ", int(line_len / 44) + 1)
+	for written, n := uint64(0), uint64(0); written < size; n++ {
+		line := fmt.Sprintf("%08d %s", n, filler)[:line_len - 1] + "\n"
+		if written + uint64(len(line)) > size {
+			line = line[:size - written]
+		}
+		if _, err = w.WriteString(line); !assertNoError(err) {
+			return false
+		}
+		written+= uint64(len(line))
+	}
+	return assertNoError(w.Flush())
+}
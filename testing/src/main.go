@@ -373,6 +373,9 @@ func initVM() {
 	setVMFunction("AppStatus", far2l_ReqRecvStatus)
 	setVMFunction("Sync", far2l_Sync)
 	setVMFunction("AutoSync", far2l_AutoSync)
+	setVMFunction("AppStats", far2l_AppStats)
+	setVMFunction("BenchBegin", bench_Begin)
+	setVMFunction("BenchEnd", bench_End)
 
 	setVMFunction("ReadCellRaw", far2l_ReqRecvReadCellRaw)
 	setVMFunction("ReadCell", far2l_ReqRecvReadCell)
@@ -459,6 +462,8 @@ func initVM() {
 	setVMFunction("MkdirsAll", aux_MkdirsAll)
 	setVMFunction("Mkfile", aux_Mkfile)
 	setVMFunction("Mkfiles", aux_Mkfiles)
+	setVMFunction("MkEmptyFiles", aux_MkEmptyFiles)
+	setVMFunction("MkTextFile", aux_MkTextFile)
 	setVMFunction("HashPath", aux_HashPath)
 	setVMFunction("HashPathes", aux_HashPathes)
 	setVMFunction("CheckFilesDataSame", aux_CheckFilesDataSame)
@@ -486,13 +491,16 @@ func main() {
 			v, err := strconv.Atoi(os.Args[arg_ofs])
 			if err != nil || v < 0 { aux_Panic("timeout must be positive integer value") }
 			g_recv_timeout = uint32(v)
+		} else if os.Args[arg_ofs] == "-j" && arg_ofs + 1 < len(os.Args) {
+			arg_ofs++
+			g_bench_json = os.Args[arg_ofs]
 		} else {
 			break
 		}
 	}
 
 	if len(os.Args) < arg_ofs + 2 {
-		log.Fatal("Usage: far2l-smoke [-t TIMEOUT_SEC] /path/to/far2l /path/to/test1 [/path/to/test2 [/path/to/test3 ...]]\n")
+		log.Fatal("Usage: far2l-smoke [-t TIMEOUT_SEC] [-j BENCH_RESULTS.json] /path/to/far2l /path/to/test1 [/path/to/test2 [/path/to/test3 ...]]\n")
 	}
 	log.SetFlags(log.LUTC | log.Ltime | log.Lmicroseconds)
 	g_far2l_sock = fmt.Sprintf("/tmp/far2l%d.sock", os.Getpid())
@@ -522,8 +530,10 @@ func main() {
 		testdir, err := filepath.Abs(os.Args[i])
 		if err != nil { log.Fatal(err) }
 		g_test_workdir = filepath.Join(testdir, "workdir")
+		g_bench_test = name
 		runTest(filepath.Join(testdir, "test.js"))
 	}
+	bench_SaveResults()
 }
 
 func runTest(file string) {
@@ -533,6 +543,7 @@ func runTest(file string) {
 	g_autosync = 10000
 	g_calm = false
 	g_last_error = ""
+	g_bench_pending = nil
 	data, err := ioutil.ReadFile(file)
 	if err != nil {
 		panic("[FAILED] Error '" + err.Error() + "' reading test" + file)
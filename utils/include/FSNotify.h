@@ -13,4 +13,5 @@ enum FSNotifyWhat
 	FSNW_NAMES_AND_STATS
 };
 
-IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what);
+// on_change (if not NULL) invoked from watcher thread once when change detected first time
+IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what, void (*on_change)() = nullptr);
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Simple byte-oriented LZ77 block codec (LZ4-alike sequences of literals and matches).
+// Tuned for speed rather than ratio, intended to reduce size of textual data sent over slow links.
+// Decompressor is strict and validates all lengths and offsets, so it can be used on untrusted input.
+
+// Appends compressed representation of given data to out, returns count of appended bytes.
+size_t LZBlockCompress(std::vector<unsigned char> &out, const unsigned char *src, size_t len);
+
+// Decompresses data that must decode exactly into dst_len bytes, returns false on malformed input.
+bool LZBlockDecompress(unsigned char *dst, size_t dst_len, const unsigned char *src, size_t len);
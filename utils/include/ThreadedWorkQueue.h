@@ -69,6 +69,10 @@ public:
 	/// Waits for dispatch of all pending items, invoke before d-tor to make sure all items processed.
 	/// Invokes CompleteProc() of finally processed items and destroys them.
 	void Finalize();
+
+	/// Same as Finalize() but gives up waiting after given amount of milliseconds elapsed.
+	/// Returns true if all pending items were processed, false if timeout happened.
+	bool Finalize(unsigned int timeout_msec);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
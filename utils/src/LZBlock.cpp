@@ -0,0 +1,140 @@
+#include "LZBlock.h"
+#include <string.h>
+#include <stdint.h>
+
+// Block is a sequence of:
+//  token: high nibble - literals count, low nibble - match length minus LZ_MIN_MATCH
+//  optional literals count extension: bytes of 255 terminated by byte < 255
+//  literals
+//  match offset: 2 bytes little-endian, nonzero
+//  optional match length extension: same encoding as literals count extension
+// Last sequence consists of token and literals only.
+
+#define LZ_MIN_MATCH      4
+#define LZ_MAX_OFFSET     0xffff
+#define LZ_HASH_BITS      14
+
+static inline uint32_t LZRead32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t LZHash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static void LZPutLength(std::vector<unsigned char> &out, size_t v)
+{
+	for (; v >= 255; v-= 255) {
+		out.push_back(255);
+	}
+	out.push_back((unsigned char)v);
+}
+
+static void LZPutSequence(std::vector<unsigned char> &out,
+	const unsigned char *lit, size_t lit_len, size_t match_len, size_t offset)
+{
+	const size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+	out.push_back((unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (match_code < 15 ? match_code : 15)));
+	if (lit_len >= 15) {
+		LZPutLength(out, lit_len - 15);
+	}
+	out.insert(out.end(), lit, lit + lit_len);
+	if (match_len) {
+		out.push_back((unsigned char)(offset & 0xff));
+		out.push_back((unsigned char)(offset >> 8));
+		if (match_code >= 15) {
+			LZPutLength(out, match_code - 15);
+		}
+	}
+}
+
+size_t LZBlockCompress(std::vector<unsigned char> &out, const unsigned char *src, size_t len)
+{
+	const size_t initial_size = out.size();
+	out.reserve(initial_size + len + len / 255 + 16);
+
+	size_t anchor = 0;
+	if (len > LZ_MIN_MATCH) {
+		std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0); // positions plus one, zero means empty
+		for (size_t i = 0; i + LZ_MIN_MATCH <= len;) {
+			const uint32_t v = LZRead32(&src[i]);
+			uint32_t &slot = table[LZHash(v)];
+			const size_t candidate = slot;
+			slot = uint32_t(i + 1);
+			if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET || LZRead32(&src[candidate - 1]) != v) {
+				// skip faster through incompressible data
+				i+= 1 + ((i - anchor) >> 6);
+				continue;
+			}
+			const size_t match_pos = candidate - 1;
+			size_t match_len = LZ_MIN_MATCH;
+			while (i + match_len < len && src[match_pos + match_len] == src[i + match_len]) {
+				++match_len;
+			}
+			LZPutSequence(out, &src[anchor], i - anchor, match_len, i - match_pos);
+			i+= match_len;
+			anchor = i;
+		}
+	}
+	LZPutSequence(out, &src[anchor], len - anchor, 0, 0);
+
+	return out.size() - initial_size;
+}
+
+static bool LZGetLength(const unsigned char *&src, const unsigned char *end, size_t &v)
+{
+	for (;;) {
+		if (src == end) {
+			return false;
+		}
+		const unsigned char b = *(src++);
+		v+= b;
+		if (b != 255) {
+			return true;
+		}
+	}
+}
+
+bool LZBlockDecompress(unsigned char *dst, size_t dst_len, const unsigned char *src, size_t len)
+{
+	const unsigned char *end = src + len;
+	size_t pos = 0;
+	while (src != end) {
+		const unsigned char token = *(src++);
+		size_t lit_len = token >> 4;
+		if (lit_len == 15 && !LZGetLength(src, end, lit_len)) {
+			return false;
+		}
+		if (lit_len > size_t(end - src) || lit_len > dst_len - pos) {
+			return false;
+		}
+		memcpy(&dst[pos], src, lit_len);
+		src+= lit_len;
+		pos+= lit_len;
+		if (src == end) {
+			break;
+		}
+
+		if (end - src < 2) {
+			return false;
+		}
+		const size_t offset = size_t(src[0]) | (size_t(src[1]) << 8);
+		src+= 2;
+		size_t match_len = token & 0xf;
+		if (match_len == 15 && !LZGetLength(src, end, match_len)) {
+			return false;
+		}
+		match_len+= LZ_MIN_MATCH;
+		if (offset == 0 || offset > pos || match_len > dst_len - pos) {
+			return false;
+		}
+		for (size_t i = 0; i < match_len; ++i, ++pos) { // may overlap, so copy bytewise
+			dst[pos] = dst[pos - offset];
+		}
+	}
+	return pos == dst_len;
+}
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdexcept>
+#include <chrono>
 
 class ThreadedWorker : public Threaded
 {
@@ -171,6 +172,24 @@ void ThreadedWorkQueue::Finalize()
 	}
 }
 
+bool ThreadedWorkQueue::Finalize(unsigned int timeout_msec)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_msec);
+	OrderedItemsDestroyer oid;
+	std::unique_lock<std::mutex> lock(_mtx);
+	for (;;) {
+		FetchOrderedDoneItems(oid);
+		if (_backlog.empty() && _working == 0) {
+			return true;
+		}
+		_notify_on_done = true;
+		if (_cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+			FetchOrderedDoneItems(oid);
+			return false;
+		}
+	}
+}
+
 // must be invoked under _mtx lock held
 void ThreadedWorkQueue::FetchOrderedDoneItems(OrderedItemsDestroyer &oid)
 {
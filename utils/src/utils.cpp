@@ -41,16 +41,14 @@ void CheckedCloseFDPair(int *fd)
 size_t WriteAll(int fd, const void *data, size_t len, size_t chunk)
 {
 	for (size_t ofs = 0; ofs < len; ) {
-		if (chunk == (size_t)-1 || chunk >= len) {
-			chunk = len;
-		}
-		ssize_t written = write(fd, (const char *)data + ofs, chunk);
+		const size_t piece = std::min(chunk, len - ofs);
+		ssize_t written = write(fd, (const char *)data + ofs, piece);
 		if (written <= 0) {
 			if (errno != EAGAIN && errno != EINTR) {
 				return ofs;
 			}
 		} else {
-			ofs+= std::min((size_t)written, chunk);
+			ofs+= std::min((size_t)written, piece);
 		}
 	}
 	return len;